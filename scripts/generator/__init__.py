@@ -1,2 +1,3 @@
 from .config import GeneratorConfig
-from .generator import BasicSampleGenerator
\ No newline at end of file
+from .generator import BasicSampleGenerator
+from .dataset import SampleDataset, DatasetSampleGenerator
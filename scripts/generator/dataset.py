@@ -0,0 +1,91 @@
+import bisect
+import glob
+import os
+import random
+import struct
+import numpy as np
+from PIL import Image
+
+# Shards written by soccerbot_generator which are memory mapped and read in place
+# Each shard is a header, the label of every sample and then the top-down RGB8 image of every sample
+SHARD_MAGIC = b"SBDS"
+SHARD_VERSION = 1
+SHARD_HEADER = struct.Struct("<4s5I3Q")
+LABEL_DTYPE = np.dtype([
+    ("x_centre", "<f4"),
+    ("y_centre", "<f4"),
+    ("width", "<f4"),
+    ("height", "<f4"),
+    ("has_ball", "<u4"),
+])
+
+class SampleShard:
+    def __init__(self, filepath):
+        with open(filepath, "rb") as fp:
+            header = fp.read(SHARD_HEADER.size)
+        if len(header) != SHARD_HEADER.size:
+            raise ValueError(f"Sample shard is too small: '{filepath}'")
+
+        magic, version, width, height, channels, total_samples, labels_offset, images_offset, image_stride = SHARD_HEADER.unpack(header)
+        if magic != SHARD_MAGIC:
+            raise ValueError(f"Invalid sample shard magic {magic} in '{filepath}'")
+        if version != SHARD_VERSION:
+            raise ValueError(f"Unsupported sample shard version {version} in '{filepath}'")
+
+        self.filepath = filepath
+        self.width = width
+        self.height = height
+        self.channels = channels
+        data = np.memmap(filepath, dtype=np.uint8, mode="r")
+        self.labels = np.ndarray((total_samples,), dtype=LABEL_DTYPE, buffer=data, offset=labels_offset)
+        # NOTE: Images are padded to be aligned so they can be further apart than their size
+        self.images = np.ndarray(
+            (total_samples, height, width, channels), dtype=np.uint8, buffer=data, offset=images_offset,
+            strides=(image_stride, width*channels, channels, 1))
+
+    def __len__(self):
+        return self.labels.shape[0]
+
+class SampleDataset:
+    def __init__(self, path):
+        filepaths = sorted(glob.glob(os.path.join(path, "*.sbds")))
+        if not filepaths:
+            raise ValueError(f"No sample shards were found in: '{path}'")
+
+        self.shards = [SampleShard(filepath) for filepath in filepaths]
+        self.width = self.shards[0].width
+        self.height = self.shards[0].height
+        for shard in self.shards:
+            if (shard.width, shard.height) != (self.width, self.height):
+                raise ValueError(f"Sample shard '{shard.filepath}' is {shard.width}x{shard.height} instead of {self.width}x{self.height}")
+
+        # index of the first sample in each shard
+        self.offsets = []
+        total_samples = 0
+        for shard in self.shards:
+            self.offsets.append(total_samples)
+            total_samples += len(shard)
+        self.total_samples = total_samples
+
+    def __len__(self):
+        return self.total_samples
+
+    # same as BasicSampleGenerator.create_sample except the image is a read only H,W,C array
+    def get_sample(self, index):
+        shard_index = bisect.bisect_right(self.offsets, index)-1
+        shard = self.shards[shard_index]
+        label = shard.labels[index-self.offsets[shard_index]]
+        image = shard.images[index-self.offsets[shard_index]]
+        bounding_box = (float(label["x_centre"]), float(label["y_centre"]), float(label["width"]), float(label["height"]))
+        has_ball = int(label["has_ball"])
+        return (image, bounding_box, has_ball)
+
+# Draws random samples from a dataset in place of generating them
+class DatasetSampleGenerator:
+    def __init__(self, path):
+        self.dataset = SampleDataset(path)
+
+    def create_sample(self):
+        index = random.randrange(len(self.dataset))
+        image, bounding_box, has_ball = self.dataset.get_sample(index)
+        return (Image.fromarray(image), bounding_box, has_ball)
@@ -0,0 +1,221 @@
+import struct
+
+NATIVE_MODEL_MAGIC = b"SBNM"
+NATIVE_MODEL_VERSION = 1
+
+LAYER_CONV2D = 0
+LAYER_DEPTHWISE_CONV2D = 1
+LAYER_MAX_POOL2D = 2
+LAYER_DENSE = 3
+
+ACTIVATION_NONE = 0
+ACTIVATION_RELU = 1
+ACTIVATION_LEAKY_RELU = 2
+
+def get_layers(module):
+    # flatten nested modules into the order they are run
+    # NOTE: This assumes modules are registered in the same order as forward() uses them
+    import torch.nn as nn
+    layers = []
+    for child in module.children():
+        if isinstance(child, (nn.Conv2d, nn.MaxPool2d, nn.Linear, nn.ReLU, nn.LeakyReLU, nn.Flatten)):
+            layers.append(child)
+        else:
+            layers.extend(get_layers(child))
+    return layers
+
+def to_array(tensor):
+    return tensor.detach().cpu().float().contiguous()
+
+class NativeLayer:
+    def __init__(self, layer_type, kernel_size, in_channels, out_channels, weights=None, biases=None):
+        self.type = layer_type
+        self.activation = ACTIVATION_NONE
+        self.negative_slope = 0.0
+        self.kernel_size = kernel_size
+        self.in_channels = in_channels
+        self.out_channels = out_channels
+        self.weights = weights
+        self.biases = biases
+
+def convert_model(model, height, width, channels):
+    # convert pytorch layers to channels last (NHWC) layers
+    # we track the shape so dense layers can be permuted from (C,H,W) to (H,W,C) flatten order
+    import torch
+    import torch.nn as nn
+    native_layers = []
+    for layer in get_layers(model):
+        if isinstance(layer, nn.Conv2d):
+            kernel_size = layer.kernel_size[0]
+            if layer.kernel_size != (kernel_size, kernel_size):
+                raise Exception(f"Only square kernels are supported: {layer}")
+            if layer.stride != (1,1) or layer.dilation != (1,1) or layer.padding not in ((0,0), "valid"):
+                raise Exception(f"Only unit stride convolutions without padding are supported: {layer}")
+            weight = to_array(layer.weight)
+            bias = to_array(layer.bias) if layer.bias is not None else torch.zeros(layer.out_channels)
+            if layer.groups == 1:
+                # (out,in,kh,kw) -> (kh,kw,in,out)
+                weight = weight.permute(2,3,1,0)
+                native_layers.append(NativeLayer(LAYER_CONV2D, kernel_size, layer.in_channels, layer.out_channels, weight, bias))
+            elif layer.groups == layer.in_channels and layer.in_channels == layer.out_channels:
+                # (channels,1,kh,kw) -> (kh,kw,channels)
+                weight = weight[:,0,:,:].permute(1,2,0)
+                native_layers.append(NativeLayer(LAYER_DEPTHWISE_CONV2D, kernel_size, layer.in_channels, layer.out_channels, weight, bias))
+            else:
+                raise Exception(f"Only regular and depthwise convolutions are supported: {layer}")
+            height, width, channels = height-kernel_size+1, width-kernel_size+1, layer.out_channels
+        elif isinstance(layer, nn.MaxPool2d):
+            kernel_size = layer.kernel_size if isinstance(layer.kernel_size, int) else layer.kernel_size[0]
+            stride = layer.stride if isinstance(layer.stride, int) else layer.stride[0]
+            if layer.kernel_size not in (kernel_size, (kernel_size, kernel_size)) or stride != kernel_size or layer.padding not in (0, (0,0)):
+                raise Exception(f"Only square pooling with stride equal to kernel size is supported: {layer}")
+            native_layers.append(NativeLayer(LAYER_MAX_POOL2D, kernel_size, channels, channels))
+            height, width = height//kernel_size, width//kernel_size
+        elif isinstance(layer, nn.Linear):
+            weight = to_array(layer.weight)
+            bias = to_array(layer.bias) if layer.bias is not None else torch.zeros(layer.out_features)
+            if height*width*channels != layer.in_features:
+                raise Exception(f"Dense layer expects {layer.in_features} inputs but got ({channels},{height},{width})")
+            # (out,C*H*W) -> (H*W*C,out) since our activations are flattened channels last
+            weight = weight.reshape(layer.out_features, channels, height, width).permute(2,3,1,0)
+            weight = weight.reshape(layer.in_features, layer.out_features)
+            native_layers.append(NativeLayer(LAYER_DENSE, 0, layer.in_features, layer.out_features, weight, bias))
+            height, width, channels = 1, 1, layer.out_features
+        elif isinstance(layer, (nn.ReLU, nn.LeakyReLU)):
+            if len(native_layers) == 0 or native_layers[-1].type == LAYER_MAX_POOL2D or native_layers[-1].activation != ACTIVATION_NONE:
+                raise Exception(f"Activation must directly follow a convolution or dense layer: {layer}")
+            if isinstance(layer, nn.ReLU):
+                native_layers[-1].activation = ACTIVATION_RELU
+            else:
+                native_layers[-1].activation = ACTIVATION_LEAKY_RELU
+                native_layers[-1].negative_slope = float(layer.negative_slope)
+        elif isinstance(layer, nn.Flatten):
+            # dense layers flatten their input
+            pass
+    return native_layers
+
+def write_native_model(filepath, native_layers, height, width, channels):
+    with open(filepath, "wb") as fp:
+        fp.write(struct.pack("<4sIIIII", NATIVE_MODEL_MAGIC, NATIVE_MODEL_VERSION, width, height, channels, len(native_layers)))
+        for layer in native_layers:
+            fp.write(struct.pack("<IIfIII",
+                layer.type, layer.activation, layer.negative_slope,
+                layer.kernel_size, layer.in_channels, layer.out_channels))
+            if layer.weights is not None:
+                fp.write(layer.weights.numpy().astype("<f4").tobytes())
+                fp.write(layer.biases.numpy().astype("<f4").tobytes())
+
+def run_native_layers(native_layers, x):
+    # reference implementation of the native model that keeps activations channels last
+    # x.shape = H,W,C
+    import torch
+    import torch.nn.functional as F
+    for layer in native_layers:
+        if layer.type == LAYER_CONV2D:
+            weight = layer.weights.permute(3,2,0,1)
+            y = F.conv2d(x.permute(2,0,1)[None], weight, layer.biases)[0].permute(1,2,0)
+        elif layer.type == LAYER_DEPTHWISE_CONV2D:
+            weight = layer.weights.permute(2,0,1)[:,None,:,:]
+            y = F.conv2d(x.permute(2,0,1)[None], weight, layer.biases, groups=layer.in_channels)[0].permute(1,2,0)
+        elif layer.type == LAYER_MAX_POOL2D:
+            y = F.max_pool2d(x.permute(2,0,1)[None], layer.kernel_size)[0].permute(1,2,0)
+        elif layer.type == LAYER_DENSE:
+            y = x.reshape(-1) @ layer.weights + layer.biases
+            y = y.reshape(1,1,-1)
+        if layer.activation == ACTIVATION_RELU:
+            y = F.relu(y)
+        elif layer.activation == ACTIVATION_LEAKY_RELU:
+            y = F.leaky_relu(y, layer.negative_slope)
+        x = y
+    return x.reshape(-1)
+
+if __name__ == '__main__':
+    import argparse
+    from models.select_model import get_model_types, select_model
+    MODEL_TYPES = get_model_types()
+    DEFAULT_MODEL_TYPE = MODEL_TYPES[0]
+    DEFAULT_MODEL_PATH = "./data/checkpoint-*.pt"
+    DEFAULT_NATIVE_PATH = "./data/native-*.bin"
+
+    parser = argparse.ArgumentParser(description="Convert pytorch model to the native inference engine format", formatter_class=argparse.ArgumentDefaultsHelpFormatter)
+    parser.add_argument("--model-type", type=str, default=DEFAULT_MODEL_TYPE, choices=MODEL_TYPES, help="Type of model")
+    parser.add_argument("--model-in", type=str, default=DEFAULT_MODEL_PATH, help="Input path for trained model. * is replaced with --model-type.")
+    parser.add_argument("--model-out", type=str, default=DEFAULT_NATIVE_PATH, help="Output path for native model. * is replaced with --model-type.")
+    parser.add_argument("--asset-path", type=str, default="../assets/", help="Path to game assets")
+    parser.add_argument("--device", type=str, default="directml", help="Device used by checkpoint. Use 'CPU' for cpu training.")
+    parser.add_argument("--total-verify-samples", type=int, default=16, help="Number of random inputs to compare the native layers against the pytorch model")
+    args = parser.parse_args()
+
+    # get the generator config
+    import sys
+    sys.path.append("../")
+    from generator import GeneratorConfig, BasicSampleGenerator
+    import os
+    import pathlib
+    import glob
+
+    PATH_MODEL_IN = args.model_in.replace("*", args.model_type)
+    PATH_MODEL_OUT = args.model_out.replace("*", args.model_type)
+
+    pathlib.Path(os.path.dirname(PATH_MODEL_OUT)).mkdir(parents=True, exist_ok=True)
+    config = GeneratorConfig()
+    config.set_background_image(os.path.join(args.asset_path, "icons/blank.png"))
+    config.set_ball_image(os.path.join(args.asset_path, "icons/ball.png"))
+    emote_filepaths = []
+    emote_filepaths.extend(glob.glob(os.path.join(args.asset_path, "icons/success*.png")))
+    emote_filepaths.extend(glob.glob(os.path.join(args.asset_path, "icons/emote*.png")))
+    config.set_emote_images(emote_filepaths)
+    config.set_score_font(os.path.join(args.asset_path, "fonts/segoeuil.ttf"), 92)
+    generator = BasicSampleGenerator(config)
+    image, bounding_box, has_ball = generator.create_sample()
+    im_original_width, im_original_height = image.size
+    im_channels = 3
+
+    # device which checkpoint is stored as
+    import torch
+    if args.device == "directml":
+        import torch_directml
+        DEVICE = torch_directml.device()
+    else:
+        DEVICE = torch.device(args.device)
+
+    # create the model
+    SoccerBotModel = select_model(args.model_type)
+    DOWNSCALE_RATIO = SoccerBotModel.DOWNSCALE_RATIO
+    im_downscale_width, im_downscale_height = int(im_original_width/DOWNSCALE_RATIO), int(im_original_height/DOWNSCALE_RATIO)
+    model = SoccerBotModel()
+    model = model.to(DEVICE)
+
+    if os.path.exists(PATH_MODEL_IN):
+        try:
+            checkpoint = torch.load(PATH_MODEL_IN)
+            model.load_state_dict(checkpoint['model_state_dict'])
+            curr_epoch = checkpoint.get('curr_epoch', 0)
+            average_loss = checkpoint.get('average_loss', torch.inf)
+            print(f"Checkpoint loaded from '{PATH_MODEL_IN}' with epoch={curr_epoch}, loss={average_loss:.3e}")
+        except Exception as ex:
+            print(f"Checkpoint failed to load from '{PATH_MODEL_IN}': {ex}")
+            exit(1)
+    else:
+        print(f"Checkpoint wasn't found at '{PATH_MODEL_IN}'")
+        exit(1)
+
+    model = model.cpu()
+    model.eval()
+    native_layers = convert_model(model, im_downscale_height, im_downscale_width, im_channels)
+
+    # the pytorch model is what the onnx model is exported from so it is our reference
+    max_error = 0.0
+    with torch.no_grad():
+        for _ in range(args.total_verify_samples):
+            x_in = torch.rand(1, im_downscale_height, im_downscale_width, im_channels)
+            y_expected = model(x_in)[0]
+            y_native = run_native_layers(native_layers, x_in[0])
+            max_error = max(max_error, float((y_expected - y_native).abs().max()))
+    print(f"Native layers have max absolute error of {max_error:.3e} over {args.total_verify_samples} samples")
+    if max_error > 1e-3:
+        print("Native layers don't match the pytorch model")
+        exit(1)
+
+    write_native_model(PATH_MODEL_OUT, native_layers, im_downscale_height, im_downscale_width, im_channels)
+    print(f"Output native model to: '{PATH_MODEL_OUT}'")
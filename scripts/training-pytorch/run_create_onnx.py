@@ -74,5 +74,10 @@ if __name__ == '__main__':
     onnx_model = model.cpu()
     onnx_model.eval()
     x_in = torch.randn(1, im_downscale_height, im_downscale_width, im_channels, requires_grad=True)
-    torch.onnx.export(onnx_model, x_in, PATH_MODEL_OUT)
+    # dynamic batch axis lets several sessions share the model through the inference server
+    torch.onnx.export(
+        onnx_model, x_in, PATH_MODEL_OUT,
+        input_names=["input"], output_names=["output"],
+        dynamic_axes={"input": {0: "batch"}, "output": {0: "batch"}},
+    )
     print(f"Output onnx model to: '{PATH_MODEL_OUT}'")
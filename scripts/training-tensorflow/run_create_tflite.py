@@ -11,6 +11,8 @@ if __name__ == '__main__':
     parser.add_argument("--model-in", type=str, default=DEFAULT_MODEL_PATH, help="Input path for trained model. * is replaced with --model-type.")
     parser.add_argument("--model-out", type=str, default=DEFAULT_QUANT_PATH, help="Output path for quantized model. * is replaced with --model-type.")
     parser.add_argument("--asset-path", type=str, default="../assets/", help="Path to game assets")
+    parser.add_argument("--input-type", type=str, default="float32", choices=["float32", "uint8", "int8"], help="Input tensor type. Integer types fully quantize the model.")
+    parser.add_argument("--total-calibration-samples", type=int, default=200, help="Number of generated samples used to calibrate integer quantization")
     args = parser.parse_args()
 
     # get the generator config
@@ -58,6 +60,17 @@ if __name__ == '__main__':
 
     quant_converter = tf.lite.TFLiteConverter.from_keras_model(model)
     quant_converter.optimizations = [tf.lite.Optimize.DEFAULT]
+    # integer inputs let the inference application write resized pixels without converting to float
+    if args.input_type != "float32":
+        def representative_dataset():
+            for _ in range(args.total_calibration_samples):
+                image, _, _ = generator.create_sample()
+                image = image.convert("RGB").resize((im_downscale_width, im_downscale_height))
+                x_in = np.asarray(image).astype(np.float32) / 255.0
+                yield [x_in[np.newaxis,...]]
+        quant_converter.representative_dataset = representative_dataset
+        quant_converter.target_spec.supported_ops = [tf.lite.OpsSet.TFLITE_BUILTINS_INT8]
+        quant_converter.inference_input_type = tf.uint8 if args.input_type == "uint8" else tf.int8
     quant_model = quant_converter.convert()
 
     with open(PATH_MODEL_OUT, "wb+") as fp:
@@ -7,6 +7,7 @@ if __name__ == "__main__":
 
     parser = argparse.ArgumentParser(description="Run model training", formatter_class=argparse.ArgumentDefaultsHelpFormatter)
     parser.add_argument("--asset-path", type=str, default="../assets/", help="Path to game assets")
+    parser.add_argument("--dataset", type=str, default="", help="Path to shards made by soccerbot_generator. If not provided samples are generated while training.")
     parser.add_argument("--model-type", type=str, default=DEFAULT_MODEL_TYPE, choices=MODEL_TYPES, help="Type of model")
     parser.add_argument("--model-in", type=str, default=DEFAULT_MODEL_PATH, help="Input path for pretrained model. * is replaced with --model-type.")
     parser.add_argument("--model-out", type=str, default=DEFAULT_MODEL_PATH, help="Output path for trained model. * is replaced with --model-type.")
@@ -56,7 +57,12 @@ if __name__ == "__main__":
     emote_filepaths.extend(glob.glob(os.path.join(args.asset_path, "icons/emote*.png")))
     config.set_emote_images(emote_filepaths)
     config.set_score_font(os.path.join(args.asset_path, "fonts/segoeuil.ttf"), 92)
-    generator = BasicSampleGenerator(config)
+    if args.dataset:
+        from generator import DatasetSampleGenerator
+        generator = DatasetSampleGenerator(args.dataset)
+        print(f"Loaded {len(generator.dataset)} samples from '{args.dataset}'")
+    else:
+        generator = BasicSampleGenerator(config)
 
     image, bounding_box, has_ball = generator.create_sample()
     im_original_width, im_original_height = image.size
@@ -2,10 +2,16 @@
 
 #include <algorithm>
 #include <memory>
+#include <string.h>
+#include <timeapi.h>
 
 #include "IModel.h"
+#include "Float16.h"
 #include "SoccerPlayer.h"
 #include "SoccerParams.h"
+#include "MSSFrameSource.h"
+#include "RecordingFrameSource.h"
+#include "AutoGuiMouseController.h"
 #include "util/MSS.h"
 #include "util/AutoGui.h"
 #include "util/KeyListener.h"
@@ -16,24 +22,16 @@ void DrawRectInBuffer(
     RGBA<uint8_t> *buffer, int width, int height, int row_stride);
 
 App::App(
-    std::unique_ptr<IModel>&& model, 
+    std::unique_ptr<IModel>&& model, std::unique_ptr<IModel>&& roi_model, const AppConfig& config,
     ID3D11Device *dx11_device, ID3D11DeviceContext *dx11_context)
 {
     m_mss = std::make_shared<util::MSS>();
-    m_params = std::make_shared<SoccerParams>();
-    {
-        auto &p = *m_params;
-        p.acceleration = 2.5f;
-        p.relative_ball_width = 0.24f;
-        p.input_delay_secs = 0.02f;
-        p.confidence_threshold = 0.5f;
-        p.max_lost_frames = 2;
-
-        p.height_trigger_soft = 0.70f;
-        p.height_trigger_hard = 0.45f;
-        p.fall_speed_trigger_soft = 1.00f;
-        p.fall_speed_trigger_hard = 4.00f;
+    m_frame_source = std::make_shared<MSSFrameSource>(m_mss);
+    if (!config.record_frames_path.empty()) {
+        m_frame_source = std::make_shared<RecordingFrameSource>(m_frame_source, config.record_frames_path.c_str());
     }
+    m_mouse = std::make_shared<AutoGuiMouseController>();
+    m_params = std::make_shared<SoccerParams>();
 
     m_dx11_device = dx11_device;
     m_dx11_context = dx11_context;
@@ -46,7 +44,7 @@ App::App(
     // setup screen shotter
     SetScreenshotSize(320, 455);
 
-    // create a texture for the model resize buffer
+    // create a texture for the model input
     {
         auto res = CreateTexture(m_model_width, m_model_height);
         m_model_texture = res.texture;
@@ -54,8 +52,24 @@ App::App(
     }
 
     // create the player
-    m_player = std::make_unique<SoccerPlayer>(std::move(model), m_mss, m_params);
+    m_player = std::make_unique<SoccerPlayer>(std::move(model), m_frame_source, m_mouse, m_params);
+    if (roi_model != nullptr) {
+        const auto roi_input = roi_model->GetInputBuffer();
+        const int roi_width = (config.roi_width > 0) ? config.roi_width : int(roi_input.width);
+        const int roi_height = (config.roi_height > 0) ? config.roi_height : int(roi_input.height);
+        m_player->SetROIModel(std::move(roi_model), roi_width, roi_height);
+    }
+    m_player->SetEstimator(CreateEstimator(config.estimator_type, m_params));
+    if (!config.flight_log_path.empty()) {
+        m_flight_recorder = std::make_shared<FlightRecorder>(config.flight_log_path, config.flight_log);
+        m_player->SetFlightRecorder(m_flight_recorder);
+    }
     m_is_model_running = true;
+    m_is_model_warm = false;
+    m_player->GetPacer().SetMode(config.pacing_mode);
+    // NOTE: The default timer period of 15.6ms is longer than a frame so sleeps can't wake in time
+    //       This is set even if pacing is off since it can be turned on from the gui
+    m_is_timer_period_set = (timeBeginPeriod(1) == TIMERR_NOERROR);
     m_is_render_running = true;
 
     // create application bindings
@@ -63,13 +77,13 @@ App::App(
 
     util::AttachKeyboardListener(VK_F1, [this](WPARAM type) {
         if (type == WM_KEYDOWN) {
-            m_is_model_running = !m_is_model_running;
+            SetModelRunning(!m_is_model_running.load());
         }
     });
 
     util::AttachKeyboardListener(VK_F2, [this](WPARAM type) {
         if (type == WM_KEYDOWN) {
-            m_is_render_running = !m_is_render_running;
+            m_is_render_running = !m_is_render_running.load();
         }
     });
 
@@ -104,16 +118,51 @@ App::App(
     m_screenshot_position.top = 316;
     m_screenshot_position.left = 799;
 
-    m_is_model_thread_running = true;
-    m_model_thread = std::make_unique<std::thread>([this]() {
-        while (m_is_model_thread_running) {
-            if (m_is_model_running) {
-                m_player->Update(m_screenshot_position.top, m_screenshot_position.left);
-            } else {
-                Sleep(10);
+    if (!config.latency_log_path.empty()) {
+        m_latency_logger = std::make_unique<LatencyLogger>(m_player->GetLatencyStats(), config.latency_log_path, config.latency_log_interval);
+    }
+
+    // pipelined mode runs each stage on its own thread instead of the single model thread
+    if (config.pipeline_depth > 0) {
+        auto pipeline_config = FramePipeline::Config{};
+        pipeline_config.depth = config.pipeline_depth;
+        pipeline_config.drop_stale = config.pipeline_drop_stale;
+        pipeline_config.capture_schedule = config.capture_schedule;
+        pipeline_config.inference_schedule = config.model_schedule;
+        m_is_model_thread_running = false;
+        m_pipeline = std::make_unique<FramePipeline>(*m_player.get(), pipeline_config, [this](int& top, int& left) {
+            if (!m_is_model_running || !m_is_model_warm) return false;
+            top = m_screenshot_position.top;
+            left = m_screenshot_position.left;
+            return true;
+        });
+        // NOTE: The pipeline stages don't touch the models until capture is allowed
+        // the models are warmed up with the same schedule as the inference stage
+        m_warmup_thread = std::make_unique<std::thread>([this, warmup_iterations = config.warmup_iterations, schedule = config.model_schedule]() {
+            TrySetCurrentThreadSchedule(schedule, "model warmup");
+            m_warmup_stats = m_player->WarmupModels(warmup_iterations);
+            m_is_model_warm = true;
+        });
+    } else {
+        m_is_model_thread_running = true;
+        m_model_thread = std::make_unique<std::thread>([this, warmup_iterations = config.warmup_iterations, schedule = config.model_schedule]() {
+            TrySetCurrentThreadSchedule(schedule, "model");
+            m_warmup_stats = m_player->WarmupModels(warmup_iterations);
+            m_is_model_warm = true;
+            while (m_is_model_thread_running) {
+                if (m_is_model_running) {
+                    m_player->Update(m_screenshot_position.top, m_screenshot_position.left);
+                } else {
+                    m_player->GetPacer().WaitPaused(std::chrono::milliseconds(100));
+                }
             }
-        }
-    });
+        });
+    }
+}
+
+void App::SetModelRunning(const bool is_running) {
+    m_is_model_running = is_running;
+    m_player->GetPacer().Wake();
 }
 
 void App::SetScreenshotSize(const int width, const int height) {
@@ -128,8 +177,20 @@ void App::SetScreenshotSize(const int width, const int height) {
 }
 
 App::~App() {
-    m_is_model_thread_running = false;
-    m_model_thread->join();
+    // NOTE: The logger writes a final entry so it is stopped before the player goes away
+    m_latency_logger = nullptr;
+    if (m_warmup_thread != nullptr) {
+        m_warmup_thread->join();
+    }
+    m_pipeline = nullptr;
+    if (m_model_thread != nullptr) {
+        m_is_model_thread_running = false;
+        m_player->GetPacer().Wake();
+        m_model_thread->join();
+    }
+    if (m_is_timer_period_set) {
+        timeEndPeriod(1);
+    }
 }
 
 App::TextureWrapper App::CreateTexture(const int width, const int height) {
@@ -167,12 +228,7 @@ App::TextureWrapper App::CreateTexture(const int width, const int height) {
 
 
 void App::UpdateScreenshotTexture() {
-    auto bitmap = m_mss->GetBitmap();
-    auto buffer_size = bitmap.GetSize();
-    auto buffer_max_size = m_mss->GetMaxSize();
-    DIBSECTION &sec = bitmap.GetBitmap();
-    BITMAP &bmp = sec.dsBm;
-    uint8_t *buffer = (uint8_t*)(bmp.bmBits);
+    const auto frame = m_frame_source->GetFrame();
 
     // setup dx11 to modify texture
     D3D11_MAPPED_SUBRESOURCE mappedResource;
@@ -183,56 +239,93 @@ void App::UpdateScreenshotTexture() {
     int row_width = mappedResource.RowPitch / 4;
 
     RGBA<uint8_t> *dst_buffer = (RGBA<uint8_t> *)(mappedResource.pData);
-    RGBA<uint8_t> *src_buffer = (RGBA<uint8_t> *)(buffer);
+    for (int y = 0; y < frame.height; y++) {
+        const uint8_t *src_row = frame.data + y*frame.row_stride;
+        memcpy(&dst_buffer[y*row_width], src_row, frame.width*sizeof(RGBA<uint8_t>));
+    }
 
-    for (int x = 0; x < buffer_size.x; x++) {
-        for (int y = 0; y < buffer_size.y; y++) {
-            int i = x + y*row_width;
-            int j = x + (buffer_max_size.y-y-1)*buffer_max_size.x;
-            dst_buffer[i] = src_buffer[j];
-        }
+    // show the crop given to the region of interest model
+    const auto& result = m_player->GetLatestResult();
+    if (m_render_overlay_flags.roi && result.is_roi && (result.roi.width <= frame.width) && (result.roi.height <= frame.height)) {
+        const RGBA<uint8_t> roi_color = {180,105,255,255}; // pink
+        const auto& roi = result.roi;
+        DrawRectInBuffer(
+            roi.left + roi.width/2, roi.top + roi.height/2, roi.width/2, roi.height/2,
+            roi_color, 1,
+            dst_buffer, frame.width, frame.height, row_width);
     }
 
-    DrawPredictions(dst_buffer, buffer_size.x, buffer_size.y, row_width);
+    DrawPredictions(dst_buffer, frame.width, frame.height, row_width);
     m_dx11_context->Unmap(m_screenshot_texture, subresource);
 }
 
 void App::UpdateModelTexture() {
-    const uint8_t *buffer = reinterpret_cast<const uint8_t *>(m_player->GetResizeBuffer().data());
-    struct {
-        int x, y;
-    } buffer_size, buffer_max_size; 
-    buffer_size.x = m_model_width;
-    buffer_size.y = m_model_height;
-    buffer_max_size = buffer_size;
+    // NOTE: The model input is normalised RGB with the bottom row first
+    const auto& preview = m_player->GetLatestPreview();
+    if (preview.data.empty()) {
+        return;
+    }
+    auto input = preview.format;
+    input.data = const_cast<uint8_t*>(preview.data.data());
+    const int width = int(input.width);
+    const int height = int(input.height);
+    // NOTE: The texture is sized for the full frame model so region of interest inputs aren't shown
+    if ((width != m_model_width) || (height != m_model_height)) {
+        return;
+    }
+    const int total_pixels = width*height;
 
     // setup dx11 to modify texture
     D3D11_MAPPED_SUBRESOURCE mappedResource;
     const UINT subresource = 0;
     m_dx11_context->Map(m_model_texture, subresource, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
 
-    // update texture from screen shotter
+    // update texture from model input
     int row_width = mappedResource.RowPitch / 4;
 
     RGBA<uint8_t> *dst_buffer = (RGBA<uint8_t> *)(mappedResource.pData);
-    RGBA<uint8_t> *src_buffer = (RGBA<uint8_t> *)(buffer);
-
-    for (int x = 0; x < buffer_size.x; x++) {
-        for (int y = 0; y < buffer_size.y; y++) {
-            int i = x + y*row_width;
-            int j = x + (buffer_max_size.y-y-1)*buffer_max_size.x;
-            dst_buffer[i] = src_buffer[j];
+    const auto to_byte = [](const float v) {
+        return uint8_t(std::clamp(v*255.0f, 0.0f, 255.0f));
+    };
+    const auto read_value = [&input](const int i) {
+        const auto& q = input.quantization;
+        switch (input.type) {
+        case InputType::UINT8:   return q.scale * float(int32_t(reinterpret_cast<const uint8_t*>(input.data)[i]) - q.zero_point);
+        case InputType::INT8:    return q.scale * float(int32_t(reinterpret_cast<const int8_t*>(input.data)[i]) - q.zero_point);
+        case InputType::FLOAT16: return half_to_float(reinterpret_cast<const uint16_t*>(input.data)[i]);
+        case InputType::FLOAT32: return reinterpret_cast<const float*>(input.data)[i];
+        default:                 return 0.0f;
+        }
+    };
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const int i = x + y*row_width;
+            const int j = x + (height-y-1)*width;
+            float r, g, b;
+            if (input.layout == InputLayout::INTERLEAVED) {
+                r = read_value(j*3 + 0);
+                g = read_value(j*3 + 1);
+                b = read_value(j*3 + 2);
+            } else {
+                r = read_value(j + 0*total_pixels);
+                g = read_value(j + 1*total_pixels);
+                b = read_value(j + 2*total_pixels);
+            }
+            // This is in BGR format
+            dst_buffer[i] = RGBA<uint8_t> { to_byte(b), to_byte(g), to_byte(r), 255 };
         }
     }
 
-    DrawPredictions(dst_buffer, buffer_size.x, buffer_size.y, row_width);
+    DrawPredictions(dst_buffer, width, height, row_width);
     m_dx11_context->Unmap(m_model_texture, subresource);
 }
 
 void App::DrawPredictions(RGBA<uint8_t>* buf, const int width, const int height, const int row_stride) {
     // render the bounding box of ball prediction
-    auto raw_pred = m_player->GetRawPrediction();
-    auto filtered_pred = m_player->GetFilteredPrediction();
+    const auto& result = m_player->GetLatestResult();
+    const auto raw_pred = result.raw_pred;
+    const auto filtered_pred = result.filtered_pred;
 
     int wx = (int)(m_params->relative_ball_width * width * 0.5f);
     int wy = wx;
@@ -251,7 +344,7 @@ void App::DrawPredictions(RGBA<uint8_t>* buf, const int width, const int height,
         pred_color = raw_color;
     }
 
-    const auto status = m_player->GetStatus();
+    const auto status = result.status;
     if (status.is_tracking) {
         pred_color = track_color;
     } 
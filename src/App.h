@@ -6,14 +6,52 @@
 #include <d3d11.h>
 
 #include <stdint.h>
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <string>
 #include <thread>
 
 #include "IModel.h"
+#include "IFrameSource.h"
+#include "IMouseController.h"
 #include "SoccerPlayer.h"
 #include "SoccerParams.h"
+#include "FramePipeline.h"
+#include "FlightRecorder.h"
+#include "FramePacer.h"
+#include "IEstimator.h"
+#include "LatencyLogger.h"
+#include "ThreadSchedule.h"
 #include "util/MSS.h"
 
+struct AppConfig {
+    // save every captured frame to this path if provided
+    std::string record_frames_path;
+    // 0 runs every stage serially on one thread, otherwise the number of slots between pipeline stages
+    int pipeline_depth = 0;
+    bool pipeline_drop_stale = true;
+    // periodically write latency percentiles to this path if provided
+    std::string latency_log_path;
+    std::chrono::milliseconds latency_log_interval = std::chrono::seconds(10);
+    // size of the crop in pixels given to the region of interest model if one is provided
+    // 0 uses the model input size so the crop isn't resized
+    int roi_width = 0;
+    int roi_height = 0;
+    // max number of synthetic inputs run through the models before frames are captured
+    int warmup_iterations = 200;
+    // the model thread runs every stage in serial mode and only inference when pipelined
+    // the capture schedule is only used when pipelined since capture is otherwise on the model thread
+    ThreadSchedule model_schedule;
+    ThreadSchedule capture_schedule;
+    // waits for the next frame of the display instead of grabbing copies of the current one
+    PacingMode pacing_mode = PacingMode::BALANCED;
+    EstimatorType estimator_type = EstimatorType::DIFFERENCE;
+    // record thumbnails of frames and what the player did with them to this path if provided
+    std::string flight_log_path;
+    FlightRecorder::Config flight_log;
+};
+
 class App
 {
 private:
@@ -23,24 +61,39 @@ private:
     };
 private:
     std::unique_ptr<std::thread> m_model_thread; 
-    bool m_is_model_thread_running;
+    std::atomic<bool> m_is_model_thread_running;
+    // warms up the models in pipelined mode since there is no model thread
+    std::unique_ptr<std::thread> m_warmup_thread;
+    // timer resolution is raised so that pacing sleeps are accurate enough to wake for a frame
+    bool m_is_timer_period_set;
 public:
     std::shared_ptr<util::MSS> m_mss;
+    std::shared_ptr<IFrameSource> m_frame_source;
+    std::shared_ptr<IMouseController> m_mouse;
     std::unique_ptr<SoccerPlayer> m_player;
+    std::unique_ptr<FramePipeline> m_pipeline;
+    std::unique_ptr<LatencyLogger> m_latency_logger;
+    std::shared_ptr<FlightRecorder> m_flight_recorder;
     std::shared_ptr<SoccerParams> m_params;
     
     // model controls
-    bool m_is_model_running;
+    // NOTE: Toggled from the gui and hotkey threads while the model thread reads it
+    std::atomic<bool> m_is_model_running;
+    // frames aren't captured until the models are warm so the first clicks aren't delayed
+    // NOTE: Warmup stats are only written before this is set
+    std::atomic<bool> m_is_model_warm;
+    WarmupStats m_warmup_stats;
     struct ScreenshotPosition {
         int top = 0;
         int left = 0;
     } m_screenshot_position;
     
     // realtime overlays 
-    bool m_is_render_running;
+    std::atomic<bool> m_is_render_running;
     struct OverlayRender {
         bool raw_pred = true;
         bool filtered_pred = false;
+        bool roi = true;
     } m_render_overlay_flags;
 
     int m_texture_width, m_texture_height;
@@ -56,11 +109,14 @@ public:
     ID3D11Device *m_dx11_device; 
     ID3D11DeviceContext *m_dx11_context;
 public:
-    App(std::unique_ptr<IModel>&& model, ID3D11Device *dx11_device, ID3D11DeviceContext *dx11_context);
+    // roi_model is optional and can be null
+    App(std::unique_ptr<IModel>&& model, std::unique_ptr<IModel>&& roi_model, const AppConfig& config, ID3D11Device *dx11_device, ID3D11DeviceContext *dx11_context);
     ~App();
     void UpdateScreenshotTexture();
     void UpdateModelTexture();
     void SetScreenshotSize(const int width, const int height);
+    // NOTE: Use this instead of writing m_is_model_running so a paused model thread wakes up immediately
+    void SetModelRunning(const bool is_running);
 private:
     TextureWrapper CreateTexture(const int width, const int height);
     void DrawPredictions(RGBA<uint8_t>* buf, const int width, const int height, const int row_stride);
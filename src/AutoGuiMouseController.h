@@ -0,0 +1,11 @@
+#pragma once
+
+#include "IMouseController.h"
+#include "util/AutoGui.h"
+
+class AutoGuiMouseController: public IMouseController
+{
+public:
+    void SetCursorPosition(const int x, const int y) override { util::SetCursorPosition(x, y); }
+    void Click(const int x, const int y) override { util::Click(x, y, util::MouseButton::LEFT); }
+};
@@ -0,0 +1,84 @@
+#include "BallController.h"
+
+#include <stdexcept>
+
+static int clamp_value(int v, const int v_min, const int v_max) {
+    if (v < v_min) v = v_min;
+    if (v > v_max) v = v_max;
+    return v;
+}
+
+BallController::BallController(std::shared_ptr<SoccerParams>& params) {
+    m_params = params;
+    m_estimator = CreateEstimator(EstimatorType::DIFFERENCE, params);
+}
+
+void BallController::SetEstimator(std::unique_ptr<IEstimator>&& estimator) {
+    if (estimator == nullptr) {
+        throw std::runtime_error("Estimator can't be null");
+    }
+    m_estimator = std::move(estimator);
+}
+
+void BallController::Reset() {
+    m_estimator->Reset();
+}
+
+BallController::Decision BallController::Update(
+    const Prediction& raw_pred, const bool is_unchanged,
+    const int64_t frame_us, const int64_t apply_us,
+    const Screen& screen, const Controls& controls)
+{
+    Decision decision;
+    decision.estimate = is_unchanged ? m_estimator->Extrapolate(apply_us) : m_estimator->Filter(raw_pred, frame_us, apply_us);
+    const Prediction filtered_pred = decision.estimate.prediction;
+    const auto velocity = decision.estimate.velocity;
+    auto& status = decision.status;
+    status.is_tracking = filtered_pred.confidence > m_params->confidence_threshold;
+    if (UpdateTriggers(*m_params, filtered_pred, velocity.y, status)) {
+        decision.velocity = velocity;
+    }
+    status.is_clicking = status.is_soft_trigger || status.is_hard_trigger;
+
+    if (controls.can_track && status.is_tracking) {
+        const auto pred = controls.can_use_predictor ? filtered_pred : raw_pred;
+        const int screen_x = screen.left + int(      pred.x  * float(screen.width));
+        const int screen_y = screen.top  + int((1.0f-pred.y) * float(screen.height));
+
+        // NOTE: We do this to prevent unfocusing the window
+        const int click_padding = controls.click_padding;
+        decision.is_cursor_moved = true;
+        decision.cursor_x = clamp_value(screen_x, screen.left+click_padding, screen.left+screen.width-click_padding);
+        decision.cursor_y = clamp_value(screen_y, screen.top+click_padding, screen.top+screen.height-click_padding);
+        decision.is_click = (controls.can_smart_click && status.is_clicking) || controls.can_always_click;
+    }
+    return decision;
+}
+
+bool BallController::UpdateTriggers(const SoccerParams& p, const Prediction& pred, const float vy, Status& status) {
+    status.is_soft_trigger = false;
+    status.is_hard_trigger = false;
+    if (pred.confidence < p.confidence_threshold) {
+        return false;
+    }
+
+    // ignore if outside of screen
+    if ((pred.x >= 1.0f) || (pred.x <= 0.0f) ||
+        (pred.y >= 1.0f) || (pred.y <= 0.0f))
+    {
+        return false;
+    }
+
+    // falling down and near bottom of screen
+    // or falling down really fast regardless of position
+    if ((vy <= -p.fall_speed_trigger_soft) && (pred.y <= p.height_trigger_soft)) {
+        status.is_soft_trigger = true;
+        return true;
+    }
+
+    if ((vy <= -p.fall_speed_trigger_hard) || (pred.y <= p.height_trigger_hard)) {
+        status.is_hard_trigger = true;
+        return true;
+    }
+    return true;
+}
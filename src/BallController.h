@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include "IEstimator.h"
+#include "Prediction.h"
+#include "SoccerParams.h"
+
+// Decides where to move the cursor and when to click from each model prediction
+// Time is passed in by the caller instead of read from a clock so that the same decisions
+// can be made on recorded trajectories or in a simulated game running faster than realtime
+class BallController
+{
+public:
+    struct Controls {
+        bool can_track = false;
+        bool can_smart_click = false;
+        bool can_always_click = false;
+        bool can_use_predictor = true;
+        int click_padding = 5;
+    };
+    struct Status {
+        bool is_tracking = false;
+        bool is_clicking = false;
+        bool is_soft_trigger = false;
+        bool is_hard_trigger = false;
+    };
+    // area of the screen that frames are captured from
+    struct Screen {
+        int left = 0;
+        int top = 0;
+        int width = 0;
+        int height = 0;
+    };
+    struct Decision {
+        IEstimator::Output estimate;
+        // velocity of the estimate while the triggers are following the ball, otherwise zero
+        IEstimator::Velocity velocity;
+        Status status;
+        // screen coordinates of the cursor if it was moved, a click is always at the cursor
+        bool is_cursor_moved = false;
+        bool is_click = false;
+        int cursor_x = 0;
+        int cursor_y = 0;
+    };
+private:
+    std::shared_ptr<SoccerParams> m_params;
+    std::unique_ptr<IEstimator> m_estimator;
+public:
+    explicit BallController(std::shared_ptr<SoccerParams>& params);
+    // the difference estimator is used by default
+    void SetEstimator(std::unique_ptr<IEstimator>&& estimator);
+    // frame_us is when the frame was captured and apply_us is when the decision is acted on
+    // unchanged frames have nothing new to observe so the last observation is moved forward instead
+    Decision Update(
+        const Prediction& raw_pred, const bool is_unchanged,
+        const int64_t frame_us, const int64_t apply_us,
+        const Screen& screen, const Controls& controls);
+    // forgets the ball such as between games
+    void Reset();
+    // sets the soft and hard triggers for a filtered prediction and its vertical velocity
+    // returns false if the ball is lost or off screen so its velocity shouldn't be followed
+    static bool UpdateTriggers(const SoccerParams& params, const Prediction& pred, const float vy, Status& status);
+};
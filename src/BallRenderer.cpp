@@ -0,0 +1,92 @@
+#include "BallRenderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string.h>
+
+constexpr uint8_t BACKGROUND_VALUE = 255;
+constexpr float PI = 3.14159265358979f;
+
+static size_t align_size(const size_t x, const size_t alignment) {
+    return ((x + alignment - 1) / alignment) * alignment;
+}
+
+BallRenderer::BallRenderer(const int width, const int height) {
+    if ((width <= 0) || (height <= 0)) {
+        throw std::runtime_error("Ball renderer requires a positive frame size");
+    }
+    m_width = width;
+    m_height = height;
+    m_row_stride = int(align_size(size_t(width)*4, 64));
+    m_buffer.resize(size_t(m_row_stride)*size_t(height));
+    memset(m_buffer.data(), BACKGROUND_VALUE, m_buffer.size());
+    m_dirty_rect.is_valid = false;
+}
+
+FrameView BallRenderer::GetFrame() const {
+    FrameView frame;
+    frame.data = m_buffer.data();
+    frame.width = m_width;
+    frame.height = m_height;
+    frame.row_stride = m_row_stride;
+    return frame;
+}
+
+void BallRenderer::Render(const EmulatorBall& ball, const bool is_visible) {
+    const int width = m_width;
+    const int height = m_height;
+
+    // clear the previous ball
+    if (m_dirty_rect.is_valid) {
+        const int total_bytes = (m_dirty_rect.x1 - m_dirty_rect.x0)*4;
+        for (int y = m_dirty_rect.y0; y < m_dirty_rect.y1; y++) {
+            uint8_t* row = &m_buffer[size_t(y)*size_t(m_row_stride) + size_t(m_dirty_rect.x0)*4];
+            memset(row, BACKGROUND_VALUE, total_bytes);
+        }
+        m_dirty_rect.is_valid = false;
+    }
+
+    if (!is_visible) {
+        return;
+    }
+
+    const float radius = ball.radius;
+    const int x0 = std::clamp(int(std::floor(ball.x - radius)), 0, width);
+    const int x1 = std::clamp(int(std::ceil (ball.x + radius)), 0, width);
+    const int y0 = std::clamp(int(std::floor(ball.y - radius)), 0, height);
+    const int y1 = std::clamp(int(std::ceil (ball.y + radius)), 0, height);
+    if ((x0 >= x1) || (y0 >= y1)) {
+        return;
+    }
+    m_dirty_rect = { x0, y0, x1, y1, true };
+
+    // ball has a dark outline and alternating dark and light panels which rotate with it
+    const float radius_sqr = radius*radius;
+    const float inner_radius = radius - 3.0f;
+    const float inner_radius_sqr = inner_radius*inner_radius;
+    const float panel_scale = 5.0f / (2.0f*PI);
+    for (int y = y0; y < y1; y++) {
+        uint8_t* row = &m_buffer[size_t(y)*size_t(m_row_stride)];
+        const float dy = (float(y) + 0.5f) - ball.y;
+        for (int x = x0; x < x1; x++) {
+            const float dx = (float(x) + 0.5f) - ball.x;
+            const float dist_sqr = dx*dx + dy*dy;
+            if (dist_sqr > radius_sqr) {
+                continue;
+            }
+            uint8_t value = 30;
+            if (dist_sqr < inner_radius_sqr) {
+                const float angle = std::atan2(dy, dx) + ball.angle + PI;
+                const int panel = int(angle * panel_scale);
+                const bool is_inner = dist_sqr < (inner_radius_sqr*0.25f);
+                value = ((panel + int(is_inner)) % 2) ? 40 : 230;
+            }
+            uint8_t* pixel = &row[x*4];
+            pixel[0] = value;
+            pixel[1] = value;
+            pixel[2] = value;
+            pixel[3] = 255;
+        }
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "EmulatorBall.h"
+#include "IFrameSource.h"
+
+// Draws a ball with rotating panels on a white BGRA8 frame
+// Only the area the ball covered in the last frame is cleared so each frame costs about the size of the ball
+class BallRenderer
+{
+private:
+    int m_width;
+    int m_height;
+    int m_row_stride;
+    std::vector<uint8_t> m_buffer;
+    struct {
+        int x0, y0, x1, y1;
+        bool is_valid;
+    } m_dirty_rect;
+public:
+    BallRenderer(const int width, const int height);
+    // the frame is left empty if the ball isn't visible
+    void Render(const EmulatorBall& ball, const bool is_visible);
+    // NOTE: The frame index and timestamp aren't set
+    FrameView GetFrame() const;
+};
@@ -0,0 +1,50 @@
+#include "EmulatorBall.h"
+
+#include <algorithm>
+#include <cmath>
+
+constexpr float PI = 3.14159265358979f;
+
+void EmulatorBall::Update(const float dt, const float window_width) {
+    const float C_drag = 0.01f;
+    vx += (-C_drag*vx) * dt;
+    vy += (gravity - C_drag*vy) * dt;
+    x += vx * dt;
+    y += vy * dt;
+
+    // spins up to half a turn a second with its horizontal speed
+    const float max_dx = 200.0f;
+    const float k = std::clamp(vx / max_dx, -1.0f, 1.0f);
+    angle += k * PI * dt;
+
+    if (x - radius < 0.0f) {
+        x = radius;
+        vx = std::abs(vx);
+    } else if (x + radius > window_width) {
+        x = window_width - radius;
+        vx = -std::abs(vx);
+    }
+}
+
+void EmulatorBall::Bounce(const float mouse_x, const float dx_random) {
+    const float min_bounce_vel = 900.0f;
+    const float max_bounce_vel = 1500.0f;
+    vy = std::clamp(vy - min_bounce_vel, -max_bounce_vel, -min_bounce_vel);
+
+    // kicked away from the side of the ball that was clicked
+    const float horizontal_bounce = 450.0f;
+    const float horizontal_limit = 1000.0f;
+    const float x_diff = -(mouse_x - x) / radius;
+    vx += x_diff*horizontal_bounce + dx_random;
+    vx = std::clamp(vx, -horizontal_limit, horizontal_limit);
+}
+
+bool EmulatorBall::IsHit(const float mouse_x, const float mouse_y) const {
+    const float dx = mouse_x - x;
+    const float dy = mouse_y - y;
+    return (dx*dx + dy*dy) <= (radius*radius);
+}
+
+bool EmulatorBall::IsOutOfWindow(const float window_height) const {
+    return (y - radius*5.0f) > window_height;
+}
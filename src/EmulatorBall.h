@@ -0,0 +1,26 @@
+#pragma once
+
+// Port of Ball from scripts/emulator/src/Ball.py
+// Pixel space of a window where y points down, so gravity is positive
+struct EmulatorBall {
+    float x = 0.0f;
+    float y = 0.0f;
+    float vx = 0.0f;
+    float vy = 0.0f;
+    // radians
+    float angle = 0.0f;
+    // the emulator's ball image is 84x83 and its radius is the mean of the half sizes
+    float radius = 41.75f;
+    float gravity = 2000.0f;
+
+    // Ball.update with drag and the collision against the side walls
+    void Update(const float dt, const float window_width);
+    // Ball.bounce for a click at mouse_x
+    // dx_random is the random horizontal kick the emulator adds which is uniform in [-150,150]
+    void Bounce(const float mouse_x, const float dx_random);
+    // Emulator.on_click checks the distance to the centre against the radius
+    bool IsHit(const float mouse_x, const float mouse_y) const;
+    bool IsOutOfWindow(const float window_height) const;
+};
+
+constexpr float EMULATOR_MAX_RANDOM_BOUNCE = 150.0f;
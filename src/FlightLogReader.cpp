@@ -0,0 +1,180 @@
+#include "FlightLogReader.h"
+
+#include <string.h>
+#include <stdexcept>
+#include <fmt/core.h>
+
+static size_t align_size(const size_t x, const size_t alignment) {
+    return ((x + alignment - 1) / alignment) * alignment;
+}
+
+static size_t get_event_payload_size(const size_t total_events) {
+    size_t size = 0;
+    for (const auto& column: GetFlightEventColumns()) {
+        size += align_size(column.size*total_events, FLIGHT_LOG_ALIGNMENT);
+    }
+    return size;
+}
+
+FlightLogReader::FlightLogReader(const char* filepath) {
+    m_file = std::make_unique<MappedFile>(filepath);
+    m_total_events = 0;
+    m_total_chunks = 0;
+    m_decoded_index = 0;
+    m_is_decoded = false;
+
+    const uint8_t* data = m_file->GetData();
+    const size_t size = m_file->GetSize();
+    if (size < sizeof(FlightLogHeader)) {
+        throw std::runtime_error(fmt::format("Flight log is too small to have a header: '{}'", filepath));
+    }
+    memcpy(&m_header, data, sizeof(FlightLogHeader));
+    if (memcmp(m_header.magic, FLIGHT_LOG_MAGIC, sizeof(m_header.magic)) != 0) {
+        throw std::runtime_error(fmt::format("Flight log has an invalid header: '{}'", filepath));
+    }
+    if (m_header.version != FLIGHT_LOG_VERSION) {
+        throw std::runtime_error(fmt::format(
+            "Flight log has version {} but expected {}: '{}'",
+            m_header.version, FLIGHT_LOG_VERSION, filepath));
+    }
+
+    size_t offset = sizeof(FlightLogHeader);
+    while ((offset + sizeof(FlightChunkHeader)) <= size) {
+        FlightChunkHeader chunk;
+        memcpy(&chunk, data + offset, sizeof(chunk));
+        const uint8_t* payload = data + offset + sizeof(chunk);
+        // NOTE: The last chunk is ignored if it was partially written
+        if (chunk.payload_size > uint64_t(size - offset - sizeof(chunk))) break;
+        const size_t payload_size = size_t(chunk.payload_size);
+
+        if (chunk.type == uint32_t(FlightChunkType::EVENTS)) {
+            if (get_event_payload_size(chunk.total_records) > payload_size) {
+                throw std::runtime_error(fmt::format("Flight log has an event chunk that is too small at offset {}: '{}'", offset, filepath));
+            }
+            EventChunk events;
+            events.payload = payload;
+            events.total_events = chunk.total_records;
+            events.first_event = m_total_events;
+            m_event_chunks.push_back(events);
+            m_total_events += events.total_events;
+        } else if (chunk.type == uint32_t(FlightChunkType::FRAMES)) {
+            size_t frame_offset = 0;
+            size_t key_index = 0;
+            for (uint32_t i = 0; i < chunk.total_records; i++) {
+                FrameRecord frame;
+                if ((frame_offset + sizeof(FlightFrameHeader)) > payload_size) {
+                    throw std::runtime_error(fmt::format("Flight log has a frame chunk that is too small at offset {}: '{}'", offset, filepath));
+                }
+                memcpy(&frame.header, payload + frame_offset, sizeof(FlightFrameHeader));
+                frame.data = payload + frame_offset + sizeof(FlightFrameHeader);
+                frame_offset = align_size(frame_offset + sizeof(FlightFrameHeader) + frame.header.data_size, FLIGHT_LOG_ALIGNMENT);
+                if (frame_offset > payload_size) {
+                    throw std::runtime_error(fmt::format("Flight log has a frame chunk that is too small at offset {}: '{}'", offset, filepath));
+                }
+                if (frame.header.encoding == uint32_t(FlightFrameEncoding::KEY)) {
+                    key_index = m_frames.size();
+                } else if (i == 0) {
+                    throw std::runtime_error(fmt::format("Flight log has a frame chunk without a key frame at offset {}: '{}'", offset, filepath));
+                }
+                frame.key_index = key_index;
+                m_frames.push_back(frame);
+            }
+        }
+        // unknown chunk types are skipped so newer logs stay readable
+        offset += sizeof(chunk) + payload_size;
+        m_total_chunks++;
+    }
+}
+
+FlightEvent FlightLogReader::GetEvent(const size_t index) const {
+    if (index >= m_total_events) {
+        throw std::runtime_error(fmt::format("Flight log event {} is out of range of {} events", index, m_total_events));
+    }
+    // find the last chunk that starts at or before the event
+    size_t lo = 0;
+    size_t hi = m_event_chunks.size();
+    while ((hi - lo) > 1) {
+        const size_t mid = (lo + hi) / 2;
+        if (m_event_chunks[mid].first_event <= index) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    const auto& chunk = m_event_chunks[lo];
+    const size_t row = index - chunk.first_event;
+    FlightEvent event;
+    const uint8_t* column_data = chunk.payload;
+    for (const auto& column: GetFlightEventColumns()) {
+        memcpy(reinterpret_cast<uint8_t*>(&event) + column.offset, column_data + row*column.size, column.size);
+        column_data += align_size(column.size*chunk.total_events, FLIGHT_LOG_ALIGNMENT);
+    }
+    return event;
+}
+
+std::vector<FlightEvent> FlightLogReader::LoadEvents() const {
+    std::vector<FlightEvent> events(m_total_events);
+    for (const auto& chunk: m_event_chunks) {
+        const uint8_t* column_data = chunk.payload;
+        for (const auto& column: GetFlightEventColumns()) {
+            for (size_t row = 0; row < chunk.total_events; row++) {
+                auto& event = events[chunk.first_event + row];
+                memcpy(reinterpret_cast<uint8_t*>(&event) + column.offset, column_data + row*column.size, column.size);
+            }
+            column_data += align_size(column.size*chunk.total_events, FLIGHT_LOG_ALIGNMENT);
+        }
+    }
+    return events;
+}
+
+std::vector<TrajectorySample> FlightLogReader::LoadTrajectory() const {
+    std::vector<TrajectorySample> samples;
+    for (const auto& event: LoadEvents()) {
+        // unchanged frames repeat the previous prediction
+        if (event.flags & FLIGHT_EVENT_UNCHANGED) continue;
+        if (!samples.empty() && (event.grab_us < samples.back().time_us)) continue;
+        TrajectorySample sample;
+        sample.time_us = event.grab_us;
+        sample.observation.x = event.raw_x;
+        sample.observation.y = event.raw_y;
+        sample.observation.confidence = event.raw_confidence;
+        samples.push_back(sample);
+    }
+    return samples;
+}
+
+FrameView FlightLogReader::GetFrame(const size_t index) {
+    if (index >= m_frames.size()) {
+        throw std::runtime_error(fmt::format("Flight log frame {} is out of range of {} frames", index, m_frames.size()));
+    }
+    const auto& target = m_frames[index];
+    // continue from the last decoded frame if it is on the way from the key frame
+    size_t start = target.key_index;
+    if (m_is_decoded && (m_decoded_index >= target.key_index) && (m_decoded_index <= index)) {
+        start = m_decoded_index + 1;
+    }
+    for (size_t i = start; i <= index; i++) {
+        const auto& frame = m_frames[i];
+        const size_t frame_size = size_t(frame.header.width)*size_t(frame.header.height)*4;
+        const bool is_key = frame.header.encoding == uint32_t(FlightFrameEncoding::KEY);
+        if (!is_key && (m_pixels.size() != frame_size)) {
+            throw std::runtime_error(fmt::format("Flight log frame {} is a delta from a frame of a different size", i));
+        }
+        m_pixels.resize(frame_size);
+        m_is_decoded = false;
+        if (!DecodeFrameDelta(frame.data, frame.header.data_size, is_key ? nullptr : m_pixels.data(), m_pixels.data(), frame_size)) {
+            throw std::runtime_error(fmt::format("Flight log frame {} is corrupt", i));
+        }
+        m_decoded_index = i;
+        m_is_decoded = true;
+    }
+
+    FrameView view;
+    view.data = m_pixels.data();
+    view.width = int(target.header.width);
+    view.height = int(target.header.height);
+    view.row_stride = view.width*4;
+    view.frame_index = target.header.frame_index;
+    view.timestamp_us = target.header.timestamp_us;
+    return view;
+}
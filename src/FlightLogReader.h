@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include "FlightRecorder.h"
+#include "IFrameSource.h"
+#include "MappedFile.h"
+#include "Trajectory.h"
+
+// Memory mapped reader of a log written by FlightRecorder for offline analysis
+// NOTE: A log that was cut short is read up to its last complete chunk
+class FlightLogReader
+{
+private:
+    struct EventChunk {
+        const uint8_t* payload;
+        size_t total_events;
+        size_t first_event;
+    };
+    struct FrameRecord {
+        FlightFrameHeader header;
+        const uint8_t* data;
+        // index of the key frame that decoding starts from
+        size_t key_index;
+    };
+
+    std::unique_ptr<MappedFile> m_file;
+    FlightLogHeader m_header;
+    std::vector<EventChunk> m_event_chunks;
+    std::vector<FrameRecord> m_frames;
+    size_t m_total_events;
+    size_t m_total_chunks;
+
+    std::vector<uint8_t> m_pixels;
+    size_t m_decoded_index;
+    bool m_is_decoded;
+public:
+    explicit FlightLogReader(const char* filepath);
+    FlightLogReader(const FlightLogReader&) = delete;
+    FlightLogReader& operator=(const FlightLogReader&) = delete;
+    int GetFrameScale() const { return int(m_header.frame_scale); }
+    size_t GetTotalChunks() const { return m_total_chunks; }
+
+    size_t GetTotalEvents() const { return m_total_events; }
+    FlightEvent GetEvent(const size_t index) const;
+    std::vector<FlightEvent> LoadEvents() const;
+    // observations of the ball from the raw predictions of frames that changed, by the time they were grabbed
+    std::vector<TrajectorySample> LoadTrajectory() const;
+
+    size_t GetTotalFrames() const { return m_frames.size(); }
+    // decodes the thumbnail into a buffer that is reused by the next call
+    // NOTE: Reading frames in order only decodes one delta per frame
+    FrameView GetFrame(const size_t index);
+};
@@ -0,0 +1,391 @@
+#include "FlightRecorder.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdexcept>
+#include <fmt/core.h>
+
+// how long the writer sleeps when there is nothing waiting
+constexpr auto WRITER_IDLE_SLEEP = std::chrono::milliseconds(5);
+
+static size_t align_size(const size_t x, const size_t alignment) {
+    return ((x + alignment - 1) / alignment) * alignment;
+}
+
+static void append_bytes(std::vector<uint8_t>& dst, const void* src, const size_t size) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(src);
+    dst.insert(dst.end(), bytes, bytes+size);
+}
+
+static void append_padding(std::vector<uint8_t>& dst) {
+    dst.resize(align_size(dst.size(), FLIGHT_LOG_ALIGNMENT), 0);
+}
+
+static const FlightRecorder::Config& validate_config(const FlightRecorder::Config& config) {
+    if (config.frame_scale < 0) {
+        throw std::runtime_error(fmt::format("Flight recorder frame scale must be positive or 0 to disable frames (got {})", config.frame_scale));
+    }
+    if ((config.total_frame_slots <= 0) || (config.total_event_slots <= 0)) {
+        throw std::runtime_error(fmt::format(
+            "Flight recorder needs at least one frame and event slot (got {} and {})",
+            config.total_frame_slots, config.total_event_slots));
+    }
+    if ((config.chunk_frames <= 0) || (config.chunk_events <= 0)) {
+        throw std::runtime_error(fmt::format(
+            "Flight recorder chunks need at least one frame and event (got {} and {})",
+            config.chunk_frames, config.chunk_events));
+    }
+    return config;
+}
+
+#define FLIGHT_EVENT_COLUMN(field) FlightEventColumn{ #field, offsetof(FlightEvent, field), sizeof(FlightEvent::field) }
+
+const std::vector<FlightEventColumn>& GetFlightEventColumns() {
+    static const std::vector<FlightEventColumn> columns = {
+        FLIGHT_EVENT_COLUMN(frame_index),
+        FLIGHT_EVENT_COLUMN(grab_us),
+        FLIGHT_EVENT_COLUMN(apply_us),
+        FLIGHT_EVENT_COLUMN(raw_x),
+        FLIGHT_EVENT_COLUMN(raw_y),
+        FLIGHT_EVENT_COLUMN(raw_confidence),
+        FLIGHT_EVENT_COLUMN(filtered_x),
+        FLIGHT_EVENT_COLUMN(filtered_y),
+        FLIGHT_EVENT_COLUMN(filtered_confidence),
+        FLIGHT_EVENT_COLUMN(velocity_x),
+        FLIGHT_EVENT_COLUMN(velocity_y),
+        FLIGHT_EVENT_COLUMN(time_to_impact),
+        FLIGHT_EVENT_COLUMN(cursor_x),
+        FLIGHT_EVENT_COLUMN(cursor_y),
+        FLIGHT_EVENT_COLUMN(flags),
+        FLIGHT_EVENT_COLUMN(us_grab),
+        FLIGHT_EVENT_COLUMN(us_preprocess),
+        FLIGHT_EVENT_COLUMN(us_inference),
+    };
+    return columns;
+}
+
+#undef FLIGHT_EVENT_COLUMN
+
+void EncodeFrameDelta(const uint8_t* curr, const uint8_t* prev, const size_t size, std::vector<uint8_t>& dst) {
+    auto get_delta = [curr, prev](const size_t i) -> uint8_t {
+        return (prev != nullptr) ? uint8_t(curr[i] - prev[i]) : curr[i];
+    };
+    // worst case is one token for every 128 literals
+    dst.resize(size + size/128 + 1);
+    size_t total_written = 0;
+    size_t i = 0;
+    while (i < size) {
+        size_t total_unchanged = 0;
+        while (((i+total_unchanged) < size) && (total_unchanged < 128) && (get_delta(i+total_unchanged) == 0)) {
+            total_unchanged++;
+        }
+        if (total_unchanged > 0) {
+            dst[total_written++] = uint8_t(127 + total_unchanged);
+            i += total_unchanged;
+            continue;
+        }
+        // literals until there are two unchanged bytes in a row
+        const size_t token_index = total_written++;
+        size_t total_literals = 0;
+        while ((i < size) && (total_literals < 128)) {
+            const uint8_t delta = get_delta(i);
+            if ((delta == 0) && (((i+1) >= size) || (get_delta(i+1) == 0))) break;
+            dst[total_written++] = delta;
+            total_literals++;
+            i++;
+        }
+        dst[token_index] = uint8_t(total_literals - 1);
+    }
+    dst.resize(total_written);
+}
+
+bool DecodeFrameDelta(const uint8_t* src, const size_t src_size, const uint8_t* prev, uint8_t* dst, const size_t size) {
+    size_t i = 0;
+    size_t j = 0;
+    while (j < src_size) {
+        const uint8_t token = src[j++];
+        if (token >= 128) {
+            const size_t total_unchanged = size_t(token) - 127;
+            if ((i + total_unchanged) > size) return false;
+            if (prev == nullptr) {
+                memset(dst+i, 0, total_unchanged);
+            } else if (prev != dst) {
+                memcpy(dst+i, prev+i, total_unchanged);
+            }
+            i += total_unchanged;
+        } else {
+            const size_t total_literals = size_t(token) + 1;
+            if (((i + total_literals) > size) || ((j + total_literals) > src_size)) return false;
+            for (size_t k = 0; k < total_literals; k++) {
+                const uint8_t base = (prev != nullptr) ? prev[i+k] : 0;
+                dst[i+k] = uint8_t(base + src[j+k]);
+            }
+            i += total_literals;
+            j += total_literals;
+        }
+    }
+    return i == size;
+}
+
+FlightRecorder::FlightRecorder(const std::string& filepath, const Config& config)
+: m_filepath(filepath),
+  m_config(validate_config(config)),
+  m_frame_free(size_t(config.total_frame_slots)),
+  m_frame_ready(size_t(config.total_frame_slots)),
+  m_events(size_t(config.total_event_slots))
+{
+    m_fp = nullptr;
+    m_file_bytes = 0;
+    m_total_chunk_frames = 0;
+    m_total_frames = 0;
+    m_total_events = 0;
+    m_total_dropped_frames = 0;
+    m_total_dropped_events = 0;
+    m_total_chunks = 0;
+    m_total_bytes = 0;
+    m_total_rotations = 0;
+    m_total_failed_writes = 0;
+    m_total_failed_opens = 0;
+
+    OpenLog();
+    if (m_fp == nullptr) {
+        throw std::runtime_error(fmt::format("Failed to open flight log for writing: '{}'", m_filepath));
+    }
+
+    m_frame_slots.resize(size_t(m_config.total_frame_slots));
+    for (int i = 0; i < m_config.total_frame_slots; i++) {
+        m_frame_free.TryPush(i);
+    }
+    m_chunk_events.reserve(size_t(m_config.chunk_events));
+    m_last_flush = std::chrono::steady_clock::now();
+
+    m_is_running = true;
+    m_thread = std::thread([this]() {
+        RunWriter();
+    });
+}
+
+FlightRecorder::~FlightRecorder() {
+    {
+        auto lock = std::scoped_lock(m_mutex);
+        m_is_running = false;
+        m_cv.notify_all();
+    }
+    m_thread.join();
+    WriteEventChunk();
+    WriteFrameChunk();
+    if (m_fp != nullptr) {
+        fclose(m_fp);
+    }
+}
+
+void FlightRecorder::PushFrame(const FrameView& frame) {
+    const int scale = m_config.frame_scale;
+    if (scale <= 0) return;
+    int index = 0;
+    if (!m_frame_free.TryPop(index)) {
+        m_total_dropped_frames.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    auto& slot = m_frame_slots[size_t(index)];
+    slot.width = (frame.width + scale - 1) / scale;
+    slot.height = (frame.height + scale - 1) / scale;
+    slot.frame_index = frame.frame_index;
+    slot.timestamp_us = frame.timestamp_us;
+    // NOTE: Only allocates for the first frame or when the frame size changes
+    const size_t dst_stride = size_t(slot.width)*4;
+    slot.pixels.resize(dst_stride*size_t(slot.height));
+    for (int y = 0; y < slot.height; y++) {
+        const uint8_t* src_row = frame.data + ptrdiff_t(y*scale)*ptrdiff_t(frame.row_stride);
+        uint8_t* dst_row = slot.pixels.data() + size_t(y)*dst_stride;
+        if (scale == 1) {
+            memcpy(dst_row, src_row, dst_stride);
+            continue;
+        }
+        for (int x = 0; x < slot.width; x++) {
+            memcpy(dst_row + x*4, src_row + x*scale*4, 4);
+        }
+    }
+    // NOTE: Can't fail since the queue has room for every slot
+    m_frame_ready.TryPush(index);
+}
+
+void FlightRecorder::PushEvent(const FlightEvent& event) {
+    if (!m_events.TryPush(event)) {
+        m_total_dropped_events.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+FlightRecorder::Stats FlightRecorder::GetStats() const {
+    Stats stats;
+    stats.total_frames = m_total_frames.load(std::memory_order_relaxed);
+    stats.total_events = m_total_events.load(std::memory_order_relaxed);
+    stats.total_dropped_frames = m_total_dropped_frames.load(std::memory_order_relaxed);
+    stats.total_dropped_events = m_total_dropped_events.load(std::memory_order_relaxed);
+    stats.total_chunks = m_total_chunks.load(std::memory_order_relaxed);
+    stats.total_bytes = m_total_bytes.load(std::memory_order_relaxed);
+    stats.total_rotations = m_total_rotations.load(std::memory_order_relaxed);
+    stats.total_failed_writes = m_total_failed_writes.load(std::memory_order_relaxed);
+    stats.total_failed_opens = m_total_failed_opens.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void FlightRecorder::RunWriter() {
+    auto lock = std::unique_lock(m_mutex);
+    while (true) {
+        // anything pushed before stopping is still written
+        const bool is_running = m_is_running;
+        lock.unlock();
+        const bool is_busy = DrainQueues();
+        const auto now = std::chrono::steady_clock::now();
+        if ((now - m_last_flush) >= m_config.flush_interval) {
+            WriteEventChunk();
+            WriteFrameChunk();
+            // NOTE: Chunks are buffered so a full disk can first show up here
+            if ((m_fp != nullptr) && (fflush(m_fp) != 0)) {
+                m_total_failed_writes.fetch_add(1, std::memory_order_relaxed);
+                RotateLog();
+            }
+            m_last_flush = now;
+        }
+        lock.lock();
+        if (!is_running) break;
+        if (!is_busy) {
+            m_cv.wait_for(lock, WRITER_IDLE_SLEEP, [this]() { return !m_is_running; });
+        }
+    }
+}
+
+bool FlightRecorder::DrainQueues() {
+    bool is_busy = false;
+    FlightEvent event;
+    while (m_events.TryPop(event)) {
+        is_busy = true;
+        m_chunk_events.push_back(event);
+        if (m_chunk_events.size() >= size_t(m_config.chunk_events)) {
+            WriteEventChunk();
+        }
+    }
+    int index = 0;
+    while (m_frame_ready.TryPop(index)) {
+        is_busy = true;
+        EncodeFrame(m_frame_slots[size_t(index)]);
+        m_frame_free.TryPush(index);
+        if (m_total_chunk_frames >= uint32_t(m_config.chunk_frames)) {
+            WriteFrameChunk();
+        }
+    }
+    return is_busy;
+}
+
+void FlightRecorder::EncodeFrame(const FrameSlot& slot) {
+    const size_t size = slot.pixels.size();
+    // every chunk starts with a key frame so it can be decoded on its own
+    const bool is_key =
+        !m_config.is_frame_delta ||
+        (m_total_chunk_frames == 0) ||
+        (m_prev_thumbnail.size() != size);
+    EncodeFrameDelta(slot.pixels.data(), is_key ? nullptr : m_prev_thumbnail.data(), size, m_encoded);
+
+    FlightFrameHeader header;
+    memset(&header, 0, sizeof(header));
+    header.frame_index = slot.frame_index;
+    header.timestamp_us = slot.timestamp_us;
+    header.width = uint32_t(slot.width);
+    header.height = uint32_t(slot.height);
+    header.encoding = uint32_t(is_key ? FlightFrameEncoding::KEY : FlightFrameEncoding::DELTA);
+    header.data_size = uint32_t(m_encoded.size());
+    append_bytes(m_chunk_frames, &header, sizeof(header));
+    append_bytes(m_chunk_frames, m_encoded.data(), m_encoded.size());
+    append_padding(m_chunk_frames);
+
+    m_prev_thumbnail.assign(slot.pixels.begin(), slot.pixels.end());
+    m_total_chunk_frames++;
+    m_total_frames.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FlightRecorder::WriteEventChunk() {
+    if (m_chunk_events.empty()) return;
+    const size_t total_events = m_chunk_events.size();
+    m_column_buffer.clear();
+    for (const auto& column: GetFlightEventColumns()) {
+        for (const auto& event: m_chunk_events) {
+            append_bytes(m_column_buffer, reinterpret_cast<const uint8_t*>(&event) + column.offset, column.size);
+        }
+        append_padding(m_column_buffer);
+    }
+    WriteChunk(FlightChunkType::EVENTS, uint32_t(total_events), m_column_buffer.data(), m_column_buffer.size());
+    m_total_events.fetch_add(total_events, std::memory_order_relaxed);
+    m_chunk_events.clear();
+}
+
+void FlightRecorder::WriteFrameChunk() {
+    if (m_total_chunk_frames == 0) return;
+    WriteChunk(FlightChunkType::FRAMES, m_total_chunk_frames, m_chunk_frames.data(), m_chunk_frames.size());
+    m_chunk_frames.clear();
+    m_total_chunk_frames = 0;
+}
+
+void FlightRecorder::WriteChunk(const FlightChunkType type, const uint32_t total_records, const uint8_t* payload, const size_t payload_size) {
+    if (m_fp == nullptr) {
+        OpenLog();
+    }
+    if (m_fp == nullptr) {
+        m_total_failed_writes.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    FlightChunkHeader header;
+    header.type = uint32_t(type);
+    header.total_records = total_records;
+    header.payload_size = uint64_t(payload_size);
+    bool is_written = true;
+    is_written = is_written && (fwrite(&header, sizeof(header), 1, m_fp) == 1);
+    is_written = is_written && (fwrite(payload, 1, payload_size, m_fp) == payload_size);
+    if (!is_written) {
+        m_total_failed_writes.fetch_add(1, std::memory_order_relaxed);
+        RotateLog();
+        return;
+    }
+    const uint64_t total_bytes = uint64_t(sizeof(header) + payload_size);
+    m_file_bytes += total_bytes;
+    m_total_bytes.fetch_add(total_bytes, std::memory_order_relaxed);
+    m_total_chunks.fetch_add(1, std::memory_order_relaxed);
+    if ((m_config.max_bytes > 0) && (m_file_bytes >= (m_config.max_bytes/2))) {
+        RotateLog();
+    }
+}
+
+void FlightRecorder::OpenLog() {
+    m_fp = fopen(m_filepath.c_str(), "wb");
+    if (m_fp == nullptr) {
+        m_total_failed_opens.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    FlightLogHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FLIGHT_LOG_MAGIC, sizeof(header.magic));
+    header.version = FLIGHT_LOG_VERSION;
+    header.frame_scale = uint32_t(m_config.frame_scale);
+    if (fwrite(&header, sizeof(header), 1, m_fp) != 1) {
+        fclose(m_fp);
+        m_fp = nullptr;
+        m_total_failed_opens.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    m_file_bytes = sizeof(header);
+    m_total_bytes.fetch_add(sizeof(header), std::memory_order_relaxed);
+}
+
+void FlightRecorder::RotateLog() {
+    if (m_fp != nullptr) {
+        fclose(m_fp);
+        m_fp = nullptr;
+    }
+    const auto old_filepath = m_filepath + ".old";
+    // NOTE: Renaming over an existing file fails on windows
+    remove(old_filepath.c_str());
+    rename(m_filepath.c_str(), old_filepath.c_str());
+    // the next frame chunk starts with a key frame so the new log doesn't depend on the old one
+    OpenLog();
+    m_total_rotations.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "IFrameSource.h"
+#include "SPSCQueue.h"
+
+// Flight logs are a header followed by chunks which are only written whole, so a log that was
+// cut short is missing at most its last chunks
+// Event chunks store each field of their events as a contiguous column so a memory mapped log
+// can be scanned a field at a time
+// Frame chunks store downscaled BGRA8 thumbnails where the first of each chunk is a key frame and
+// the rest are deltas from the thumbnail before them, so every chunk can be decoded on its own
+struct FlightLogHeader {
+    char magic[4];
+    uint32_t version;
+    // thumbnails keep every nth pixel in each direction
+    uint32_t frame_scale;
+    uint32_t reserved;
+};
+
+enum class FlightChunkType: uint32_t {
+    EVENTS = 1,
+    FRAMES = 2,
+};
+
+struct FlightChunkHeader {
+    uint32_t type;
+    uint32_t total_records;
+    // bytes after this header including padding
+    uint64_t payload_size;
+};
+
+enum class FlightFrameEncoding: uint32_t {
+    KEY = 0,
+    DELTA = 1,
+};
+
+struct FlightFrameHeader {
+    uint64_t frame_index;
+    int64_t timestamp_us;
+    uint32_t width;
+    uint32_t height;
+    uint32_t encoding;
+    // bytes of encoded data before padding
+    uint32_t data_size;
+};
+
+constexpr char FLIGHT_LOG_MAGIC[4] = {'S','B','F','L'};
+constexpr uint32_t FLIGHT_LOG_VERSION = 1;
+// columns and frames are padded so that every value is aligned in a memory mapped log
+constexpr size_t FLIGHT_LOG_ALIGNMENT = 8;
+
+enum FlightEventFlags: uint32_t {
+    FLIGHT_EVENT_TRACKING      = 1u << 0,
+    FLIGHT_EVENT_SOFT_TRIGGER  = 1u << 1,
+    FLIGHT_EVENT_HARD_TRIGGER  = 1u << 2,
+    FLIGHT_EVENT_CURSOR_MOVED  = 1u << 3,
+    FLIGHT_EVENT_CLICKED       = 1u << 4,
+    FLIGHT_EVENT_ROI           = 1u << 5,
+    FLIGHT_EVENT_UNCHANGED     = 1u << 6,
+};
+
+// what the player saw and did for one frame
+// NOTE: Fields are scalars so that each one can be stored as a column
+struct FlightEvent {
+    uint64_t frame_index = 0;
+    // when the grab of the frame finished and when its prediction was acted on
+    int64_t grab_us = 0;
+    int64_t apply_us = 0;
+    float raw_x = 0.0f;
+    float raw_y = 0.0f;
+    float raw_confidence = 0.0f;
+    float filtered_x = 0.0f;
+    float filtered_y = 0.0f;
+    float filtered_confidence = 0.0f;
+    float velocity_x = 0.0f;
+    float velocity_y = 0.0f;
+    float time_to_impact = -1.0f;
+    // screen coordinates the cursor was moved to if it was
+    int32_t cursor_x = 0;
+    int32_t cursor_y = 0;
+    uint32_t flags = 0;
+    int32_t us_grab = 0;
+    int32_t us_preprocess = 0;
+    int32_t us_inference = 0;
+};
+
+// byte offset and size of every field of FlightEvent in the order their columns are stored
+struct FlightEventColumn {
+    const char* name;
+    size_t offset;
+    size_t size;
+};
+const std::vector<FlightEventColumn>& GetFlightEventColumns();
+
+// differences from a previous buffer as runs of bytes, or from zeros if there is no previous buffer
+// token 0 to 127 is followed by token+1 literal differences and token 128 to 255 is token-127 unchanged bytes
+void EncodeFrameDelta(const uint8_t* curr, const uint8_t* prev, const size_t size, std::vector<uint8_t>& dst);
+// decodes in place if dst and prev are the same buffer, returns false if the data is corrupt
+bool DecodeFrameDelta(const uint8_t* src, const size_t src_size, const uint8_t* prev, uint8_t* dst, const size_t size);
+
+// Always on recording of the player that can be inspected after a missed ball
+// The player's stages only copy into preallocated slots and push to lock free queues,
+// and a background thread does the encoding and writing
+// Frames and events are dropped instead of blocking if the writer falls behind
+//
+// When a log reaches half of the maximum size it is moved to "<path>.old" and a new one is started
+// so that the most recent history is always kept without filling the disk
+// A failed write also starts a new log since anything after a partial chunk couldn't be read
+class FlightRecorder
+{
+public:
+    struct Config {
+        // thumbnails keep every nth pixel in each direction, frames aren't recorded if 0
+        int frame_scale = 4;
+        // key frames only if false
+        bool is_frame_delta = true;
+        // frames and events that can be waiting for the writer
+        int total_frame_slots = 16;
+        int total_event_slots = 1024;
+        // records per chunk
+        int chunk_frames = 60;
+        int chunk_events = 256;
+        // partial chunks are written after this long so a crash loses little
+        std::chrono::milliseconds flush_interval = std::chrono::milliseconds(1000);
+        // of the current and old log together, no limit if 0
+        uint64_t max_bytes = 0;
+    };
+    struct Stats {
+        uint64_t total_frames = 0;
+        uint64_t total_events = 0;
+        uint64_t total_dropped_frames = 0;
+        uint64_t total_dropped_events = 0;
+        uint64_t total_chunks = 0;
+        uint64_t total_bytes = 0;
+        uint64_t total_rotations = 0;
+        // chunks that were lost because a write or flush failed or there was no log open
+        uint64_t total_failed_writes = 0;
+        // times the log couldn't be created, which is retried on the next chunk
+        uint64_t total_failed_opens = 0;
+    };
+private:
+    struct FrameSlot {
+        std::vector<uint8_t> pixels;
+        uint64_t frame_index = 0;
+        int64_t timestamp_us = 0;
+        int width = 0;
+        int height = 0;
+    };
+
+    const std::string m_filepath;
+    const Config m_config;
+    FILE* m_fp;
+    uint64_t m_file_bytes;
+
+    // producer side
+    std::vector<FrameSlot> m_frame_slots;
+    SPSCQueue<int> m_frame_free;
+    SPSCQueue<int> m_frame_ready;
+    SPSCQueue<FlightEvent> m_events;
+
+    // writer side
+    std::vector<FlightEvent> m_chunk_events;
+    std::vector<uint8_t> m_chunk_frames;
+    uint32_t m_total_chunk_frames;
+    std::vector<uint8_t> m_prev_thumbnail;
+    std::vector<uint8_t> m_encoded;
+    std::vector<uint8_t> m_column_buffer;
+    std::chrono::steady_clock::time_point m_last_flush;
+
+    std::atomic<uint64_t> m_total_frames;
+    std::atomic<uint64_t> m_total_events;
+    std::atomic<uint64_t> m_total_dropped_frames;
+    std::atomic<uint64_t> m_total_dropped_events;
+    std::atomic<uint64_t> m_total_chunks;
+    std::atomic<uint64_t> m_total_bytes;
+    std::atomic<uint64_t> m_total_rotations;
+    std::atomic<uint64_t> m_total_failed_writes;
+    std::atomic<uint64_t> m_total_failed_opens;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_is_running;
+    std::thread m_thread;
+public:
+    FlightRecorder(const std::string& filepath, const Config& config);
+    ~FlightRecorder();
+    FlightRecorder(const FlightRecorder&) = delete;
+    FlightRecorder& operator=(const FlightRecorder&) = delete;
+    // NOTE: Frames and events each need to be pushed from a single thread, which can differ
+    void PushFrame(const FrameView& frame);
+    void PushEvent(const FlightEvent& event);
+    Stats GetStats() const;
+    const Config& GetConfig() const { return m_config; }
+private:
+    void RunWriter();
+    // returns true if anything was waiting
+    bool DrainQueues();
+    void EncodeFrame(const FrameSlot& slot);
+    void WriteEventChunk();
+    void WriteFrameChunk();
+    void WriteChunk(const FlightChunkType type, const uint32_t total_records, const uint8_t* payload, const size_t payload_size);
+    void OpenLog();
+    void RotateLog();
+};
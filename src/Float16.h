@@ -0,0 +1,60 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+// IEEE-754 half precision conversions for models with float16 tensors
+inline uint16_t float_to_half(const float value) {
+    uint32_t x;
+    memcpy(&x, &value, sizeof(x));
+    const uint32_t sign = (x >> 16) & 0x8000u;
+    const uint32_t abs_x = x & 0x7FFFFFFFu;
+    // nan and infinity
+    if (abs_x >= 0x7F800000u) {
+        return uint16_t(sign | 0x7C00u | ((abs_x > 0x7F800000u) ? 0x0200u : 0u));
+    }
+    // overflow to infinity
+    if (abs_x >= 0x477FF000u) {
+        return uint16_t(sign | 0x7C00u);
+    }
+    // subnormals and underflow to zero
+    if (abs_x < 0x38800000u) {
+        if (abs_x < 0x33000000u) return uint16_t(sign);
+        const uint32_t mantissa = (abs_x & 0x007FFFFFu) | 0x00800000u;
+        const uint32_t shift = 126u - (abs_x >> 23);
+        const uint32_t half_bit = 1u << (shift - 1u);
+        uint32_t result = mantissa >> shift;
+        // round to nearest even
+        const uint32_t remainder = mantissa & ((1u << shift) - 1u);
+        if ((remainder > half_bit) || ((remainder == half_bit) && (result & 1u))) result++;
+        return uint16_t(sign | result);
+    }
+    // normals with round to nearest even
+    uint32_t result = abs_x - 0x38000000u;
+    result += 0x0FFFu + ((result >> 13) & 1u);
+    return uint16_t(sign | (result >> 13));
+}
+
+inline float half_to_float(const uint16_t value) {
+    const uint32_t sign = uint32_t(value & 0x8000u) << 16;
+    const uint32_t exponent = (value >> 10) & 0x1Fu;
+    uint32_t mantissa = value & 0x03FFu;
+    uint32_t x;
+    if (exponent == 0x1Fu) {
+        x = sign | 0x7F800000u | (mantissa << 13);
+    } else if (exponent != 0) {
+        x = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+    } else if (mantissa == 0) {
+        x = sign;
+    } else {
+        // renormalise subnormal
+        uint32_t e = 113u;
+        while ((mantissa & 0x0400u) == 0) {
+            mantissa <<= 1;
+            e--;
+        }
+        x = sign | (e << 23) | ((mantissa & 0x03FFu) << 13);
+    }
+    float result;
+    memcpy(&result, &x, sizeof(result));
+    return result;
+}
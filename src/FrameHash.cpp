@@ -0,0 +1,126 @@
+#include "FrameHash.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// same constants and round as xxhash32
+constexpr uint32_t PRIME32_1 = 0x9E3779B1u;
+constexpr uint32_t PRIME32_2 = 0x85EBCA77u;
+constexpr uint32_t PRIME32_3 = 0xC2B2AE3Du;
+constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+
+// 8 lanes of 32bit words so that the hash is the same for each instruction set
+#if defined(__AVX2__)
+struct u32x8 { __m256i v; };
+static inline u32x8 u32x8_load(const uint8_t* x) { return { _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x)) }; }
+static inline void u32x8_store(uint32_t* x, const u32x8 a) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(x), a.v); }
+static inline u32x8 u32x8_broadcast(const uint32_t x) { return { _mm256_set1_epi32(int32_t(x)) }; }
+static inline u32x8 u32x8_add(const u32x8 a, const u32x8 b) { return { _mm256_add_epi32(a.v, b.v) }; }
+static inline u32x8 u32x8_mul(const u32x8 a, const u32x8 b) { return { _mm256_mullo_epi32(a.v, b.v) }; }
+static inline u32x8 u32x8_rotl13(const u32x8 a) { return { _mm256_or_si256(_mm256_slli_epi32(a.v, 13), _mm256_srli_epi32(a.v, 19)) }; }
+#elif defined(__ARM_NEON)
+struct u32x8 { uint32x4_t lo, hi; };
+static inline u32x8 u32x8_load(const uint8_t* x) { return { vreinterpretq_u32_u8(vld1q_u8(x)), vreinterpretq_u32_u8(vld1q_u8(x+16)) }; }
+static inline void u32x8_store(uint32_t* x, const u32x8 a) { vst1q_u32(x, a.lo); vst1q_u32(x+4, a.hi); }
+static inline u32x8 u32x8_broadcast(const uint32_t x) { return { vdupq_n_u32(x), vdupq_n_u32(x) }; }
+static inline u32x8 u32x8_add(const u32x8 a, const u32x8 b) { return { vaddq_u32(a.lo, b.lo), vaddq_u32(a.hi, b.hi) }; }
+static inline u32x8 u32x8_mul(const u32x8 a, const u32x8 b) { return { vmulq_u32(a.lo, b.lo), vmulq_u32(a.hi, b.hi) }; }
+static inline u32x8 u32x8_rotl13(const u32x8 a) { return { vsriq_n_u32(vshlq_n_u32(a.lo, 13), a.lo, 19), vsriq_n_u32(vshlq_n_u32(a.hi, 13), a.hi, 19) }; }
+#else
+struct u32x8 { uint32_t v[8]; };
+static inline u32x8 u32x8_load(const uint8_t* x) { u32x8 a; memcpy(a.v, x, sizeof(a.v)); return a; }
+static inline void u32x8_store(uint32_t* x, const u32x8 a) { memcpy(x, a.v, sizeof(a.v)); }
+static inline u32x8 u32x8_broadcast(const uint32_t x) { u32x8 a; for (int i = 0; i < 8; i++) a.v[i] = x; return a; }
+static inline u32x8 u32x8_add(const u32x8 a, const u32x8 b) { u32x8 c; for (int i = 0; i < 8; i++) c.v[i] = a.v[i] + b.v[i]; return c; }
+static inline u32x8 u32x8_mul(const u32x8 a, const u32x8 b) { u32x8 c; for (int i = 0; i < 8; i++) c.v[i] = a.v[i] * b.v[i]; return c; }
+static inline u32x8 u32x8_rotl13(const u32x8 a) { u32x8 c; for (int i = 0; i < 8; i++) c.v[i] = (a.v[i] << 13) | (a.v[i] >> 19); return c; }
+#endif
+
+// NOTE: The multiplies have a long latency so we interleave this many accumulators
+constexpr int TOTAL_ACCUMULATORS = 4;
+constexpr size_t BLOCK_SIZE = 32;
+
+struct HashState {
+    u32x8 acc[TOTAL_ACCUMULATORS];
+    uint64_t tail;
+};
+
+static inline u32x8 hash_round(const u32x8 acc, const u32x8 x, const u32x8 prime_1, const u32x8 prime_2) {
+    return u32x8_mul(u32x8_rotl13(u32x8_add(acc, u32x8_mul(x, prime_2))), prime_1);
+}
+
+static void hash_span(HashState& state, const uint8_t* data, const size_t size) {
+    const u32x8 prime_1 = u32x8_broadcast(PRIME32_1);
+    const u32x8 prime_2 = u32x8_broadcast(PRIME32_2);
+    size_t i = 0;
+    for (; i+BLOCK_SIZE*TOTAL_ACCUMULATORS <= size; i += BLOCK_SIZE*TOTAL_ACCUMULATORS) {
+        for (int k = 0; k < TOTAL_ACCUMULATORS; k++) {
+            state.acc[k] = hash_round(state.acc[k], u32x8_load(&data[i + k*BLOCK_SIZE]), prime_1, prime_2);
+        }
+    }
+    for (; i+BLOCK_SIZE <= size; i += BLOCK_SIZE) {
+        state.acc[0] = hash_round(state.acc[0], u32x8_load(&data[i]), prime_1, prime_2);
+    }
+    // rows of odd widths leave a few bytes over
+    uint64_t tail = state.tail;
+    for (; i < size; i++) {
+        tail = (tail ^ uint64_t(data[i])) * PRIME64_1;
+    }
+    state.tail = tail;
+}
+
+static void init_state(HashState& state, const uint64_t seed) {
+    for (int k = 0; k < TOTAL_ACCUMULATORS; k++) {
+        state.acc[k] = u32x8_broadcast(PRIME32_3 + uint32_t(k)*PRIME32_1);
+    }
+    state.tail = seed;
+}
+
+static uint64_t finish_hash(const HashState& state) {
+    uint64_t hash = state.tail;
+    uint32_t lanes[8];
+    for (int k = 0; k < TOTAL_ACCUMULATORS; k++) {
+        u32x8_store(lanes, state.acc[k]);
+        for (int j = 0; j < 8; j++) {
+            hash = (hash ^ uint64_t(lanes[j])) * PRIME64_1;
+            hash ^= hash >> 29;
+        }
+    }
+    hash *= PRIME64_2;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint64_t GetFrameHash(const FrameView& frame) {
+    HashState state;
+    init_state(state, (uint64_t(uint32_t(frame.width)) << 32) | uint64_t(uint32_t(frame.height)));
+
+    if ((frame.data == nullptr) || (frame.width <= 0) || (frame.height <= 0)) {
+        return state.tail * PRIME64_2;
+    }
+
+    // contiguous frames are hashed as a single span so there are fewer leftover bytes
+    const size_t row_size = size_t(frame.width)*4;
+    if (frame.row_stride == int(row_size)) {
+        hash_span(state, frame.data, row_size*size_t(frame.height));
+    } else {
+        for (int y = 0; y < frame.height; y++) {
+            hash_span(state, frame.data + ptrdiff_t(y)*ptrdiff_t(frame.row_stride), row_size);
+        }
+    }
+    return finish_hash(state);
+}
+
+uint64_t GetDataHash(const uint8_t* data, const size_t size) {
+    HashState state;
+    init_state(state, uint64_t(size));
+    hash_span(state, data, size);
+    return finish_hash(state);
+}
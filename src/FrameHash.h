@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "IFrameSource.h"
+
+// Fast non cryptographic hash of the visible pixels of a frame for detecting unchanged frames
+// Runs independent multiply rotate rounds on 8 lanes of 32bit words so that it keeps up with memory bandwidth
+// Frames with different sizes always hash differently and padding between rows isn't read
+// NOTE: Contiguous frames are hashed as one span so only compare hashes of frames with the same row stride
+uint64_t GetFrameHash(const FrameView& frame);
+// Same hash over a contiguous buffer which is used to key caches by file contents
+uint64_t GetDataHash(const uint8_t* data, const size_t size);
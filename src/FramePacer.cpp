@@ -0,0 +1,230 @@
+#include "FramePacer.h"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <fmt/core.h>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define CPU_RELAX() _mm_pause()
+#else
+#define CPU_RELAX()
+#endif
+
+// intervals longer than this are the game pausing rather than the source frame rate
+constexpr int64_t MAX_FRAME_INTERVAL_NS = 250'000'000;
+constexpr int64_t DEFAULT_WAKE_MARGIN_NS = 1'000'000;
+constexpr int64_t MIN_WAKE_MARGIN_NS = 200'000;
+// grabs of the old frame after waking before the margin is shrunk
+constexpr int TOTAL_EARLY_GRABS = 3;
+// the last stretch before a frame is yielded or spun through since sleeps overshoot
+constexpr int64_t FINAL_WAIT_NS = 200'000;
+// sleeps are assumed to be this late until they have been measured
+constexpr int64_t DEFAULT_SLEEP_OVERSHOOT_NS = 1'000'000;
+
+const char* GetPacingModeString(const PacingMode mode) {
+    switch (mode) {
+    case PacingMode::OFF:      return "off";
+    case PacingMode::LATENCY:  return "latency";
+    case PacingMode::BALANCED: return "balanced";
+    case PacingMode::POWER:    return "power";
+    default:                   return "unknown";
+    }
+}
+
+PacingMode ParsePacingMode(const std::string& str) {
+    if (str.compare("off") == 0) return PacingMode::OFF;
+    if (str.compare("latency") == 0) return PacingMode::LATENCY;
+    if (str.compare("balanced") == 0) return PacingMode::BALANCED;
+    if (str.compare("power") == 0) return PacingMode::POWER;
+    throw std::runtime_error(fmt::format("Invalid pacing mode: '{}'. Options: [off, latency, balanced, power]", str));
+}
+
+FramePacer::FramePacer(const PacingMode mode)
+: m_mode(mode)
+{
+    Reset();
+    m_sleep_overshoot_mean_ns = DEFAULT_SLEEP_OVERSHOOT_NS;
+    m_sleep_overshoot_deviation_ns = 0;
+    m_total_wakes = 0;
+}
+
+void FramePacer::Reset() {
+    auto lock = std::scoped_lock(m_mutex);
+    m_intervals.fill(0);
+    m_total_intervals = 0;
+    m_next_interval = 0;
+    m_frame_interval_ns = 0;
+    m_has_last_frame = false;
+    m_wake_margin_ns = DEFAULT_WAKE_MARGIN_NS;
+    m_is_paced = false;
+    m_total_grabs_since_wake = 0;
+}
+
+void FramePacer::OnFrame(const bool is_new_frame, const Clock::time_point grab_time) {
+    auto lock = std::scoped_lock(m_mutex);
+    m_stats.total_grabs++;
+    if (!is_new_frame) {
+        m_total_grabs_since_wake++;
+        return;
+    }
+    m_stats.total_new_frames++;
+
+    // correct the margin from how many grabs it took to see the frame we woke for
+    if (m_is_paced && (m_frame_interval_ns > 0)) {
+        if (m_total_grabs_since_wake == 0) {
+            m_wake_margin_ns += m_wake_margin_ns/2;
+        } else if (m_total_grabs_since_wake >= TOTAL_EARLY_GRABS) {
+            m_wake_margin_ns -= m_wake_margin_ns/8;
+        }
+        m_wake_margin_ns = std::clamp(m_wake_margin_ns, MIN_WAKE_MARGIN_NS, std::max(m_frame_interval_ns/2, MIN_WAKE_MARGIN_NS));
+    }
+    m_is_paced = false;
+    m_total_grabs_since_wake = 0;
+
+    // NOTE: Frames are seen when they are grabbed rather than when they arrive so intervals
+    //       are off by up to one grab, and the median rejects those doubled by a dropped frame
+    if (m_has_last_frame) {
+        const int64_t interval_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(grab_time - m_last_frame_time).count();
+        if ((interval_ns > 0) && (interval_ns < MAX_FRAME_INTERVAL_NS)) {
+            m_intervals[m_next_interval] = interval_ns;
+            m_next_interval = (m_next_interval + 1) % TOTAL_INTERVAL_SAMPLES;
+            m_total_intervals = std::min(m_total_intervals + 1, TOTAL_INTERVAL_SAMPLES);
+            if (m_total_intervals >= MIN_INTERVAL_SAMPLES) {
+                auto samples = m_intervals;
+                auto* middle = samples.data() + m_total_intervals/2;
+                std::nth_element(samples.data(), middle, samples.data() + m_total_intervals);
+                m_frame_interval_ns = *middle;
+            }
+        }
+    }
+    m_last_frame_time = grab_time;
+    m_has_last_frame = true;
+}
+
+void FramePacer::WaitForFrame() {
+    const auto mode = m_mode.load();
+    if (mode == PacingMode::OFF) {
+        return;
+    }
+    auto lock = std::unique_lock(m_mutex);
+    if (m_frame_interval_ns == 0) {
+        return;
+    }
+    const auto now = Clock::now();
+    const auto interval = std::chrono::nanoseconds(m_frame_interval_ns);
+    const auto margin = std::chrono::nanoseconds(m_wake_margin_ns);
+    const auto elapsed = now - m_last_frame_time;
+    Clock::time_point deadline;
+    bool is_paced = false;
+    if (elapsed < (interval - margin)) {
+        deadline = m_last_frame_time + interval - margin;
+        is_paced = true;
+    } else if (elapsed < (interval + margin)) {
+        // the frame is due so poll for it as often as the mode allows
+        if (mode == PacingMode::LATENCY) {
+            return;
+        }
+        if (mode == PacingMode::BALANCED) {
+            lock.unlock();
+            std::this_thread::yield();
+            return;
+        }
+        deadline = now + margin/4;
+    } else {
+        // the source skipped frames or stopped changing so wait for where the next one would be
+        const int64_t total_intervals = int64_t((elapsed + margin) / interval) + 1;
+        deadline = m_last_frame_time + total_intervals*interval - margin;
+        is_paced = true;
+    }
+    // NOTE: Polls inside the window keep counting grabs towards the wake they follow
+    if (is_paced) {
+        m_is_paced = true;
+        m_total_grabs_since_wake = 0;
+        m_stats.total_paced_waits++;
+    }
+    const int64_t sleep_overshoot_ns = GetSleepOvershoot();
+    lock.unlock();
+    WaitUntil(deadline, mode, sleep_overshoot_ns);
+}
+
+void FramePacer::WaitUntil(const Clock::time_point deadline, const PacingMode mode, const int64_t sleep_overshoot_ns) {
+    // power mode only sleeps and accepts waking late
+    const int64_t final_wait_ns = (mode == PacingMode::POWER) ? 0 : FINAL_WAIT_NS;
+    auto sleep_deadline = deadline - std::chrono::nanoseconds(sleep_overshoot_ns + final_wait_ns);
+    auto now = Clock::now();
+    // NOTE: Sleeps on windows overshoot by the timer period which can be longer than a frame
+    //       so power mode sleeps until the deadline anyway instead of polling
+    if ((mode == PacingMode::POWER) && (sleep_deadline <= now)) {
+        sleep_deadline = deadline;
+    }
+    uint64_t sleep_ns = 0;
+    if (sleep_deadline > now) {
+        const auto sleep_start = now;
+        const bool is_timed_out = SleepUntil(sleep_deadline);
+        now = Clock::now();
+        sleep_ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(now - sleep_start).count());
+        auto lock = std::scoped_lock(m_mutex);
+        m_stats.total_sleep_ns += sleep_ns;
+        if (!is_timed_out) {
+            return;
+        }
+        // running mean and mean deviation like tcp's retransmit timer
+        const int64_t overshoot_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - sleep_deadline).count();
+        const int64_t error_ns = overshoot_ns - m_sleep_overshoot_mean_ns;
+        m_sleep_overshoot_mean_ns += error_ns/8;
+        m_sleep_overshoot_deviation_ns += (std::abs(error_ns) - m_sleep_overshoot_deviation_ns)/4;
+    }
+    if ((mode == PacingMode::POWER) || (now >= deadline)) {
+        return;
+    }
+
+    const auto wait_start = now;
+    if (mode == PacingMode::BALANCED) {
+        while (Clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+    } else {
+        while (Clock::now() < deadline) {
+            CPU_RELAX();
+        }
+    }
+    const uint64_t wait_ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - wait_start).count());
+    auto lock = std::scoped_lock(m_mutex);
+    if (mode == PacingMode::BALANCED) {
+        m_stats.total_yield_ns += wait_ns;
+    } else {
+        m_stats.total_spin_ns += wait_ns;
+    }
+}
+
+bool FramePacer::SleepUntil(const Clock::time_point deadline) {
+    auto lock = std::unique_lock(m_wake_mutex);
+    const uint64_t total_wakes = m_total_wakes;
+    return !m_wake_cv.wait_until(lock, deadline, [&]() { return m_total_wakes != total_wakes; });
+}
+
+void FramePacer::WaitPaused(const std::chrono::milliseconds timeout) {
+    SleepUntil(Clock::now() + timeout);
+}
+
+void FramePacer::Wake() {
+    auto lock = std::scoped_lock(m_wake_mutex);
+    m_total_wakes++;
+    m_wake_cv.notify_all();
+}
+
+int64_t FramePacer::GetSleepOvershoot() const {
+    return m_sleep_overshoot_mean_ns + 2*m_sleep_overshoot_deviation_ns;
+}
+
+FramePacer::Stats FramePacer::GetStats() const {
+    auto lock = std::scoped_lock(m_mutex);
+    Stats stats = m_stats;
+    stats.frame_interval_ns = m_frame_interval_ns;
+    stats.wake_margin_ns = m_wake_margin_ns;
+    stats.sleep_overshoot_ns = GetSleepOvershoot();
+    return stats;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+// How the pacer trades cpu usage for how soon a new frame is grabbed
+enum class PacingMode {
+    // grab again as soon as the previous frame is done
+    OFF,
+    // spins through the last stretch before a frame is due
+    LATENCY,
+    // yields the last stretch before a frame is due to other threads
+    BALANCED,
+    // only sleeps so frames can be grabbed a little late but the core is mostly idle
+    POWER,
+};
+
+const char* GetPacingModeString(const PacingMode mode);
+PacingMode ParsePacingMode(const std::string& str);
+
+// Learns the interval between new frames of the source and waits until just before the next one
+// instead of grabbing copies of the current frame as fast as possible
+// Waits sleep for as long as the measured wake up latency of the os allows, then yield or spin
+// for the rest depending on the mode
+//
+// last frame --[sleep]--[yield or spin]--> wake --(margin)--> next frame
+//
+// The wake margin grows if the first grab after waking already has a new frame since it could have
+// arrived before we woke, and shrinks if we keep grabbing the old frame after waking
+class FramePacer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    struct Stats {
+        uint64_t total_grabs = 0;
+        uint64_t total_new_frames = 0;
+        // waits for a frame that was predicted from the learned interval
+        uint64_t total_paced_waits = 0;
+        uint64_t total_sleep_ns = 0;
+        uint64_t total_yield_ns = 0;
+        uint64_t total_spin_ns = 0;
+        // learned state which is 0 until enough frames have been seen
+        int64_t frame_interval_ns = 0;
+        int64_t wake_margin_ns = 0;
+        int64_t sleep_overshoot_ns = 0;
+    };
+private:
+    // odd so the median is a sample
+    static constexpr int TOTAL_INTERVAL_SAMPLES = 15;
+    static constexpr int MIN_INTERVAL_SAMPLES = 5;
+
+    std::atomic<PacingMode> m_mode;
+    // NOTE: Waits happen on the capture thread while frames are reported by the preprocessing thread
+    mutable std::mutex m_mutex;
+    std::array<int64_t, TOTAL_INTERVAL_SAMPLES> m_intervals;
+    int m_total_intervals;
+    int m_next_interval;
+    int64_t m_frame_interval_ns;
+    bool m_has_last_frame;
+    Clock::time_point m_last_frame_time;
+    int64_t m_wake_margin_ns;
+    // set when we waited for a predicted frame so the margin can be corrected by the grabs after it
+    bool m_is_paced;
+    int m_total_grabs_since_wake;
+    // how late timed sleeps wake up as a running mean and mean deviation
+    int64_t m_sleep_overshoot_mean_ns;
+    int64_t m_sleep_overshoot_deviation_ns;
+    Stats m_stats;
+
+    // sleeps are on a condition variable so Wake() can interrupt them
+    std::mutex m_wake_mutex;
+    std::condition_variable m_wake_cv;
+    uint64_t m_total_wakes;
+public:
+    explicit FramePacer(const PacingMode mode = PacingMode::BALANCED);
+    FramePacer(const FramePacer&) = delete;
+    FramePacer& operator=(const FramePacer&) = delete;
+    void SetMode(const PacingMode mode) { m_mode = mode; }
+    PacingMode GetMode() const { return m_mode; }
+    // blocks until just before the next frame is expected, returns immediately if the interval isn't known
+    void WaitForFrame();
+    // called for every grab that was compared against the previous one
+    void OnFrame(const bool is_new_frame, const Clock::time_point grab_time);
+    // forget the learned interval such as when grabs are no longer compared
+    void Reset();
+    // blocks while paused until Wake() is called or the timeout passes
+    void WaitPaused(const std::chrono::milliseconds timeout);
+    // interrupts any current wait such as when resuming or stopping
+    void Wake();
+    Stats GetStats() const;
+private:
+    int64_t GetSleepOvershoot() const;
+    // returns false if interrupted by Wake()
+    bool SleepUntil(const Clock::time_point deadline);
+    void WaitUntil(const Clock::time_point deadline, const PacingMode mode, const int64_t sleep_overshoot_ns);
+};
@@ -0,0 +1,228 @@
+#include "FramePipeline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <string.h>
+#include <fmt/core.h>
+
+// waiting threads spin for a short while before sleeping since frames usually arrive soon
+constexpr int TOTAL_SPINS_BEFORE_SLEEP = 256;
+constexpr auto MAX_SLEEP_DURATION = std::chrono::milliseconds(1);
+constexpr auto PAUSE_SLEEP_DURATION = std::chrono::milliseconds(10);
+
+FramePipeline::FramePipeline(SoccerPlayer& player, const Config& config, CapturePoll&& capture_poll)
+: m_player(player),
+  m_config(config),
+  m_capture_poll(std::move(capture_poll)),
+  m_capture_free(size_t(std::max(config.depth, 1))),
+  m_capture_ready(size_t(std::max(config.depth, 1))),
+  m_input_free(size_t(std::max(config.depth, 1))),
+  m_input_ready(size_t(std::max(config.depth, 1))),
+  m_results(size_t(std::max(config.depth, 1)))
+{
+    if (config.depth < 1) {
+        throw std::runtime_error(fmt::format("Pipeline depth must be at least 1 (got {})", config.depth));
+    }
+
+    // staging buffers for the model input have the same format as the model
+    m_model_input_size = GetInputBufferSize(m_player.GetModelInputBuffer());
+    if (m_player.HasROIModel()) {
+        m_model_input_size = std::max(m_model_input_size, GetInputBufferSize(m_player.GetModelInputBuffer(true)));
+    }
+
+    const int total_slots = config.depth;
+    m_capture_slots.resize(size_t(total_slots));
+    m_input_slots.resize(size_t(total_slots));
+    for (int i = 0; i < total_slots; i++) {
+        m_input_slots[i].data.resize(m_model_input_size);
+        m_capture_free.TryPush(i);
+        m_input_free.TryPush(i);
+    }
+
+    m_is_running = true;
+    m_total_captured = 0;
+    m_total_inferred = 0;
+    m_total_dropped = 0;
+    m_total_waiting = 0;
+    m_threads.emplace_back([this]() {
+        TrySetCurrentThreadSchedule(m_config.capture_schedule, "pipeline capture");
+        RunCapture();
+    });
+    m_threads.emplace_back([this]() { RunPreprocess(); });
+    m_threads.emplace_back([this]() {
+        TrySetCurrentThreadSchedule(m_config.inference_schedule, "pipeline inference");
+        RunInference();
+    });
+    m_threads.emplace_back([this]() { RunControl(); });
+}
+
+FramePipeline::~FramePipeline() {
+    m_is_running = false;
+    // the capture stage may be waiting on the pacer for the next frame
+    m_player.GetPacer().Wake();
+    {
+        auto lock = std::scoped_lock(m_wait_mutex);
+        m_wait_cv.notify_all();
+    }
+    for (auto& thread: m_threads) {
+        thread.join();
+    }
+}
+
+FramePipeline::Stats FramePipeline::GetStats() const {
+    Stats stats;
+    stats.total_captured = m_total_captured;
+    stats.total_inferred = m_total_inferred;
+    stats.total_dropped = m_total_dropped;
+    return stats;
+}
+
+void FramePipeline::Notify() {
+    // NOTE: Only take the lock if a thread is actually sleeping
+    if (m_total_waiting.load() > 0) {
+        auto lock = std::scoped_lock(m_wait_mutex);
+        m_wait_cv.notify_all();
+    }
+}
+
+template <typename F>
+bool FramePipeline::WaitUntil(F&& is_ready) {
+    for (int i = 0; i < TOTAL_SPINS_BEFORE_SLEEP; i++) {
+        if (is_ready()) return true;
+        if (!m_is_running) return false;
+        std::this_thread::yield();
+    }
+    while (m_is_running) {
+        if (is_ready()) return true;
+        auto lock = std::unique_lock(m_wait_mutex);
+        m_total_waiting++;
+        // NOTE: The timeout guards against a notify that raced with us going to sleep
+        m_wait_cv.wait_for(lock, MAX_SLEEP_DURATION);
+        m_total_waiting--;
+    }
+    return false;
+}
+
+template <typename T>
+bool FramePipeline::Pop(SPSCQueue<T>& queue, T& item) {
+    const bool is_popped = WaitUntil([&]() { return queue.TryPop(item); });
+    if (is_popped) Notify();
+    return is_popped;
+}
+
+template <typename T>
+bool FramePipeline::Push(SPSCQueue<T>& queue, const T& item) {
+    const bool is_pushed = WaitUntil([&]() { return queue.TryPush(item); });
+    if (is_pushed) Notify();
+    return is_pushed;
+}
+
+bool FramePipeline::PopNewest(SPSCQueue<int>& ready, SPSCQueue<int>& free, int& index) {
+    if (!Pop(ready, index)) {
+        return false;
+    }
+    if (!m_config.drop_stale) {
+        return true;
+    }
+    int newer_index;
+    while (ready.TryPop(newer_index)) {
+        // NOTE: The free queue can hold every slot so this never fails
+        free.TryPush(index);
+        index = newer_index;
+        m_total_dropped++;
+    }
+    Notify();
+    return true;
+}
+
+void FramePipeline::RunCapture() {
+    while (m_is_running) {
+        int top = 0;
+        int left = 0;
+        if (!m_capture_poll(top, left)) {
+            m_player.GetPacer().WaitPaused(PAUSE_SLEEP_DURATION);
+            continue;
+        }
+
+        // wait for a free slot before grabbing so that the frame is as fresh as possible
+        int index = 0;
+        if (!Pop(m_capture_free, index)) break;
+        auto& slot = m_capture_slots[index];
+        slot.context = SoccerPlayer::FrameContext{};
+        const auto frame = m_player.CaptureFrame(top, left, slot.context);
+
+        // frame source reuses its buffer on the next grab so we need our own copy
+        const size_t row_size = size_t(frame.width)*4;
+        slot.pixels.resize(row_size*size_t(frame.height));
+        for (int y = 0; y < frame.height; y++) {
+            const uint8_t* src = frame.data + ptrdiff_t(y)*ptrdiff_t(frame.row_stride);
+            memcpy(&slot.pixels[size_t(y)*row_size], src, row_size);
+        }
+        slot.frame = frame;
+        slot.frame.data = slot.pixels.data();
+        slot.frame.row_stride = int(row_size);
+
+        m_total_captured++;
+        if (!Push(m_capture_ready, index)) break;
+    }
+}
+
+void FramePipeline::RunPreprocess() {
+    while (m_is_running) {
+        // NOTE: Get the output slot first so we don't hold onto a capture slot while it goes stale
+        int input_index = 0;
+        if (!Pop(m_input_free, input_index)) break;
+        int capture_index = 0;
+        if (!PopNewest(m_capture_ready, m_capture_free, capture_index)) break;
+
+        auto& capture_slot = m_capture_slots[capture_index];
+        auto& input_slot = m_input_slots[input_index];
+        input_slot.context = capture_slot.context;
+        m_player.SelectRegion(input_slot.context);
+        InputBuffer dst = m_player.GetModelInputBuffer(input_slot.context.is_roi);
+        dst.data = input_slot.data.data();
+        m_player.PreprocessFrame(capture_slot.frame, dst, input_slot.context);
+
+        if (!Push(m_capture_free, capture_index)) break;
+        if (!Push(m_input_ready, input_index)) break;
+    }
+}
+
+void FramePipeline::RunInference() {
+    while (m_is_running) {
+        int index = 0;
+        if (!PopNewest(m_input_ready, m_input_free, index)) break;
+
+        auto& slot = m_input_slots[index];
+        Result result;
+        result.context = slot.context;
+        // NOTE: The model owns its input tensor so the staged input is copied in
+        //       This is the only copy the pipeline adds and is at most a few microseconds
+        // unchanged frames weren't preprocessed and reuse the last prediction
+        if (!result.context.is_unchanged) {
+            const auto model_input = m_player.GetModelInputBuffer(result.context.is_roi);
+            memcpy(model_input.data, slot.data.data(), GetInputBufferSize(model_input));
+        }
+        if (!Push(m_input_free, index)) break;
+
+        result.prediction = m_player.RunModel(result.context);
+        m_total_inferred++;
+        if (!Push(m_results, result)) break;
+    }
+}
+
+void FramePipeline::RunControl() {
+    while (m_is_running) {
+        Result result;
+        if (!Pop(m_results, result)) break;
+        if (m_config.drop_stale) {
+            Result newer_result;
+            while (m_results.TryPop(newer_result)) {
+                result = newer_result;
+                m_total_dropped++;
+            }
+        }
+        m_player.ApplyPrediction(result.prediction, result.context);
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "IFrameSource.h"
+#include "IModel.h"
+#include "Prediction.h"
+#include "SoccerPlayer.h"
+#include "SPSCQueue.h"
+#include "ThreadSchedule.h"
+
+// Runs the stages of SoccerPlayer on their own threads so that capture, preprocessing,
+// inference and control overlap. Throughput is limited by the slowest stage instead of the sum.
+// Frames are passed between stages through fixed pools of slots using lock free queues.
+//
+// capture -> [capture slots] -> preprocess -> [input slots] -> inference -> [results] -> control
+class FramePipeline
+{
+public:
+    struct Config {
+        // number of slots between each stage
+        // 1 keeps at most one frame in flight per stage for the lowest latency
+        // 2 or 3 lets stages run ahead of each other for higher throughput
+        int depth = 2;
+        // consumers skip to the newest queued frame so we never act on an old frame
+        bool drop_stale = true;
+        // capture and inference are the latency critical stages so only they can be pinned
+        ThreadSchedule capture_schedule;
+        ThreadSchedule inference_schedule;
+    };
+    struct Stats {
+        uint64_t total_captured = 0;
+        uint64_t total_inferred = 0;
+        uint64_t total_dropped = 0;
+    };
+    // return false to pause capture, otherwise provide the screen position to capture from
+    using CapturePoll = std::function<bool(int& top, int& left)>;
+private:
+    struct CaptureSlot {
+        std::vector<uint8_t> pixels;
+        FrameView frame;
+        SoccerPlayer::FrameContext context;
+    };
+    struct InputSlot {
+        std::vector<uint8_t> data;
+        SoccerPlayer::FrameContext context;
+    };
+    struct Result {
+        Prediction prediction;
+        SoccerPlayer::FrameContext context;
+    };
+
+    SoccerPlayer& m_player;
+    const Config m_config;
+    CapturePoll m_capture_poll;
+    // staging buffers are large enough for either the full frame or region of interest model
+    size_t m_model_input_size;
+
+    std::vector<CaptureSlot> m_capture_slots;
+    std::vector<InputSlot> m_input_slots;
+    // empty slots flow back to the producer and filled slots flow forward to the consumer
+    SPSCQueue<int> m_capture_free;
+    SPSCQueue<int> m_capture_ready;
+    SPSCQueue<int> m_input_free;
+    SPSCQueue<int> m_input_ready;
+    SPSCQueue<Result> m_results;
+
+    std::atomic<bool> m_is_running;
+    std::atomic<uint64_t> m_total_captured;
+    std::atomic<uint64_t> m_total_inferred;
+    std::atomic<uint64_t> m_total_dropped;
+    // idle stages sleep here after spinning for a while
+    std::mutex m_wait_mutex;
+    std::condition_variable m_wait_cv;
+    std::atomic<int> m_total_waiting;
+    std::vector<std::thread> m_threads;
+public:
+    FramePipeline(SoccerPlayer& player, const Config& config, CapturePoll&& capture_poll);
+    ~FramePipeline();
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+    const Config& GetConfig() const { return m_config; }
+    Stats GetStats() const;
+private:
+    void RunCapture();
+    void RunPreprocess();
+    void RunInference();
+    void RunControl();
+    void Notify();
+    template <typename F>
+    bool WaitUntil(F&& is_ready);
+    // blocks until an item is available or the pipeline is stopped
+    template <typename T>
+    bool Pop(SPSCQueue<T>& queue, T& item);
+    template <typename T>
+    bool Push(SPSCQueue<T>& queue, const T& item);
+    // pops the newest slot and returns the skipped ones to their free queue
+    bool PopNewest(SPSCQueue<int>& ready, SPSCQueue<int>& free, int& index);
+};
@@ -0,0 +1,185 @@
+#include "GameSimulator.h"
+
+#include <stdexcept>
+#include <fmt/core.h>
+
+const char* GetObservationModeString(const ObservationMode mode) {
+    switch (mode) {
+    case ObservationMode::TRUTH: return "truth";
+    case ObservationMode::NOISY: return "noisy";
+    case ObservationMode::MODEL: return "model";
+    default:                     return "unknown";
+    }
+}
+
+ObservationMode ParseObservationMode(const std::string& str) {
+    if (str.compare("truth") == 0) return ObservationMode::TRUTH;
+    if (str.compare("noisy") == 0) return ObservationMode::NOISY;
+    if (str.compare("model") == 0) return ObservationMode::MODEL;
+    throw std::runtime_error(fmt::format("Invalid observation mode: '{}'. Options: [truth, noisy, model]", str));
+}
+
+GameSimulator::GameSimulator(const Config& config, std::shared_ptr<SoccerParams>& params)
+: m_controller(params)
+{
+    if ((config.width <= 0) || (config.height <= 0)) {
+        throw std::runtime_error(fmt::format("Game simulator requires a positive window size (got {}x{})", config.width, config.height));
+    }
+    if (config.frame_rate <= 0.0f) {
+        throw std::runtime_error(fmt::format("Frame rate must be positive (got {})", config.frame_rate));
+    }
+    if ((config.inference_latency_ms < 0.0f) || (config.input_latency_ms < 0.0f)) {
+        throw std::runtime_error(fmt::format(
+            "Latencies can't be negative (got inference={}ms, input={}ms)",
+            config.inference_latency_ms, config.input_latency_ms));
+    }
+    m_config = config;
+    m_params = params;
+    m_controls.can_track = true;
+    m_controls.can_smart_click = true;
+    m_controls.can_always_click = false;
+    m_controls.can_use_predictor = config.can_use_predictor;
+    // a click lands for each frame the controller is triggered on and a few frames are in flight at once
+    m_pending_clicks.reserve(16);
+}
+
+void GameSimulator::SetEstimator(std::unique_ptr<IEstimator>&& estimator) {
+    m_controller.SetEstimator(std::move(estimator));
+}
+
+void GameSimulator::SetModel(std::unique_ptr<IModel>&& model) {
+    m_model = std::move(model);
+    if (m_model != nullptr && m_renderer == nullptr) {
+        m_renderer = std::make_unique<BallRenderer>(m_config.width, m_config.height);
+    }
+}
+
+GameSimulator::GameResult GameSimulator::Play(const uint32_t seed) {
+    if ((m_config.observation_mode == ObservationMode::MODEL) && (m_model == nullptr)) {
+        throw std::runtime_error("Model observations require a model");
+    }
+
+    const float width = float(m_config.width);
+    const float height = float(m_config.height);
+    const double frame_period_us = 1e6 / double(m_config.frame_rate);
+    const int64_t inference_us = int64_t(m_config.inference_latency_ms * 1000.0f);
+    const int64_t input_us = int64_t(m_config.input_latency_ms * 1000.0f);
+    const int total_max_frames = int(m_config.max_game_secs * m_config.frame_rate);
+    const float dt = 1.0f / m_config.frame_rate;
+    const BallController::Screen screen { 0, 0, m_config.width, m_config.height };
+
+    m_rng.seed(seed);
+    std::uniform_int_distribution<int> random_bounce(-int(EMULATOR_MAX_RANDOM_BOUNCE), int(EMULATOR_MAX_RANDOM_BOUNCE));
+    m_controller.Reset();
+    m_pending_clicks.clear();
+
+    // same as Emulator.on_fail which leaves the ball waiting at its spawn until it is clicked
+    m_ball = EmulatorBall{};
+    m_ball.x = float(m_config.width / 2);
+    m_ball.y = height - m_ball.radius - 10.0f;
+    bool is_playing = false;
+    EmulatorBall last_ball = m_ball;
+
+    GameResult result;
+    for (int i = 0; i < total_max_frames; i++) {
+        const int64_t frame_us = int64_t(double(i) * frame_period_us);
+        result.total_frames++;
+
+        // clicks are handled before the ball moves like the emulator's event loop
+        size_t total_pending = 0;
+        bool is_clicked = false;
+        for (size_t j = 0; j < m_pending_clicks.size(); j++) {
+            const auto click = m_pending_clicks[j];
+            if (click.land_us > frame_us) {
+                m_pending_clicks[total_pending++] = click;
+                continue;
+            }
+            result.total_clicks++;
+            is_clicked = true;
+            if (!m_ball.IsHit(click.x, click.y)) {
+                result.total_misses++;
+                continue;
+            }
+            is_playing = true;
+            result.score++;
+            m_ball.Bounce(click.x, float(random_bounce(m_rng)));
+        }
+        m_pending_clicks.resize(total_pending);
+
+        if (is_playing) {
+            m_ball.Update(dt, width);
+            if (m_ball.IsOutOfWindow(height)) {
+                return result;
+            }
+        }
+
+        // the waiting ball gives the same frame until it is clicked
+        // NOTE: The emulator draws an emote for every click so even a missed click changes the frame
+        // NOTE: Noisy observations are drawn again for every frame since a missed detection would
+        //       otherwise be repeated until the game times out, unlike a model whose misses depend on the frame
+        const bool is_unchanged =
+            (i > 0) && !is_clicked &&
+            (m_config.observation_mode != ObservationMode::NOISY) &&
+            (m_ball.x == last_ball.x) && (m_ball.y == last_ball.y) && (m_ball.angle == last_ball.angle);
+        last_ball = m_ball;
+        const Prediction raw_pred = Observe(is_unchanged);
+        const int64_t apply_us = frame_us + inference_us;
+        const auto decision = m_controller.Update(raw_pred, is_unchanged, frame_us, apply_us, screen, m_controls);
+        if (decision.is_click) {
+            m_pending_clicks.push_back({ apply_us + input_us, float(decision.cursor_x), float(decision.cursor_y) });
+        }
+    }
+    result.is_timeout = true;
+    return result;
+}
+
+Prediction GameSimulator::Observe(const bool is_unchanged) {
+    if (is_unchanged) {
+        return m_last_pred;
+    }
+    const float width = float(m_config.width);
+    const float height = float(m_config.height);
+    Prediction pred;
+    switch (m_config.observation_mode) {
+    case ObservationMode::TRUTH:
+        {
+            const bool is_visible = (m_ball.y - m_ball.radius < height) && (m_ball.y + m_ball.radius > 0.0f);
+            pred = Prediction { m_ball.x / width, 1.0f - m_ball.y / height, is_visible ? 1.0f : 0.0f };
+        }
+        break;
+    case ObservationMode::NOISY:
+        pred = ObserveNoisy();
+        break;
+    case ObservationMode::MODEL:
+        {
+            m_renderer->Render(m_ball, true);
+            m_preprocessor.Process(m_renderer->GetFrame(), m_model->GetInputBuffer());
+            m_model->Parse();
+            pred = m_model->GetPrediction();
+        }
+        break;
+    default:
+        throw std::runtime_error(fmt::format("Invalid observation mode: {}", int(m_config.observation_mode)));
+    }
+    m_last_pred = pred;
+    return pred;
+}
+
+Prediction GameSimulator::ObserveNoisy() {
+    // same model of a noisy detector as the estimator benchmark
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    const float width = float(m_config.width);
+    const float height = float(m_config.height);
+    const bool is_visible = (m_ball.y - m_ball.radius < height) && (m_ball.y + m_ball.radius > 0.0f);
+    const bool is_detected = is_visible && (uniform(m_rng) >= m_config.dropout);
+    if (!is_detected) {
+        return Prediction { uniform(m_rng), uniform(m_rng), 0.4f*uniform(m_rng) };
+    }
+    // less confident predictions are further off like a real model
+    const float confidence = 0.6f + 0.4f*uniform(m_rng);
+    const float noise = m_config.noise / confidence;
+    const float x = m_ball.x / width;
+    const float y = 1.0f - m_ball.y / height;
+    return Prediction { x + noise*normal(m_rng), y + noise*normal(m_rng), confidence };
+}
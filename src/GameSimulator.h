@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "BallController.h"
+#include "BallRenderer.h"
+#include "EmulatorBall.h"
+#include "IEstimator.h"
+#include "IModel.h"
+#include "Preprocessor.h"
+#include "Prediction.h"
+#include "SoccerParams.h"
+
+// what the controller is given for each frame of the game
+enum class ObservationMode {
+    TRUTH,  // exact position of the ball
+    NOISY,  // truth with noise that grows as the confidence drops and visible balls that are missed
+    MODEL,  // a model run on a rendered frame of the game
+};
+
+const char* GetObservationModeString(const ObservationMode mode);
+ObservationMode ParseObservationMode(const std::string& str);
+
+// Plays games of the emulator without a window by stepping its ball physics at a fixed frame rate
+// The clicks of a BallController land back in the game after the configured latencies so whole
+// games run as fast as the controller can make decisions
+class GameSimulator
+{
+public:
+    struct Config {
+        // same window size and frame rate as the python emulator
+        int width = 322;
+        int height = 455;
+        float frame_rate = 60.0f;
+        // between a frame being displayed and the controller acting on it
+        float inference_latency_ms = 8.0f;
+        // between the controller acting and the click landing in the game
+        float input_latency_ms = 20.0f;
+        ObservationMode observation_mode = ObservationMode::TRUTH;
+        // standard deviation of noisy observations at full confidence in normalised screen units
+        float noise = 0.004f;
+        // chance that a noisy observation misses a visible ball
+        float dropout = 0.05f;
+        // games that last this long are stopped so a perfect controller doesn't play forever
+        float max_game_secs = 120.0f;
+        // the controller always tracks and smart clicks but can ignore its estimator's projection
+        bool can_use_predictor = true;
+    };
+    struct GameResult {
+        int score = 0;
+        int total_clicks = 0;
+        // clicks that landed outside of the ball
+        int total_misses = 0;
+        int total_frames = 0;
+        bool is_timeout = false;
+    };
+private:
+    // click waiting for its latency before it lands in the game
+    struct PendingClick {
+        int64_t land_us;
+        float x;
+        float y;
+    };
+private:
+    Config m_config;
+    std::shared_ptr<SoccerParams> m_params;
+    BallController m_controller;
+    BallController::Controls m_controls;
+    EmulatorBall m_ball;
+    std::mt19937 m_rng;
+    // reused between games so that playing doesn't allocate
+    std::vector<PendingClick> m_pending_clicks;
+    // only used for model observations
+    std::unique_ptr<IModel> m_model;
+    std::unique_ptr<BallRenderer> m_renderer;
+    Preprocessor m_preprocessor;
+    Prediction m_last_pred;
+public:
+    GameSimulator(const Config& config, std::shared_ptr<SoccerParams>& params);
+    // the difference estimator is used by default
+    void SetEstimator(std::unique_ptr<IEstimator>&& estimator);
+    // required for model observations
+    // NOTE: The frames are drawn by BallRenderer and not with the emulator's sprites
+    void SetModel(std::unique_ptr<IModel>&& model);
+    // plays a single game from the ball waiting at its spawn until it falls out of the window
+    // games with the same seed play out the same way
+    GameResult Play(const uint32_t seed);
+    const auto& GetConfig() const { return m_config; }
+private:
+    Prediction Observe(const bool is_unchanged);
+    Prediction ObserveNoisy();
+};
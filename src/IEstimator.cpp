@@ -0,0 +1,70 @@
+#include "IEstimator.h"
+
+#include <math.h>
+#include <stdexcept>
+#include <fmt/core.h>
+#include "KalmanEstimator.h"
+#include "Predictor.h"
+
+const char* GetEstimatorTypeString(const EstimatorType type) {
+    switch (type) {
+    case EstimatorType::DIFFERENCE: return "difference";
+    case EstimatorType::KALMAN:     return "kalman";
+    default:                        return "unknown";
+    }
+}
+
+EstimatorType ParseEstimatorType(const std::string& str) {
+    if (str.compare("difference") == 0) return EstimatorType::DIFFERENCE;
+    if (str.compare("kalman") == 0) return EstimatorType::KALMAN;
+    throw std::runtime_error(fmt::format("Invalid estimator: '{}'. Options: [difference, kalman]", str));
+}
+
+std::unique_ptr<IEstimator> CreateEstimator(const EstimatorType type, std::shared_ptr<SoccerParams>& params) {
+    switch (type) {
+    case EstimatorType::DIFFERENCE: return std::make_unique<Predictor>(params);
+    case EstimatorType::KALMAN:     return std::make_unique<KalmanEstimator>(params, KalmanEstimator::Config{});
+    default: throw std::runtime_error(fmt::format("Invalid estimator type: {}", int(type)));
+    }
+}
+
+float ReflectOffWalls(const float x, const float relative_ball_width) {
+    const float radius = relative_ball_width / 2.0f;
+    const float right_border = 1.0f-radius;
+    const float left_border = radius;
+    if (x > right_border) {
+        return right_border - (x - right_border);
+    }
+    if (x < left_border) {
+        return left_border + (left_border - x);
+    }
+    return x;
+}
+
+float GetTimeToHeight(const float y, const float vy, const float ay, const float height) {
+    // solve 0.5*ay*t^2 + vy*t + (y-height) = 0 for the first positive t
+    const float dy = y - height;
+    if (dy <= 0.0f) {
+        return 0.0f;
+    }
+    const float a = 0.5f*ay;
+    if (fabsf(a) < 1e-6f) {
+        return (vy < 0.0f) ? (-dy / vy) : -1.0f;
+    }
+    const float discriminant = vy*vy - 4.0f*a*dy;
+    if (discriminant < 0.0f) {
+        return -1.0f;
+    }
+    // NOTE: Avoids cancellation when vy is much larger than a*dy
+    const float q = -0.5f * (vy + copysignf(sqrtf(discriminant), vy));
+    if (q == 0.0f) {
+        return -1.0f;
+    }
+    const float t0 = q / a;
+    const float t1 = dy / q;
+    const float t_min = fminf(t0, t1);
+    const float t_max = fmaxf(t0, t1);
+    if (t_min > 0.0f) return t_min;
+    if (t_max > 0.0f) return t_max;
+    return -1.0f;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include "Prediction.h"
+#include "SoccerParams.h"
+
+// Tracks the ball from noisy model predictions and projects it forward to when our input lands
+// Timestamps are microseconds on any monotonic clock and are passed in rather than read from a clock
+// so that recorded trajectories can be replayed through an estimator
+class IEstimator
+{
+public:
+    struct Velocity {
+        float x = 0.0f;
+        float y = 0.0f;
+    };
+    struct Output {
+        // zero confidence if the ball isn't being tracked
+        Prediction prediction;
+        // at the time of the last observation
+        Velocity velocity;
+        // seconds after the input lands until the ball falls to the hard trigger height
+        // 0 if it is already below it and negative if it won't fall that far
+        float time_to_impact = -1.0f;
+    };
+public:
+    virtual ~IEstimator() {}
+    // frame_us is when the frame was captured and apply_us is when the output is used
+    virtual Output Filter(const Prediction& pred, const int64_t frame_us, const int64_t apply_us) = 0;
+    // moves the last observation forward to apply_us without changing the estimator state
+    // used when a frame is identical to the last one so there is nothing new to observe
+    virtual Output Extrapolate(const int64_t apply_us) = 0;
+    virtual void Reset() = 0;
+};
+
+enum class EstimatorType {
+    // velocity from the difference of the last two observations
+    DIFFERENCE,
+    // constant acceleration kalman filter with gravity as the prior
+    KALMAN,
+};
+
+const char* GetEstimatorTypeString(const EstimatorType type);
+EstimatorType ParseEstimatorType(const std::string& str);
+std::unique_ptr<IEstimator> CreateEstimator(const EstimatorType type, std::shared_ptr<SoccerParams>& params);
+
+// reflects a projected position off the left or right border for a ball of the given relative width
+float ReflectOffWalls(const float x, const float relative_ball_width);
+// seconds until a ball at height y falls to the given height with constant acceleration
+// 0 if it is already below and negative if it never gets there
+float GetTimeToHeight(const float y, const float vy, const float ay, const float height);
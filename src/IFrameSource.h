@@ -0,0 +1,24 @@
+#pragma once
+#include <stdint.h>
+
+// View into a BGRA8 frame owned by the frame source
+// The view is only valid until the next call to IFrameSource::Grab
+struct FrameView {
+    const uint8_t* data = nullptr; // points to the top row of the image
+    int width = 0;
+    int height = 0;
+    int row_stride = 0; // bytes between rows, negative for bottom-up images
+    uint64_t frame_index = 0;
+    int64_t timestamp_us = 0; // time the frame was captured
+};
+
+class IFrameSource
+{
+public:
+    IFrameSource() {}
+    virtual ~IFrameSource() {}
+    // top and left are the screen coordinates of the capture area
+    // returns false if no more frames are available
+    virtual bool Grab(const int top, const int left) = 0;
+    virtual FrameView GetFrame() = 0;
+};
@@ -0,0 +1,81 @@
+#include "IModel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "Float16.h"
+
+// latency has settled once the median of a window of calls is within this fraction of the previous window
+constexpr int WARMUP_WINDOW_SIZE = 8;
+constexpr float WARMUP_TOLERANCE = 0.05f;
+
+static uint64_t get_median(std::vector<uint64_t> values) {
+    std::nth_element(values.begin(), values.begin() + values.size()/2, values.end());
+    return values[values.size()/2];
+}
+
+// fill the input with noise in the model's own format since all zero inputs can take faster paths
+static void fill_synthetic_input(const InputBuffer& buffer) {
+    const size_t total_values = buffer.width*buffer.height*3;
+    uint32_t state = 0x12345678u;
+    for (size_t i = 0; i < total_values; i++) {
+        // xorshift32
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        const uint8_t value = uint8_t(state >> 24);
+        switch (buffer.type) {
+        case InputType::UINT8:   reinterpret_cast<uint8_t*>(buffer.data)[i] = value; break;
+        case InputType::INT8:    reinterpret_cast<int8_t*>(buffer.data)[i] = int8_t(int32_t(value) - 128); break;
+        case InputType::FLOAT16: reinterpret_cast<uint16_t*>(buffer.data)[i] = float_to_half(float(value) / 255.0f); break;
+        case InputType::FLOAT32: reinterpret_cast<float*>(buffer.data)[i] = float(value) / 255.0f; break;
+        default: break;
+        }
+    }
+}
+
+WarmupStats IModel::Warmup(const int max_iterations) {
+    WarmupStats stats;
+    if (max_iterations <= 0) {
+        return stats;
+    }
+    // NOTE: Only the first input is filled since the buffer may be smaller than the max batch
+    fill_synthetic_input(GetInputBuffer());
+
+    std::vector<uint64_t> window;
+    window.reserve(WARMUP_WINDOW_SIZE);
+    uint64_t last_median = 0;
+    for (int i = 0; i < max_iterations; i++) {
+        const auto dt_start = std::chrono::steady_clock::now();
+        Parse();
+        const auto dt_end = std::chrono::steady_clock::now();
+        const uint64_t elapsed_ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(dt_end - dt_start).count());
+        if (i == 0) {
+            stats.first_ns = elapsed_ns;
+        }
+        stats.max_ns = std::max(stats.max_ns, elapsed_ns);
+        stats.total_ns += elapsed_ns;
+        stats.total_iterations++;
+
+        window.push_back(elapsed_ns);
+        if (int(window.size()) < WARMUP_WINDOW_SIZE) {
+            continue;
+        }
+        const uint64_t median = get_median(window);
+        window.clear();
+        stats.converged_ns = median;
+        if (last_median > 0) {
+            const float change = float(std::max(median, last_median) - std::min(median, last_median)) / float(last_median);
+            if (change <= WARMUP_TOLERANCE) {
+                stats.is_converged = true;
+                break;
+            }
+        }
+        last_median = median;
+    }
+    // NOTE: Runs shorter than a window report the median of what they have
+    if (!window.empty() && (stats.converged_ns == 0)) {
+        stats.converged_ns = get_median(window);
+    }
+    return stats;
+}
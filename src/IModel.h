@@ -1,5 +1,6 @@
 #pragma once
 #include <stddef.h>
+#include <stdint.h>
 #include "Prediction.h"
 
 template <typename T>
@@ -12,10 +13,79 @@ struct RGB {
     T r, g, b;
 };
 
+enum class InputLayout {
+    INTERLEAVED, // (H,W,C)
+    PLANAR,      // (C,H,W)
+};
+
+enum class InputType {
+    UINT8,
+    INT8,
+    FLOAT16,
+    FLOAT32,
+};
+
+inline size_t GetInputTypeSize(const InputType type) {
+    switch (type) {
+    case InputType::UINT8:   return 1;
+    case InputType::INT8:    return 1;
+    case InputType::FLOAT16: return 2;
+    case InputType::FLOAT32: return 4;
+    default:                 return 0;
+    }
+}
+
+inline const char* GetInputTypeString(const InputType type) {
+    switch (type) {
+    case InputType::UINT8:   return "uint8";
+    case InputType::INT8:    return "int8";
+    case InputType::FLOAT16: return "float16";
+    case InputType::FLOAT32: return "float32";
+    default:                 return "unknown";
+    }
+}
+
+// normalised_value = scale*(quantised_value - zero_point)
+// NOTE: Only used by integer input types, float inputs are normalised to [0,1]
+struct QuantizationParams {
+    float scale = 1.0f;
+    int32_t zero_point = 0;
+};
+
+// Integer models without quantisation parameters are assumed to take raw pixel values
+inline QuantizationParams GetDefaultQuantization(const InputType type) {
+    switch (type) {
+    case InputType::UINT8: return QuantizationParams { 1.0f/255.0f, 0 };
+    case InputType::INT8:  return QuantizationParams { 1.0f/255.0f, -128 };
+    default:               return QuantizationParams {};
+    }
+}
+
+// Input tensor owned by the model that the preprocessor writes into
+// Size in bytes is width*height*3*GetInputTypeSize(type)
 struct InputBuffer {
-    RGB<float>* data;
+    void* data;
     size_t width;
     size_t height;
+    InputType type = InputType::FLOAT32;
+    InputLayout layout = InputLayout::INTERLEAVED;
+    QuantizationParams quantization;
+};
+
+inline size_t GetInputBufferSize(const InputBuffer& buffer) {
+    return buffer.width * buffer.height * 3 * GetInputTypeSize(buffer.type);
+}
+
+// Latency of each call while warming up a model, in nanoseconds
+struct WarmupStats {
+    int total_iterations = 0;
+    // latency stopped changing before the iteration limit was reached
+    bool is_converged = false;
+    uint64_t first_ns = 0;
+    uint64_t max_ns = 0;
+    // median of the last window of calls
+    uint64_t converged_ns = 0;
+    uint64_t total_ns = 0;
 };
 
 class IModel
@@ -27,4 +97,14 @@ public:
     virtual void Parse() = 0;
     virtual Prediction GetPrediction() = 0;
     virtual void PrintSummary() = 0;
+    // Models that can run several inputs in one call override these
+    // Inputs of a batch are stored one after the other from GetInputBuffer().data
+    // NOTE: Changing the batch size can move the input buffer
+    virtual size_t GetMaxBatchSize() { return 1; }
+    virtual void SetBatchSize(const size_t batch_size) {}
+    virtual Prediction GetBatchPrediction(const size_t index) { return GetPrediction(); }
+    // Runs synthetic inputs through the current batch size until the latency of each call settles
+    // so that lazy allocations, thread pool startup and kernel selection don't land on real frames
+    // NOTE: Overwrites the input buffer
+    virtual WarmupStats Warmup(const int max_iterations);
 };
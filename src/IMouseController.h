@@ -0,0 +1,10 @@
+#pragma once
+
+class IMouseController
+{
+public:
+    IMouseController() {}
+    virtual ~IMouseController() {}
+    virtual void SetCursorPosition(const int x, const int y) = 0;
+    virtual void Click(const int x, const int y) = 0;
+};
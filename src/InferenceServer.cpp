@@ -0,0 +1,189 @@
+#include "InferenceServer.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+#include <fmt/core.h>
+
+class InferenceServer::SessionModel: public IModel
+{
+private:
+    InferenceServer& m_server;
+    const size_t m_index;
+    Prediction m_prediction;
+public:
+    SessionModel(InferenceServer& server, const size_t index)
+    : m_server(server), m_index(index) {}
+    // NOTE: Our input is only read by the batch thread while Parse() is blocked
+    InputBuffer GetInputBuffer() override {
+        auto buffer = m_server.m_input_format;
+        buffer.data = m_server.m_sessions[m_index].input.data();
+        return buffer;
+    }
+    void Parse() override {
+        m_prediction = m_server.Submit(m_index);
+    }
+    Prediction GetPrediction() override { return m_prediction; }
+    void PrintSummary() override {
+        printf("[inference server session %zu/%zu, max_batch_size=%zu, max_batch_delay=%lldus]\n",
+            m_index+1, m_server.GetTotalSessions(), m_server.GetMaxBatchSize(),
+            static_cast<long long>(m_server.m_config.max_batch_delay.count()));
+        m_server.m_model->PrintSummary();
+    }
+};
+
+InferenceServer::InferenceServer(std::unique_ptr<IModel>&& model, const size_t total_sessions, const Config& config)
+: m_model(std::move(model)),
+  m_config(config)
+{
+    if (m_model == nullptr) {
+        throw std::runtime_error("Inference server requires a model");
+    }
+    if (total_sessions == 0) {
+        throw std::runtime_error("Inference server must have at least 1 session");
+    }
+
+    m_model->SetBatchSize(1);
+    m_input_format = m_model->GetInputBuffer();
+    m_input_format.data = nullptr;
+    m_input_size = GetInputBufferSize(m_input_format);
+
+    // NOTE: Sessions write into their own buffer since the batch input is only contiguous
+    //       for the sessions that are in it and the rest may still be preprocessing
+    m_sessions.resize(total_sessions);
+    for (auto& session: m_sessions) {
+        session.input.resize(m_input_size, 0);
+    }
+    m_total_created_sessions = 0;
+    m_total_pending = 0;
+    m_next_session = 0;
+    m_is_running = true;
+    m_total_batches = 0;
+    m_total_requests = 0;
+    m_total_partial_batches = 0;
+    m_total_failed_batches = 0;
+    m_thread = std::thread([this]() {
+        TrySetCurrentThreadSchedule(m_config.batch_schedule, "inference server batch");
+        RunBatches();
+    });
+}
+
+InferenceServer::~InferenceServer() {
+    {
+        auto lock = std::scoped_lock(m_mutex);
+        m_is_running = false;
+        m_request_cv.notify_all();
+        m_result_cv.notify_all();
+    }
+    m_thread.join();
+}
+
+std::unique_ptr<IModel> InferenceServer::CreateSession() {
+    auto lock = std::scoped_lock(m_mutex);
+    if (m_total_created_sessions >= m_sessions.size()) {
+        throw std::runtime_error(fmt::format(
+            "Inference server only has {} sessions", m_sessions.size()));
+    }
+    const size_t index = m_total_created_sessions++;
+    return std::make_unique<SessionModel>(*this, index);
+}
+
+InferenceServer::Stats InferenceServer::GetStats() const {
+    Stats stats;
+    stats.total_batches = m_total_batches;
+    stats.total_requests = m_total_requests;
+    stats.total_partial_batches = m_total_partial_batches;
+    stats.total_failed_batches = m_total_failed_batches;
+    return stats;
+}
+
+Prediction InferenceServer::Submit(const size_t index) {
+    auto lock = std::unique_lock(m_mutex);
+    auto& session = m_sessions[index];
+    session.is_pending = true;
+    session.submit_time = std::chrono::steady_clock::now();
+    m_total_pending++;
+    m_request_cv.notify_one();
+    // NOTE: If the server is stopped we return the last prediction instead of blocking forever
+    m_result_cv.wait(lock, [&]() { return !session.is_pending || !m_is_running; });
+    if (session.error != nullptr) {
+        auto error = session.error;
+        session.error = nullptr;
+        std::rethrow_exception(error);
+    }
+    return session.prediction;
+}
+
+void InferenceServer::RunBatches() {
+    const size_t total_sessions = m_sessions.size();
+    const size_t max_batch_size = std::max(m_model->GetMaxBatchSize(), size_t(1));
+    std::vector<size_t> batch;
+    batch.reserve(total_sessions);
+
+    auto lock = std::unique_lock(m_mutex);
+    while (true) {
+        m_request_cv.wait(lock, [&]() { return (m_total_pending > 0) || !m_is_running; });
+        if (!m_is_running) break;
+
+        // wait for the other sessions until the oldest request runs out of time
+        // sessions that haven't been created yet will never submit so we don't wait on them
+        auto oldest_submit_time = std::chrono::steady_clock::time_point::max();
+        for (const auto& session: m_sessions) {
+            if (session.is_pending) {
+                oldest_submit_time = std::min(oldest_submit_time, session.submit_time);
+            }
+        }
+        const size_t total_expected = std::min(m_total_created_sessions, max_batch_size);
+        m_request_cv.wait_until(lock, oldest_submit_time + m_config.max_batch_delay, [&]() {
+            return (m_total_pending >= total_expected) || !m_is_running;
+        });
+        if (!m_is_running) break;
+
+        batch.clear();
+        for (size_t i = 0; (i < total_sessions) && (batch.size() < max_batch_size); i++) {
+            const size_t index = (m_next_session + i) % total_sessions;
+            if (m_sessions[index].is_pending) {
+                batch.push_back(index);
+            }
+        }
+        m_next_session = (batch.back() + 1) % total_sessions;
+        const bool is_partial = batch.size() < total_expected;
+
+        // pending sessions are blocked in Submit() so their inputs can be read without the lock
+        lock.unlock();
+        // NOTE: An exception from the model is handed to the sessions of the batch instead of
+        //       ending the batch thread, which would leave them blocked in Submit() forever
+        std::exception_ptr error = nullptr;
+        try {
+            const auto dt_start = std::chrono::steady_clock::now();
+            m_model->SetBatchSize(batch.size());
+            // NOTE: Changing the batch size can move the model's input buffer
+            uint8_t* batch_input = reinterpret_cast<uint8_t*>(m_model->GetInputBuffer().data);
+            for (size_t i = 0; i < batch.size(); i++) {
+                memcpy(&batch_input[i*m_input_size], m_sessions[batch[i]].input.data(), m_input_size);
+            }
+            m_model->Parse();
+            const auto dt_end = std::chrono::steady_clock::now();
+            m_batch_latency.Record(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(dt_end - dt_start).count()));
+            for (size_t i = 0; i < batch.size(); i++) {
+                m_sessions[batch[i]].prediction = m_model->GetBatchPrediction(i);
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        lock.lock();
+
+        for (size_t i = 0; i < batch.size(); i++) {
+            auto& session = m_sessions[batch[i]];
+            session.error = error;
+            session.is_pending = false;
+        }
+        m_total_pending -= batch.size();
+        m_total_batches++;
+        m_total_requests += batch.size();
+        if (is_partial) m_total_partial_batches++;
+        if (error != nullptr) m_total_failed_batches++;
+        m_result_cv.notify_all();
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "IModel.h"
+#include "LatencyHistogram.h"
+#include "Prediction.h"
+#include "ThreadSchedule.h"
+
+// Shares one model between several sessions so that many game windows can run from one process
+// Each session is given a model proxy that is used by its own SoccerPlayer like any other model.
+// Calling Parse() on a proxy queues its input and blocks until the batch containing it is run.
+// Requests are gathered until every session has one queued or the oldest has waited for
+// max_batch_delay, then they are copied into the shared model's input and run in a single call.
+//
+// session 0: SoccerPlayer -> proxy --+
+// session 1: SoccerPlayer -> proxy --+--> [pending inputs] -> batch thread -> model
+// session 2: SoccerPlayer -> proxy --+
+class InferenceServer
+{
+public:
+    struct Config {
+        // longest time a request waits for the other sessions before its batch is run anyway
+        // this bounds the latency added to a session whose peers are paused or running slower
+        std::chrono::microseconds max_batch_delay = std::chrono::microseconds(2000);
+        // the batch thread is the one that runs the model
+        ThreadSchedule batch_schedule;
+    };
+    struct Stats {
+        uint64_t total_batches = 0;
+        uint64_t total_requests = 0;
+        // batches that ran out of time before they were as full as the sessions allow
+        uint64_t total_partial_batches = 0;
+        // batches where the model threw an exception
+        uint64_t total_failed_batches = 0;
+    };
+private:
+    class SessionModel;
+    struct Session {
+        std::vector<uint8_t> input;
+        Prediction prediction;
+        // exception thrown by the model while running this session's batch
+        std::exception_ptr error = nullptr;
+        bool is_pending = false;
+        std::chrono::steady_clock::time_point submit_time;
+    };
+
+    std::unique_ptr<IModel> m_model;
+    const Config m_config;
+    // format of a single input of the shared model
+    InputBuffer m_input_format;
+    size_t m_input_size;
+
+    // sessions are fixed when the server is created so the batch thread can index them freely
+    std::vector<Session> m_sessions;
+    size_t m_total_created_sessions;
+    size_t m_total_pending;
+    // batches larger than the model's limit are split starting from here so every session is served
+    size_t m_next_session;
+    bool m_is_running;
+    std::mutex m_mutex;
+    std::condition_variable m_request_cv;
+    std::condition_variable m_result_cv;
+
+    std::atomic<uint64_t> m_total_batches;
+    std::atomic<uint64_t> m_total_requests;
+    std::atomic<uint64_t> m_total_partial_batches;
+    std::atomic<uint64_t> m_total_failed_batches;
+    // time taken by each batched call to the model
+    LatencyHistogram m_batch_latency;
+    std::thread m_thread;
+public:
+    InferenceServer(std::unique_ptr<IModel>&& model, const size_t total_sessions, const Config& config);
+    ~InferenceServer();
+    InferenceServer(const InferenceServer&) = delete;
+    InferenceServer& operator=(const InferenceServer&) = delete;
+    // Model proxy for the next session
+    // NOTE: Proxies must be destroyed before the server and each one used from a single thread
+    //       If the model throws while running a batch the exception is rethrown from Parse() of every session in it
+    std::unique_ptr<IModel> CreateSession();
+    const Config& GetConfig() const { return m_config; }
+    size_t GetTotalSessions() const { return m_sessions.size(); }
+    size_t GetMaxBatchSize() const { return m_model->GetMaxBatchSize(); }
+    Stats GetStats() const;
+    const LatencyHistogram& GetBatchLatency() const { return m_batch_latency; }
+private:
+    Prediction Submit(const size_t index);
+    void RunBatches();
+};
@@ -0,0 +1,165 @@
+#include "KalmanEstimator.h"
+
+#include <algorithm>
+
+KalmanEstimator::KalmanEstimator(std::shared_ptr<SoccerParams>& params, const Config& config)
+: m_params(params), m_config(config)
+{
+    Reset();
+}
+
+void KalmanEstimator::Reset() {
+    for (auto& axis: m_axes) {
+        SeedAxis(axis, 0.0, 0.0, 0.0, 0.0);
+    }
+    m_has_state = false;
+    m_total_lost_frames = 0;
+    m_last_frame_us = 0;
+    m_last_confidence = 0.0f;
+}
+
+IEstimator::Output KalmanEstimator::Filter(const Prediction& pred, const int64_t frame_us, const int64_t apply_us) {
+    auto& p = *m_params;
+    if (pred.confidence < p.confidence_threshold) {
+        m_total_lost_frames++;
+        if (m_total_lost_frames >= p.max_lost_frames) {
+            m_has_state = false;
+        }
+        return Output {};
+    }
+    m_total_lost_frames = 0;
+
+    // less confident predictions are noisier
+    const double confidence = std::max(double(pred.confidence), double(m_config.min_confidence));
+    const double noise = double(m_config.position_noise) / confidence;
+    const double variance = noise*noise;
+    const double z[2] = { double(pred.x), double(pred.y) };
+    const double acceleration[2] = { 0.0, -double(p.acceleration) };
+
+    if (!m_has_state) {
+        for (int i = 0; i < 2; i++) {
+            SeedAxis(m_axes[i], z[i], 0.0, acceleration[i], variance);
+        }
+        m_has_state = true;
+    } else {
+        // NOTE: Lost frames aren't observed so this can span several frames
+        const double dt = std::max(double(frame_us - m_last_frame_us) * 1e-6, 0.0);
+        for (int i = 0; i < 2; i++) {
+            auto& axis = m_axes[i];
+            PredictAxis(axis, dt);
+            if (!UpdateAxis(axis, z[i], variance)) {
+                const double velocity = (dt > 0.0) ? ((z[i] - axis.last_z) / dt) : axis.x[1];
+                SeedAxis(axis, z[i], velocity, acceleration[i], variance);
+            }
+            axis.last_z = z[i];
+        }
+    }
+    m_last_frame_us = frame_us;
+    m_last_confidence = pred.confidence;
+    return Project(apply_us);
+}
+
+IEstimator::Output KalmanEstimator::Extrapolate(const int64_t apply_us) {
+    return Project(apply_us);
+}
+
+void KalmanEstimator::SeedAxis(Axis& axis, const double z, const double velocity, const double acceleration, const double variance) const {
+    const double velocity_std = double(m_config.initial_velocity_std);
+    const double acceleration_std = double(m_config.initial_acceleration_std);
+    axis.x[0] = z;
+    axis.x[1] = velocity;
+    axis.x[2] = acceleration;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            axis.P[i][j] = 0.0;
+        }
+    }
+    axis.P[0][0] = variance;
+    axis.P[1][1] = velocity_std*velocity_std;
+    axis.P[2][2] = acceleration_std*acceleration_std;
+    axis.last_z = z;
+}
+
+void KalmanEstimator::PredictAxis(Axis& axis, const double dt) const {
+    const double dt2 = dt*dt;
+    const double dt3 = dt2*dt;
+    const double F[3][3] = {
+        { 1.0, dt,  0.5*dt2 },
+        { 0.0, 1.0, dt      },
+        { 0.0, 0.0, 1.0     },
+    };
+    // discrete white noise jerk
+    const double q = double(m_config.jerk_noise) * double(m_config.jerk_noise);
+    const double Q[3][3] = {
+        { q*dt3*dt2/20.0, q*dt2*dt2/8.0, q*dt3/6.0 },
+        { q*dt2*dt2/8.0,  q*dt3/3.0,     q*dt2/2.0 },
+        { q*dt3/6.0,      q*dt2/2.0,     q*dt      },
+    };
+
+    double x[3];
+    for (int i = 0; i < 3; i++) {
+        x[i] = F[i][0]*axis.x[0] + F[i][1]*axis.x[1] + F[i][2]*axis.x[2];
+    }
+    // P = F*P*F^T + Q
+    double FP[3][3];
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            FP[i][j] = F[i][0]*axis.P[0][j] + F[i][1]*axis.P[1][j] + F[i][2]*axis.P[2][j];
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        axis.x[i] = x[i];
+        for (int j = 0; j < 3; j++) {
+            axis.P[i][j] = FP[i][0]*F[j][0] + FP[i][1]*F[j][1] + FP[i][2]*F[j][2] + Q[i][j];
+        }
+    }
+}
+
+bool KalmanEstimator::UpdateAxis(Axis& axis, const double z, const double variance) const {
+    // only the position is observed so the innovation and its covariance are scalars
+    const double innovation = z - axis.x[0];
+    const double S = axis.P[0][0] + variance;
+    const double gate = double(m_config.gate_sigmas);
+    if ((innovation*innovation) > (gate*gate*S)) {
+        return false;
+    }
+    double K[3];
+    for (int i = 0; i < 3; i++) {
+        K[i] = axis.P[i][0] / S;
+    }
+    const double P0[3] = { axis.P[0][0], axis.P[0][1], axis.P[0][2] };
+    for (int i = 0; i < 3; i++) {
+        axis.x[i] += K[i]*innovation;
+        for (int j = 0; j < 3; j++) {
+            axis.P[i][j] -= K[i]*P0[j];
+        }
+    }
+    // keep the covariance symmetric as rounding errors accumulate
+    for (int i = 0; i < 3; i++) {
+        for (int j = i+1; j < 3; j++) {
+            const double mean = 0.5*(axis.P[i][j] + axis.P[j][i]);
+            axis.P[i][j] = mean;
+            axis.P[j][i] = mean;
+        }
+    }
+    return true;
+}
+
+IEstimator::Output KalmanEstimator::Project(const int64_t apply_us) const {
+    if (!m_has_state || (m_total_lost_frames > 0)) {
+        return Output {};
+    }
+    auto& p = *m_params;
+    const auto& ax = m_axes[0].x;
+    const auto& ay = m_axes[1].x;
+    const double t = double(apply_us - m_last_frame_us) * 1e-6 + double(p.input_delay_secs);
+    const float x = float(ax[0] + ax[1]*t + 0.5*ax[2]*t*t);
+    const float y = float(ay[0] + ay[1]*t + 0.5*ay[2]*t*t);
+    const float vy = float(ay[1] + ay[2]*t);
+
+    Output output;
+    output.prediction = Prediction { ReflectOffWalls(x, p.relative_ball_width), y, m_last_confidence };
+    output.velocity = Velocity { float(ax[1]), float(ay[1]) };
+    output.time_to_impact = GetTimeToHeight(y, vy, float(ay[2]), p.height_trigger_hard);
+    return output;
+}
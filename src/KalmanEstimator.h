@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include "IEstimator.h"
+#include "Prediction.h"
+#include "SoccerParams.h"
+
+// Constant acceleration kalman filter run separately on each axis
+// State of an axis is [position, velocity, acceleration] and only the position is observed
+// Vertical acceleration starts at gravity so a few observations are enough to track a falling ball
+// Observations are weighted by the model's confidence
+//
+// Kicks and wall bounces change the velocity instantly which the motion model can't explain
+// Observations further from the predicted position than the gate reseed that axis from the
+// difference of the last two observations so the filter doesn't lag behind the new motion
+class KalmanEstimator: public IEstimator
+{
+public:
+    struct Config {
+        // standard deviation of the predicted position at full confidence in normalised screen units
+        float position_noise = 0.004f;
+        // white noise jerk that lets the acceleration drift from the gravity prior in normalised units per second^3
+        float jerk_noise = 1.0f;
+        // innovations further than this many standard deviations are a change in motion
+        float gate_sigmas = 4.0f;
+        // uncertainty after seeding an axis
+        float initial_velocity_std = 1.0f;
+        float initial_acceleration_std = 1.0f;
+        // low confidence predictions are treated as this confident so they can't be trusted infinitely less
+        float min_confidence = 0.1f;
+    };
+private:
+    struct Axis {
+        // fixed size so that updates never allocate
+        double x[3];
+        double P[3][3];
+        // last observation for reseeding
+        double last_z;
+    };
+    std::shared_ptr<SoccerParams> m_params;
+    Config m_config;
+    // x then y
+    Axis m_axes[2];
+    bool m_has_state;
+    int m_total_lost_frames;
+    int64_t m_last_frame_us;
+    float m_last_confidence;
+public:
+    KalmanEstimator(std::shared_ptr<SoccerParams>& params, const Config& config);
+    Output Filter(const Prediction& pred, const int64_t frame_us, const int64_t apply_us) override;
+    Output Extrapolate(const int64_t apply_us) override;
+    void Reset() override;
+    const auto& GetConfig() const { return m_config; }
+private:
+    void SeedAxis(Axis& axis, const double z, const double velocity, const double acceleration, const double variance) const;
+    void PredictAxis(Axis& axis, const double dt) const;
+    // returns false if the observation was outside of the gate
+    bool UpdateAxis(Axis& axis, const double z, const double variance) const;
+    Output Project(const int64_t apply_us) const;
+};
@@ -0,0 +1,133 @@
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static int floor_log2(const uint64_t value) {
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanReverse64(&index, value);
+    return int(index);
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+LatencyHistogram::LatencyHistogram() {
+    for (auto& count: m_counts) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    m_total_count = 0;
+    m_total_sum = 0;
+    m_max_value = 0;
+}
+
+int LatencyHistogram::GetBucketIndex(const uint64_t value) {
+    if (value < uint64_t(SUB_BUCKET_COUNT)) {
+        return int(value);
+    }
+    const int exponent = floor_log2(value);
+    if (exponent >= MAX_VALUE_BITS) {
+        return TOTAL_BUCKETS-1;
+    }
+    // value is in [2^exponent, 2^(exponent+1)) which has buckets of width 2^shift
+    const int shift = exponent - SUB_BUCKET_BITS + 1;
+    const int sub_bucket = int(value >> shift);
+    return SUB_BUCKET_COUNT + (shift-1)*SUB_BUCKET_HALF + (sub_bucket - SUB_BUCKET_HALF);
+}
+
+uint64_t LatencyHistogram::GetBucketLowerBound(const int index) {
+    if (index < SUB_BUCKET_COUNT) {
+        return uint64_t(index);
+    }
+    const int shift = (index - SUB_BUCKET_COUNT) / SUB_BUCKET_HALF + 1;
+    const uint64_t sub_bucket = uint64_t((index - SUB_BUCKET_COUNT) % SUB_BUCKET_HALF + SUB_BUCKET_HALF);
+    return sub_bucket << shift;
+}
+
+uint64_t LatencyHistogram::GetBucketUpperBound(const int index) {
+    if (index < SUB_BUCKET_COUNT) {
+        return uint64_t(index);
+    }
+    const int shift = (index - SUB_BUCKET_COUNT) / SUB_BUCKET_HALF + 1;
+    const uint64_t sub_bucket = uint64_t((index - SUB_BUCKET_COUNT) % SUB_BUCKET_HALF + SUB_BUCKET_HALF);
+    return ((sub_bucket+1) << shift) - 1;
+}
+
+void LatencyHistogram::Record(const uint64_t ns_value) {
+    const int index = GetBucketIndex(ns_value);
+    m_counts[index].fetch_add(1, std::memory_order_relaxed);
+    m_total_count.fetch_add(1, std::memory_order_relaxed);
+    m_total_sum.fetch_add(ns_value, std::memory_order_relaxed);
+    uint64_t max_value = m_max_value.load(std::memory_order_relaxed);
+    while ((ns_value > max_value) && !m_max_value.compare_exchange_weak(max_value, ns_value, std::memory_order_relaxed)) {}
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::GetSnapshot() const {
+    Snapshot snapshot;
+    // NOTE: Total count is taken from the buckets so that it is consistent with them
+    //       if a value is being recorded while we copy
+    uint64_t total_count = 0;
+    for (int i = 0; i < TOTAL_BUCKETS; i++) {
+        const uint64_t count = m_counts[i].load(std::memory_order_relaxed);
+        snapshot.counts[i] = count;
+        total_count += count;
+    }
+    snapshot.total_count = total_count;
+    snapshot.total_sum = m_total_sum.load(std::memory_order_relaxed);
+    snapshot.max_value = m_max_value.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+uint64_t LatencyHistogram::Snapshot::GetPercentile(const double percentile) const {
+    if (total_count == 0) {
+        return 0;
+    }
+    const double fraction = std::clamp(percentile, 0.0, 100.0) / 100.0;
+    const uint64_t target = std::max(uint64_t(std::ceil(fraction * double(total_count))), uint64_t(1));
+    uint64_t cumulative = 0;
+    for (int i = 0; i < TOTAL_BUCKETS; i++) {
+        cumulative += counts[i];
+        if (cumulative >= target) {
+            return std::min(GetBucketUpperBound(i), max_value);
+        }
+    }
+    return max_value;
+}
+
+double LatencyHistogram::Snapshot::GetMean() const {
+    if (total_count == 0) {
+        return 0.0;
+    }
+    return double(total_sum) / double(total_count);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::Snapshot::GetDifference(const Snapshot& previous) const {
+    Snapshot difference;
+    int max_index = -1;
+    for (int i = 0; i < TOTAL_BUCKETS; i++) {
+        const uint64_t count = (counts[i] > previous.counts[i]) ? (counts[i] - previous.counts[i]) : 0;
+        difference.counts[i] = count;
+        difference.total_count += count;
+        if (count > 0) max_index = i;
+    }
+    difference.total_sum = (total_sum > previous.total_sum) ? (total_sum - previous.total_sum) : 0;
+    difference.max_value = (max_index >= 0) ? std::min(GetBucketUpperBound(max_index), max_value) : 0;
+    return difference;
+}
+
+const char* GetLatencyStageString(const LatencyStage stage) {
+    switch (stage) {
+    case LatencyStage::GRAB:       return "grab";
+    case LatencyStage::PREPROCESS: return "preprocess";
+    case LatencyStage::INFERENCE:  return "inference";
+    case LatencyStage::CONTROL:    return "control";
+    case LatencyStage::TOTAL:      return "total";
+    case LatencyStage::END_TO_END: return "end_to_end";
+    default:                       return "unknown";
+    }
+}
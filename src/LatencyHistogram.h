@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+
+// Log bucketed histogram of durations in nanoseconds similar to HdrHistogram
+// Each power of two range is split into linear sub buckets which bounds the relative error
+// Recording is a few relaxed atomic increments so it is safe to call from the hot loop
+// while another thread takes snapshots
+class LatencyHistogram
+{
+public:
+    // 64 sub buckets per power of two gives at most 1/32 = 3.1% relative error
+    static constexpr int SUB_BUCKET_BITS = 6;
+    static constexpr int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static constexpr int SUB_BUCKET_HALF = SUB_BUCKET_COUNT / 2;
+    // values are clamped to 2^44ns which is almost 5 hours
+    static constexpr int MAX_VALUE_BITS = 44;
+    static constexpr int TOTAL_BUCKETS = SUB_BUCKET_COUNT + (MAX_VALUE_BITS - SUB_BUCKET_BITS) * SUB_BUCKET_HALF;
+
+    struct Snapshot {
+        std::array<uint64_t, TOTAL_BUCKETS> counts {};
+        uint64_t total_count = 0;
+        uint64_t total_sum = 0;
+        uint64_t max_value = 0;
+        // percentile in [0,100] as the highest value in its bucket clamped to the max
+        uint64_t GetPercentile(const double percentile) const;
+        double GetMean() const;
+        // counts recorded since an earlier snapshot of the same histogram
+        // NOTE: Max is estimated from the highest non empty bucket
+        Snapshot GetDifference(const Snapshot& previous) const;
+    };
+private:
+    std::array<std::atomic<uint64_t>, TOTAL_BUCKETS> m_counts;
+    std::atomic<uint64_t> m_total_count;
+    std::atomic<uint64_t> m_total_sum;
+    std::atomic<uint64_t> m_max_value;
+public:
+    LatencyHistogram();
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+    void Record(const uint64_t ns_value);
+    template <typename Rep, typename Period>
+    void Record(const std::chrono::duration<Rep, Period> duration) {
+        const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+        Record(uint64_t((ns > 0) ? ns : 0));
+    }
+    Snapshot GetSnapshot() const;
+
+    static int GetBucketIndex(const uint64_t value);
+    static uint64_t GetBucketLowerBound(const int index);
+    static uint64_t GetBucketUpperBound(const int index);
+};
+
+// Latency of each stage of the player and of the whole capture to click loop
+enum class LatencyStage: int {
+    GRAB = 0,
+    PREPROCESS,
+    INFERENCE,
+    CONTROL,
+    TOTAL,      // start of preprocessing to end of inference
+    END_TO_END, // start of capture to mouse input being sent
+    COUNT,
+};
+
+constexpr int TOTAL_LATENCY_STAGES = int(LatencyStage::COUNT);
+const char* GetLatencyStageString(const LatencyStage stage);
+
+// NOTE: Each stage should only be recorded from one thread at a time
+class LatencyStats
+{
+private:
+    std::array<LatencyHistogram, TOTAL_LATENCY_STAGES> m_histograms;
+public:
+    LatencyHistogram& Get(const LatencyStage stage) { return m_histograms[int(stage)]; }
+    const LatencyHistogram& Get(const LatencyStage stage) const { return m_histograms[int(stage)]; }
+    template <typename Rep, typename Period>
+    void Record(const LatencyStage stage, const std::chrono::duration<Rep, Period> duration) {
+        m_histograms[int(stage)].Record(duration);
+    }
+};
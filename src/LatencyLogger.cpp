@@ -0,0 +1,91 @@
+#include "LatencyLogger.h"
+
+#include <stdexcept>
+#include <fmt/core.h>
+
+#include "ToolUtils.h"
+
+static double ns_to_us(const uint64_t ns) {
+    return double(ns) * 1e-3;
+}
+
+LatencyLogger::LatencyLogger(const LatencyStats& stats, const std::string& filepath, const std::chrono::milliseconds interval)
+: m_stats(stats), m_interval(interval)
+{
+    if (interval.count() <= 0) {
+        throw std::runtime_error(fmt::format("Latency log interval must be positive (got {}ms)", interval.count()));
+    }
+    m_format = (ends_with(filepath, ".json") || ends_with(filepath, ".jsonl")) ? Format::JSON : Format::CSV;
+    m_file = fopen(filepath.c_str(), "w");
+    if (m_file == nullptr) {
+        throw std::runtime_error(fmt::format("Failed to open latency log '{}'", filepath));
+    }
+    if (m_format == Format::CSV) {
+        fmt::print(m_file, "time_s,stage,count,mean_us,p50_us,p95_us,p99_us,p999_us,max_us,total_count,total_p99_us,total_max_us\n");
+    }
+
+    m_start = std::chrono::steady_clock::now();
+    m_previous.resize(TOTAL_LATENCY_STAGES);
+    for (int i = 0; i < TOTAL_LATENCY_STAGES; i++) {
+        m_previous[i] = m_stats.Get(LatencyStage(i)).GetSnapshot();
+    }
+
+    m_is_running = true;
+    m_thread = std::thread([this]() {
+        auto lock = std::unique_lock(m_mutex);
+        auto next_entry = std::chrono::steady_clock::now() + m_interval;
+        while (m_is_running) {
+            m_cv.wait_until(lock, next_entry, [this]() { return !m_is_running; });
+            if (!m_is_running) break;
+            WriteEntry();
+            next_entry += m_interval;
+        }
+    });
+}
+
+LatencyLogger::~LatencyLogger() {
+    {
+        auto lock = std::scoped_lock(m_mutex);
+        m_is_running = false;
+        m_cv.notify_all();
+    }
+    m_thread.join();
+    WriteEntry();
+    fclose(m_file);
+}
+
+void LatencyLogger::WriteEntry() {
+    const double time_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+    if (m_format == Format::JSON) {
+        fmt::print(m_file, "{{\"time_s\":{:.3f},\"stages\":{{", time_s);
+    }
+    for (int i = 0; i < TOTAL_LATENCY_STAGES; i++) {
+        const auto stage = LatencyStage(i);
+        const auto total = m_stats.Get(stage).GetSnapshot();
+        const auto interval = total.GetDifference(m_previous[i]);
+        m_previous[i] = total;
+        if (m_format == Format::CSV) {
+            fmt::print(m_file, "{:.3f},{},{},{:.1f},{:.1f},{:.1f},{:.1f},{:.1f},{:.1f},{},{:.1f},{:.1f}\n",
+                time_s, GetLatencyStageString(stage), interval.total_count,
+                interval.GetMean()*1e-3,
+                ns_to_us(interval.GetPercentile(50.0)), ns_to_us(interval.GetPercentile(95.0)),
+                ns_to_us(interval.GetPercentile(99.0)), ns_to_us(interval.GetPercentile(99.9)),
+                ns_to_us(interval.max_value),
+                total.total_count, ns_to_us(total.GetPercentile(99.0)), ns_to_us(total.max_value));
+        } else {
+            fmt::print(m_file,
+                "{}\"{}\":{{\"count\":{},\"mean_us\":{:.1f},\"p50_us\":{:.1f},\"p95_us\":{:.1f},\"p99_us\":{:.1f},\"p999_us\":{:.1f},\"max_us\":{:.1f},"
+                "\"total_count\":{},\"total_p99_us\":{:.1f},\"total_max_us\":{:.1f}}}",
+                (i == 0) ? "" : ",", GetLatencyStageString(stage), interval.total_count,
+                interval.GetMean()*1e-3,
+                ns_to_us(interval.GetPercentile(50.0)), ns_to_us(interval.GetPercentile(95.0)),
+                ns_to_us(interval.GetPercentile(99.0)), ns_to_us(interval.GetPercentile(99.9)),
+                ns_to_us(interval.max_value),
+                total.total_count, ns_to_us(total.GetPercentile(99.0)), ns_to_us(total.max_value));
+        }
+    }
+    if (m_format == Format::JSON) {
+        fmt::print(m_file, "}}}}\n");
+    }
+    fflush(m_file);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdio.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "LatencyHistogram.h"
+
+// Periodically appends the latency percentiles of each stage to a file from a background thread
+// Each entry has the statistics for the last interval and the running totals since startup
+// Files ending in .json or .jsonl are written as one json object per line, otherwise csv
+class LatencyLogger
+{
+public:
+    enum class Format { CSV, JSON };
+private:
+    const LatencyStats& m_stats;
+    FILE* m_file;
+    Format m_format;
+    std::chrono::milliseconds m_interval;
+    std::chrono::steady_clock::time_point m_start;
+    std::vector<LatencyHistogram::Snapshot> m_previous;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_is_running;
+    std::thread m_thread;
+public:
+    LatencyLogger(const LatencyStats& stats, const std::string& filepath, const std::chrono::milliseconds interval);
+    // writes a final entry for the partial interval
+    ~LatencyLogger();
+    LatencyLogger(const LatencyLogger&) = delete;
+    LatencyLogger& operator=(const LatencyLogger&) = delete;
+private:
+    void WriteEntry();
+};
@@ -0,0 +1,40 @@
+#include "MSSFrameSource.h"
+#include <chrono>
+
+MSSFrameSource::MSSFrameSource(std::shared_ptr<util::MSS>& mss) {
+    m_mss = mss;
+    m_frame_index = 0;
+    m_timestamp_us = 0;
+}
+
+bool MSSFrameSource::Grab(const int top, const int left) {
+    m_mss->Grab(top, left);
+    const auto clock = std::chrono::steady_clock::now();
+    m_timestamp_us = std::chrono::time_point_cast<std::chrono::microseconds>(clock).time_since_epoch().count();
+    m_frame_index++;
+    return true;
+}
+
+FrameView MSSFrameSource::GetFrame() {
+    auto bitmap = m_mss->GetBitmap();
+    const auto size = bitmap.GetSize();
+    // NOTE: The screenshot buffer can be resized, so we might have to do some cropping
+    const auto buffer_max_size = m_mss->GetMaxSize();
+
+    auto &sec = bitmap.GetBitmap();
+    BITMAP &bmp = sec.dsBm;
+    const uint8_t *buffer = reinterpret_cast<const uint8_t *>(bmp.bmBits);
+
+    // NOTE: GDI uses a bottom-up DIB section so the top row of the screenshot is the last row in memory
+    const int total_channels = 4;
+    const int stride = sizeof(uint8_t)*total_channels*buffer_max_size.x;
+
+    FrameView frame;
+    frame.data = buffer + (buffer_max_size.y-1)*stride;
+    frame.width = size.x;
+    frame.height = size.y;
+    frame.row_stride = -stride;
+    frame.frame_index = m_frame_index;
+    frame.timestamp_us = m_timestamp_us;
+    return frame;
+}
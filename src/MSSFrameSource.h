@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include "IFrameSource.h"
+#include "util/MSS.h"
+
+class MSSFrameSource: public IFrameSource
+{
+private:
+    std::shared_ptr<util::MSS> m_mss;
+    uint64_t m_frame_index;
+    int64_t m_timestamp_us;
+public:
+    MSSFrameSource(std::shared_ptr<util::MSS>& mss);
+    bool Grab(const int top, const int left) override;
+    FrameView GetFrame() override;
+};
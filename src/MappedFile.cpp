@@ -0,0 +1,151 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+#include <fmt/core.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+MappedFile::MappedFile(const char* filepath) {
+    m_data = nullptr;
+    m_size = 0;
+    m_mapping_handle = NULL;
+    m_file_handle = CreateFileA(
+        filepath, GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_file_handle == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error(fmt::format("Failed to open file for mapping: '{}'", filepath));
+    }
+
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(m_file_handle, &file_size);
+    m_size = size_t(file_size.QuadPart);
+    // NOTE: Windows refuses to map empty files
+    if (m_size == 0) {
+        return;
+    }
+
+    m_mapping_handle = CreateFileMappingA(m_file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (m_mapping_handle == NULL) {
+        CloseHandle(m_file_handle);
+        throw std::runtime_error(fmt::format("Failed to create file mapping: '{}'", filepath));
+    }
+    m_data = reinterpret_cast<const uint8_t*>(MapViewOfFile(m_mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    if (m_data == nullptr) {
+        CloseHandle(m_mapping_handle);
+        CloseHandle(m_file_handle);
+        throw std::runtime_error(fmt::format("Failed to map view of file: '{}'", filepath));
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (m_data != nullptr) UnmapViewOfFile(m_data);
+    if (m_mapping_handle != NULL) CloseHandle(m_mapping_handle);
+    CloseHandle(m_file_handle);
+}
+
+MappedFileWriter::MappedFileWriter(const char* filepath, const size_t size) {
+    if (size == 0) {
+        throw std::runtime_error(fmt::format("Mapped file must have a positive size: '{}'", filepath));
+    }
+    m_data = nullptr;
+    m_size = size;
+    m_file_handle = CreateFileA(
+        filepath, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_file_handle == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error(fmt::format("Failed to create file for mapping: '{}'", filepath));
+    }
+
+    // NOTE: Mapping a file larger than it is grows it to the size of the mapping
+    const uint64_t size_u64 = uint64_t(size);
+    m_mapping_handle = CreateFileMappingA(
+        m_file_handle, NULL, PAGE_READWRITE,
+        DWORD(size_u64 >> 32), DWORD(size_u64 & 0xFFFFFFFFu), NULL);
+    if (m_mapping_handle == NULL) {
+        CloseHandle(m_file_handle);
+        throw std::runtime_error(fmt::format("Failed to create file mapping: '{}'", filepath));
+    }
+    m_data = reinterpret_cast<uint8_t*>(MapViewOfFile(m_mapping_handle, FILE_MAP_WRITE, 0, 0, 0));
+    if (m_data == nullptr) {
+        CloseHandle(m_mapping_handle);
+        CloseHandle(m_file_handle);
+        throw std::runtime_error(fmt::format("Failed to map view of file: '{}'", filepath));
+    }
+}
+
+MappedFileWriter::~MappedFileWriter() {
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mapping_handle);
+    CloseHandle(m_file_handle);
+}
+#else
+MappedFile::MappedFile(const char* filepath) {
+    m_data = nullptr;
+    m_size = 0;
+    m_fd = open(filepath, O_RDONLY);
+    if (m_fd < 0) {
+        throw std::runtime_error(fmt::format("Failed to open file for mapping: '{}'", filepath));
+    }
+
+    struct stat file_stat;
+    if (fstat(m_fd, &file_stat) != 0) {
+        close(m_fd);
+        throw std::runtime_error(fmt::format("Failed to get size of file: '{}'", filepath));
+    }
+    m_size = size_t(file_stat.st_size);
+    // NOTE: mmap fails on empty files
+    if (m_size == 0) {
+        return;
+    }
+
+    void* data = mmap(NULL, m_size, PROT_READ, MAP_SHARED, m_fd, 0);
+    if (data == MAP_FAILED) {
+        close(m_fd);
+        throw std::runtime_error(fmt::format("Failed to map file: '{}'", filepath));
+    }
+    m_data = reinterpret_cast<const uint8_t*>(data);
+}
+
+MappedFile::~MappedFile() {
+    if (m_data != nullptr) munmap(const_cast<uint8_t*>(m_data), m_size);
+    close(m_fd);
+}
+
+MappedFileWriter::MappedFileWriter(const char* filepath, const size_t size) {
+    if (size == 0) {
+        throw std::runtime_error(fmt::format("Mapped file must have a positive size: '{}'", filepath));
+    }
+    m_data = nullptr;
+    m_size = size;
+    m_fd = open(filepath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m_fd < 0) {
+        throw std::runtime_error(fmt::format("Failed to create file for mapping: '{}'", filepath));
+    }
+    if (ftruncate(m_fd, off_t(size)) != 0) {
+        close(m_fd);
+        throw std::runtime_error(fmt::format("Failed to resize file to {} bytes: '{}'", size, filepath));
+    }
+
+    void* data = mmap(NULL, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (data == MAP_FAILED) {
+        close(m_fd);
+        throw std::runtime_error(fmt::format("Failed to map file: '{}'", filepath));
+    }
+    m_data = reinterpret_cast<uint8_t*>(data);
+}
+
+MappedFileWriter::~MappedFileWriter() {
+    munmap(m_data, m_size);
+    close(m_fd);
+}
+#endif
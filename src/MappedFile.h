@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Read only memory mapping of an entire file
+class MappedFile
+{
+private:
+    const uint8_t* m_data;
+    size_t m_size;
+#if defined(_WIN32)
+    void* m_file_handle;
+    void* m_mapping_handle;
+#else
+    int m_fd;
+#endif
+public:
+    explicit MappedFile(const char* filepath);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    const uint8_t* GetData() const { return m_data; }
+    size_t GetSize() const { return m_size; }
+};
+
+// Read write memory mapping of a new file with a fixed size
+// NOTE: An existing file at the path is replaced
+class MappedFileWriter
+{
+private:
+    uint8_t* m_data;
+    size_t m_size;
+#if defined(_WIN32)
+    void* m_file_handle;
+    void* m_mapping_handle;
+#else
+    int m_fd;
+#endif
+public:
+    MappedFileWriter(const char* filepath, const size_t size);
+    ~MappedFileWriter();
+    MappedFileWriter(const MappedFileWriter&) = delete;
+    MappedFileWriter& operator=(const MappedFileWriter&) = delete;
+    uint8_t* GetData() { return m_data; }
+    size_t GetSize() const { return m_size; }
+};
@@ -0,0 +1,182 @@
+#include "ModelEvaluator.h"
+
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <utility>
+#include <fmt/core.h>
+#include "IFrameSource.h"
+
+// nearest rank percentile in [0,100] of sorted values
+// NOTE: Values must not be empty
+static float get_percentile(const std::vector<float>& sorted, const float percentile) {
+    const size_t rank = size_t(std::ceil(percentile / 100.0f * float(sorted.size())));
+    return sorted[std::clamp(rank, size_t(1), sorted.size()) - 1];
+}
+
+// mann-whitney statistic with tied confidences counted as half
+// returns false if there are only samples with a ball or only samples without one
+static bool get_auc(const std::vector<SampleLabel>& labels, const std::vector<Prediction>& preds, float& auc) {
+    std::vector<std::pair<float, bool>> scores;
+    scores.reserve(preds.size());
+    size_t total_positives = 0;
+    for (size_t i = 0; i < preds.size(); i++) {
+        const bool has_ball = labels[i].has_ball != 0;
+        scores.push_back({ preds[i].confidence, has_ball });
+        total_positives += size_t(has_ball);
+    }
+    const size_t total_negatives = scores.size() - total_positives;
+    if ((total_positives == 0) || (total_negatives == 0)) {
+        return false;
+    }
+    std::sort(scores.begin(), scores.end());
+
+    // sum of the ranks of the positives starting from 1 with ties given their average rank
+    double rank_sum = 0.0;
+    size_t start = 0;
+    while (start < scores.size()) {
+        size_t end = start;
+        size_t total_tied_positives = 0;
+        while ((end < scores.size()) && (scores[end].first == scores[start].first)) {
+            total_tied_positives += size_t(scores[end].second);
+            end++;
+        }
+        const double average_rank = 0.5 * double(start + 1 + end);
+        rank_sum += average_rank * double(total_tied_positives);
+        start = end;
+    }
+    const double p = double(total_positives);
+    const double n = double(total_negatives);
+    auc = float((rank_sum - 0.5*p*(p + 1.0)) / (p * n));
+    return true;
+}
+
+ModelEvaluator::ModelEvaluator(std::unique_ptr<IModel>&& model)
+: m_model(std::move(model))
+{
+    if (m_model == nullptr) {
+        throw std::runtime_error("Model evaluator requires a model");
+    }
+}
+
+EvaluatedSample ModelEvaluator::Evaluate(const uint8_t* image, const int width, const int height) {
+    const size_t total_pixels = size_t(width)*size_t(height);
+    m_frame.resize(total_pixels*4);
+    for (size_t i = 0; i < total_pixels; i++) {
+        m_frame[i*4+0] = image[i*3+2];
+        m_frame[i*4+1] = image[i*3+1];
+        m_frame[i*4+2] = image[i*3+0];
+        m_frame[i*4+3] = 0xFF;
+    }
+
+    // NOTE: The model expects the bottom row of the screen to be the first row of the image
+    //       So we start from the last row and walk upwards like the player does
+    FrameView frame;
+    frame.width = width;
+    frame.height = height;
+    frame.row_stride = -width*4;
+    frame.data = m_frame.data() + size_t(height-1)*size_t(width)*4;
+
+    EvaluatedSample sample;
+    const auto dt_start = std::chrono::steady_clock::now();
+    m_preprocessor.Process(frame, m_model->GetInputBuffer());
+    const auto dt_preprocess_end = std::chrono::steady_clock::now();
+    m_model->Parse();
+    sample.pred = m_model->GetPrediction();
+    const auto dt_end = std::chrono::steady_clock::now();
+    sample.preprocess_ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(dt_preprocess_end - dt_start).count());
+    sample.inference_ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(dt_end - dt_preprocess_end).count());
+    return sample;
+}
+
+EvaluationSummary ModelEvaluator::Summarise(
+    const std::vector<SampleLabel>& labels, const std::vector<Prediction>& preds,
+    const float confidence_threshold, const int total_roc_points)
+{
+    if (labels.size() != preds.size()) {
+        throw std::runtime_error(fmt::format("Got {} predictions for {} labels", preds.size(), labels.size()));
+    }
+    if (total_roc_points < 2) {
+        throw std::runtime_error(fmt::format("Roc curve requires at least 2 points (got {})", total_roc_points));
+    }
+
+    EvaluationSummary summary;
+    summary.total_samples = int(labels.size());
+    summary.confidence_threshold = confidence_threshold;
+    std::vector<float> distances;
+    int total_correct = 0;
+    int total_hits = 0;
+    double total_confidence_error = 0.0;
+    double total_position_error = 0.0;
+    double total_distance = 0.0;
+    for (size_t i = 0; i < labels.size(); i++) {
+        const auto& label = labels[i];
+        const auto& pred = preds[i];
+        const bool has_ball = label.has_ball != 0;
+        const float expected_confidence = has_ball ? 1.0f : 0.0f;
+        total_correct += int((pred.confidence > confidence_threshold) == has_ball);
+        total_confidence_error += double(std::abs(pred.confidence - expected_confidence));
+        if (!has_ball) continue;
+
+        // labels are measured downwards from the top while predictions are measured upwards from the bottom
+        const float dx = pred.x - label.x_centre;
+        const float dy = pred.y - (1.0f - label.y_centre);
+        const float distance = std::sqrt(dx*dx + dy*dy);
+        summary.total_balls++;
+        total_position_error += double(std::abs(dx) + std::abs(dy));
+        total_distance += double(distance);
+        distances.push_back(distance);
+        const float rx = 0.5f*label.width;
+        const float ry = 0.5f*label.height;
+        if ((rx > 0.0f) && (ry > 0.0f)) {
+            total_hits += int((dx*dx)/(rx*rx) + (dy*dy)/(ry*ry) <= 1.0f);
+        }
+    }
+
+    const int total_samples = summary.total_samples;
+    const int total_balls = summary.total_balls;
+    summary.has_confidence = total_samples > 0;
+    if (summary.has_confidence) {
+        summary.confidence_accuracy = float(total_correct) / float(total_samples);
+        summary.mean_confidence_error = float(total_confidence_error / double(total_samples));
+    }
+    summary.has_position = total_balls > 0;
+    if (summary.has_position) {
+        summary.mean_position_error = float(total_position_error / double(total_balls));
+        summary.mean_distance = float(total_distance / double(total_balls));
+        summary.hit_rate = float(total_hits) / float(total_balls);
+        std::sort(distances.begin(), distances.end());
+        summary.p50_distance = get_percentile(distances, 50.0f);
+        summary.p90_distance = get_percentile(distances, 90.0f);
+        summary.p99_distance = get_percentile(distances, 99.0f);
+        summary.max_distance = distances.back();
+    }
+    summary.has_confidence_auc = get_auc(labels, preds, summary.confidence_auc);
+
+    const int total_empty = total_samples - total_balls;
+    for (int i = 0; i < total_roc_points; i++) {
+        ConfidenceRocPoint point;
+        point.threshold = float(i) / float(total_roc_points-1);
+        int total_true_positives = 0;
+        int total_false_positives = 0;
+        for (size_t j = 0; j < labels.size(); j++) {
+            if (preds[j].confidence < point.threshold) continue;
+            if (labels[j].has_ball != 0) {
+                total_true_positives++;
+            } else {
+                total_false_positives++;
+            }
+        }
+        point.has_true_positive_rate = total_balls > 0;
+        if (point.has_true_positive_rate) {
+            point.true_positive_rate = float(total_true_positives) / float(total_balls);
+        }
+        point.has_false_positive_rate = total_empty > 0;
+        if (point.has_false_positive_rate) {
+            point.false_positive_rate = float(total_false_positives) / float(total_empty);
+        }
+        summary.roc.push_back(point);
+    }
+    return summary;
+}
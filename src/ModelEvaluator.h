@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include "IModel.h"
+#include "Prediction.h"
+#include "Preprocessor.h"
+#include "SampleDataset.h"
+
+// Prediction of a model for a labeled sample and how long each stage took
+struct EvaluatedSample {
+    Prediction pred;
+    uint64_t preprocess_ns = 0;
+    uint64_t inference_ns = 0;
+};
+
+// Point of the confidence roc curve
+// NOTE: A rate is only valid if there were samples of its kind
+struct ConfidenceRocPoint {
+    float threshold = 0.0f;
+    // fraction of samples with a ball at or above the threshold
+    bool has_true_positive_rate = false;
+    float true_positive_rate = 0.0f;
+    // fraction of samples without a ball at or above the threshold
+    bool has_false_positive_rate = false;
+    float false_positive_rate = 0.0f;
+};
+
+// Accuracy of a model over a set of labeled samples
+// Position errors are normalised to the image size and only use samples with a ball
+// NOTE: Metrics without any samples to measure are flagged as invalid and left at zero
+//       since nan can't be relied on with fast math
+struct EvaluationSummary {
+    int total_samples = 0;
+    int total_balls = 0;
+    // same metrics as calculate_metrics in the training scripts
+    float confidence_threshold = 0.5f;
+    // there was at least one sample
+    bool has_confidence = false;
+    float confidence_accuracy = 0.0f;
+    float mean_confidence_error = 0.0f;
+    // there was at least one sample with a ball
+    bool has_position = false;
+    float mean_position_error = 0.0f;
+    // distance between the predicted and labeled centres
+    float mean_distance = 0.0f;
+    float p50_distance = 0.0f;
+    float p90_distance = 0.0f;
+    float p99_distance = 0.0f;
+    float max_distance = 0.0f;
+    // fraction of predicted centres that land inside the labeled bounding box's ellipse
+    float hit_rate = 0.0f;
+    // area under the roc curve which is the chance a sample with a ball has a higher confidence than one without
+    // there were samples both with and without a ball
+    bool has_confidence_auc = false;
+    float confidence_auc = 0.0f;
+    std::vector<ConfidenceRocPoint> roc;
+};
+
+// Runs labeled samples through a model with the same preprocessing as the player
+// Holds its own model and frame buffer so each thread can have one
+class ModelEvaluator
+{
+private:
+    std::unique_ptr<IModel> m_model;
+    Preprocessor m_preprocessor;
+    // sample converted to BGRA8 like a screen capture
+    std::vector<uint8_t> m_frame;
+public:
+    explicit ModelEvaluator(std::unique_ptr<IModel>&& model);
+    // image is a top-down RGB8 sample from a dataset
+    EvaluatedSample Evaluate(const uint8_t* image, const int width, const int height);
+    IModel& GetModel() { return *m_model; }
+    // roc points are evenly spaced thresholds from 0 to 1
+    static EvaluationSummary Summarise(
+        const std::vector<SampleLabel>& labels, const std::vector<Prediction>& preds,
+        const float confidence_threshold, const int total_roc_points);
+};
@@ -0,0 +1,501 @@
+#include "NativeModel.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <fmt/core.h>
+#include "MappedFile.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// 8 floats so that every kernel can be written once for each instruction set
+#if defined(__AVX2__)
+struct vec8 { __m256 v; };
+static inline vec8 vec8_load(const float* x) { return { _mm256_loadu_ps(x) }; }
+static inline void vec8_store(float* x, const vec8 a) { _mm256_storeu_ps(x, a.v); }
+static inline vec8 vec8_broadcast(const float x) { return { _mm256_set1_ps(x) }; }
+static inline vec8 vec8_zero() { return { _mm256_setzero_ps() }; }
+static inline vec8 vec8_max(const vec8 a, const vec8 b) { return { _mm256_max_ps(a.v, b.v) }; }
+static inline vec8 vec8_min(const vec8 a, const vec8 b) { return { _mm256_min_ps(a.v, b.v) }; }
+// a*b + c
+static inline vec8 vec8_fmadd(const vec8 a, const vec8 b, const vec8 c) {
+#if defined(__FMA__) || defined(_MSC_VER)
+    return { _mm256_fmadd_ps(a.v, b.v, c.v) };
+#else
+    return { _mm256_add_ps(_mm256_mul_ps(a.v, b.v), c.v) };
+#endif
+}
+#elif defined(__ARM_NEON)
+struct vec8 { float32x4_t lo, hi; };
+static inline vec8 vec8_load(const float* x) { return { vld1q_f32(x), vld1q_f32(x+4) }; }
+static inline void vec8_store(float* x, const vec8 a) { vst1q_f32(x, a.lo); vst1q_f32(x+4, a.hi); }
+static inline vec8 vec8_broadcast(const float x) { return { vdupq_n_f32(x), vdupq_n_f32(x) }; }
+static inline vec8 vec8_zero() { return vec8_broadcast(0.0f); }
+static inline vec8 vec8_max(const vec8 a, const vec8 b) { return { vmaxq_f32(a.lo, b.lo), vmaxq_f32(a.hi, b.hi) }; }
+static inline vec8 vec8_min(const vec8 a, const vec8 b) { return { vminq_f32(a.lo, b.lo), vminq_f32(a.hi, b.hi) }; }
+static inline vec8 vec8_fmadd(const vec8 a, const vec8 b, const vec8 c) {
+    return { vmlaq_f32(c.lo, a.lo, b.lo), vmlaq_f32(c.hi, a.hi, b.hi) };
+}
+#else
+struct vec8 { float v[8]; };
+static inline vec8 vec8_load(const float* x) { vec8 a; for (int i = 0; i < 8; i++) a.v[i] = x[i]; return a; }
+static inline void vec8_store(float* x, const vec8 a) { for (int i = 0; i < 8; i++) x[i] = a.v[i]; }
+static inline vec8 vec8_broadcast(const float x) { vec8 a; for (int i = 0; i < 8; i++) a.v[i] = x; return a; }
+static inline vec8 vec8_zero() { return vec8_broadcast(0.0f); }
+static inline vec8 vec8_max(const vec8 a, const vec8 b) { vec8 c; for (int i = 0; i < 8; i++) c.v[i] = std::max(a.v[i], b.v[i]); return c; }
+static inline vec8 vec8_min(const vec8 a, const vec8 b) { vec8 c; for (int i = 0; i < 8; i++) c.v[i] = std::min(a.v[i], b.v[i]); return c; }
+static inline vec8 vec8_fmadd(const vec8 a, const vec8 b, const vec8 c) {
+    vec8 d; for (int i = 0; i < 8; i++) d.v[i] = a.v[i]*b.v[i] + c.v[i]; return d;
+}
+#endif
+
+static_assert(NativeModel::TOTAL_LANES == 8, "Kernels are written for 8 lanes");
+
+static inline vec8 apply_activation(const vec8 x, const vec8 negative_slope) {
+    const vec8 zero = vec8_zero();
+    return vec8_fmadd(negative_slope, vec8_min(x, zero), vec8_max(x, zero));
+}
+
+static int pad_channels(const int channels) {
+    constexpr int N = NativeModel::TOTAL_LANES;
+    return ((channels + N - 1) / N) * N;
+}
+
+static const char* get_layer_type_string(const NativeLayerType type) {
+    switch (type) {
+    case NativeLayerType::CONV2D:           return "conv2d";
+    case NativeLayerType::DEPTHWISE_CONV2D: return "depthwise_conv2d";
+    case NativeLayerType::MAX_POOL2D:       return "max_pool2d";
+    case NativeLayerType::DENSE:            return "dense";
+    default:                                return "unknown";
+    }
+}
+
+static const char* get_activation_string(const NativeActivation activation) {
+    switch (activation) {
+    case NativeActivation::NONE:       return "none";
+    case NativeActivation::RELU:       return "relu";
+    case NativeActivation::LEAKY_RELU: return "leaky_relu";
+    default:                           return "unknown";
+    }
+}
+
+// Each call computes NX adjacent output pixels for NV vectors of output channels
+// so that every weight load is shared across pixels and every input broadcast across channels
+// K_ and C_ are the kernel size and input channels if known at compile time otherwise 0
+template <int NV, int NX, int K_, int C_>
+static inline void conv2d_block(
+    const float* src, float* dst, const float* weights, const float* biases,
+    const int kernel_size, const int in_channels, const int in_row_stride, const int in_stride, const int out_stride,
+    const vec8 negative_slope)
+{
+    const int K = (K_ > 0) ? K_ : kernel_size;
+    const int C = (C_ > 0) ? C_ : in_channels;
+    vec8 acc[NX][NV];
+    for (int j = 0; j < NV; j++) {
+        const vec8 bias = vec8_load(&biases[j*8]);
+        for (int i = 0; i < NX; i++) acc[i][j] = bias;
+    }
+    for (int ky = 0; ky < K; ky++) {
+        for (int kx = 0; kx < K; kx++) {
+            const float* x_row = &src[ky*in_row_stride + kx*in_stride];
+            const float* w_row = &weights[(ky*K + kx)*C*out_stride];
+            for (int c = 0; c < C; c++) {
+                vec8 w[NV];
+                for (int j = 0; j < NV; j++) w[j] = vec8_load(&w_row[c*out_stride + j*8]);
+                for (int i = 0; i < NX; i++) {
+                    const vec8 x = vec8_broadcast(x_row[i*in_stride + c]);
+                    for (int j = 0; j < NV; j++) acc[i][j] = vec8_fmadd(x, w[j], acc[i][j]);
+                }
+            }
+        }
+    }
+    for (int i = 0; i < NX; i++) {
+        for (int j = 0; j < NV; j++) {
+            vec8_store(&dst[i*out_stride + j*8], apply_activation(acc[i][j], negative_slope));
+        }
+    }
+}
+
+template <int NV, int K_, int C_>
+static void conv2d_row(
+    const float* src, float* dst, const float* weights, const float* biases,
+    const int kernel_size, const int in_channels, const int in_row_stride, const int in_stride, const int out_stride,
+    const int out_width, const vec8 negative_slope)
+{
+    constexpr int NX = 4;
+    int x = 0;
+    for (; x+NX <= out_width; x += NX) {
+        conv2d_block<NV,NX,K_,C_>(
+            &src[x*in_stride], &dst[x*out_stride], weights, biases,
+            kernel_size, in_channels, in_row_stride, in_stride, out_stride, negative_slope);
+    }
+    for (; x < out_width; x++) {
+        conv2d_block<NV,1,K_,C_>(
+            &src[x*in_stride], &dst[x*out_stride], weights, biases,
+            kernel_size, in_channels, in_row_stride, in_stride, out_stride, negative_slope);
+    }
+}
+
+template <int K_, int C_>
+static void conv2d(const float* src, float* dst, const float* weights, const float* biases,
+    const int kernel_size, const int in_width, const int in_channels, const int in_stride,
+    const int out_width, const int out_height, const int out_stride, const vec8 negative_slope)
+{
+    const int in_row_stride = in_width*in_stride;
+    for (int y = 0; y < out_height; y++) {
+        const float* src_row = &src[y*in_row_stride];
+        float* dst_row = &dst[y*out_width*out_stride];
+        // two vectors of output channels at a time uses 8 accumulators over 4 pixels
+        int c = 0;
+        for (; c+16 <= out_stride; c += 16) {
+            conv2d_row<2,K_,C_>(src_row, &dst_row[c], &weights[c], &biases[c],
+                kernel_size, in_channels, in_row_stride, in_stride, out_stride, out_width, negative_slope);
+        }
+        for (; c < out_stride; c += 8) {
+            conv2d_row<1,K_,C_>(src_row, &dst_row[c], &weights[c], &biases[c],
+                kernel_size, in_channels, in_row_stride, in_stride, out_stride, out_width, negative_slope);
+        }
+    }
+}
+
+template <int K_>
+static void depthwise_conv2d(const float* src, float* dst, const float* weights, const float* biases,
+    const int kernel_size, const int in_width, const int stride,
+    const int out_width, const int out_height, const vec8 negative_slope)
+{
+    const int K = (K_ > 0) ? K_ : kernel_size;
+    const int in_row_stride = in_width*stride;
+    for (int y = 0; y < out_height; y++) {
+        for (int x = 0; x < out_width; x++) {
+            const float* src_pixel = &src[y*in_row_stride + x*stride];
+            float* dst_pixel = &dst[(y*out_width + x)*stride];
+            for (int c = 0; c < stride; c += 8) {
+                vec8 acc = vec8_load(&biases[c]);
+                for (int ky = 0; ky < K; ky++) {
+                    for (int kx = 0; kx < K; kx++) {
+                        const vec8 v = vec8_load(&src_pixel[ky*in_row_stride + kx*stride + c]);
+                        const vec8 w = vec8_load(&weights[(ky*K + kx)*stride + c]);
+                        acc = vec8_fmadd(v, w, acc);
+                    }
+                }
+                vec8_store(&dst_pixel[c], apply_activation(acc, negative_slope));
+            }
+        }
+    }
+}
+
+template <int K_>
+static void max_pool2d(const float* src, float* dst,
+    const int kernel_size, const int in_width, const int stride,
+    const int out_width, const int out_height)
+{
+    const int K = (K_ > 0) ? K_ : kernel_size;
+    const int in_row_stride = in_width*stride;
+    for (int y = 0; y < out_height; y++) {
+        for (int x = 0; x < out_width; x++) {
+            const float* src_pixel = &src[(y*K)*in_row_stride + (x*K)*stride];
+            float* dst_pixel = &dst[(y*out_width + x)*stride];
+            for (int c = 0; c < stride; c += 8) {
+                vec8 acc = vec8_load(&src_pixel[c]);
+                for (int ky = 0; ky < K; ky++) {
+                    for (int kx = 0; kx < K; kx++) {
+                        acc = vec8_max(acc, vec8_load(&src_pixel[ky*in_row_stride + kx*stride + c]));
+                    }
+                }
+                vec8_store(&dst_pixel[c], acc);
+            }
+        }
+    }
+}
+
+template <int NV>
+static inline void dense_block(const float* src, float* dst, const float* weights, const float* biases,
+    const int in_channels, const int out_stride, const vec8 negative_slope)
+{
+    vec8 acc[NV];
+    for (int j = 0; j < NV; j++) acc[j] = vec8_load(&biases[j*8]);
+    for (int i = 0; i < in_channels; i++) {
+        const vec8 x = vec8_broadcast(src[i]);
+        for (int j = 0; j < NV; j++) acc[j] = vec8_fmadd(x, vec8_load(&weights[i*out_stride + j*8]), acc[j]);
+    }
+    for (int j = 0; j < NV; j++) vec8_store(&dst[j*8], apply_activation(acc[j], negative_slope));
+}
+
+static void dense(const float* src, float* dst, const float* weights, const float* biases,
+    const int in_channels, const int out_stride, const vec8 negative_slope)
+{
+    int c = 0;
+    for (; c+32 <= out_stride; c += 32) {
+        dense_block<4>(src, &dst[c], &weights[c], &biases[c], in_channels, out_stride, negative_slope);
+    }
+    for (; c < out_stride; c += 8) {
+        dense_block<1>(src, &dst[c], &weights[c], &biases[c], in_channels, out_stride, negative_slope);
+    }
+}
+
+NativeModel::NativeModel(const char* filepath, const size_t max_batch_size)
+: m_max_batch_size(max_batch_size), m_batch_size(1)
+{
+    if (max_batch_size == 0) {
+        throw std::runtime_error("Native model must have a max batch size of at least 1");
+    }
+    auto file = std::make_unique<MappedFile>(filepath);
+    const uint8_t* data = file->GetData();
+    const size_t size = file->GetSize();
+    size_t offset = 0;
+    auto read = [&](void* dst, const size_t length) {
+        if (offset + length > size) {
+            throw std::runtime_error(fmt::format("Native model file is truncated: '{}'", filepath));
+        }
+        memcpy(dst, &data[offset], length);
+        offset += length;
+    };
+
+    NativeModelHeader header;
+    read(&header, sizeof(header));
+    if (memcmp(header.magic, NATIVE_MODEL_MAGIC, sizeof(header.magic)) != 0) {
+        throw std::runtime_error(fmt::format("Native model file has an invalid header: '{}'", filepath));
+    }
+    if (header.version != NATIVE_MODEL_VERSION) {
+        throw std::runtime_error(fmt::format(
+            "Native model file has version {} but expected {}: '{}'",
+            header.version, NATIVE_MODEL_VERSION, filepath));
+    }
+    if (header.input_channels != 3) {
+        throw std::runtime_error(fmt::format("Native model must have 3 input channels but has {}", header.input_channels));
+    }
+    m_width = size_t(header.input_width);
+    m_height = size_t(header.input_height);
+    m_channels = size_t(header.input_channels);
+    m_input_buffer.resize(m_width*m_height*m_channels*m_max_batch_size);
+    m_predictions.resize(m_max_batch_size);
+
+    // the model input is the only activation without channel padding
+    int width = int(m_width);
+    int height = int(m_height);
+    int channels = int(m_channels);
+    int stride = int(m_channels);
+    size_t max_activation_size = 0;
+    for (uint32_t i = 0; i < header.total_layers; i++) {
+        NativeLayerHeader layer_header;
+        read(&layer_header, sizeof(layer_header));
+
+        Layer layer;
+        layer.type = NativeLayerType(layer_header.type);
+        layer.activation = NativeActivation(layer_header.activation);
+        layer.kernel_size = int(layer_header.kernel_size);
+        layer.in_width = width;
+        layer.in_height = height;
+        layer.in_channels = channels;
+        layer.in_stride = stride;
+        switch (layer.activation) {
+        case NativeActivation::NONE:       layer.negative_slope = 1.0f; break;
+        case NativeActivation::RELU:       layer.negative_slope = 0.0f; break;
+        case NativeActivation::LEAKY_RELU: layer.negative_slope = layer_header.negative_slope; break;
+        default:
+            throw std::runtime_error(fmt::format("Native model layer {} has unknown activation {}", i, layer_header.activation));
+        }
+
+        const int K = layer.kernel_size;
+        const int in_channels = int(layer_header.in_channels);
+        const int out_channels = int(layer_header.out_channels);
+        const bool is_spatial = (layer.type != NativeLayerType::DENSE);
+        if (is_spatial && ((K <= 0) || (K > width) || (K > height))) {
+            throw std::runtime_error(fmt::format(
+                "Native model layer {} has kernel size {} for a {}x{} input", i, K, width, height));
+        }
+        // dense layers flatten their input
+        const int expected_in_channels = is_spatial ? channels : (width*height*channels);
+        if (in_channels != expected_in_channels) {
+            throw std::runtime_error(fmt::format(
+                "Native model layer {} expects {} input channels but has {}", i, expected_in_channels, in_channels));
+        }
+
+        // read weights and pad the output channels out to whole vectors
+        size_t total_weights = 0;
+        size_t total_rows = 0;
+        switch (layer.type) {
+        case NativeLayerType::CONV2D:
+            layer.out_width = width-K+1;
+            layer.out_height = height-K+1;
+            layer.out_channels = out_channels;
+            total_rows = size_t(K*K*in_channels);
+            break;
+        case NativeLayerType::DEPTHWISE_CONV2D:
+            layer.out_width = width-K+1;
+            layer.out_height = height-K+1;
+            layer.out_channels = channels;
+            total_rows = size_t(K*K);
+            break;
+        case NativeLayerType::MAX_POOL2D:
+            layer.out_width = width/K;
+            layer.out_height = height/K;
+            layer.out_channels = channels;
+            break;
+        case NativeLayerType::DENSE:
+            layer.out_width = 1;
+            layer.out_height = 1;
+            layer.out_channels = out_channels;
+            total_rows = size_t(in_channels);
+            break;
+        default:
+            throw std::runtime_error(fmt::format("Native model layer {} has unknown type {}", i, layer_header.type));
+        }
+        if (layer.out_channels != out_channels) {
+            throw std::runtime_error(fmt::format(
+                "Native model layer {} must have {} output channels but has {}", i, layer.out_channels, out_channels));
+        }
+        layer.out_stride = pad_channels(layer.out_channels);
+        total_weights = total_rows*size_t(out_channels);
+
+        if (layer.type != NativeLayerType::MAX_POOL2D) {
+            std::vector<float> weights(total_weights);
+            std::vector<float> biases(out_channels);
+            read(weights.data(), weights.size()*sizeof(float));
+            read(biases.data(), biases.size()*sizeof(float));
+
+            // padded rows and columns are zero so padded channels stay zero after every layer
+            const int out_stride = layer.out_stride;
+            layer.biases.resize(size_t(out_stride), 0.0f);
+            std::copy(biases.begin(), biases.end(), layer.biases.begin());
+            if (layer.type == NativeLayerType::DENSE) {
+                // our flattened input has padded channels between each pixel
+                layer.weights.resize(size_t(width*height*stride)*size_t(out_stride), 0.0f);
+                for (int p = 0; p < width*height; p++) {
+                    for (int c = 0; c < channels; c++) {
+                        const float* src = &weights[size_t(p*channels + c)*size_t(out_channels)];
+                        float* dst = &layer.weights[size_t(p*stride + c)*size_t(out_stride)];
+                        std::copy(src, src+out_channels, dst);
+                    }
+                }
+            } else {
+                layer.weights.resize(total_rows*size_t(out_stride), 0.0f);
+                for (size_t r = 0; r < total_rows; r++) {
+                    const float* src = &weights[r*size_t(out_channels)];
+                    float* dst = &layer.weights[r*size_t(out_stride)];
+                    std::copy(src, src+out_channels, dst);
+                }
+            }
+        }
+
+        if ((layer.out_width <= 0) || (layer.out_height <= 0)) {
+            throw std::runtime_error(fmt::format("Native model layer {} has an empty output", i));
+        }
+        width = layer.out_width;
+        height = layer.out_height;
+        channels = layer.out_channels;
+        stride = layer.out_stride;
+        max_activation_size = std::max(max_activation_size, size_t(width)*size_t(height)*size_t(stride));
+        layer.kernel = SelectKernel(layer);
+        m_layers.push_back(std::move(layer));
+    }
+
+    if (m_layers.empty()) {
+        throw std::runtime_error(fmt::format("Native model has no layers: '{}'", filepath));
+    }
+    if ((width != 1) || (height != 1) || (channels != 3)) {
+        throw std::runtime_error(fmt::format(
+            "Native model must output 3 values but outputs ({},{},{})", height, width, channels));
+    }
+    for (auto& activations: m_activations) {
+        activations.resize(max_activation_size, 0.0f);
+    }
+}
+
+void NativeModel::Parse() {
+    // NOTE: Batches are run one input at a time since a single thread gains little from
+    //       interleaving them and the activations stay in cache
+    const size_t input_size = m_width*m_height*m_channels;
+    for (size_t b = 0; b < m_batch_size; b++) {
+        const float* src = &m_input_buffer[b*input_size];
+        for (size_t i = 0; i < m_layers.size(); i++) {
+            float* dst = m_activations[i % 2].data();
+            m_layers[i].kernel(m_layers[i], src, dst);
+            src = dst;
+        }
+        auto& prediction = m_predictions[b];
+        prediction.x = src[0];
+        prediction.y = src[1];
+        prediction.confidence = src[2];
+    }
+}
+
+void NativeModel::SetBatchSize(const size_t batch_size) {
+    if ((batch_size == 0) || (batch_size > m_max_batch_size)) {
+        throw std::runtime_error(fmt::format(
+            "Native model batch size must be between 1 and {} (got {})", m_max_batch_size, batch_size));
+    }
+    m_batch_size = batch_size;
+}
+
+template <int K, int C>
+void NativeModel::RunConv2D(const Layer& layer, const float* src, float* dst) {
+    conv2d<K,C>(src, dst, layer.weights.data(), layer.biases.data(),
+        layer.kernel_size, layer.in_width, layer.in_channels, layer.in_stride,
+        layer.out_width, layer.out_height, layer.out_stride, vec8_broadcast(layer.negative_slope));
+}
+
+template <int K>
+void NativeModel::RunDepthwiseConv2D(const Layer& layer, const float* src, float* dst) {
+    depthwise_conv2d<K>(src, dst, layer.weights.data(), layer.biases.data(),
+        layer.kernel_size, layer.in_width, layer.in_stride,
+        layer.out_width, layer.out_height, vec8_broadcast(layer.negative_slope));
+}
+
+template <int K>
+void NativeModel::RunMaxPool2D(const Layer& layer, const float* src, float* dst) {
+    max_pool2d<K>(src, dst, layer.kernel_size, layer.in_width, layer.in_stride, layer.out_width, layer.out_height);
+}
+
+void NativeModel::RunDense(const Layer& layer, const float* src, float* dst) {
+    dense(src, dst, layer.weights.data(), layer.biases.data(),
+        layer.in_width*layer.in_height*layer.in_stride, layer.out_stride, vec8_broadcast(layer.negative_slope));
+}
+
+NativeModel::LayerKernel NativeModel::SelectKernel(const Layer& layer) {
+    const int K = layer.kernel_size;
+    const int C = layer.in_channels;
+    // shapes used by the basic models from the training scripts
+    switch (layer.type) {
+    case NativeLayerType::CONV2D:
+        if ((K == 3) && (C == 3))  return &RunConv2D<3,3>;
+        if ((K == 3) && (C == 16)) return &RunConv2D<3,16>;
+        if ((K == 3) && (C == 32)) return &RunConv2D<3,32>;
+        if ((K == 3) && (C == 64)) return &RunConv2D<3,64>;
+        if ((K == 3) && (C == 128)) return &RunConv2D<3,128>;
+        if ((K == 1) && (C == 16)) return &RunConv2D<1,16>;
+        if ((K == 1) && (C == 32)) return &RunConv2D<1,32>;
+        return &RunConv2D<0,0>;
+    case NativeLayerType::DEPTHWISE_CONV2D:
+        if (K == 3) return &RunDepthwiseConv2D<3>;
+        return &RunDepthwiseConv2D<0>;
+    case NativeLayerType::MAX_POOL2D:
+        if (K == 2) return &RunMaxPool2D<2>;
+        if (K == 3) return &RunMaxPool2D<3>;
+        return &RunMaxPool2D<0>;
+    case NativeLayerType::DENSE:
+    default:
+        return &RunDense;
+    }
+}
+
+void NativeModel::PrintSummary() {
+    printf("[input: (%zu,%zu,%zu)]\n", m_height, m_width, m_channels);
+    printf("[layers: %zu]\n", m_layers.size());
+    size_t total_parameters = 0;
+    for (const auto& layer: m_layers) {
+        printf("    %s(k=%d) %s: (%d,%d,%d) -> (%d,%d,%d)\n",
+            get_layer_type_string(layer.type), layer.kernel_size, get_activation_string(layer.activation),
+            layer.in_height, layer.in_width, layer.in_channels,
+            layer.out_height, layer.out_width, layer.out_channels);
+        total_parameters += layer.weights.size() + layer.biases.size();
+    }
+    printf("[parameters: %zu including padding]\n", total_parameters);
+}
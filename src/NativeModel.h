@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "IModel.h"
+#include "Prediction.h"
+
+// Native model files are a header followed by each layer in the order they are run
+// Each layer header is followed by its float32 weights and then its biases
+// Weights are laid out for channels last (NHWC) activations:
+// - CONV2D:           (kernel, kernel, in_channels, out_channels), pointwise convolutions have kernel=1
+// - DEPTHWISE_CONV2D: (kernel, kernel, channels)
+// - MAX_POOL2D:       no weights, stride is the same as the kernel size
+// - DENSE:            (in_channels, out_channels) where the input is flattened in (height, width, channels) order
+// All layers except pooling have out_channels biases
+struct NativeModelHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t input_width;
+    uint32_t input_height;
+    uint32_t input_channels;
+    uint32_t total_layers;
+};
+
+enum class NativeLayerType: uint32_t {
+    CONV2D = 0,
+    DEPTHWISE_CONV2D = 1,
+    MAX_POOL2D = 2,
+    DENSE = 3,
+};
+
+enum class NativeActivation: uint32_t {
+    NONE = 0,
+    RELU = 1,
+    LEAKY_RELU = 2,
+};
+
+struct NativeLayerHeader {
+    uint32_t type;
+    uint32_t activation;
+    float negative_slope; // only used by leaky relu
+    uint32_t kernel_size;
+    uint32_t in_channels;
+    uint32_t out_channels;
+};
+
+constexpr char NATIVE_MODEL_MAGIC[4] = {'S','B','N','M'};
+constexpr uint32_t NATIVE_MODEL_VERSION = 1;
+
+// Runs small convolutional models on a single thread without a runtime
+// Activations are stored channels last with the channels padded to the simd width
+// so that every kernel works on whole vectors of output channels
+class NativeModel: public IModel
+{
+public:
+    // floats per simd vector, channels are padded to a multiple of this
+    static constexpr int TOTAL_LANES = 8;
+private:
+    struct Layer;
+    using LayerKernel = void (*)(const Layer& layer, const float* src, float* dst);
+    struct Layer {
+        NativeLayerType type;
+        NativeActivation activation;
+        // output = max(x,0) + negative_slope*min(x,0) so this also covers relu and no activation
+        float negative_slope;
+        int kernel_size;
+        int in_width, in_height, in_channels;
+        int out_width, out_height, out_channels;
+        // floats between adjacent pixels which includes the channel padding
+        int in_stride;
+        int out_stride;
+        std::vector<float> weights; // output channels padded to out_stride
+        std::vector<float> biases;  // (out_stride)
+        // picked when loading so that layers with common shapes use specialised loops
+        LayerKernel kernel;
+    };
+    std::vector<Layer> m_layers;
+    size_t m_width;
+    size_t m_height;
+    size_t m_channels;
+    size_t m_max_batch_size;
+    size_t m_batch_size;
+    std::vector<float> m_input_buffer; // (max_batch_size,H,W,C)
+    // layers alternate between these
+    std::vector<float> m_activations[2];
+    std::vector<Prediction> m_predictions; // (max_batch_size)
+public:
+    explicit NativeModel(const char* filepath, const size_t max_batch_size=1);
+    InputBuffer GetInputBuffer() override {
+        return InputBuffer {
+            m_input_buffer.data(),
+            m_width,
+            m_height,
+        };
+    }
+    void Parse() override;
+    Prediction GetPrediction() override { return m_predictions[0]; }
+    void PrintSummary() override;
+    size_t GetMaxBatchSize() override { return m_max_batch_size; }
+    void SetBatchSize(const size_t batch_size) override;
+    Prediction GetBatchPrediction(const size_t index) override { return m_predictions[index]; }
+private:
+    static LayerKernel SelectKernel(const Layer& layer);
+    // template arguments of 0 are read from the layer at runtime
+    template <int K, int C>
+    static void RunConv2D(const Layer& layer, const float* src, float* dst);
+    template <int K>
+    static void RunDepthwiseConv2D(const Layer& layer, const float* src, float* dst);
+    template <int K>
+    static void RunMaxPool2D(const Layer& layer, const float* src, float* dst);
+    static void RunDense(const Layer& layer, const float* src, float* dst);
+};
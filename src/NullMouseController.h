@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+#include "IMouseController.h"
+
+// Discards mouse events so the player can run headless
+class NullMouseController: public IMouseController
+{
+private:
+    uint64_t m_total_moves = 0;
+    uint64_t m_total_clicks = 0;
+public:
+    void SetCursorPosition(const int x, const int y) override { m_total_moves++; }
+    void Click(const int x, const int y) override { m_total_clicks++; }
+    uint64_t GetTotalMoves() const { return m_total_moves; }
+    uint64_t GetTotalClicks() const { return m_total_clicks; }
+};
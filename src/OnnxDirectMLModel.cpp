@@ -2,20 +2,42 @@
 
 #include <onnxruntime_c_api.h>
 #include <onnxruntime_cxx_api.h>
+#if defined(_WIN32)
 #include <dml_provider_factory.h>
+#endif
 #include <cpu_provider_factory.h>
+#include <onnxruntime_session_options_config_keys.h>
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
 
 #include <cstdlib>
+#include <atomic>
+#include <filesystem>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <unordered_map>
 #include <fmt/core.h>
 #include <stdexcept>
 #include <string.h>
 #include <stdio.h>
 #include <inttypes.h>
+#include "Float16.h"
+#include "FrameHash.h"
 
 const char* onnx_data_type_to_str(ONNXTensorElementDataType type);
 
-std::basic_string<wchar_t> create_wchar_string(const char* src) {
+// onnxruntime uses wide strings for filepaths on windows
+#if defined(_WIN32)
+std::basic_string<ORTCHAR_T> create_ort_string(const char* src) {
     const size_t length = strlen(src)+1;
     auto dest = std::vector<wchar_t>(length);
     size_t total_written = 0;
@@ -23,20 +45,142 @@ std::basic_string<wchar_t> create_wchar_string(const char* src) {
     auto res = std::basic_string<wchar_t>(dest.data(), length);
     return res;
 }
+#else
+std::basic_string<ORTCHAR_T> create_ort_string(const char* src) {
+    return std::basic_string<ORTCHAR_T>(src);
+}
+#endif
+
+// Cpu allocator that recycles freed blocks by size so steady state inference never reaches the heap
+// Counts requests and cache misses so we can check that inference is allocation free
+struct OnnxCountingAllocator: public OrtAllocator
+{
+private:
+    // block size is stored in a header in front of the returned pointer
+    static constexpr size_t ALIGNMENT = 64;
+    Ort::MemoryInfo m_memory_info;
+    std::mutex m_mutex;
+    std::unordered_map<size_t, std::vector<void*>> m_free_blocks;
+    std::atomic<uint64_t> m_total_requests {0};
+    std::atomic<uint64_t> m_total_allocations {0};
+    std::atomic<uint64_t> m_total_frees {0};
+    std::atomic<uint64_t> m_total_bytes {0};
+public:
+    OnnxCountingAllocator()
+    : m_memory_info(Ort::MemoryInfo::CreateCpu(OrtAllocatorType::OrtDeviceAllocator, OrtMemType::OrtMemTypeDefault))
+    {
+        OrtAllocator::version = ORT_API_VERSION;
+        OrtAllocator::Alloc = [](OrtAllocator* self, size_t size) {
+            return static_cast<OnnxCountingAllocator*>(self)->Allocate(size);
+        };
+        OrtAllocator::Free = [](OrtAllocator* self, void* ptr) {
+            static_cast<OnnxCountingAllocator*>(self)->Deallocate(ptr);
+        };
+        OrtAllocator::Info = [](const OrtAllocator* self) {
+            return static_cast<const OrtMemoryInfo*>(static_cast<const OnnxCountingAllocator*>(self)->m_memory_info);
+        };
+    }
+    ~OnnxCountingAllocator() {
+        for (auto& [size, blocks]: m_free_blocks) {
+            for (void* block: blocks) {
+                ::operator delete(block, std::align_val_t(ALIGNMENT));
+            }
+        }
+    }
+    OnnxCountingAllocator(const OnnxCountingAllocator&) = delete;
+    OnnxCountingAllocator& operator=(const OnnxCountingAllocator&) = delete;
+
+    void* Allocate(const size_t size) {
+        m_total_requests++;
+        const size_t block_size = ((size + ALIGNMENT - 1) / ALIGNMENT) * ALIGNMENT + ALIGNMENT;
+        void* block = nullptr;
+        {
+            auto lock = std::scoped_lock(m_mutex);
+            auto it = m_free_blocks.find(block_size);
+            if ((it != m_free_blocks.end()) && !it->second.empty()) {
+                block = it->second.back();
+                it->second.pop_back();
+            }
+        }
+        if (block == nullptr) {
+            block = ::operator new(block_size, std::align_val_t(ALIGNMENT));
+            *reinterpret_cast<size_t*>(block) = block_size;
+            m_total_allocations++;
+            m_total_bytes += block_size;
+        }
+        return reinterpret_cast<uint8_t*>(block) + ALIGNMENT;
+    }
+
+    void Deallocate(void* ptr) {
+        if (ptr == nullptr) return;
+        m_total_frees++;
+        void* block = reinterpret_cast<uint8_t*>(ptr) - ALIGNMENT;
+        const size_t block_size = *reinterpret_cast<size_t*>(block);
+        auto lock = std::scoped_lock(m_mutex);
+        m_free_blocks[block_size].push_back(block);
+    }
+
+    OnnxDirectMLModel::AllocatorStats GetStats() const {
+        OnnxDirectMLModel::AllocatorStats stats;
+        stats.total_requests = m_total_requests;
+        stats.total_allocations = m_total_allocations;
+        stats.total_frees = m_total_frees;
+        stats.total_bytes = m_total_bytes;
+        return stats;
+    }
+};
+
+// Creates the worker threads of onnxruntime's thread pools so that they can be pinned
+struct OnnxThreadScheduler
+{
+    ThreadSchedule schedule;
+    std::atomic<size_t> total_threads {0};
+
+    static OrtCustomThreadHandle CreateThread(void* options, OrtThreadWorkerFn worker_fn, void* worker_param) {
+        auto* scheduler = reinterpret_cast<OnnxThreadScheduler*>(options);
+        auto schedule = scheduler->schedule;
+        const size_t index = scheduler->total_threads++;
+        if (!schedule.cpus.empty()) {
+            schedule.cpus = { schedule.cpus[index % schedule.cpus.size()] };
+        }
+        auto* thread = new std::thread([schedule, worker_fn, worker_param]() {
+            TrySetCurrentThreadSchedule(schedule, "onnx worker");
+            worker_fn(worker_param);
+        });
+        return reinterpret_cast<OrtCustomThreadHandle>(thread);
+    }
+
+    static void JoinThread(OrtCustomThreadHandle handle) {
+        auto* thread = reinterpret_cast<std::thread*>(const_cast<OrtCustomHandleType*>(handle));
+        thread->join();
+        delete thread;
+    }
+};
 
 OnnxDirectMLModel::OnnxDirectMLModel(const char* filepath, OnnxDirectMLModel::GPU_Options opts) 
 : m_ort_api(Ort::GetApi())
 {
+#if defined(_WIN32)
     m_env = std::make_unique<Ort::Env>(ORT_LOGGING_LEVEL_WARNING, "onnx-directml-gpu");
     m_session_options.SetExecutionMode(ExecutionMode::ORT_SEQUENTIAL);
     ORT_ABORT_ON_ERROR(OrtSessionOptionsAppendExecutionProvider_DML(m_session_options, opts.device_id));
-    InitModel(filepath);
+    // NOTE: DirectML compiles fused partitions of the graph which can't be saved so there is no cache
+    InitModel(filepath, opts.max_batch_size, "");
+#else
+    throw std::runtime_error("DirectML execution provider is only available on windows");
+#endif
 }
 
 OnnxDirectMLModel::OnnxDirectMLModel(const char* filepath, OnnxDirectMLModel::CPU_Options opts)
 : m_ort_api(Ort::GetApi())
 {
     m_env = std::make_unique<Ort::Env>(ORT_LOGGING_LEVEL_WARNING, "onnx-cpu");
+    if (opts.is_count_allocations) {
+        // NOTE: Sessions only use allocators registered on the environment when asked to
+        m_counting_allocator = std::make_unique<OnnxCountingAllocator>();
+        Ort::ThrowOnError(m_ort_api.RegisterAllocator(*m_env, m_counting_allocator.get()));
+        m_session_options.AddConfigEntry(kOrtSessionOptionsConfigUseEnvAllocators, "1");
+    }
     if (opts.total_threads != 0) {
         m_session_options.SetIntraOpNumThreads(opts.total_threads);
     }
@@ -45,15 +189,143 @@ OnnxDirectMLModel::OnnxDirectMLModel(const char* filepath, OnnxDirectMLModel::CP
     } else {
         m_session_options.SetExecutionMode(ExecutionMode::ORT_PARALLEL);
     }
-    InitModel(filepath);
+    // NOTE: The thread calling Run() also does intra op work so it should be pinned by the caller
+    if (!opts.worker_schedule.IsDefault()) {
+        m_thread_scheduler = std::make_unique<OnnxThreadScheduler>();
+        m_thread_scheduler->schedule = opts.worker_schedule;
+        m_session_options.SetCustomCreateThreadFn(&OnnxThreadScheduler::CreateThread);
+        m_session_options.SetCustomThreadCreationOptions(m_thread_scheduler.get());
+        m_session_options.SetCustomJoinThreadFn(&OnnxThreadScheduler::JoinThread);
+    }
+    InitModel(filepath, opts.max_batch_size, opts.cache_directory);
 }
 
-OnnxDirectMLModel::~OnnxDirectMLModel() {}
+OnnxDirectMLModel::~OnnxDirectMLModel() {
+    // release everything that can hold memory from our allocator before it is unregistered
+    m_bindings.clear();
+    m_session = nullptr;
+    m_model_file = nullptr;
+    if (m_counting_allocator != nullptr) {
+        OrtStatus* status = m_ort_api.UnregisterAllocator(*m_env, m_counting_allocator->Info(m_counting_allocator.get()));
+        if (status != nullptr) m_ort_api.ReleaseStatus(status);
+    }
+}
 
-void OnnxDirectMLModel::InitModel(const char* filepath) {
-    auto w_filepath = create_wchar_string(filepath);
+// highest tier of the instruction sets that onnxruntime picks kernels and blocked layouts for
+// NOTE: Graphs optimised with ORT_ENABLE_ALL contain layout transforms for these so they aren't portable
+static const char* get_cpu_isa_tag() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int regs[4] = {0};
+    __cpuid(regs, 0);
+    const int max_leaf = regs[0];
+    __cpuid(regs, 1);
+    const bool has_sse41 = (regs[2] & (1 << 19)) != 0;
+    const bool has_avx = (regs[2] & (1 << 28)) != 0;
+    bool has_avx2 = false;
+    bool has_avx512f = false;
+    bool has_avx512vnni = false;
+    if (max_leaf >= 7) {
+        __cpuidex(regs, 7, 0);
+        has_avx2 = (regs[1] & (1 << 5)) != 0;
+        has_avx512f = (regs[1] & (1 << 16)) != 0;
+        has_avx512vnni = (regs[2] & (1 << 11)) != 0;
+    }
+    if (has_avx512vnni && has_avx512f) return "avx512vnni";
+    if (has_avx512f) return "avx512f";
+    if (has_avx2) return "avx2";
+    if (has_avx) return "avx";
+    if (has_sse41) return "sse41";
+    return "x86";
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512vnni") && __builtin_cpu_supports("avx512f")) return "avx512vnni";
+    if (__builtin_cpu_supports("avx512f")) return "avx512f";
+    if (__builtin_cpu_supports("avx2")) return "avx2";
+    if (__builtin_cpu_supports("avx")) return "avx";
+    if (__builtin_cpu_supports("sse4.1")) return "sse41";
+    return "x86";
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    return "arm64";
+#else
+    return "generic";
+#endif
+}
 
-    m_session = std::make_unique<Ort::Session>(*m_env.get(), w_filepath.c_str(), m_session_options);
+static uint64_t get_process_id() {
+#if defined(_WIN32)
+    return uint64_t(_getpid());
+#else
+    return uint64_t(getpid());
+#endif
+}
+
+void OnnxDirectMLModel::CreateSession(const char* filepath, const std::string& cache_directory) {
+    // NOTE: The model is mapped instead of read so that the page cache is shared between processes
+    auto model_file = std::make_unique<MappedFile>(filepath);
+    if (cache_directory.empty()) {
+        m_session = std::make_unique<Ort::Session>(*m_env.get(), model_file->GetData(), model_file->GetSize(), m_session_options);
+        return;
+    }
+
+    // optimised graphs depend on the model, the runtime version, the execution provider,
+    // the optimisation level and the instruction sets of the cpu they were optimised on
+    // NOTE: Sessions use the default level of ORT_ENABLE_ALL
+    const uint64_t model_hash = GetDataHash(model_file->GetData(), model_file->GetSize());
+    const auto cache_path = std::filesystem::path(cache_directory) /
+        fmt::format("{:016x}-ort{}-cpu-all-{}.ort", model_hash, OrtGetApiBase()->GetVersionString(), get_cpu_isa_tag());
+    m_cache_path = cache_path.string();
+
+    std::error_code error;
+    if (std::filesystem::exists(cache_path, error)) {
+        try {
+            auto cache_file = std::make_unique<MappedFile>(m_cache_path.c_str());
+            auto options = m_session_options.Clone();
+            options.AddConfigEntry(kOrtSessionOptionsConfigLoadModelFormat, "ORT");
+            options.AddConfigEntry(kOrtSessionOptionsConfigUseORTModelBytesDirectly, "1");
+            options.AddConfigEntry(kOrtSessionOptionsConfigUseORTModelBytesForInitializers, "1");
+            // the cached graph was already optimised when it was saved
+            options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_DISABLE_ALL);
+            m_session = std::make_unique<Ort::Session>(*m_env.get(), cache_file->GetData(), cache_file->GetSize(), options);
+            m_model_file = std::move(cache_file);
+            m_is_loaded_from_cache = true;
+            return;
+        } catch (const Ort::Exception& ex) {
+            fprintf(stderr, "Ignoring invalid onnx model cache '%s': %s\n", m_cache_path.c_str(), ex.what());
+        }
+    }
+
+    // NOTE: The optimised model is written to a unique temporary file and renamed into place
+    //       so that other processes starting at the same time never read a partial cache
+    //       The process id keeps it unique between processes and the counter between models of this process
+    static std::atomic<uint64_t> total_temp_files {0};
+    std::filesystem::create_directories(cache_path.parent_path(), error);
+    const auto temp_path = fmt::format("{}.{}-{}.tmp", m_cache_path, get_process_id(), total_temp_files++);
+    const auto ort_temp_path = create_ort_string(temp_path.c_str());
+    try {
+        auto options = m_session_options.Clone();
+        options.AddConfigEntry(kOrtSessionOptionsConfigSaveModelFormat, "ORT");
+        options.SetOptimizedModelFilePath(ort_temp_path.c_str());
+        m_session = std::make_unique<Ort::Session>(*m_env.get(), model_file->GetData(), model_file->GetSize(), options);
+    } catch (const Ort::Exception& ex) {
+        fprintf(stderr, "Failed to save onnx model cache '%s': %s\n", m_cache_path.c_str(), ex.what());
+        std::filesystem::remove(temp_path, error);
+        m_cache_path.clear();
+        m_session = std::make_unique<Ort::Session>(*m_env.get(), model_file->GetData(), model_file->GetSize(), m_session_options);
+        return;
+    }
+    std::filesystem::rename(temp_path, cache_path, error);
+    if (error) {
+        fprintf(stderr, "Failed to write onnx model cache '%s': %s\n", m_cache_path.c_str(), error.message().c_str());
+        std::filesystem::remove(temp_path, error);
+    }
+}
+
+void OnnxDirectMLModel::InitModel(const char* filepath, const size_t max_batch_size, const std::string& cache_directory) {
+    if (max_batch_size == 0) {
+        throw std::runtime_error("Model must have a max batch size of at least 1");
+    }
+
+    CreateSession(filepath, cache_directory);
 
     if (m_session->GetInputCount() != 1) {
         throw std::runtime_error(fmt::format(
@@ -76,6 +348,14 @@ void OnnxDirectMLModel::InitModel(const char* filepath) {
             input_shape.size()
         ));
     }
+    // NOTE: Dynamic axes are given as -1 and models exported without one only take a single input
+    if ((max_batch_size > 1) && (input_shape[0] != -1)) {
+        throw std::runtime_error(fmt::format(
+            "Model has a fixed batch size of {} so it can't run batches of up to {}. "
+            "Export it with a dynamic batch axis.",
+            input_shape[0], max_batch_size
+        ));
+    }
 
     const auto& output_info = m_session->GetOutputTypeInfo(0).GetTensorTypeAndShapeInfo();
     const auto& output_shape = output_info.GetShape();
@@ -101,48 +381,118 @@ void OnnxDirectMLModel::InitModel(const char* filepath) {
     if (output_size != 3) {
         throw std::runtime_error(fmt::format("Model expected 3 outputs (got {})", output_size));
     }
+
+    switch (input_type) {
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT:   m_input_type = InputType::FLOAT32; break;
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16: m_input_type = InputType::FLOAT16; break;
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8:   m_input_type = InputType::UINT8;   break;
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT8:    m_input_type = InputType::INT8;    break;
+    default:
+        throw std::runtime_error(fmt::format(
+            "Model has unsupported input type {}", onnx_data_type_to_str(input_type)));
+    }
+
+    // NOTE: Onnx tensors don't carry quantisation parameters, so integer models whose input
+    //       QuantizeLinear node was stripped can store them in the custom metadata instead
+    m_input_quantization = GetDefaultQuantization(m_input_type);
+    if ((m_input_type == InputType::UINT8) || (m_input_type == InputType::INT8)) {
+        auto metadata = m_session->GetModelMetadata();
+        auto scale = metadata.LookupCustomMetadataMapAllocated("input_scale", m_allocator);
+        auto zero_point = metadata.LookupCustomMetadataMapAllocated("input_zero_point", m_allocator);
+        if (scale != nullptr) m_input_quantization.scale = std::strtof(scale.get(), nullptr);
+        if (zero_point != nullptr) m_input_quantization.zero_point = int32_t(std::strtol(zero_point.get(), nullptr, 10));
+        if (m_input_quantization.scale <= 0.0f) {
+            throw std::runtime_error(fmt::format(
+                "Model has invalid input quantisation scale {}", m_input_quantization.scale));
+        }
+    }
+
+    m_output_type = output_type;
+    if ((output_type != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT) && (output_type != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16)) {
+        throw std::runtime_error(fmt::format(
+            "Model has unsupported output type {}", onnx_data_type_to_str(output_type)));
+    }
     
-    // Allocate buffer and associate it with input tensor
-    m_input_buffer.resize(m_num_pixels);
+    // Allocate buffers for the largest batch
+    m_max_batch_size = max_batch_size;
+    m_batch_size = 1;
+    const size_t input_size = m_num_pixels*m_channels*GetInputTypeSize(m_input_type);
+    m_input_buffer.resize(input_size*m_max_batch_size);
     m_input_shape[0] = 1;
     m_input_shape[1] = input_shape[1];
     m_input_shape[2] = input_shape[2]; 
     m_input_shape[3] = input_shape[3]; 
 
-    auto input_mem_info = Ort::MemoryInfo::CreateCpu(
-        OrtAllocatorType::OrtArenaAllocator, 
-        OrtMemType::OrtMemTypeCPUInput
-    );
-    auto input_tensor = Ort::Value::CreateTensor<float>(
-        input_mem_info, 
-        reinterpret_cast<float*>(m_input_buffer.data()), m_num_pixels*m_channels,
-        m_input_shape, 4
-    );
-    m_input_tensors.emplace_back(std::move(input_tensor));
+    // Output is written into our own buffer instead of a new tensor each run
+    const size_t output_element_size = (output_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16) ? sizeof(uint16_t) : sizeof(float);
+    m_output_buffer.resize(output_size*output_element_size*m_max_batch_size);
+    m_output_shape[0] = 1;
+    m_output_shape[1] = int64_t(output_size);
+    m_predictions.resize(m_max_batch_size);
     
-    // Need to keep track of tensor labels for inference
+    // Names are only needed when binding
     auto input_name = m_session->GetInputNameAllocated(0, m_allocator);
     auto output_name = m_session->GetOutputNameAllocated(0, m_allocator);
     m_input_name = std::string(input_name.get()); 
     m_output_name = std::string(output_name.get()); 
+
+    auto input_mem_info = Ort::MemoryInfo::CreateCpu(
+        OrtAllocatorType::OrtArenaAllocator, 
+        OrtMemType::OrtMemTypeCPUInput
+    );
+    auto output_mem_info = Ort::MemoryInfo::CreateCpu(
+        OrtAllocatorType::OrtArenaAllocator, 
+        OrtMemType::OrtMemTypeDefault
+    );
+    m_bindings.resize(m_max_batch_size);
+    for (size_t i = 0; i < m_max_batch_size; i++) {
+        const size_t batch_size = i+1;
+        int64_t batch_input_shape[4] = { int64_t(batch_size), m_input_shape[1], m_input_shape[2], m_input_shape[3] };
+        int64_t batch_output_shape[2] = { int64_t(batch_size), m_output_shape[1] };
+        auto& binding = m_bindings[i];
+        binding.input_tensor = Ort::Value::CreateTensor(
+            input_mem_info, 
+            m_input_buffer.data(), input_size*batch_size,
+            batch_input_shape, 4,
+            input_type
+        );
+        binding.output_tensor = Ort::Value::CreateTensor(
+            output_mem_info,
+            m_output_buffer.data(), output_size*output_element_size*batch_size,
+            batch_output_shape, 2,
+            output_type
+        );
+        binding.io_binding = std::make_unique<Ort::IoBinding>(*m_session);
+        binding.io_binding->BindInput(m_input_name.c_str(), binding.input_tensor);
+        binding.io_binding->BindOutput(m_output_name.c_str(), binding.output_tensor);
+    }
 }
 
 void OnnxDirectMLModel::Parse() {
-    const char* input_names[1] = { m_input_name.c_str() };
-    const char* output_names[1] = { m_output_name.c_str() };
-
-    auto run_options = Ort::RunOptions { nullptr };
-    auto output_tensors = m_session->Run(
-        run_options, 
-        input_names, m_input_tensors.data(), 1,
-        output_names, 1
-    );
+    m_session->Run(m_run_options, *m_bindings[m_batch_size-1].io_binding);
     
-    const auto& output_tensor = output_tensors[0];
-    const float* output_data = output_tensor.GetTensorData<float>();
-    m_prediction.x = output_data[0];
-    m_prediction.y = output_data[1];
-    m_prediction.confidence = output_data[2];
+    for (size_t i = 0; i < m_batch_size; i++) {
+        auto& prediction = m_predictions[i];
+        if (m_output_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16) {
+            const uint16_t* output_data = &reinterpret_cast<const uint16_t*>(m_output_buffer.data())[i*3];
+            prediction.x = half_to_float(output_data[0]);
+            prediction.y = half_to_float(output_data[1]);
+            prediction.confidence = half_to_float(output_data[2]);
+        } else {
+            const float* output_data = &reinterpret_cast<const float*>(m_output_buffer.data())[i*3];
+            prediction.x = output_data[0];
+            prediction.y = output_data[1];
+            prediction.confidence = output_data[2];
+        }
+    }
+}
+
+void OnnxDirectMLModel::SetBatchSize(const size_t batch_size) {
+    if ((batch_size == 0) || (batch_size > m_max_batch_size)) {
+        throw std::runtime_error(fmt::format(
+            "Model batch size must be between 1 and {} (got {})", m_max_batch_size, batch_size));
+    }
+    m_batch_size = batch_size;
 }
 
 void OnnxDirectMLModel::PrintSummary() {
@@ -160,6 +510,9 @@ void OnnxDirectMLModel::PrintSummary() {
         }
         printf(")\n");
     }
+    if ((m_input_type == InputType::UINT8) || (m_input_type == InputType::INT8)) {
+        printf("    [scale=%g, zero_point=%d]\n", m_input_quantization.scale, int(m_input_quantization.zero_point));
+    }
 
     const size_t total_outputs = m_session->GetOutputCount();
     printf("[outputs: %zu]\n", total_outputs);
@@ -176,6 +529,27 @@ void OnnxDirectMLModel::PrintSummary() {
         printf(")\n");
     }
 
+    if (!m_cache_path.empty()) {
+        printf("[model cache]\n");
+        printf("    %s: %s\n", m_is_loaded_from_cache ? "loaded" : "saved", m_cache_path.c_str());
+    }
+
+    if (m_thread_scheduler != nullptr) {
+        const auto& schedule = m_thread_scheduler->schedule;
+        printf("[worker threads]\n");
+        printf("    created=%zu, cpus=%s, priority=%s\n",
+            m_thread_scheduler->total_threads.load(),
+            schedule.cpus.empty() ? "any" : GetCpuListString(schedule.cpus).c_str(),
+            GetThreadPriorityString(schedule.priority));
+    }
+
+    if (m_counting_allocator != nullptr) {
+        const auto stats = GetAllocatorStats();
+        printf("[cpu allocator]\n");
+        printf("    requests=%" PRIu64 ", heap_allocations=%" PRIu64 ", frees=%" PRIu64 ", bytes=%" PRIu64 "\n",
+            stats.total_requests, stats.total_allocations, stats.total_frees, stats.total_bytes);
+    }
+
     auto providers = Ort::GetAvailableProviders();
     printf("[execution providers: %zu]\n", providers.size());
     for (const auto& provider: providers) {
@@ -183,6 +557,13 @@ void OnnxDirectMLModel::PrintSummary() {
     }
 }
 
+OnnxDirectMLModel::AllocatorStats OnnxDirectMLModel::GetAllocatorStats() const {
+    if (m_counting_allocator == nullptr) {
+        return AllocatorStats{};
+    }
+    return m_counting_allocator->GetStats();
+}
+
 void OnnxDirectMLModel::ORT_ABORT_ON_ERROR(OrtStatus* status) {
     if (status == nullptr) {
         return; 
@@ -4,57 +4,113 @@
 #include <stdint.h>
 #include <vector>
 #include <memory>
+#include <string>
 #include "IModel.h"
+#include "MappedFile.h"
 #include "Prediction.h"
+#include "ThreadSchedule.h"
 
 #include <onnxruntime_c_api.h>
 #include <onnxruntime_cxx_api.h>
 
+struct OnnxCountingAllocator;
+struct OnnxThreadScheduler;
+
 class OnnxDirectMLModel: public IModel
 {
 public:
     struct GPU_Options {
         int device_id = 0;
+        // batches need the model to be exported with a dynamic batch axis
+        size_t max_batch_size = 1;
     };
     struct CPU_Options {
         int total_threads = 0; 
         bool is_sequential = false;
+        // replace the cpu arena with our own caching allocator that counts heap allocations
+        bool is_count_allocations = false;
+        size_t max_batch_size = 1;
+        // directory to keep optimised models in so later sessions skip graph optimisation
+        // cached models are stored in ort format and their weights are used in place from the mapping
+        // so processes that load the same model share the pages. Disabled if empty.
+        std::string cache_directory;
+        // cpus and priority of the intra and inter op worker threads
+        // each worker is pinned to the next cpu in the list so they don't migrate between them
+        ThreadSchedule worker_schedule;
+    };
+    struct AllocatorStats {
+        uint64_t total_requests = 0;    // allocations requested by onnxruntime
+        uint64_t total_allocations = 0; // requests that missed the cache and went to the heap
+        uint64_t total_frees = 0;
+        uint64_t total_bytes = 0;       // currently held from the heap including cached blocks
     };
 private:
+    // NOTE: Must outlive the environment and session that it is registered with
+    std::unique_ptr<OnnxCountingAllocator> m_counting_allocator;
+    // NOTE: Must outlive the session whose thread pools create their workers through it
+    std::unique_ptr<OnnxThreadScheduler> m_thread_scheduler;
     std::unique_ptr<Ort::Env> m_env;
     Ort::SessionOptions m_session_options;
+    // NOTE: Sessions loaded from an ort format cache use the weights in this mapping so it must outlive them
+    std::unique_ptr<MappedFile> m_model_file;
+    std::string m_cache_path;
+    bool m_is_loaded_from_cache = false;
     std::unique_ptr<Ort::Session> m_session;
     Ort::AllocatorWithDefaultOptions m_allocator;
     const OrtApi& m_ort_api;
     
-    std::vector<RGB<float>> m_input_buffer;
+    std::vector<uint8_t> m_input_buffer;
     size_t m_height;
     size_t m_width;
     size_t m_channels;
     size_t m_num_pixels;
+    InputType m_input_type;
+    QuantizationParams m_input_quantization;
+    ONNXTensorElementDataType m_output_type;
     
-    // input/output parameters for execution context
-    std::vector<Ort::Value> m_input_tensors;
+    // input/output tensors are bound once for each batch size so inference doesn't allocate
+    // tensors of a smaller batch are views over the start of the same buffers
+    struct Binding {
+        Ort::Value input_tensor {nullptr};
+        Ort::Value output_tensor {nullptr};
+        std::unique_ptr<Ort::IoBinding> io_binding;
+    };
+    std::vector<uint8_t> m_output_buffer;
+    std::vector<Binding> m_bindings; // index is batch_size-1
     int64_t m_input_shape[4];
+    int64_t m_output_shape[2];
     std::string m_input_name;
     std::string m_output_name;
+    Ort::RunOptions m_run_options;
+    size_t m_max_batch_size;
+    size_t m_batch_size;
 
-    Prediction m_prediction;
+    std::vector<Prediction> m_predictions;
 public:
     OnnxDirectMLModel(const char* filepath, GPU_Options opts);
     OnnxDirectMLModel(const char* filepath, CPU_Options opts);
     ~OnnxDirectMLModel() override;
     InputBuffer GetInputBuffer() override {
-        return InputBuffer {
+        InputBuffer buffer {
             m_input_buffer.data(), 
             m_width,
-            m_height
+            m_height,
+            m_input_type,
         };
+        buffer.quantization = m_input_quantization;
+        return buffer;
     }
     void Parse() override;
-    Prediction GetPrediction() override { return m_prediction; }
+    Prediction GetPrediction() override { return m_predictions[0]; }
     void PrintSummary() override;
+    size_t GetMaxBatchSize() override { return m_max_batch_size; }
+    void SetBatchSize(const size_t batch_size) override;
+    Prediction GetBatchPrediction(const size_t index) override { return m_predictions[index]; }
+    bool IsCountingAllocations() const { return m_counting_allocator != nullptr; }
+    AllocatorStats GetAllocatorStats() const;
+    bool IsLoadedFromCache() const { return m_is_loaded_from_cache; }
 private:
-    void InitModel(const char* filepath);
+    void InitModel(const char* filepath, const size_t max_batch_size, const std::string& cache_directory);
+    void CreateSession(const char* filepath, const std::string& cache_directory);
     void ORT_ABORT_ON_ERROR(OrtStatus* status);
 };
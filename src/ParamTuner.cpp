@@ -0,0 +1,213 @@
+#include "ParamTuner.h"
+
+#include <math.h>
+#include <algorithm>
+#include <stdexcept>
+#include <fmt/core.h>
+
+const char* GetTunedParamString(const TunedParam param) {
+    switch (param) {
+    case TunedParam::ACCELERATION:            return "acceleration";
+    case TunedParam::INPUT_DELAY_SECS:        return "input_delay_secs";
+    case TunedParam::CONFIDENCE_THRESHOLD:    return "confidence_threshold";
+    case TunedParam::MAX_LOST_FRAMES:         return "max_lost_frames";
+    case TunedParam::FALL_SPEED_TRIGGER_SOFT: return "fall_speed_trigger_soft";
+    case TunedParam::HEIGHT_TRIGGER_SOFT:     return "height_trigger_soft";
+    case TunedParam::FALL_SPEED_TRIGGER_HARD: return "fall_speed_trigger_hard";
+    case TunedParam::HEIGHT_TRIGGER_HARD:     return "height_trigger_hard";
+    default:                                  return "unknown";
+    }
+}
+
+float GetTunedParam(const SoccerParams& p, const TunedParam param) {
+    switch (param) {
+    case TunedParam::ACCELERATION:            return p.acceleration;
+    case TunedParam::INPUT_DELAY_SECS:        return p.input_delay_secs;
+    case TunedParam::CONFIDENCE_THRESHOLD:    return p.confidence_threshold;
+    case TunedParam::MAX_LOST_FRAMES:         return float(p.max_lost_frames);
+    case TunedParam::FALL_SPEED_TRIGGER_SOFT: return p.fall_speed_trigger_soft;
+    case TunedParam::HEIGHT_TRIGGER_SOFT:     return p.height_trigger_soft;
+    case TunedParam::FALL_SPEED_TRIGGER_HARD: return p.fall_speed_trigger_hard;
+    case TunedParam::HEIGHT_TRIGGER_HARD:     return p.height_trigger_hard;
+    default: throw std::runtime_error(fmt::format("Invalid tuned param: {}", int(param)));
+    }
+}
+
+void SetTunedParam(SoccerParams& p, const TunedParam param, const float value) {
+    switch (param) {
+    case TunedParam::ACCELERATION:            p.acceleration = value; break;
+    case TunedParam::INPUT_DELAY_SECS:        p.input_delay_secs = value; break;
+    case TunedParam::CONFIDENCE_THRESHOLD:    p.confidence_threshold = value; break;
+    case TunedParam::MAX_LOST_FRAMES:         p.max_lost_frames = int(lroundf(value)); break;
+    case TunedParam::FALL_SPEED_TRIGGER_SOFT: p.fall_speed_trigger_soft = value; break;
+    case TunedParam::HEIGHT_TRIGGER_SOFT:     p.height_trigger_soft = value; break;
+    case TunedParam::FALL_SPEED_TRIGGER_HARD: p.fall_speed_trigger_hard = value; break;
+    case TunedParam::HEIGHT_TRIGGER_HARD:     p.height_trigger_hard = value; break;
+    default: throw std::runtime_error(fmt::format("Invalid tuned param: {}", int(param)));
+    }
+}
+
+ParamTuner::ParamTuner(const Config& config, const EstimatorType estimator_type)
+: m_params(std::make_shared<SoccerParams>()), m_controller(m_params)
+{
+    m_config = config;
+    m_controller.SetEstimator(CreateEstimator(estimator_type, m_params));
+    m_controls.can_track = true;
+    m_controls.can_smart_click = true;
+    m_controls.can_always_click = false;
+    m_controls.can_use_predictor = true;
+}
+
+TuningTrajectory ParamTuner::PrepareTrajectory(const Config& config, const std::string& name, const std::vector<TrajectorySample>& samples) {
+    if ((config.screen_width <= 0) || (config.screen_height <= 0)) {
+        throw std::runtime_error(fmt::format("Tuner requires a positive screen size (got {}x{})", config.screen_width, config.screen_height));
+    }
+    const size_t total_samples = samples.size();
+    const float confidence = config.reference_confidence;
+    TuningTrajectory trajectory;
+    trajectory.name = name;
+
+    // find where each fall starts at the top of its arc and where it ends
+    struct Fall {
+        int64_t start_us;
+        int64_t end_us;
+    };
+    std::vector<Fall> falls;
+    bool has_apex = false;
+    float apex_y = 0.0f;
+    int64_t apex_us = 0;
+    const auto end_fall = [&](const int64_t end_us) {
+        falls.push_back({ has_apex ? apex_us : end_us, end_us });
+        has_apex = false;
+    };
+    // vertical speed of the reference between two samples
+    const auto get_speed = [&](const size_t i0, const float y0, const size_t i1, const float y1) {
+        const int64_t dt_us = samples[i1].time_us - samples[i0].time_us;
+        return (dt_us > 0) ? (y1 - y0) / (float(dt_us) * 1e-6f) : 0.0f;
+    };
+    // the last two samples where the ball was seen
+    bool has_last = false;
+    bool has_before_last = false;
+    size_t last_index = 0;
+    size_t before_last_index = 0;
+    float last_y = 0.0f;
+    float before_last_y = 0.0f;
+    const int64_t loss_us = int64_t(config.loss_secs * 1e6f);
+    const auto is_lost_after_last = [&]() {
+        return has_last && has_before_last &&
+            (last_y < config.fall_end_height) &&
+            (get_speed(before_last_index, before_last_y, last_index, last_y) <= -config.min_fall_speed);
+    };
+    for (size_t i = 0; i < total_samples; i++) {
+        float x, y;
+        if (!GetReferencePosition(samples[i], confidence, x, y)) {
+            if (has_last && is_lost_after_last() && ((samples[i].time_us - samples[last_index].time_us) >= loss_us)) {
+                trajectory.total_losses++;
+                end_fall(samples[last_index].time_us);
+                has_last = false;
+                has_before_last = false;
+            }
+            continue;
+        }
+        // a bounce is the bottom of a fall where the ball goes back up
+        // NOTE: Both neighbours must be seen so a bounce is never also counted as a loss
+        if (has_last && (last_index+1 == i) && has_before_last && (before_last_index+1 == last_index)) {
+            const float fall_speed = get_speed(before_last_index, before_last_y, last_index, last_y);
+            const float rise_speed = get_speed(last_index, last_y, i, y);
+            if ((last_y < config.fall_end_height) && (fall_speed <= -config.min_fall_speed) && (rise_speed >= config.min_fall_speed)) {
+                trajectory.total_bounces++;
+                end_fall(samples[last_index].time_us);
+            }
+        }
+        if (!has_apex || (y > apex_y)) {
+            has_apex = true;
+            apex_y = y;
+            apex_us = samples[i].time_us;
+        }
+        before_last_index = last_index;
+        before_last_y = last_y;
+        has_before_last = has_last;
+        last_index = i;
+        last_y = y;
+        has_last = true;
+    }
+    // the ball could have been lost right before the end
+    if (is_lost_after_last() && ((samples.back().time_us - samples[last_index].time_us) >= loss_us)) {
+        trajectory.total_losses++;
+        end_fall(samples[last_index].time_us);
+    }
+    trajectory.total_falls = int(falls.size());
+
+    // where the ball is when the click for each frame lands and which fall that is in
+    const int64_t land_delay_us = int64_t((config.latency_ms + config.input_latency_ms) * 1000.0f);
+    const float width = float(config.screen_width);
+    const float height = float(config.screen_height);
+    trajectory.observations.resize(total_samples);
+    trajectory.times_us.resize(total_samples);
+    trajectory.land_x.resize(total_samples, 0.0f);
+    trajectory.land_y.resize(total_samples, 0.0f);
+    trajectory.is_land_valid.resize(total_samples, 0);
+    trajectory.fall_indices.resize(total_samples, -1);
+    size_t reference_index = 0;
+    size_t fall_index = 0;
+    for (size_t i = 0; i < total_samples; i++) {
+        const auto& sample = samples[i];
+        trajectory.observations[i] = sample.observation;
+        trajectory.times_us[i] = sample.time_us;
+        const int64_t land_us = sample.time_us + land_delay_us;
+        reference_index = std::max(reference_index, i);
+        float x, y;
+        if (GetReferencePositionAt(samples, confidence, reference_index, land_us, x, y)) {
+            trajectory.land_x[i] = x * width;
+            trajectory.land_y[i] = (1.0f - y) * height;
+            trajectory.is_land_valid[i] = 1;
+        }
+        while ((fall_index < falls.size()) && (falls[fall_index].end_us < land_us)) {
+            fall_index++;
+        }
+        if ((fall_index < falls.size()) && (land_us >= falls[fall_index].start_us)) {
+            trajectory.fall_indices[i] = int32_t(fall_index);
+        }
+    }
+    return trajectory;
+}
+
+TuningScore ParamTuner::Evaluate(const SoccerParams& params, const std::vector<TuningTrajectory>& trajectories) {
+    *m_params = params;
+    const BallController::Screen screen { 0, 0, m_config.screen_width, m_config.screen_height };
+    const int64_t latency_us = int64_t(m_config.latency_ms * 1000.0f);
+    const float radius_sqr = m_config.ball_radius * m_config.ball_radius;
+
+    TuningScore score;
+    for (const auto& trajectory: trajectories) {
+        m_controller.Reset();
+        score.total_falls += trajectory.total_falls;
+        int32_t last_caught = -1;
+        const size_t total_samples = trajectory.observations.size();
+        for (size_t i = 0; i < total_samples; i++) {
+            const int64_t frame_us = trajectory.times_us[i];
+            const auto decision = m_controller.Update(
+                trajectory.observations[i], false, frame_us, frame_us + latency_us, screen, m_controls);
+            if (!decision.is_click) {
+                continue;
+            }
+            score.total_clicks++;
+            const float dx = float(decision.cursor_x) - trajectory.land_x[i];
+            const float dy = float(decision.cursor_y) - trajectory.land_y[i];
+            const bool is_hit = (trajectory.is_land_valid[i] != 0) && ((dx*dx + dy*dy) <= radius_sqr);
+            if (!is_hit) {
+                score.total_misses++;
+                continue;
+            }
+            const int32_t fall = trajectory.fall_indices[i];
+            if ((fall >= 0) && (fall != last_caught)) {
+                score.total_caught++;
+                last_caught = fall;
+            }
+        }
+    }
+    if (score.total_falls > 0) {
+        score.objective = (double(score.total_caught) - double(m_config.miss_penalty)*double(score.total_misses)) / double(score.total_falls);
+    }
+    return score;
+}
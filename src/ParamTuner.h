@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "BallController.h"
+#include "IEstimator.h"
+#include "Prediction.h"
+#include "SoccerParams.h"
+#include "Trajectory.h"
+
+// soccer params that are searched over, the rest are left as given
+enum class TunedParam {
+    ACCELERATION,
+    INPUT_DELAY_SECS,
+    CONFIDENCE_THRESHOLD,
+    MAX_LOST_FRAMES,
+    FALL_SPEED_TRIGGER_SOFT,
+    HEIGHT_TRIGGER_SOFT,
+    FALL_SPEED_TRIGGER_HARD,
+    HEIGHT_TRIGGER_HARD,
+};
+constexpr int TOTAL_TUNED_PARAMS = 8;
+
+const char* GetTunedParamString(const TunedParam param);
+float GetTunedParam(const SoccerParams& params, const TunedParam param);
+// integer params are rounded
+void SetTunedParam(SoccerParams& params, const TunedParam param, const float value);
+
+// Trajectory replayed by the tuner with what every click would have done worked out beforehand
+// Falls of the ball are found from the reference positions. Each one ends when the ball bounces or
+// is lost out of the bottom of the screen, and a click catches a fall if it lands on the ball after
+// the ball starts falling and before the fall ends
+// NOTE: The recorded ball doesn't react to our clicks so only the first catch of each fall counts
+struct TuningTrajectory {
+    std::string name;
+    std::vector<Prediction> observations;
+    std::vector<int64_t> times_us;
+    // where the ball is in screen pixels when a click for each frame lands
+    std::vector<float> land_x;
+    std::vector<float> land_y;
+    std::vector<uint8_t> is_land_valid;
+    // fall that a click for each frame lands in or -1 if the ball isn't falling then
+    std::vector<int32_t> fall_indices;
+    int total_falls = 0;
+    int total_bounces = 0;
+    int total_losses = 0;
+};
+
+// how well a set of params played the trajectories
+struct TuningScore {
+    int total_falls = 0;
+    int total_caught = 0;
+    int total_clicks = 0;
+    // clicks that land outside of the ball
+    int total_misses = 0;
+    double objective = 0.0;
+};
+
+// Replays trajectories through the real estimator and triggers for a set of params
+// Holds its own params and controller so each thread can have one
+class ParamTuner
+{
+public:
+    struct Config {
+        // between the frame being captured and the controller acting on it
+        float latency_ms = 8.0f;
+        // between the controller acting and the click landing which input_delay_secs is an estimate of
+        float input_latency_ms = 20.0f;
+        // window the trajectories were captured from so clicks can be checked in pixels
+        int screen_width = 322;
+        int screen_height = 455;
+        float ball_radius = 41.75f;
+        // observations need this confidence to be used as the reference if there is no ground truth
+        float reference_confidence = 0.5f;
+        // a fall only ends in a bounce or a loss if the ball is below this height
+        float fall_end_height = 0.5f;
+        // the ball must be moving at least this fast in screen heights per second to count as falling or bouncing
+        float min_fall_speed = 0.5f;
+        // the ball is lost if it isn't seen for this long after falling below the fall end height
+        float loss_secs = 0.2f;
+        // each click that misses costs this fraction of a caught fall
+        float miss_penalty = 0.01f;
+    };
+private:
+    Config m_config;
+    std::shared_ptr<SoccerParams> m_params;
+    BallController m_controller;
+    BallController::Controls m_controls;
+public:
+    ParamTuner(const Config& config, const EstimatorType estimator_type);
+    // NOTE: Samples must be in increasing order of time
+    static TuningTrajectory PrepareTrajectory(const Config& config, const std::string& name, const std::vector<TrajectorySample>& samples);
+    // NOTE: Doesn't allocate so it can be called for every candidate without touching the heap
+    TuningScore Evaluate(const SoccerParams& params, const std::vector<TuningTrajectory>& trajectories);
+    const auto& GetConfig() const { return m_config; }
+};
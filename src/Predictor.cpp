@@ -1,23 +1,22 @@
 #include "Predictor.h"
 #include <stdint.h>
-#include <chrono>
 
 Predictor::Predictor(std::shared_ptr<SoccerParams> &params) {
     m_params = params;
+    Reset();
+}
+
+void Predictor::Reset() {
     m_last_time_us = 0;
     m_total_lost_frames = 0;
     m_has_last_prediction = false;
+    m_last_velocity = Velocity { 0.0f, 0.0f };
+    m_last_frame_us = 0;
 }
 
-Predictor::FilteredOutput Predictor::Filter(Prediction pred, float pred_delay_secs) {
-    const auto get_us = []() {
-        auto clock = std::chrono::high_resolution_clock::now(); 
-        return std::chrono::time_point_cast<std::chrono::microseconds>(clock).time_since_epoch().count();
-    };
-
-    int64_t us_now = get_us();
-    int64_t us_frame = us_now - m_last_time_us;
-    m_last_time_us = us_now;
+IEstimator::Output Predictor::Filter(const Prediction& pred, const int64_t frame_us, const int64_t apply_us) {
+    int64_t us_frame = frame_us - m_last_time_us;
+    m_last_time_us = frame_us;
 
     // dt = seconds
     float dt_frame = (float)(us_frame) / 1000000.0f;
@@ -29,10 +28,7 @@ Predictor::FilteredOutput Predictor::Filter(Prediction pred, float pred_delay_se
         if (m_total_lost_frames >= p.max_lost_frames) {
             m_has_last_prediction = false;
         }
-        return FilteredOutput { 
-            Prediction { 0.0f, 0.0f, 0.0f },
-            FilteredOutput::Velocity { 0.0f, 0.0f }
-        };
+        return Output {};
     }
 
     // seed prediction if its missing (we track motion)
@@ -43,37 +39,48 @@ Predictor::FilteredOutput Predictor::Filter(Prediction pred, float pred_delay_se
     }
 
     // calculate velocity
+    // NOTE: Frames with the same timestamp have no motion between them
     auto &last_pred = m_last_prediction;
-    float net_delay_secs = pred_delay_secs + p.input_delay_secs;
-    float vx = (pred.x - last_pred.x) / dt_frame;
-    float vy = (pred.y - last_pred.y) / dt_frame;
+    float net_delay_secs = float(apply_us - frame_us) / 1000000.0f + p.input_delay_secs;
+    float vx = (dt_frame > 0.0f) ? ((pred.x - last_pred.x) / dt_frame) : m_last_velocity.x;
+    float vy = (dt_frame > 0.0f) ? ((pred.y - last_pred.y) / dt_frame) : m_last_velocity.y;
+
+    m_last_prediction = pred;
+    m_last_velocity = Velocity { vx, vy };
+    m_last_frame_us = frame_us;
+    return Project(pred, vx, vy, net_delay_secs);
+}
+
+IEstimator::Output Predictor::Extrapolate(const int64_t apply_us) {
+    if (!m_has_last_prediction || (m_total_lost_frames > 0)) {
+        return Output {};
+    }
+    // the last observation was made this long before the output is used
+    const float dt_elapsed = float(apply_us - m_last_frame_us) / 1000000.0f;
+    const float net_delay_secs = dt_elapsed + m_params->input_delay_secs;
+    const auto velocity = m_last_velocity;
+    return Project(m_last_prediction, velocity.x, velocity.y, net_delay_secs);
+}
+
+IEstimator::Output Predictor::Project(const Prediction& pred, const float vx, const float vy, const float net_delay_secs) const {
+    auto &p = *m_params;
 
     float real_x = pred.x + vx*net_delay_secs;
     float real_y = pred.y + vy*net_delay_secs;
 
     // if ball is moving, then it is under influence of gravity
+    float ay = 0.0f;
     if (vy != 0.0f && vx != 0.0f) {
-        real_y -= p.acceleration * 0.5f * (net_delay_secs * net_delay_secs);
+        ay = -p.acceleration;
+        real_y += ay * 0.5f * (net_delay_secs * net_delay_secs);
     }
 
     // calculate bounce
-    float width_rel = p.relative_ball_width;
-    float radius = width_rel / 2.0f;
-    float right_border = 1.0f-radius;
-    float left_border = radius;
+    real_x = ReflectOffWalls(real_x, p.relative_ball_width);
 
-    // reflect x position off the left or right border
-    if (real_x > right_border) {
-        float delta = real_x - right_border;
-        real_x = right_border - delta;
-    } else if (real_x < left_border) {
-        float delta = left_border - real_x;
-        real_x = left_border + delta;
-    }
-
-    m_last_prediction = pred;
-    return FilteredOutput { 
-        Prediction { real_x, real_y, pred.confidence },
-        FilteredOutput::Velocity { vx, vy }
-    };
+    Output output;
+    output.prediction = Prediction { real_x, real_y, pred.confidence };
+    output.velocity = Velocity { vx, vy };
+    output.time_to_impact = GetTimeToHeight(real_y, vy + ay*net_delay_secs, ay, p.height_trigger_hard);
+    return output;
 }
@@ -1,11 +1,13 @@
 #pragma once
 
+#include "IEstimator.h"
 #include "Prediction.h"
 #include "SoccerParams.h"
 #include <memory>
 #include <stdint.h>
 
-class Predictor
+// Velocity from the difference of consecutive observations
+class Predictor: public IEstimator
 {
 private:
     std::shared_ptr<SoccerParams> m_params;
@@ -15,15 +17,14 @@ private:
 
     Prediction m_last_prediction;
     bool m_has_last_prediction;
-public:
-    struct FilteredOutput {
-        Prediction prediction;
-        struct Velocity {
-            float x = 0.0f;
-            float y = 0.0f;
-        } velocity;
-    };
+    // last confident observation so it can be extrapolated without a new one
+    Velocity m_last_velocity;
+    int64_t m_last_frame_us;
 public:
     Predictor(std::shared_ptr<SoccerParams> &params);
-    FilteredOutput Filter(Prediction pred, float pred_delay_secs);
-};
\ No newline at end of file
+    Output Filter(const Prediction& pred, const int64_t frame_us, const int64_t apply_us) override;
+    Output Extrapolate(const int64_t apply_us) override;
+    void Reset() override;
+private:
+    Output Project(const Prediction& pred, const float vx, const float vy, const float net_delay_secs) const;
+};
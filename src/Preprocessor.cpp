@@ -0,0 +1,391 @@
+#include "Preprocessor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <fmt/core.h>
+#include "Float16.h"
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+struct FilterTaps {
+    int total_taps = 0;
+    std::vector<int32_t> starts;
+    std::vector<int32_t> weights; // (total_outputs, total_taps)
+};
+
+// Triangle filter whose support widens to the scale factor when downscaling
+// Samples outside the image are clamped to the border
+static FilterTaps create_filter_taps(const int total_inputs, const int total_outputs, const int tap_multiple) {
+    const float scale = float(total_inputs) / float(total_outputs);
+    const float radius = std::max(scale, 1.0f);
+
+    std::vector<std::vector<float>> all_weights(total_outputs);
+    std::vector<int32_t> starts(total_outputs);
+    int max_taps = 1;
+    for (int i = 0; i < total_outputs; i++) {
+        const float centre = (float(i) + 0.5f)*scale - 0.5f;
+        const int j_start = int(std::floor(centre - radius));
+        const int j_end = int(std::ceil(centre + radius));
+        const int start = std::clamp(j_start, 0, total_inputs-1);
+        const int end = std::clamp(j_end, 0, total_inputs-1);
+        auto& weights = all_weights[i];
+        weights.resize(end-start+1, 0.0f);
+        for (int j = j_start; j <= j_end; j++) {
+            const float w = 1.0f - std::abs(float(j) - centre)/radius;
+            if (w <= 0.0f) continue;
+            const int k = std::clamp(j, 0, total_inputs-1) - start;
+            weights[k] += w;
+        }
+        starts[i] = start;
+        max_taps = std::max(max_taps, int(weights.size()));
+    }
+
+    FilterTaps taps;
+    taps.total_taps = ((max_taps + tap_multiple - 1) / tap_multiple) * tap_multiple;
+    taps.starts = std::move(starts);
+    taps.weights.resize(size_t(total_outputs)*size_t(taps.total_taps), 0);
+
+    const int32_t weight_sum = 1 << Preprocessor::WEIGHT_BITS;
+    for (int i = 0; i < total_outputs; i++) {
+        const auto& weights = all_weights[i];
+        float total = 0.0f;
+        for (const float w: weights) total += w;
+
+        int32_t* dst = &taps.weights[size_t(i)*size_t(taps.total_taps)];
+        int32_t fixed_total = 0;
+        int k_max = 0;
+        for (int k = 0; k < int(weights.size()); k++) {
+            dst[k] = int32_t(std::round(weights[k]/total * float(weight_sum)));
+            fixed_total += dst[k];
+            if (dst[k] > dst[k_max]) k_max = k;
+        }
+        // NOTE: Rounding errors go into the largest tap so the filter has unity gain
+        dst[k_max] += weight_sum - fixed_total;
+    }
+    return taps;
+}
+
+Preprocessor::Preprocessor() {
+    m_src_width = 0;
+    m_src_height = 0;
+    m_dst_width = 0;
+    m_dst_height = 0;
+    m_filter_row = &Preprocessor::FilterRow<0>;
+    m_filter_columns = &Preprocessor::FilterColumns<0>;
+}
+
+void Preprocessor::UpdateTaps(const int src_width, const int src_height, const int dst_width, const int dst_height) {
+    if ((src_width == m_src_width) && (src_height == m_src_height) &&
+        (dst_width == m_dst_width) && (dst_height == m_dst_height))
+    {
+        return;
+    }
+    m_src_width = src_width;
+    m_src_height = src_height;
+    m_dst_width = dst_width;
+    m_dst_height = dst_height;
+
+    // vertical taps are processed in pairs
+    {
+        const auto taps = create_filter_taps(src_height, dst_height, 2);
+        m_y_taps.total_taps = taps.total_taps;
+        m_y_taps.rows.resize(taps.weights.size());
+        m_y_taps.weights.resize(taps.weights.size());
+        for (int i = 0; i < dst_height; i++) {
+            for (int k = 0; k < taps.total_taps; k++) {
+                const size_t j = size_t(i)*size_t(taps.total_taps) + size_t(k);
+                // padded taps have zero weight but still need to point to a valid row
+                m_y_taps.rows[j] = std::min(taps.starts[i] + k, src_height-1);
+                m_y_taps.weights[j] = int16_t(taps.weights[j]);
+            }
+        }
+    }
+
+    // horizontal taps are processed in groups of 4
+    {
+        const auto taps = create_filter_taps(src_width, dst_width, 4);
+        const int total_taps = taps.total_taps;
+        m_x_taps.total_taps = total_taps;
+        m_x_taps.starts = taps.starts;
+        m_x_taps.weights.resize(size_t(dst_width)*size_t(total_taps)*4);
+        for (int i = 0; i < dst_width; i++) {
+            const int32_t* src = &taps.weights[size_t(i)*size_t(total_taps)];
+            int16_t* dst = &m_x_taps.weights[size_t(i)*size_t(total_taps)*4];
+            for (int k = 0; k < total_taps; k += 2) {
+                for (int c = 0; c < 4; c++) {
+                    dst[k*4 + c*2 + 0] = int16_t(src[k+0]);
+                    dst[k*4 + c*2 + 1] = int16_t(src[k+1]);
+                }
+            }
+        }
+        // padded taps can read past the end of the row
+        m_row_buffer.resize((size_t(src_width) + size_t(total_taps))*4, 0);
+        std::fill(m_row_buffer.begin(), m_row_buffer.end(), int16_t(0));
+        m_pixel_buffer.resize(size_t(dst_width)*4, 0);
+    }
+
+    // downscaling the capture by 1, 2 and 4 for the models from the training scripts
+    switch (m_y_taps.total_taps) {
+    case 4:  m_filter_row = &Preprocessor::FilterRow<4>; break;
+    case 8:  m_filter_row = &Preprocessor::FilterRow<8>; break;
+    case 12: m_filter_row = &Preprocessor::FilterRow<12>; break;
+    default: m_filter_row = &Preprocessor::FilterRow<0>; break;
+    }
+    switch (m_x_taps.total_taps) {
+    case 4:  m_filter_columns = &Preprocessor::FilterColumns<4>; break;
+    case 8:  m_filter_columns = &Preprocessor::FilterColumns<8>; break;
+    case 12: m_filter_columns = &Preprocessor::FilterColumns<12>; break;
+    default: m_filter_columns = &Preprocessor::FilterColumns<0>; break;
+    }
+}
+
+void Preprocessor::Process(const FrameView& frame, InputBuffer dst) {
+    if ((frame.width <= 0) || (frame.height <= 0)) {
+        throw std::runtime_error(fmt::format("Preprocessor got an empty frame ({},{})", frame.width, frame.height));
+    }
+    UpdateTaps(frame.width, frame.height, int(dst.width), int(dst.height));
+    for (int y = 0; y < m_dst_height; y++) {
+        (this->*m_filter_row)(frame, y);
+        (this->*m_filter_columns)();
+        WriteRow(dst, y);
+    }
+}
+
+template <int TOTAL_TAPS>
+void Preprocessor::FilterRow(const FrameView& frame, const int dst_y) {
+    constexpr int SHIFT = WEIGHT_BITS - ROW_BITS;
+    constexpr int32_t ROUND = 1 << (SHIFT-1);
+    constexpr int MAX_TAPS = 64;
+    static_assert((TOTAL_TAPS % 2) == 0, "Vertical taps are processed in pairs");
+
+    const int total_taps = (TOTAL_TAPS > 0) ? TOTAL_TAPS : m_y_taps.total_taps;
+    const int32_t* tap_rows = &m_y_taps.rows[size_t(dst_y)*size_t(total_taps)];
+    const int16_t* tap_weights = &m_y_taps.weights[size_t(dst_y)*size_t(total_taps)];
+    if (total_taps > MAX_TAPS) {
+        throw std::runtime_error(fmt::format("Preprocessor downscale factor is too large ({} taps)", total_taps));
+    }
+
+    const uint8_t* rows[MAX_TAPS];
+    for (int k = 0; k < total_taps; k++) {
+        rows[k] = frame.data + ptrdiff_t(tap_rows[k])*ptrdiff_t(frame.row_stride);
+    }
+
+    const int total_values = m_src_width*4;
+    int16_t* out = m_row_buffer.data();
+    int i = 0;
+
+#if defined(__AVX2__)
+    // unpack and madd interleaves pairs of rows, and packs restores the original order
+    __m256i weight_pairs[MAX_TAPS/2];
+    for (int k = 0; k < total_taps; k += 2) {
+        const int32_t pair = int32_t(uint16_t(tap_weights[k])) | (int32_t(tap_weights[k+1]) << 16);
+        weight_pairs[k/2] = _mm256_set1_epi32(pair);
+    }
+    for (; i+16 <= total_values; i += 16) {
+        __m256i acc_lo = _mm256_set1_epi32(ROUND);
+        __m256i acc_hi = _mm256_set1_epi32(ROUND);
+        for (int k = 0; k < total_taps; k += 2) {
+            const __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k+0] + i)));
+            const __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k+1] + i)));
+            const __m256i w = weight_pairs[k/2];
+            acc_lo = _mm256_add_epi32(acc_lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), w));
+            acc_hi = _mm256_add_epi32(acc_hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), w));
+        }
+        acc_lo = _mm256_srai_epi32(acc_lo, SHIFT);
+        acc_hi = _mm256_srai_epi32(acc_hi, SHIFT);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_packs_epi32(acc_lo, acc_hi));
+    }
+#elif defined(__SSE4_1__)
+    __m128i weight_pairs[MAX_TAPS/2];
+    for (int k = 0; k < total_taps; k += 2) {
+        const int32_t pair = int32_t(uint16_t(tap_weights[k])) | (int32_t(tap_weights[k+1]) << 16);
+        weight_pairs[k/2] = _mm_set1_epi32(pair);
+    }
+    for (; i+8 <= total_values; i += 8) {
+        __m128i acc_lo = _mm_set1_epi32(ROUND);
+        __m128i acc_hi = _mm_set1_epi32(ROUND);
+        for (int k = 0; k < total_taps; k += 2) {
+            const __m128i a = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(rows[k+0] + i)));
+            const __m128i b = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(rows[k+1] + i)));
+            const __m128i w = weight_pairs[k/2];
+            acc_lo = _mm_add_epi32(acc_lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+            acc_hi = _mm_add_epi32(acc_hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+        }
+        acc_lo = _mm_srai_epi32(acc_lo, SHIFT);
+        acc_hi = _mm_srai_epi32(acc_hi, SHIFT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(acc_lo, acc_hi));
+    }
+#elif defined(__ARM_NEON)
+    for (; i+8 <= total_values; i += 8) {
+        int32x4_t acc_lo = vdupq_n_s32(ROUND);
+        int32x4_t acc_hi = vdupq_n_s32(ROUND);
+        for (int k = 0; k < total_taps; k++) {
+            const int16x8_t x = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(rows[k] + i)));
+            acc_lo = vmlal_n_s16(acc_lo, vget_low_s16(x), tap_weights[k]);
+            acc_hi = vmlal_n_s16(acc_hi, vget_high_s16(x), tap_weights[k]);
+        }
+        const int16x4_t lo = vmovn_s32(vshrq_n_s32(acc_lo, SHIFT));
+        const int16x4_t hi = vmovn_s32(vshrq_n_s32(acc_hi, SHIFT));
+        vst1q_s16(out + i, vcombine_s16(lo, hi));
+    }
+#endif
+
+    for (; i < total_values; i++) {
+        int32_t acc = ROUND;
+        for (int k = 0; k < total_taps; k++) {
+            acc += int32_t(rows[k][i]) * int32_t(tap_weights[k]);
+        }
+        out[i] = int16_t(acc >> SHIFT);
+    }
+}
+
+template <int TOTAL_TAPS>
+void Preprocessor::FilterColumns() {
+    static_assert((TOTAL_TAPS % 4) == 0, "Horizontal taps are processed in groups of 4");
+    const int total_taps = (TOTAL_TAPS > 0) ? TOTAL_TAPS : m_x_taps.total_taps;
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+    // (a.c0,a.c1,a.c2,a.c3,b.c0,b.c1,b.c2,b.c3) => (a.c0,b.c0,a.c1,b.c1,...) for madd with tap pairs
+    const __m128i pair_shuffle = _mm_setr_epi8(0,1,8,9, 2,3,10,11, 4,5,12,13, 6,7,14,15);
+#endif
+#if defined(__AVX2__)
+    const __m256i pair_shuffle_x2 = _mm256_broadcastsi128_si256(pair_shuffle);
+#endif
+
+    for (int x = 0; x < m_dst_width; x++) {
+        const int16_t* src = &m_row_buffer[size_t(m_x_taps.starts[x])*4];
+        const int16_t* weights = &m_x_taps.weights[size_t(x)*size_t(total_taps)*4];
+        int32_t* acc = &m_pixel_buffer[size_t(x)*4];
+
+#if defined(__AVX2__)
+        __m256i acc_x2 = _mm256_setzero_si256();
+        for (int k = 0; k < total_taps; k += 4) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + k*4));
+            v = _mm256_shuffle_epi8(v, pair_shuffle_x2);
+            const __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + k*4));
+            acc_x2 = _mm256_add_epi32(acc_x2, _mm256_madd_epi16(v, w));
+        }
+        const __m128i acc_x1 = _mm_add_epi32(_mm256_castsi256_si128(acc_x2), _mm256_extracti128_si256(acc_x2, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc), acc_x1);
+#elif defined(__SSE4_1__)
+        __m128i acc_x1 = _mm_setzero_si128();
+        for (int k = 0; k < total_taps; k += 2) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + k*4));
+            v = _mm_shuffle_epi8(v, pair_shuffle);
+            const __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + k*4));
+            acc_x1 = _mm_add_epi32(acc_x1, _mm_madd_epi16(v, w));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc), acc_x1);
+#elif defined(__ARM_NEON)
+        int32x4_t acc_x1 = vdupq_n_s32(0);
+        for (int k = 0; k < total_taps; k++) {
+            const int16_t w = weights[(k/2)*8 + (k%2)];
+            acc_x1 = vmlal_n_s16(acc_x1, vld1_s16(src + k*4), w);
+        }
+        vst1q_s32(acc, acc_x1);
+#else
+        for (int c = 0; c < 4; c++) {
+            int32_t total = 0;
+            for (int k = 0; k < total_taps; k++) {
+                const int16_t w = weights[(k/2)*8 + (k%2)];
+                total += int32_t(src[k*4 + c]) * int32_t(w);
+            }
+            acc[c] = total;
+        }
+#endif
+    }
+}
+
+// Writes each channel of the filtered row after swapping from BGRA to RGB
+template <typename T, typename F>
+static void store_row(const int32_t* src, InputBuffer dst, const int dst_y, F&& convert) {
+    T* dst_data = reinterpret_cast<T*>(dst.data);
+    const size_t width = dst.width;
+    const size_t total_pixels = dst.width*dst.height;
+    const size_t offset = size_t(dst_y)*width;
+    if (dst.layout == InputLayout::INTERLEAVED) {
+        T* dst_row = &dst_data[offset*3];
+        for (size_t x = 0; x < width; x++) {
+            dst_row[x*3 + 0] = convert(src[x*4 + 2]);
+            dst_row[x*3 + 1] = convert(src[x*4 + 1]);
+            dst_row[x*3 + 2] = convert(src[x*4 + 0]);
+        }
+    } else {
+        for (int c = 0; c < 3; c++) {
+            T* dst_row = &dst_data[offset + size_t(c)*total_pixels];
+            const int32_t* src_channel = &src[2-c];
+            for (size_t x = 0; x < width; x++) {
+                dst_row[x] = convert(src_channel[x*4]);
+            }
+        }
+    }
+}
+
+void Preprocessor::WriteRow(InputBuffer dst, const int dst_y) {
+    // filtered values are in the range [0, 255 << FIXED_BITS]
+    constexpr int FIXED_BITS = ROW_BITS + WEIGHT_BITS;
+    const float scale = 1.0f / (255.0f * float(1 << FIXED_BITS));
+    const int32_t* src = m_pixel_buffer.data();
+
+    switch (dst.type) {
+    case InputType::FLOAT32:
+        store_row<float>(src, dst, dst_y, [scale](const int32_t v) {
+            return float(v) * scale;
+        });
+        return;
+    case InputType::FLOAT16:
+        store_row<uint16_t>(src, dst, dst_y, [scale](const int32_t v) {
+#if defined(__F16C__)
+            return uint16_t(_cvtss_sh(float(v) * scale, 0));
+#else
+            return float_to_half(float(v) * scale);
+#endif
+        });
+        return;
+    case InputType::UINT8:
+    case InputType::INT8:
+        break;
+    default:
+        throw std::runtime_error(fmt::format("Preprocessor got unsupported input type {}", int(dst.type)));
+    }
+
+    const bool is_signed = dst.type == InputType::INT8;
+    const int32_t q_min = is_signed ? -128 : 0;
+    const int32_t q_max = is_signed ? 127 : 255;
+    const int32_t zero_point = dst.quantization.zero_point;
+    const auto quantize = [&](auto&& to_integer) {
+        return [=](const int32_t v) {
+            return std::clamp(to_integer(v) + zero_point, q_min, q_max);
+        };
+    };
+
+    // NOTE: Models quantised with a scale of 1/255 take the pixel value directly
+    //       so we can round off the fractional bits and skip float conversion entirely
+    const bool is_pixel_scale = std::abs(dst.quantization.scale*255.0f - 1.0f) < 1e-4f;
+    if (is_pixel_scale) {
+        const auto to_integer = [](const int32_t v) {
+            return (v + (1 << (FIXED_BITS-1))) >> FIXED_BITS;
+        };
+        if (is_signed) {
+            store_row<int8_t>(src, dst, dst_y, [f = quantize(to_integer)](const int32_t v) { return int8_t(f(v)); });
+        } else {
+            store_row<uint8_t>(src, dst, dst_y, [f = quantize(to_integer)](const int32_t v) { return uint8_t(f(v)); });
+        }
+        return;
+    }
+
+    const float q_scale = scale / dst.quantization.scale;
+    const auto to_integer = [q_scale](const int32_t v) {
+        return int32_t(std::lround(float(v) * q_scale));
+    };
+    if (is_signed) {
+        store_row<int8_t>(src, dst, dst_y, [f = quantize(to_integer)](const int32_t v) { return int8_t(f(v)); });
+    } else {
+        store_row<uint8_t>(src, dst, dst_y, [f = quantize(to_integer)](const int32_t v) { return uint8_t(f(v)); });
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "IFrameSource.h"
+#include "IModel.h"
+
+// Resizes a BGRA8 frame, swaps it to RGB and normalises it in a single pass
+// Writes directly into the model's input buffer so no intermediate image is needed
+// Quantised inputs are written from the fixed point result without going through float
+// Uses a separable triangle filter with fixed point taps that widen when downscaling
+class Preprocessor
+{
+public:
+    // weights sum to this value
+    static constexpr int WEIGHT_BITS = 14;
+    // vertically filtered rows keep this many fractional bits
+    static constexpr int ROW_BITS = 6;
+private:
+    struct VerticalTaps {
+        // padded to an even number of taps so we can process them in pairs
+        int total_taps = 0;
+        std::vector<int32_t> rows;     // (total_outputs, total_taps)
+        std::vector<int16_t> weights;  // (total_outputs, total_taps)
+    };
+    struct HorizontalTaps {
+        // padded to a multiple of 4 taps so we can process them in groups
+        int total_taps = 0;
+        std::vector<int32_t> starts;   // (total_outputs)
+        // weights are expanded so that pairs of taps can be loaded directly into a simd register
+        // (total_outputs, total_taps/2, 4 channels, 2 taps)
+        std::vector<int16_t> weights;
+    };
+
+    int m_src_width;
+    int m_src_height;
+    int m_dst_width;
+    int m_dst_height;
+    VerticalTaps m_y_taps;
+    HorizontalTaps m_x_taps;
+    // filters specialised for the number of taps of the current resize
+    using FilterRowKernel = void (Preprocessor::*)(const FrameView&, const int);
+    using FilterColumnsKernel = void (Preprocessor::*)();
+    FilterRowKernel m_filter_row;
+    FilterColumnsKernel m_filter_columns;
+    // single vertically filtered row in fixed point BGRA
+    std::vector<int16_t> m_row_buffer;
+    // single fully filtered row in fixed point BGRA
+    std::vector<int32_t> m_pixel_buffer;
+public:
+    Preprocessor();
+    // frame rows are written to the model in the order given by the frame view
+    void Process(const FrameView& frame, InputBuffer dst);
+private:
+    void UpdateTaps(const int src_width, const int src_height, const int dst_width, const int dst_height);
+    // TOTAL_TAPS is known at compile time for common resizes so the tap loops are fully unrolled
+    // the generic version with TOTAL_TAPS=0 reads the number of taps at runtime
+    template <int TOTAL_TAPS>
+    void FilterRow(const FrameView& frame, const int dst_y);
+    template <int TOTAL_TAPS>
+    void FilterColumns();
+    void WriteRow(InputBuffer dst, const int dst_y);
+};
@@ -0,0 +1,95 @@
+#include "RawFrameFile.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdexcept>
+#include <fmt/core.h>
+
+static size_t align_size(const size_t x, const size_t alignment) {
+    return ((x + alignment - 1) / alignment) * alignment;
+}
+
+RawFrameWriter::RawFrameWriter(const char* filepath) {
+    m_fp = fopen(filepath, "wb+");
+    if (m_fp == nullptr) {
+        throw std::runtime_error(fmt::format("Failed to open raw frame file for writing: '{}'", filepath));
+    }
+    memset(&m_header, 0, sizeof(m_header));
+    m_is_header_written = false;
+    m_is_failed = false;
+    m_total_frames = 0;
+    m_total_skipped_frames = 0;
+}
+
+RawFrameWriter::~RawFrameWriter() {
+    // NOTE: Buffered frames are only written here so the last of them can still fail
+    if ((fclose(m_fp) != 0) && !m_is_failed) {
+        fprintf(stderr, "Failed to finish writing raw frame file after %llu frames: %s\n",
+            (unsigned long long)m_total_frames, strerror(errno));
+    }
+}
+
+bool RawFrameWriter::Write(const FrameView& frame) {
+    // NOTE: Records after a short write would be misaligned so we stop recording
+    //       The reader ignores the partially written last record
+    if (m_is_failed) {
+        m_total_skipped_frames++;
+        return false;
+    }
+
+    const uint32_t row_stride = uint32_t(frame.width)*4;
+    if (!m_is_header_written) {
+        memcpy(m_header.magic, RAW_FRAME_MAGIC, sizeof(m_header.magic));
+        m_header.version = RAW_FRAME_VERSION;
+        m_header.width = uint32_t(frame.width);
+        m_header.height = uint32_t(frame.height);
+        m_header.row_stride = row_stride;
+        m_header.data_offset = align_size(sizeof(RawFrameHeader), RAW_FRAME_ALIGNMENT);
+        m_header.record_size = uint32_t(align_size(
+            RAW_FRAME_ALIGNMENT + size_t(row_stride)*size_t(frame.height), 
+            RAW_FRAME_ALIGNMENT));
+        static const uint8_t header_padding[RAW_FRAME_ALIGNMENT] = {0};
+        const size_t padding_size = size_t(m_header.data_offset) - sizeof(m_header);
+        bool is_written = true;
+        is_written = is_written && (fwrite(&m_header, sizeof(m_header), 1, m_fp) == 1);
+        is_written = is_written && (fwrite(header_padding, 1, padding_size, m_fp) == padding_size);
+        m_is_header_written = true;
+        if (!is_written) {
+            OnWriteFailed();
+            return false;
+        }
+    }
+
+    if ((uint32_t(frame.width) != m_header.width) || (uint32_t(frame.height) != m_header.height)) {
+        m_total_skipped_frames++;
+        return false;
+    }
+
+    // timestamp is stored at the start of the record and the pixels are aligned after it
+    static const uint8_t padding[RAW_FRAME_ALIGNMENT] = {0};
+    const size_t timestamp_padding_size = RAW_FRAME_ALIGNMENT-sizeof(frame.timestamp_us);
+    bool is_written = true;
+    is_written = is_written && (fwrite(&frame.timestamp_us, sizeof(frame.timestamp_us), 1, m_fp) == 1);
+    is_written = is_written && (fwrite(padding, 1, timestamp_padding_size, m_fp) == timestamp_padding_size);
+    for (int y = 0; is_written && (y < frame.height); y++) {
+        const uint8_t* row = frame.data + y*frame.row_stride;
+        is_written = fwrite(row, 1, row_stride, m_fp) == row_stride;
+    }
+    const size_t total_written = RAW_FRAME_ALIGNMENT + size_t(row_stride)*size_t(frame.height);
+    const size_t record_padding_size = size_t(m_header.record_size) - total_written;
+    is_written = is_written && (fwrite(padding, 1, record_padding_size, m_fp) == record_padding_size);
+    is_written = is_written && (ferror(m_fp) == 0);
+    if (!is_written) {
+        OnWriteFailed();
+        return false;
+    }
+    m_total_frames++;
+    return true;
+}
+
+void RawFrameWriter::OnWriteFailed() {
+    m_is_failed = true;
+    m_total_skipped_frames++;
+    fprintf(stderr, "Failed to write raw frame file after %llu frames, recording stopped: %s\n",
+        (unsigned long long)m_total_frames, strerror(errno));
+}
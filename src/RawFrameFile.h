@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "IFrameSource.h"
+
+// Raw frame recordings are stored as a header followed by fixed size records
+// Each record is a int64_t timestamp followed by the top-down BGRA8 pixels
+// Records are padded so that the pixel data of every frame is aligned
+struct RawFrameHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t row_stride;
+    uint32_t record_size;
+    uint64_t data_offset;
+};
+
+constexpr char RAW_FRAME_MAGIC[4] = {'S','B','R','F'};
+constexpr uint32_t RAW_FRAME_VERSION = 1;
+constexpr size_t RAW_FRAME_ALIGNMENT = 64;
+
+class RawFrameWriter
+{
+private:
+    FILE* m_fp;
+    RawFrameHeader m_header;
+    bool m_is_header_written;
+    // a write came up short so nothing more is recorded
+    bool m_is_failed;
+    uint64_t m_total_frames;
+    uint64_t m_total_skipped_frames;
+public:
+    explicit RawFrameWriter(const char* filepath);
+    ~RawFrameWriter();
+    RawFrameWriter(const RawFrameWriter&) = delete;
+    RawFrameWriter& operator=(const RawFrameWriter&) = delete;
+    // frame size is fixed by the first frame, frames of a different size are skipped
+    // NOTE: If a write fails, e.g. the disk is full, the error is printed and every later frame is skipped
+    bool Write(const FrameView& frame);
+    bool IsFailed() const { return m_is_failed; }
+    uint64_t GetTotalFrames() const { return m_total_frames; }
+    uint64_t GetTotalSkippedFrames() const { return m_total_skipped_frames; }
+private:
+    void OnWriteFailed();
+};
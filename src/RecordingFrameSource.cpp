@@ -0,0 +1,14 @@
+#include "RecordingFrameSource.h"
+
+RecordingFrameSource::RecordingFrameSource(std::shared_ptr<IFrameSource>& source, const char* filepath) {
+    m_source = source;
+    m_writer = std::make_unique<RawFrameWriter>(filepath);
+}
+
+bool RecordingFrameSource::Grab(const int top, const int left) {
+    if (!m_source->Grab(top, left)) {
+        return false;
+    }
+    m_writer->Write(m_source->GetFrame());
+    return true;
+}
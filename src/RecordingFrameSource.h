@@ -0,0 +1,18 @@
+#pragma once
+
+#include <memory>
+#include "IFrameSource.h"
+#include "RawFrameFile.h"
+
+// Passes through frames from another source while saving them for replay
+class RecordingFrameSource: public IFrameSource
+{
+private:
+    std::shared_ptr<IFrameSource> m_source;
+    std::unique_ptr<RawFrameWriter> m_writer;
+public:
+    RecordingFrameSource(std::shared_ptr<IFrameSource>& source, const char* filepath);
+    bool Grab(const int top, const int left) override;
+    FrameView GetFrame() override { return m_source->GetFrame(); }
+    const auto& GetWriter() const { return *m_writer; }
+};
@@ -0,0 +1,98 @@
+#include "ReplayFrameSource.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <stdexcept>
+#include <fmt/core.h>
+
+ReplayFrameSource::ReplayFrameSource(const char* filepath, bool is_loop) {
+    m_file = std::make_unique<MappedFile>(filepath);
+    m_is_loop = is_loop;
+    m_curr_frame = 0;
+    m_total_grabs = 0;
+    m_loop_offset_us = 0;
+
+    if (m_file->GetSize() < sizeof(RawFrameHeader)) {
+        throw std::runtime_error(fmt::format("Raw frame file is too small to have a header: '{}'", filepath));
+    }
+    memcpy(&m_header, m_file->GetData(), sizeof(RawFrameHeader));
+    if (memcmp(m_header.magic, RAW_FRAME_MAGIC, sizeof(m_header.magic)) != 0) {
+        throw std::runtime_error(fmt::format("Raw frame file has an invalid header: '{}'", filepath));
+    }
+    if (m_header.version != RAW_FRAME_VERSION) {
+        throw std::runtime_error(fmt::format(
+            "Raw frame file has version {} but expected {}: '{}'", 
+            m_header.version, RAW_FRAME_VERSION, filepath));
+    }
+    if ((m_header.width == 0) || (m_header.height == 0)) {
+        throw std::runtime_error(fmt::format(
+            "Raw frame file has an invalid frame size {}x{}: '{}'", m_header.width, m_header.height, filepath));
+    }
+    // NOTE: Frames are read with a signed int row stride so it must fit in one
+    if ((uint64_t(m_header.row_stride) < uint64_t(m_header.width)*4) || (m_header.row_stride > uint32_t(INT32_MAX))) {
+        throw std::runtime_error(fmt::format(
+            "Raw frame file has an invalid row stride {} for a width of {}: '{}'", m_header.row_stride, m_header.width, filepath));
+    }
+    if (uint64_t(m_header.record_size) < RAW_FRAME_ALIGNMENT + uint64_t(m_header.row_stride)*uint64_t(m_header.height)) {
+        throw std::runtime_error(fmt::format("Raw frame file has an invalid record size: '{}'", filepath));
+    }
+    if ((m_header.data_offset < sizeof(RawFrameHeader)) || (m_header.data_offset > uint64_t(m_file->GetSize()))) {
+        throw std::runtime_error(fmt::format(
+            "Raw frame file has a data offset of {} outside of its {} bytes: '{}'",
+            m_header.data_offset, m_file->GetSize(), filepath));
+    }
+
+    // NOTE: A recording that was cut short will have a partially written last frame which we ignore
+    m_total_frames = (m_file->GetSize() - size_t(m_header.data_offset)) / size_t(m_header.record_size);
+    if (m_total_frames == 0) {
+        throw std::runtime_error(fmt::format("Raw frame file has no frames: '{}'", filepath));
+    }
+}
+
+bool ReplayFrameSource::Grab(const int top, const int left) {
+    // first grab returns the first frame
+    if (m_total_grabs == 0) {
+        m_total_grabs++;
+        return true;
+    }
+    if ((m_curr_frame+1) >= m_total_frames) {
+        if (!m_is_loop) {
+            return false;
+        }
+        // keep timestamps increasing across loops by adding the duration of the recording
+        const int64_t us_first = GetFrame(0).timestamp_us;
+        const int64_t us_last = GetFrame(m_total_frames-1).timestamp_us;
+        const int64_t us_duration = us_last - us_first;
+        const int64_t us_frame = (m_total_frames > 1) ? (us_duration / int64_t(m_total_frames-1)) : 0;
+        m_loop_offset_us += us_duration + us_frame;
+        m_curr_frame = 0;
+    } else {
+        m_curr_frame++;
+    }
+    m_total_grabs++;
+    return true;
+}
+
+FrameView ReplayFrameSource::GetFrame() {
+    auto frame = GetFrame(m_curr_frame);
+    // NOTE: Looping recordings should still produce unique frame indices
+    frame.frame_index = (m_total_grabs > 0) ? (m_total_grabs-1) : 0;
+    frame.timestamp_us += m_loop_offset_us;
+    return frame;
+}
+
+FrameView ReplayFrameSource::GetFrame(const size_t index) const {
+    const uint8_t* record = 
+        m_file->GetData() + 
+        size_t(m_header.data_offset) + 
+        index*size_t(m_header.record_size);
+
+    FrameView frame;
+    memcpy(&frame.timestamp_us, record, sizeof(frame.timestamp_us));
+    frame.data = record + RAW_FRAME_ALIGNMENT;
+    frame.width = int(m_header.width);
+    frame.height = int(m_header.height);
+    frame.row_stride = int(m_header.row_stride);
+    frame.frame_index = uint64_t(index);
+    return frame;
+}
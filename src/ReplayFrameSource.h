@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include "IFrameSource.h"
+#include "MappedFile.h"
+#include "RawFrameFile.h"
+
+// Replays a raw frame recording directly from a memory mapping without copying
+class ReplayFrameSource: public IFrameSource
+{
+private:
+    std::unique_ptr<MappedFile> m_file;
+    RawFrameHeader m_header;
+    size_t m_total_frames;
+    size_t m_curr_frame;
+    uint64_t m_total_grabs;
+    int64_t m_loop_offset_us;
+    bool m_is_loop;
+public:
+    ReplayFrameSource(const char* filepath, bool is_loop=true);
+    bool Grab(const int top, const int left) override;
+    FrameView GetFrame() override;
+    size_t GetTotalFrames() const { return m_total_frames; }
+    FrameView GetFrame(const size_t index) const;
+};
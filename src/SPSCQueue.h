@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+// Bounded lock free queue for exactly one producer thread and one consumer thread
+// Head and tail live on separate cache lines so the two threads don't false share
+template <typename T>
+class SPSCQueue
+{
+private:
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+    std::vector<T> m_items;
+    size_t m_mask;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_head; // next item to pop, written by consumer
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_tail; // next item to push, written by producer
+public:
+    // capacity is rounded up to a power of two
+    explicit SPSCQueue(const size_t capacity) {
+        size_t total = 1;
+        while (total < capacity) total *= 2;
+        m_items.resize(total);
+        m_mask = total-1;
+        m_head.store(0, std::memory_order_relaxed);
+        m_tail.store(0, std::memory_order_relaxed);
+    }
+    SPSCQueue(const SPSCQueue&) = delete;
+    SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+    // producer only
+    bool TryPush(const T& item) {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        const size_t head = m_head.load(std::memory_order_acquire);
+        if ((tail - head) > m_mask) {
+            return false;
+        }
+        m_items[tail & m_mask] = item;
+        m_tail.store(tail+1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer only
+    bool TryPop(T& item) {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        const size_t tail = m_tail.load(std::memory_order_acquire);
+        if (head == tail) {
+            return false;
+        }
+        item = m_items[head & m_mask];
+        m_head.store(head+1, std::memory_order_release);
+        return true;
+    }
+
+    // approximate when called from a thread that isn't the producer or consumer
+    size_t GetSize() const {
+        const size_t tail = m_tail.load(std::memory_order_acquire);
+        const size_t head = m_head.load(std::memory_order_acquire);
+        return tail - head;
+    }
+    size_t GetCapacity() const { return m_mask+1; }
+};
@@ -0,0 +1,149 @@
+#include "SampleDataset.h"
+
+#include <string.h>
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <fmt/core.h>
+
+static size_t align_size(const size_t x, const size_t alignment) {
+    return ((x + alignment - 1) / alignment) * alignment;
+}
+
+static SampleShardHeader create_header(const int width, const int height, const int total_samples) {
+    if ((width <= 0) || (height <= 0)) {
+        throw std::runtime_error(fmt::format("Sample shard requires a positive image size (got {}x{})", width, height));
+    }
+    if (total_samples <= 0) {
+        throw std::runtime_error(fmt::format("Sample shard requires a positive number of samples (got {})", total_samples));
+    }
+    SampleShardHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SAMPLE_SHARD_MAGIC, sizeof(header.magic));
+    header.version = SAMPLE_SHARD_VERSION;
+    header.width = uint32_t(width);
+    header.height = uint32_t(height);
+    header.channels = SAMPLE_SHARD_CHANNELS;
+    header.total_samples = uint32_t(total_samples);
+    header.labels_offset = align_size(sizeof(SampleShardHeader), SAMPLE_SHARD_ALIGNMENT);
+    header.images_offset = align_size(
+        size_t(header.labels_offset) + sizeof(SampleLabel)*size_t(total_samples),
+        SAMPLE_SHARD_ALIGNMENT);
+    header.image_stride = align_size(size_t(width)*size_t(height)*SAMPLE_SHARD_CHANNELS, SAMPLE_SHARD_ALIGNMENT);
+    return header;
+}
+
+static size_t get_total_size(const SampleShardHeader& header) {
+    return size_t(header.images_offset) + size_t(header.image_stride)*size_t(header.total_samples);
+}
+
+SampleShardWriter::SampleShardWriter(const char* filepath, const int width, const int height, const int total_samples)
+: m_header(create_header(width, height, total_samples)), m_file(filepath, get_total_size(m_header))
+{
+    // NOTE: New files are zero filled so the padding doesn't need to be written
+    memcpy(m_file.GetData(), &m_header, sizeof(m_header));
+}
+
+SampleLabel& SampleShardWriter::GetLabel(const int index) {
+    uint8_t* data = m_file.GetData() + size_t(m_header.labels_offset) + sizeof(SampleLabel)*size_t(index);
+    return *reinterpret_cast<SampleLabel*>(data);
+}
+
+uint8_t* SampleShardWriter::GetImage(const int index) {
+    return m_file.GetData() + size_t(m_header.images_offset) + size_t(m_header.image_stride)*size_t(index);
+}
+
+SampleShardReader::SampleShardReader(const char* filepath) {
+    m_file = std::make_unique<MappedFile>(filepath);
+    const size_t size = m_file->GetSize();
+    if (size < sizeof(SampleShardHeader)) {
+        throw std::runtime_error(fmt::format("Sample shard is too small to have a header: '{}'", filepath));
+    }
+    memcpy(&m_header, m_file->GetData(), sizeof(SampleShardHeader));
+    if (memcmp(m_header.magic, SAMPLE_SHARD_MAGIC, sizeof(m_header.magic)) != 0) {
+        throw std::runtime_error(fmt::format("Sample shard has an invalid header: '{}'", filepath));
+    }
+    if (m_header.version != SAMPLE_SHARD_VERSION) {
+        throw std::runtime_error(fmt::format(
+            "Sample shard has version {} but expected {}: '{}'",
+            m_header.version, SAMPLE_SHARD_VERSION, filepath));
+    }
+    if (m_header.channels != SAMPLE_SHARD_CHANNELS) {
+        throw std::runtime_error(fmt::format(
+            "Sample shard has {} channels but expected {}: '{}'",
+            m_header.channels, SAMPLE_SHARD_CHANNELS, filepath));
+    }
+    // NOTE: Labels are read in place so they have to be aligned
+    const bool is_valid_layout =
+        (m_header.labels_offset >= sizeof(SampleShardHeader)) &&
+        (m_header.labels_offset % alignof(SampleLabel) == 0) &&
+        (m_header.labels_offset + sizeof(SampleLabel)*uint64_t(m_header.total_samples) <= m_header.images_offset) &&
+        (m_header.image_stride >= uint64_t(m_header.width)*uint64_t(m_header.height)*SAMPLE_SHARD_CHANNELS);
+    if (!is_valid_layout) {
+        throw std::runtime_error(fmt::format("Sample shard has an invalid layout: '{}'", filepath));
+    }
+    if (get_total_size(m_header) > size) {
+        throw std::runtime_error(fmt::format(
+            "Sample shard is {} bytes but {} samples need {} bytes: '{}'",
+            size, m_header.total_samples, get_total_size(m_header), filepath));
+    }
+}
+
+const SampleLabel& SampleShardReader::GetLabel(const int index) const {
+    const uint8_t* data = m_file->GetData() + size_t(m_header.labels_offset) + sizeof(SampleLabel)*size_t(index);
+    return *reinterpret_cast<const SampleLabel*>(data);
+}
+
+const uint8_t* SampleShardReader::GetImage(const int index) const {
+    return m_file->GetData() + size_t(m_header.images_offset) + size_t(m_header.image_stride)*size_t(index);
+}
+
+SampleDataset::SampleDataset(const std::string& path) {
+    std::vector<std::string> filepaths;
+    if (std::filesystem::is_directory(path)) {
+        for (const auto& entry: std::filesystem::directory_iterator(path)) {
+            if (entry.is_regular_file() && (entry.path().extension() == ".sbds")) {
+                filepaths.push_back(entry.path().string());
+            }
+        }
+    }
+    if (filepaths.empty()) {
+        throw std::runtime_error(fmt::format("No sample shards were found in: '{}'", path));
+    }
+    std::sort(filepaths.begin(), filepaths.end());
+
+    m_total_samples = 0;
+    for (const auto& filepath: filepaths) {
+        m_shards.emplace_back(filepath.c_str());
+        const auto& header = m_shards.back().GetHeader();
+        if (m_shards.size() == 1) {
+            m_width = int(header.width);
+            m_height = int(header.height);
+        } else if ((int(header.width) != m_width) || (int(header.height) != m_height)) {
+            throw std::runtime_error(fmt::format(
+                "Sample shard '{}' is {}x{} instead of {}x{}",
+                filepath, header.width, header.height, m_width, m_height));
+        }
+        m_offsets.push_back(m_total_samples);
+        m_total_samples += int(header.total_samples);
+    }
+}
+
+const SampleShardReader& SampleDataset::FindShard(const int index, int& shard_sample) const {
+    const auto it = std::upper_bound(m_offsets.begin(), m_offsets.end(), index);
+    const size_t shard_index = size_t(it - m_offsets.begin()) - 1;
+    shard_sample = index - m_offsets[shard_index];
+    return m_shards[shard_index];
+}
+
+const SampleLabel& SampleDataset::GetLabel(const int index) const {
+    int shard_sample = 0;
+    const auto& shard = FindShard(index, shard_sample);
+    return shard.GetLabel(shard_sample);
+}
+
+const uint8_t* SampleDataset::GetImage(const int index) const {
+    int shard_sample = 0;
+    const auto& shard = FindShard(index, shard_sample);
+    return shard.GetImage(shard_sample);
+}
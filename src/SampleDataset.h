@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+// Training samples are stored in shards that are memory mapped and read in place
+// Each shard is a header, the label of every sample and then the top-down RGB8 image of every sample
+// Images are padded so that each one is aligned
+struct SampleShardHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint32_t total_samples;
+    uint64_t labels_offset;
+    uint64_t images_offset;
+    uint64_t image_stride;
+};
+static_assert(sizeof(SampleShardHeader) == 48, "Sample shard header must be packed");
+
+// Bounding box of the ball normalised to the image size, which is zero if there is no ball
+struct SampleLabel {
+    float x_centre;
+    float y_centre;
+    float width;
+    float height;
+    uint32_t has_ball;
+};
+static_assert(sizeof(SampleLabel) == 20, "Sample label must be packed");
+
+constexpr char SAMPLE_SHARD_MAGIC[4] = {'S','B','D','S'};
+constexpr uint32_t SAMPLE_SHARD_VERSION = 1;
+constexpr uint32_t SAMPLE_SHARD_CHANNELS = 3;
+constexpr size_t SAMPLE_SHARD_ALIGNMENT = 64;
+
+// Creates a shard with a fixed number of samples that are written in place
+class SampleShardWriter
+{
+private:
+    // NOTE: The header is laid out before the file is created with its size
+    SampleShardHeader m_header;
+    MappedFileWriter m_file;
+public:
+    SampleShardWriter(const char* filepath, const int width, const int height, const int total_samples);
+    const auto& GetHeader() const { return m_header; }
+    // NOTE: Different samples can be written from different threads at the same time
+    SampleLabel& GetLabel(const int index);
+    uint8_t* GetImage(const int index);
+};
+
+// Reads the samples of a shard in place
+class SampleShardReader
+{
+private:
+    std::unique_ptr<MappedFile> m_file;
+    SampleShardHeader m_header;
+public:
+    explicit SampleShardReader(const char* filepath);
+    const auto& GetHeader() const { return m_header; }
+    int GetTotalSamples() const { return int(m_header.total_samples); }
+    const SampleLabel& GetLabel(const int index) const;
+    const uint8_t* GetImage(const int index) const;
+};
+
+// Every shard in a folder in order of their filenames, same as SampleDataset in scripts/generator/dataset.py
+// NOTE: Every shard must have the same image size
+class SampleDataset
+{
+private:
+    std::vector<SampleShardReader> m_shards;
+    // index of the first sample in each shard
+    std::vector<int> m_offsets;
+    int m_width;
+    int m_height;
+    int m_total_samples;
+public:
+    explicit SampleDataset(const std::string& path);
+    int GetWidth() const { return m_width; }
+    int GetHeight() const { return m_height; }
+    int GetTotalSamples() const { return m_total_samples; }
+    size_t GetTotalShards() const { return m_shards.size(); }
+    const SampleLabel& GetLabel(const int index) const;
+    // top-down RGB8 image with rows that are width*3 bytes apart
+    const uint8_t* GetImage(const int index) const;
+private:
+    const SampleShardReader& FindShard(const int index, int& shard_sample) const;
+};
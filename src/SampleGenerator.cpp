@@ -0,0 +1,619 @@
+#include "SampleGenerator.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <fmt/core.h>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+#define STBI_ONLY_BMP
+#include <stb/stb_image.h>
+#define STB_TRUETYPE_IMPLEMENTATION
+#include <stb/stb_truetype.h>
+
+constexpr float PI = 3.14159265358979f;
+
+static constexpr uint32_t pack_rgba(const uint8_t r, const uint8_t g, const uint8_t b, const uint8_t a) {
+    return uint32_t(r) | (uint32_t(g) << 8) | (uint32_t(b) << 16) | (uint32_t(a) << 24);
+}
+
+constexpr uint8_t BACKGROUND_VALUE = 255;
+// NOTE: PIL writes the colour of a shape drawn on an RGBA image instead of blending it
+//       so the light beams are solid once the alpha is dropped
+constexpr uint32_t LIGHT_BEAM_COLOUR = pack_rgba(255, 241, 192, 10);
+constexpr uint8_t SCORE_COLOURS[TOTAL_SCORE_COLOURS][3] = {
+    { 100, 100, 100 },  // grey
+    {   0, 135, 255 },  // blue
+};
+constexpr int TOTAL_FIREWORK_COLOURS = 4;
+constexpr uint8_t FIREWORK_COLOURS[TOTAL_FIREWORK_COLOURS][3] = {
+    {  86, 213,  77 },  // green
+    { 255, 149, 234 },  // pink
+    { 252, 214,  81 },  // yellow
+    {  79, 228, 255 },  // blue
+};
+
+static void find_spans(SampleImage& image) {
+    image.spans.resize(size_t(image.height));
+    for (int y = 0; y < image.height; y++) {
+        const uint8_t* row = &image.data[size_t(y)*size_t(image.width)*4];
+        int x0 = 0;
+        int x1 = image.width;
+        while ((x0 < x1) && (row[x0*4+3] == 0)) x0++;
+        while ((x1 > x0) && (row[(x1-1)*4+3] == 0)) x1--;
+        image.spans[size_t(y)] = { x0, x1 };
+    }
+}
+
+// dst = (src*alpha + dst*(255-alpha))/255 for every channel with the same rounding as PIL
+static void blend_row(uint8_t* dst, const uint8_t* src, const int total_pixels) {
+    int i = 0;
+#if defined(__AVX2__)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i max_alpha = _mm256_set1_epi16(255);
+        const __m256i round = _mm256_set1_epi16(128);
+        const auto blend = [&](const __m256i s, const __m256i d) {
+            // copy the alpha of each pixel to all four of its channels
+            const __m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, 0xFF), 0xFF);
+            __m256i x = _mm256_mullo_epi16(s, a);
+            x = _mm256_add_epi16(x, _mm256_mullo_epi16(d, _mm256_sub_epi16(max_alpha, a)));
+            x = _mm256_add_epi16(x, round);
+            return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+        };
+        for (; i+8 <= total_pixels; i += 8) {
+            const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i*4));
+            const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i*4));
+            const __m256i lo = blend(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero));
+            const __m256i hi = blend(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(d, zero));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i*4), _mm256_packus_epi16(lo, hi));
+        }
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i max_alpha = _mm_set1_epi16(255);
+        const __m128i round = _mm_set1_epi16(128);
+        const auto blend = [&](const __m128i s, const __m128i d) {
+            const __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xFF), 0xFF);
+            __m128i x = _mm_mullo_epi16(s, a);
+            x = _mm_add_epi16(x, _mm_mullo_epi16(d, _mm_sub_epi16(max_alpha, a)));
+            x = _mm_add_epi16(x, round);
+            return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+        };
+        for (; i+4 <= total_pixels; i += 4) {
+            const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i*4));
+            const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i*4));
+            const __m128i lo = blend(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+            const __m128i hi = blend(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i*4), _mm_packus_epi16(lo, hi));
+        }
+    }
+#elif defined(__ARM_NEON)
+    for (; i+8 <= total_pixels; i += 8) {
+        const uint8x8x4_t s = vld4_u8(src + i*4);
+        uint8x8x4_t d = vld4_u8(dst + i*4);
+        const uint8x8_t a = s.val[3];
+        const uint8x8_t inv_a = vmvn_u8(a);
+        for (int c = 0; c < 4; c++) {
+            uint16x8_t x = vmull_u8(s.val[c], a);
+            x = vmlal_u8(x, d.val[c], inv_a);
+            x = vaddq_u16(x, vdupq_n_u16(128));
+            d.val[c] = vshrn_n_u16(vaddq_u16(x, vshrq_n_u16(x, 8)), 8);
+        }
+        vst4_u8(dst + i*4, d);
+    }
+#endif
+
+    for (; i < total_pixels; i++) {
+        const uint32_t a = src[i*4+3];
+        for (int c = 0; c < 4; c++) {
+            const uint32_t x = uint32_t(src[i*4+c])*a + uint32_t(dst[i*4+c])*(255-a) + 128;
+            dst[i*4+c] = uint8_t((x + (x >> 8)) >> 8);
+        }
+    }
+}
+
+// pastes an image using its own alpha as the mask
+static void paste_image(SampleImage& canvas, const SampleImage& image, const int x, const int y) {
+    const int y0 = std::max(y, 0);
+    const int y1 = std::min(y + image.height, canvas.height);
+    for (int j = y0; j < y1; j++) {
+        const auto& span = image.spans[size_t(j - y)];
+        const int x0 = std::max(x + span.x0, 0);
+        const int x1 = std::min(x + span.x1, canvas.width);
+        if (x0 >= x1) continue;
+        uint8_t* dst = &canvas.data[(size_t(j)*size_t(canvas.width) + size_t(x0))*4];
+        const uint8_t* src = &image.data[(size_t(j - y)*size_t(image.width) + size_t(x0 - x))*4];
+        blend_row(dst, src, x1 - x0);
+    }
+}
+
+// fills the pixels of a row from x_min to x_max inclusive
+static void fill_row(SampleImage& canvas, const int y, const float x_min, const float x_max, const uint32_t colour) {
+    const int x0 = std::max(int(ceilf(x_min)), 0);
+    const int x1 = std::min(int(floorf(x_max)), canvas.width-1);
+    uint8_t* row = &canvas.data[size_t(y)*size_t(canvas.width)*4];
+    for (int x = x0; x <= x1; x++) {
+        memcpy(&row[x*4], &colour, sizeof(colour));
+    }
+}
+
+// NOTE: Like PIL the centre of a pixel is at its integer coordinates
+static void fill_convex_polygon(SampleImage& canvas, const float* xs, const float* ys, const int total_points, const uint32_t colour) {
+    float y_min = ys[0];
+    float y_max = ys[0];
+    for (int i = 1; i < total_points; i++) {
+        y_min = std::min(y_min, ys[i]);
+        y_max = std::max(y_max, ys[i]);
+    }
+    const int y0 = std::max(int(ceilf(y_min)), 0);
+    const int y1 = std::min(int(floorf(y_max)), canvas.height-1);
+    for (int y = y0; y <= y1; y++) {
+        const float yc = float(y);
+        bool is_inside = false;
+        float x_min = 0.0f;
+        float x_max = 0.0f;
+        for (int i = 0; i < total_points; i++) {
+            const int k = (i+1) % total_points;
+            const float xa = xs[i], ya = ys[i];
+            const float xb = xs[k], yb = ys[k];
+            if ((yc < std::min(ya, yb)) || (yc > std::max(ya, yb))) continue;
+            const float xa_cross = (ya == yb) ? xa : (xa + (yc - ya)*(xb - xa)/(yb - ya));
+            const float xb_cross = (ya == yb) ? xb : xa_cross;
+            if (!is_inside) {
+                x_min = std::min(xa_cross, xb_cross);
+                x_max = std::max(xa_cross, xb_cross);
+                is_inside = true;
+            } else {
+                x_min = std::min(x_min, std::min(xa_cross, xb_cross));
+                x_max = std::max(x_max, std::max(xa_cross, xb_cross));
+            }
+        }
+        if (is_inside) {
+            fill_row(canvas, y, x_min, x_max, colour);
+        }
+    }
+}
+
+// bounding box of the ellipse is inclusive like PIL
+static void fill_ellipse(SampleImage& canvas, const int x0, const int y0, const int x1, const int y1, const uint32_t colour) {
+    const float cx = float(x0 + x1) / 2.0f;
+    const float cy = float(y0 + y1) / 2.0f;
+    const float rx = float(x1 - x0 + 1) / 2.0f;
+    const float ry = float(y1 - y0 + 1) / 2.0f;
+    const int row_start = std::max(y0, 0);
+    const int row_end = std::min(y1, canvas.height-1);
+    for (int y = row_start; y <= row_end; y++) {
+        const float dy = (float(y) - cy) / ry;
+        const float half_width = rx * sqrtf(std::max(1.0f - dy*dy, 0.0f));
+        fill_row(canvas, y, cx - half_width, cx + half_width, colour);
+    }
+}
+
+static void draw_line(SampleImage& canvas, const float x0, const float y0, const float x1, const float y1, const float width, const uint32_t colour) {
+    const float dx = x1 - x0;
+    const float dy = y1 - y0;
+    const float length = sqrtf(dx*dx + dy*dy);
+    if (length <= 0.0f) return;
+    const float nx = -dy / length * width / 2.0f;
+    const float ny =  dx / length * width / 2.0f;
+    const float xs[4] = { x0 + nx, x1 + nx, x1 - nx, x0 - nx };
+    const float ys[4] = { y0 + ny, y1 + ny, y1 - ny, y0 - ny };
+    fill_convex_polygon(canvas, xs, ys, 4, colour);
+}
+
+// PIL's nearest neighbour rotation counter clockwise about the centre with transparent corners
+// NOTE: The alpha of the unrotated image is kept since the python generator uses it as the mask
+static void rotate_image(const SampleImage& src, const float degrees, SampleImage& dst) {
+    const float angle = degrees * PI / 180.0f;
+    const float cos_angle = cosf(angle);
+    const float sin_angle = sinf(angle);
+    const float cx = float(src.width) / 2.0f;
+    const float cy = float(src.height) / 2.0f;
+    for (int y = 0; y < src.height; y++) {
+        for (int x = 0; x < src.width; x++) {
+            const float dx = float(x) + 0.5f - cx;
+            const float dy = float(y) + 0.5f - cy;
+            const float x_in = cos_angle*dx - sin_angle*dy + cx;
+            const float y_in = sin_angle*dx + cos_angle*dy + cy;
+            const int ix = int(floorf(x_in));
+            const int iy = int(floorf(y_in));
+            uint8_t* out = &dst.data[(size_t(y)*size_t(src.width) + size_t(x))*4];
+            if ((ix >= 0) && (ix < src.width) && (iy >= 0) && (iy < src.height)) {
+                memcpy(out, &src.data[(size_t(iy)*size_t(src.width) + size_t(ix))*4], 3);
+            } else {
+                memset(out, 0, 3);
+            }
+            out[3] = src.data[(size_t(y)*size_t(src.width) + size_t(x))*4 + 3];
+        }
+    }
+}
+
+SampleImage LoadSampleImage(const char* filepath) {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    uint8_t* data = stbi_load(filepath, &width, &height, &channels, 4);
+    if (data == nullptr) {
+        throw std::runtime_error(fmt::format("Failed to load image '{}': {}", filepath, stbi_failure_reason()));
+    }
+    SampleImage image;
+    image.width = width;
+    image.height = height;
+    image.data.assign(data, data + size_t(width)*size_t(height)*4);
+    stbi_image_free(data);
+    find_spans(image);
+    return image;
+}
+
+static std::vector<uint8_t> read_file(const char* filepath) {
+    FILE* fp = fopen(filepath, "rb");
+    if (fp == nullptr) {
+        throw std::runtime_error(fmt::format("Failed to open file: '{}'", filepath));
+    }
+    std::vector<uint8_t> data;
+    uint8_t block[4096];
+    size_t total_read = 0;
+    while ((total_read = fread(block, 1, sizeof(block), fp)) > 0) {
+        data.insert(data.end(), block, block + total_read);
+    }
+    fclose(fp);
+    return data;
+}
+
+// icons that start with the prefix in order of their name like the python glob
+static std::vector<std::string> find_icons(const std::filesystem::path& directory, const std::string& prefix) {
+    std::vector<std::string> filepaths;
+    for (const auto& entry: std::filesystem::directory_iterator(directory)) {
+        const auto filename = entry.path().filename().string();
+        if ((filename.rfind(prefix, 0) == 0) && (entry.path().extension() == ".png")) {
+            filepaths.push_back(entry.path().string());
+        }
+    }
+    std::sort(filepaths.begin(), filepaths.end());
+    return filepaths;
+}
+
+static void load_digits(SampleAssets& assets, const char* filepath, const float font_size) {
+    const auto font_data = read_file(filepath);
+    stbtt_fontinfo font;
+    if (stbtt_InitFont(&font, font_data.data(), stbtt_GetFontOffsetForIndex(font_data.data(), 0)) == 0) {
+        throw std::runtime_error(fmt::format("Failed to load font: '{}'", filepath));
+    }
+    // PIL sizes fonts by their em square and rounds the ascender up like freetype
+    const float scale = stbtt_ScaleForMappingEmToPixels(&font, font_size);
+    int ascent = 0;
+    int descent = 0;
+    int line_gap = 0;
+    stbtt_GetFontVMetrics(&font, &ascent, &descent, &line_gap);
+    assets.font_ascent = int(ceilf(float(ascent)*scale));
+
+    for (int digit = 0; digit < 10; digit++) {
+        const int codepoint = '0' + digit;
+        auto& glyph = assets.digits[digit];
+        int advance = 0;
+        int left_side_bearing = 0;
+        stbtt_GetCodepointHMetrics(&font, codepoint, &advance, &left_side_bearing);
+        glyph.advance = float(advance)*scale;
+
+        int width = 0;
+        int height = 0;
+        uint8_t* coverage = stbtt_GetCodepointBitmap(&font, scale, scale, codepoint, &width, &height, &glyph.x_offset, &glyph.y_offset);
+        for (int i = 0; i < TOTAL_SCORE_COLOURS; i++) {
+            auto& image = glyph.images[i];
+            image.width = (coverage != nullptr) ? width : 0;
+            image.height = (coverage != nullptr) ? height : 0;
+            image.data.resize(size_t(image.width)*size_t(image.height)*4);
+            for (size_t k = 0; k < size_t(image.width)*size_t(image.height); k++) {
+                memcpy(&image.data[k*4], SCORE_COLOURS[i], 3);
+                image.data[k*4+3] = coverage[k];
+            }
+            find_spans(image);
+        }
+        stbtt_FreeBitmap(coverage, nullptr);
+
+        for (int next = 0; next < 10; next++) {
+            assets.digit_kerning[digit][next] = float(stbtt_GetCodepointKernAdvance(&font, codepoint, '0' + next))*scale;
+        }
+    }
+}
+
+std::shared_ptr<SampleAssets> LoadSampleAssets(const std::string& asset_path, const std::string& ball_filename, const float font_size) {
+    const auto root = std::filesystem::path(asset_path);
+    auto assets = std::make_shared<SampleAssets>();
+    assets->background = LoadSampleImage((root / "icons" / "blank.png").string().c_str());
+    assets->ball = LoadSampleImage((root / "icons" / ball_filename).string().c_str());
+    for (const char* prefix: { "success", "emote" }) {
+        for (const auto& filepath: find_icons(root / "icons", prefix)) {
+            assets->emotes.push_back(LoadSampleImage(filepath.c_str()));
+        }
+    }
+    if (assets->emotes.empty()) {
+        throw std::runtime_error(fmt::format("No emotes were found in: '{}'", (root / "icons").string()));
+    }
+    load_digits(*assets, (root / "fonts" / "segoeuil.ttf").string().c_str(), font_size);
+    return assets;
+}
+
+SampleGenerator::SampleGenerator(std::shared_ptr<const SampleAssets> assets)
+: m_assets(assets)
+{
+    const auto& background = m_assets->background;
+    const auto& ball = m_assets->ball;
+    m_canvas.width = background.width;
+    m_canvas.height = background.height;
+    m_canvas.data.resize(size_t(background.width)*size_t(background.height)*4);
+    m_rotated_ball.width = ball.width;
+    m_rotated_ball.height = ball.height;
+    m_rotated_ball.data.resize(ball.data.size());
+    m_rotated_ball.spans = ball.spans;
+}
+
+int SampleGenerator::GetRandomInt(const int v_min, const int v_max) {
+    return std::uniform_int_distribution<int>(v_min, v_max)(m_rng);
+}
+
+float SampleGenerator::GetRandomUniform(const float v_min, const float v_max) {
+    const float t = std::uniform_real_distribution<float>(0.0f, 1.0f)(m_rng);
+    return v_min + (v_max - v_min)*t;
+}
+
+SampleLabel SampleGenerator::Generate(const uint32_t seed, const uint32_t index) {
+    std::seed_seq seed_sequence { seed, index };
+    m_rng.seed(seed_sequence);
+    memset(m_canvas.data.data(), BACKGROUND_VALUE, m_canvas.data.size());
+
+    int score = GetRandomInt(0, 60);
+    if (GetRandomUniform(0.0f, 1.0f) > 0.5f) {
+        CreateLightBeams();
+    }
+    if (GetRandomUniform(0.0f, 1.0f) > 0.5f) {
+        CreateFireworks();
+    }
+    paste_image(m_canvas, m_assets->background, 0, 0);
+
+    auto score_colour = (GetRandomUniform(0.0f, 1.0f) > 0.5f) ? ScoreColour::GREY : ScoreColour::BLUE;
+    if (score > 30) {
+        score = GetRandomInt(30, 100000);
+        score_colour = ScoreColour::GREY;
+    }
+    CreateScore(score, score_colour);
+
+    SampleLabel label;
+    memset(&label, 0, sizeof(label));
+    if (GetRandomInt(0, 1) == 1) {
+        label = CreateBall();
+    }
+
+    const int total_groups = GetRandomInt(0, 4);
+    for (int i = 0; i < total_groups; i++) {
+        const float group_type = GetRandomUniform(0.0f, 1.0f);
+        if (group_type < 0.3f) {
+            // NOTE: Without a ball these streak from the top left corner like the python generator
+            PopulateEmotes(0, 25, GetStreakedEmotes(label.x_centre, label.y_centre));
+        } else if (group_type < 0.5f) {
+            PopulateEmotes(0, 15, GetLocalScatteredEmotes());
+        } else if (group_type < 0.8f) {
+            PopulateEmotes(0, 10, Rect { 0.0f, 0.0f, 1.0f, 1.0f });
+        }
+    }
+    return label;
+}
+
+void SampleGenerator::CopyToRGB(uint8_t* dst) const {
+    const size_t total_pixels = size_t(m_canvas.width)*size_t(m_canvas.height);
+    const uint8_t* src = m_canvas.data.data();
+    size_t i = 0;
+#if defined(__AVX2__) || defined(__SSSE3__)
+    // pack 4 pixels into the bottom 12 bytes of each vector and join every 4 vectors into 3
+    const __m128i pack_rgb = _mm_setr_epi8(0,1,2, 4,5,6, 8,9,10, 12,13,14, -1,-1,-1,-1);
+    for (; i+16 <= total_pixels; i += 16) {
+        const __m128i a = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i*4 +  0)), pack_rgb);
+        const __m128i b = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i*4 + 16)), pack_rgb);
+        const __m128i c = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i*4 + 32)), pack_rgb);
+        const __m128i d = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i*4 + 48)), pack_rgb);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i*3 +  0), _mm_or_si128(a, _mm_slli_si128(b, 12)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i*3 + 16), _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i*3 + 32), _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+    }
+#elif defined(__ARM_NEON)
+    for (; i+16 <= total_pixels; i += 16) {
+        const uint8x16x4_t rgba = vld4q_u8(src + i*4);
+        const uint8x16x3_t rgb = { rgba.val[0], rgba.val[1], rgba.val[2] };
+        vst3q_u8(dst + i*3, rgb);
+    }
+#endif
+    for (; i < total_pixels; i++) {
+        dst[i*3+0] = src[i*4+0];
+        dst[i*3+1] = src[i*4+1];
+        dst[i*3+2] = src[i*4+2];
+    }
+}
+
+void SampleGenerator::CreateLightBeams() {
+    constexpr int MAX_LIGHT_BEAMS = 5;
+    constexpr float X_OFFSET = 100.0f;
+    constexpr float SPREAD = PI/100.0f;
+    const float width = float(m_canvas.width);
+    const float height = float(m_canvas.height);
+    const float beam_length = width + height;
+    const float y = height - 10.0f;
+
+    const int total_light_beams = GetRandomInt(1, MAX_LIGHT_BEAMS);
+    for (int i = 0; i < total_light_beams; i++) {
+        const bool is_left = GetRandomUniform(0.0f, 1.0f) > 0.5f;
+        const float x = is_left ? -X_OFFSET : (width + X_OFFSET);
+        const float angle = is_left ? GetRandomUniform(-PI/2.0f, 0.0f) : GetRandomUniform(-PI, -PI/2.0f);
+        // far corners are truncated to integers like the python generator
+        const float xs[3] = {
+            x,
+            float(int(x + beam_length*cosf(angle + SPREAD))),
+            float(int(x + beam_length*cosf(angle - SPREAD))),
+        };
+        const float ys[3] = {
+            y,
+            float(int(y + beam_length*sinf(angle + SPREAD))),
+            float(int(y + beam_length*sinf(angle - SPREAD))),
+        };
+        fill_convex_polygon(m_canvas, xs, ys, 3, LIGHT_BEAM_COLOUR);
+    }
+}
+
+void SampleGenerator::CreateFireworks() {
+    constexpr int MAX_FIREWORKS = 5;
+    constexpr int MAX_COLOUR_JITTER = 30;
+    const int total_fireworks = GetRandomInt(1, MAX_FIREWORKS);
+    for (int i = 0; i < total_fireworks; i++) {
+        const int explosion_size = GetRandomInt(10, 60);
+        // NOTE: The colours vary between versions of the game and its tonemap can alter them slightly
+        const auto& base_colour = FIREWORK_COLOURS[GetRandomInt(0, TOTAL_FIREWORK_COLOURS-1)];
+        uint8_t colour[3];
+        for (int c = 0; c < 3; c++) {
+            colour[c] = uint8_t(std::clamp(int(base_colour[c]) + GetRandomInt(-MAX_COLOUR_JITTER, MAX_COLOUR_JITTER), 0, 255));
+        }
+        const int x = GetRandomInt(0, m_canvas.width);
+        const int y = GetRandomInt(0, m_canvas.height);
+        CreateFirework(x, y, explosion_size, pack_rgba(colour[0], colour[1], colour[2], 255));
+    }
+}
+
+void SampleGenerator::CreateFirework(const int x, const int y, const int explosion_size, const uint32_t colour) {
+    constexpr float COLLAPSE_CHANCE = 0.7f;
+    constexpr int TOTAL_LINES = 12;
+    constexpr float STREAK_SIZE = 3.0f;
+
+    const bool is_collapsed = GetRandomUniform(0.0f, 1.0f) < COLLAPSE_CHANCE;
+    if (!is_collapsed) {
+        const int fire_radius = GetRandomInt(0, explosion_size/2);
+        fill_ellipse(m_canvas, x-fire_radius, y-fire_radius, x+fire_radius, y+fire_radius, colour);
+        return;
+    }
+
+    const int fire_radius = GetRandomInt(0, explosion_size/3);
+    const float start_radius = float(explosion_size)/2.0f - float(fire_radius);
+    const float streak_length = float(explosion_size - fire_radius);
+    const float end_radius = start_radius + streak_length;
+    if (float(fire_radius) > float(explosion_size)/10.0f) {
+        fill_ellipse(m_canvas, x-fire_radius, y-fire_radius, x+fire_radius, y+fire_radius, colour);
+    }
+
+    const float delta = 2.0f*PI/float(TOTAL_LINES);
+    float angle = 0.0f;
+    for (int i = 0; i < TOTAL_LINES; i++) {
+        const float x0 = float(int(float(x) + start_radius*cosf(angle)));
+        const float y0 = float(int(float(y) + start_radius*sinf(angle)));
+        const float x1 = float(int(float(x) + end_radius*cosf(angle)));
+        const float y1 = float(int(float(y) + end_radius*sinf(angle)));
+        draw_line(m_canvas, x0, y0, x1, y1, STREAK_SIZE, colour);
+        angle += delta;
+    }
+}
+
+void SampleGenerator::CreateScore(const int score, const ScoreColour colour) {
+    const auto& assets = *m_assets;
+    char text[16];
+    const int total_digits = snprintf(text, sizeof(text), "%d", score);
+
+    // bounding box from the top left of the text like PIL's textbbox
+    int pen_xs[sizeof(text)];
+    int right = 0;
+    int bottom = 0;
+    float pen_x = 0.0f;
+    for (int i = 0; i < total_digits; i++) {
+        const int digit = text[i] - '0';
+        const auto& glyph = assets.digits[digit];
+        pen_xs[i] = int(lroundf(pen_x));
+        right = std::max(right, pen_xs[i] + glyph.x_offset + glyph.images[0].width);
+        bottom = std::max(bottom, assets.font_ascent + glyph.y_offset + glyph.images[0].height);
+        pen_x += glyph.advance;
+        if (i+1 < total_digits) {
+            pen_x += assets.digit_kerning[digit][text[i+1] - '0'];
+        }
+    }
+
+    const int x = int(float(m_canvas.width)/2.0f - float(right)/2.0f);
+    const int y = int(float(m_canvas.height)/5.0f - float(bottom)/2.0f);
+    for (int i = 0; i < total_digits; i++) {
+        const auto& glyph = assets.digits[text[i] - '0'];
+        paste_image(m_canvas, glyph.images[int(colour)], x + pen_xs[i] + glyph.x_offset, y + assets.font_ascent + glyph.y_offset);
+    }
+}
+
+SampleLabel SampleGenerator::CreateBall() {
+    const auto& ball = m_assets->ball;
+    const float background_width = float(m_canvas.width);
+    const float background_height = float(m_canvas.height);
+    const float ball_width = float(ball.width);
+    const float ball_height = float(ball.height);
+
+    // NOTE: The ball can be further out to the sides than in the game for a more varied data set
+    const int x = GetRandomInt(int(-ball_width/2.0f), int(background_width - ball_width/2.0f));
+    const int y = GetRandomInt(int(-ball_height/2.0f), int(background_height - ball_height/2.0f));
+    const int rotation = GetRandomInt(0, 360);
+    rotate_image(ball, float(rotation), m_rotated_ball);
+    paste_image(m_canvas, m_rotated_ball, x, y);
+
+    SampleLabel label;
+    label.x_centre = (float(x) + ball_width/2.0f) / background_width;
+    label.y_centre = (float(y) + ball_height/2.0f) / background_height;
+    label.width = ball_width / background_width;
+    label.height = ball_height / background_height;
+    label.has_ball = 1;
+    return label;
+}
+
+void SampleGenerator::PopulateEmotes(const int min_emotes, const int max_emotes, const Rect& rect) {
+    const auto& emotes = m_assets->emotes;
+    const float width = float(m_canvas.width);
+    const float height = float(m_canvas.height);
+    const float left = rect.left*width;
+    const float right = rect.right*width;
+    const float top = rect.top*height;
+    const float bottom = rect.bottom*height;
+
+    const int total_emotes = GetRandomInt(min_emotes, max_emotes);
+    for (int i = 0; i < total_emotes; i++) {
+        const auto& emote = emotes[size_t(GetRandomInt(0, int(emotes.size())-1))];
+        const int x = int(GetRandomUniform(left, right));
+        const int y = int(GetRandomUniform(top, bottom));
+        paste_image(m_canvas, emote, x, y);
+    }
+}
+
+SampleGenerator::Rect SampleGenerator::GetStreakedEmotes(const float x, const float y) {
+    constexpr float X_OFFSET = 0.1f;
+    constexpr float Y_OFFSET = 0.1f;
+    constexpr float WIDTH = 0.05f;
+    constexpr float HEIGHT = 0.3f;
+    Rect rect;
+    rect.left = x + GetRandomUniform(-X_OFFSET, X_OFFSET);
+    const float y_offset = GetRandomUniform(-Y_OFFSET, Y_OFFSET);
+    rect.top = y + y_offset - GetRandomUniform(0.0f, HEIGHT);
+    rect.left = std::clamp(rect.left, 0.0f, 1.0f);
+    rect.top = std::clamp(rect.top, 0.0f, 1.0f);
+    rect.right = std::clamp(rect.left + GetRandomUniform(0.0f, WIDTH), 0.0f, 1.0f);
+    rect.bottom = std::clamp(rect.top + GetRandomUniform(0.0f, HEIGHT), 0.0f, 1.0f);
+    return rect;
+}
+
+SampleGenerator::Rect SampleGenerator::GetLocalScatteredEmotes() {
+    Rect rect;
+    rect.left = GetRandomUniform(0.0f, 1.0f);
+    rect.top = GetRandomUniform(0.0f, 1.0f);
+    const float width = GetRandomUniform(0.0f, 1.0f);
+    const float height = GetRandomUniform(0.0f, 1.0f);
+    rect.right = std::clamp(rect.left + width, 0.0f, 1.0f);
+    rect.bottom = std::clamp(rect.top + height, 0.0f, 1.0f);
+    return rect;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "SampleDataset.h"
+
+// Top-down RGBA8 image
+struct SampleImage {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> data;
+    // columns [x0,x1) of each row that aren't fully transparent so pasting can skip the rest
+    struct Span {
+        int x0;
+        int x1;
+    };
+    std::vector<Span> spans;
+};
+
+// loads any image as RGBA8 and finds its spans
+SampleImage LoadSampleImage(const char* filepath);
+
+// colours of the score text
+enum class ScoreColour {
+    GREY,
+    BLUE,
+};
+constexpr int TOTAL_SCORE_COLOURS = 2;
+
+// Digit of the score font with its coverage in each of the score colours
+struct SampleGlyph {
+    SampleImage images[TOTAL_SCORE_COLOURS];
+    // from the pen position on the baseline to the top left of the image
+    int x_offset = 0;
+    int y_offset = 0;
+    float advance = 0.0f;
+};
+
+// Everything the samples are made from which is shared read only between generators
+struct SampleAssets {
+    SampleImage background;
+    SampleImage ball;
+    std::vector<SampleImage> emotes;
+    SampleGlyph digits[10];
+    float digit_kerning[10][10];
+    int font_ascent = 0;
+};
+
+// Same assets as the python training scripts
+// Emotes are every icons/success*.png and icons/emote*.png and the score font is fonts/segoeuil.ttf
+std::shared_ptr<SampleAssets> LoadSampleAssets(const std::string& asset_path, const std::string& ball_filename, const float font_size);
+
+// Composites training samples the same way as BasicSampleGenerator in scripts/generator
+// The random choices are made with the same distributions in the same order, and images are blended
+// with the same rounding as PIL
+// NOTE: Shapes are filled at pixel centres so their edges can differ from PIL by a pixel
+class SampleGenerator
+{
+private:
+    struct Rect {
+        float left;
+        float top;
+        float right;
+        float bottom;
+    };
+    std::shared_ptr<const SampleAssets> m_assets;
+    std::mt19937 m_rng;
+    SampleImage m_canvas;
+    SampleImage m_rotated_ball;
+public:
+    explicit SampleGenerator(std::shared_ptr<const SampleAssets> assets);
+    // samples with the same seed and index are the same
+    SampleLabel Generate(const uint32_t seed, const uint32_t index);
+    const SampleImage& GetImage() const { return m_canvas; }
+    // drops the alpha channel like converting the python sample to RGB
+    void CopyToRGB(uint8_t* dst) const;
+private:
+    int GetRandomInt(const int v_min, const int v_max);
+    float GetRandomUniform(const float v_min, const float v_max);
+    void CreateLightBeams();
+    void CreateFireworks();
+    void CreateFirework(const int x, const int y, const int explosion_size, const uint32_t colour);
+    void CreateScore(const int score, const ScoreColour colour);
+    SampleLabel CreateBall();
+    void PopulateEmotes(const int min_emotes, const int max_emotes, const Rect& rect);
+    Rect GetStreakedEmotes(const float x, const float y);
+    Rect GetLocalScatteredEmotes();
+};
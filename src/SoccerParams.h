@@ -1,18 +1,19 @@
 #pragma once
 
+// NOTE: The defaults are the values the gui application starts with and the tools use them unless overridden
 struct SoccerParams {
-    float acceleration;
-    float relative_ball_width;
-    float input_delay_secs; 
-    float confidence_threshold;
+    float acceleration = 2.5f;
+    float relative_ball_width = 0.24f;
+    float input_delay_secs = 0.02f;
+    float confidence_threshold = 0.5f;
     
-    int max_lost_frames;
+    int max_lost_frames = 2;
 
     // height and speed at which we trigger
-    float height_trigger_soft;
-    float fall_speed_trigger_soft;
+    float height_trigger_soft = 0.70f;
+    float fall_speed_trigger_soft = 1.00f;
 
     // speed at which we trigger regardless of height
-    float fall_speed_trigger_hard;
-    float height_trigger_hard;
-};
\ No newline at end of file
+    float fall_speed_trigger_hard = 4.00f;
+    float height_trigger_hard = 0.45f;
+};
@@ -1,202 +1,352 @@
-#include <__msvc_chrono.hpp>
-#define STB_IMAGE_RESIZE_IMPLEMENTATION
-#include "stb/stb_image_resize2.h"
 #include "SoccerPlayer.h"
-#include "util/AutoGui.h"
 #include <chrono>
+#include <stdexcept>
+#include <string.h>
+#include <fmt/core.h>
+#include "FrameHash.h"
 
-int clamp_value(int v, const int v_min, const int v_max) {
+static int clamp_value(int v, const int v_min, const int v_max) {
     if (v < v_min) v = v_min;
     if (v > v_max) v = v_max;
     return v;
 }
 
+static int64_t get_timestamp_us(const std::chrono::high_resolution_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+}
+
 SoccerPlayer::SoccerPlayer(
     std::unique_ptr<IModel>&& model,
-    std::shared_ptr<util::MSS>& mss,
+    std::shared_ptr<IFrameSource>& frame_source,
+    std::shared_ptr<IMouseController>& mouse,
     std::shared_ptr<SoccerParams>& params)
+: m_controller(params), m_pacer(PacingMode::OFF)
 {
     m_model = std::move(model);
-    m_mss = mss;
+    m_frame_source = frame_source;
+    m_mouse = mouse;
     m_params = params;
-    m_predictor = std::make_unique<Predictor>(params);
-    
-    auto in_buffer = m_model->GetInputBuffer();
-    m_resize_buffer_size.x = in_buffer.width;
-    m_resize_buffer_size.y = in_buffer.height;
-    m_resize_buffer.resize(m_resize_buffer_size.x * m_resize_buffer_size.y);
 
-    m_has_prev_filtered_pred = false;
     m_velocity = {0.0f, 0.0f};
+    m_time_to_impact = -1.0f;
+
+    m_roi_model = nullptr;
+    m_roi_width = 0;
+    m_roi_height = 0;
+    m_total_roi_lost_frames = 0;
+    m_total_roi_frames = 0;
+
+    m_last_frame_hash = 0;
+    m_has_last_frame_hash = false;
+    m_last_inferred_hash = 0;
+    m_is_frame_hash_stale = false;
+    m_total_skipped_frames = 0;
     
-    m_timing_index = 0;
-    SetTimingHistoryLength(60*2);
+    m_total_frames = 0;
+    m_is_preview_enabled = false;
 }
 
-void SoccerPlayer::SetTimingHistoryLength(const size_t N) {
-    m_timings.resize(N);
-    if (m_timing_index >= N) {
-        m_timing_index = N-1;
+void SoccerPlayer::SetROIModel(std::unique_ptr<IModel>&& model, const int width, const int height) {
+    if ((width <= 0) || (height <= 0)) {
+        throw std::runtime_error(fmt::format("Region of interest must have a positive size ({},{})", width, height));
     }
+    m_roi_model = std::move(model);
+    m_roi_width = width;
+    m_roi_height = height;
+}
+
+void SoccerPlayer::SetEstimator(std::unique_ptr<IEstimator>&& estimator) {
+    m_controller.SetEstimator(std::move(estimator));
+}
+
+void SoccerPlayer::SetFlightRecorder(std::shared_ptr<FlightRecorder> recorder) {
+    m_flight_recorder = std::move(recorder);
+}
+
+WarmupStats SoccerPlayer::WarmupModels(const int max_iterations) {
+    const auto stats = m_model->Warmup(max_iterations);
+    if (m_roi_model != nullptr) {
+        m_roi_model->Warmup(max_iterations);
+    }
+    return stats;
 }
 
 bool SoccerPlayer::Update(const int top, const int left) {
-    // update the model from the bitmap
+    FrameContext context;
+    const auto frame = CaptureFrame(top, left, context);
+    SelectRegion(context);
+    PreprocessFrame(frame, GetModelInputBuffer(context.is_roi), context);
+    const Prediction raw_pred = RunModel(context);
+    ApplyPrediction(raw_pred, context);
+    return true;
+}
+
+FrameView SoccerPlayer::CaptureFrame(const int top, const int left, FrameContext& context) {
+    m_pacer.WaitForFrame();
+    context.pacer_grab_time = FramePacer::Clock::now();
     const auto dt_grab_start = std::chrono::high_resolution_clock::now();
-    m_mss->Grab(top, left);
+    m_frame_source->Grab(top, left);
+    const auto frame = m_frame_source->GetFrame();
     const auto dt_grab_end = std::chrono::high_resolution_clock::now();
-    
-    const auto dt_resize_start = std::chrono::high_resolution_clock::now();
-    ResizeImage();
-    const auto dt_resize_end = std::chrono::high_resolution_clock::now();
-    
-    const auto dt_convert_start = std::chrono::high_resolution_clock::now();
-    ConvertImage();
-    const auto dt_convert_end = std::chrono::high_resolution_clock::now();
 
-    const auto dt_model_start = std::chrono::high_resolution_clock::now();
-    m_model->Parse();
-    const Prediction raw_pred = m_model->GetPrediction();
-    const auto dt_model_end = std::chrono::high_resolution_clock::now();
-    
-    // Summarise timings
-    Timings timing;
-    timing.us_image_grab = std::chrono::duration_cast<std::chrono::microseconds>(dt_grab_end-dt_grab_start).count();
-    timing.us_image_resize = std::chrono::duration_cast<std::chrono::microseconds>(dt_resize_end-dt_resize_start).count();
-    timing.us_image_convert = std::chrono::duration_cast<std::chrono::microseconds>(dt_convert_end-dt_convert_start).count();
-    timing.us_model_inference = std::chrono::duration_cast<std::chrono::microseconds>(dt_model_end-dt_model_start).count();
-    timing.us_total = std::chrono::duration_cast<std::chrono::microseconds>(dt_model_end-dt_resize_start).count();
-    m_timings[m_timing_index] = timing;
-    m_timing_index = (m_timing_index + 1) % m_timings.size();
-
-    const auto dt_prediction_delay = dt_model_end - dt_grab_end;
-    const int64_t us_prediction_delay = std::chrono::duration_cast<std::chrono::microseconds>(dt_prediction_delay).count();
-    const float sec_prediction_delay = float(us_prediction_delay) / 1e6f;
+    context.frame_index = frame.frame_index;
+    context.top = top;
+    context.left = left;
+    context.width = frame.width;
+    context.height = frame.height;
+    context.grab_start = dt_grab_start;
+    context.grab_end = dt_grab_end;
+    context.timings.us_image_grab = std::chrono::duration_cast<std::chrono::microseconds>(dt_grab_end-dt_grab_start).count();
+    m_latency.Record(LatencyStage::GRAB, dt_grab_end-dt_grab_start);
+    return frame;
+}
 
-    // play soccer
-    const auto filtered_output = m_predictor->Filter(raw_pred, sec_prediction_delay);
-    const Prediction filtered_pred = filtered_output.prediction;
-    m_status.is_tracking = filtered_pred.confidence > m_params->confidence_threshold;
-    UpdateTriggers(filtered_pred, filtered_output.velocity.x, filtered_output.velocity.y);
-    m_status.is_clicking = m_status.is_soft_trigger || m_status.is_hard_trigger;
-
-    if (m_controls.can_track && m_status.is_tracking) {
-        const auto pred = m_controls.can_use_predictor ? filtered_pred : raw_pred;
-        const int screen_x = left + int(      pred.x  * float(m_capture_buffer_size.x));
-        const int screen_y = top  + int((1.0f-pred.y) * float(m_capture_buffer_size.y));
-        
-        // NOTE: We do this to prevent unfocusing the window
-        const int click_padding = m_controls.click_padding;
-        const int click_x = clamp_value(screen_x, left+click_padding, left+m_capture_buffer_size.x-click_padding);
-        const int click_y = clamp_value(screen_y, top+click_padding, top+m_capture_buffer_size.y-click_padding);
-        util::SetCursorPosition(click_x, click_y);
-
-        const bool is_click = (m_controls.can_smart_click && m_status.is_clicking) || m_controls.can_always_click;
-        if (is_click) {
-            util::Click(click_x, click_y, util::MouseButton::LEFT);
-        }
+void SoccerPlayer::SelectRegion(FrameContext& context) {
+    context.is_roi = false;
+    context.roi = Region { 0, 0, context.width, context.height };
+    if ((m_roi_model == nullptr) || !m_controls.can_use_roi) {
+        return;
+    }
+    if ((m_roi_width > context.width) || (m_roi_height > context.height)) {
+        return;
+    }
+    // fall back to searching the full frame if we lost track of the ball
+    const auto& target = m_roi_targets.Read();
+    if (!target.is_valid) {
+        return;
     }
 
-    // update predictions
-    m_raw_pred = raw_pred;
-    m_filtered_pred = Prediction { filtered_pred.x, filtered_pred.y, filtered_pred.confidence };
+    // move the last known position forward to when this frame was captured
+    const float dt = std::chrono::duration<float>(context.grab_end - target.timestamp).count();
+    const float x = target.pred.x + target.velocity.x*dt;
+    float y = target.pred.y + target.velocity.y*dt;
+    // same as the predictor, a moving ball is under the influence of gravity
+    if ((target.velocity.x != 0.0f) && (target.velocity.y != 0.0f)) {
+        y -= m_params->acceleration * 0.5f * (dt*dt);
+    }
+    const int centre_x = int(      x  * float(context.width));
+    const int centre_y = int((1.0f-y) * float(context.height));
 
-    return true;
+    context.is_roi = true;
+    context.roi.width = m_roi_width;
+    context.roi.height = m_roi_height;
+    context.roi.left = clamp_value(centre_x - m_roi_width/2,  0, context.width  - m_roi_width);
+    context.roi.top  = clamp_value(centre_y - m_roi_height/2, 0, context.height - m_roi_height);
 }
 
-void SoccerPlayer::ResizeImage() {
-    auto bitmap = m_mss->GetBitmap();
-    const auto src_size = bitmap.GetSize();
-    m_capture_buffer_size.x = src_size.x;
-    m_capture_buffer_size.y = src_size.y;
-
-    // NOTE: The screenshot buffer can be resized, so we might have to do some cropping
-    const auto buffer_max_size = m_mss->GetMaxSize();
-
-    const int total_channels = 4;
-    const int src_stride = sizeof(uint8_t)*total_channels*buffer_max_size.x;
-    const int dst_stride = sizeof(uint8_t)*total_channels*m_resize_buffer_size.x;
-    const int src_rows_skip = buffer_max_size.y - src_size.y;
-    const int src_bytes_offset = src_rows_skip*src_stride;
-
-    auto &sec = bitmap.GetBitmap();
-    BITMAP &bmp = sec.dsBm;
-    const uint8_t *src_buffer = reinterpret_cast<uint8_t *>(bmp.bmBits);
-    uint8_t *dst_buffer = reinterpret_cast<uint8_t *>(m_resize_buffer.data());
-
-    // resize with quality
-    if ((m_resize_buffer_size.x != src_size.x) || (m_resize_buffer_size.y != src_size.y)) {
-        stbir_resize_uint8_linear(
-            src_buffer+src_bytes_offset, src_size.x, src_size.y, src_stride,
-            dst_buffer, m_resize_buffer_size.x, m_resize_buffer_size.y, dst_stride,
-            STBIR_RGBA
-        );
-    // copy without resizing
+void SoccerPlayer::PreprocessFrame(const FrameView& frame, InputBuffer dst, FrameContext& context) {
+    const auto dt_preprocess_start = std::chrono::high_resolution_clock::now();
+    // the model would give the same result for the same pixels
+    // which happens when we capture faster than the display refreshes or the game is paused
+    context.is_unchanged = false;
+    context.frame_hash = 0;
+    if (m_controls.can_skip_unchanged) {
+        context.frame_hash = GetFrameHash(frame);
+        const bool is_new_frame = !m_has_last_frame_hash || (context.frame_hash != m_last_frame_hash);
+        m_pacer.OnFrame(is_new_frame, context.pacer_grab_time);
+        const bool is_stale = m_is_frame_hash_stale.exchange(false);
+        context.is_unchanged = m_has_last_frame_hash && !is_stale && (context.frame_hash == m_last_frame_hash);
+        m_last_frame_hash = context.frame_hash;
+        m_has_last_frame_hash = true;
     } else {
-        int i_src = src_bytes_offset;
-        int i_dst = 0;
-        for (int y = 0; y < m_resize_buffer_size.y; y++) {
-            std::memcpy(&dst_buffer[i_dst], &src_buffer[i_src], dst_stride);
-            i_src += src_stride;
-            i_dst += dst_stride;
+        // the pacer can't tell new frames apart without the hashes
+        if (m_has_last_frame_hash) {
+            m_pacer.Reset();
         }
+        m_has_last_frame_hash = false;
     }
-}
+    if (context.is_unchanged) {
+        context.is_roi = false;
+        const auto dt_preprocess_end = std::chrono::high_resolution_clock::now();
+        context.preprocess_start = dt_preprocess_start;
+        context.timings.us_image_preprocess = std::chrono::duration_cast<std::chrono::microseconds>(dt_preprocess_end-dt_preprocess_start).count();
+        m_latency.Record(LatencyStage::PREPROCESS, dt_preprocess_end-dt_preprocess_start);
+        return;
+    }
+
+    FrameView region = frame;
+    if (context.is_roi) {
+        const auto& roi = context.roi;
+        region.data = frame.data + ptrdiff_t(roi.top)*ptrdiff_t(frame.row_stride) + ptrdiff_t(roi.left)*4;
+        region.width = roi.width;
+        region.height = roi.height;
+    }
+    // NOTE: The model expects the bottom row of the screen to be the first row of the image
+    //       So we start from the last row and walk upwards
+    FrameView flipped_frame = region;
+    flipped_frame.data = region.data + (region.height-1)*region.row_stride;
+    flipped_frame.row_stride = -region.row_stride;
+    // each preprocessor caches the filter taps for its own input size
+    auto& preprocessor = context.is_roi ? m_roi_preprocessor : m_preprocessor;
+    preprocessor.Process(flipped_frame, dst);
+    const auto dt_preprocess_end = std::chrono::high_resolution_clock::now();
 
-void SoccerPlayer::ConvertImage() {
-    RGB<float> *dst_buffer = m_model->GetInputBuffer().data;
-    const RGBA<uint8_t> *src_buffer = m_resize_buffer.data();
-    const int total_pixels = m_resize_buffer_size.x * m_resize_buffer_size.y;
-    for (int i = 0; i < total_pixels; i++) {
-        dst_buffer[i].r = float(src_buffer[i].b) / 255.0f;
-        dst_buffer[i].g = float(src_buffer[i].g) / 255.0f;
-        dst_buffer[i].b = float(src_buffer[i].r) / 255.0f;
+    context.preprocess_start = dt_preprocess_start;
+    context.timings.us_image_preprocess = std::chrono::duration_cast<std::chrono::microseconds>(dt_preprocess_end-dt_preprocess_start).count();
+    m_latency.Record(LatencyStage::PREPROCESS, dt_preprocess_end-dt_preprocess_start);
+    // NOTE: The frame is only valid until this stage returns so the thumbnail is copied here
+    if (m_flight_recorder != nullptr) {
+        m_flight_recorder->PushFrame(frame);
     }
 }
 
-void SoccerPlayer::UpdateTriggers(Prediction pred, const float vx, const float vy) {
-    auto &p = *(m_params.get());
-    if (pred.confidence < m_params->confidence_threshold) {
-        m_status.is_soft_trigger = false;
-        m_status.is_hard_trigger = false;
-        m_velocity = {0.0f, 0.0f};
-        return;
+Prediction SoccerPlayer::RunModel(FrameContext& context) {
+    if (context.is_unchanged) {
+        // NOTE: If the matching frame was dropped we give the last prediction this once and
+        //       make the preprocessing stage run the model on the next frame
+        if (context.frame_hash != m_last_inferred_hash) {
+            m_is_frame_hash_stale = true;
+        }
+        const auto dt_model_end = std::chrono::high_resolution_clock::now();
+        context.timings.us_model_inference = 0;
+        context.timings.us_total = std::chrono::duration_cast<std::chrono::microseconds>(dt_model_end-context.preprocess_start).count();
+        m_latency.Record(LatencyStage::TOTAL, dt_model_end-context.preprocess_start);
+        return m_last_inferred_pred;
     }
 
-    if (!m_has_prev_filtered_pred) {
-        m_has_prev_filtered_pred = true;
-        m_prev_filtered_pred = pred;
+    const auto dt_model_start = std::chrono::high_resolution_clock::now();
+    auto& model = context.is_roi ? *m_roi_model : *m_model;
+    model.Parse();
+    Prediction raw_pred = model.GetPrediction();
+    if (context.is_roi) {
+        // convert from the crop to the full frame where y is measured upwards from the bottom
+        const auto& roi = context.roi;
+        raw_pred.x = (float(roi.left) + raw_pred.x*float(roi.width)) / float(context.width);
+        raw_pred.y = 1.0f - (float(roi.top) + (1.0f-raw_pred.y)*float(roi.height)) / float(context.height);
     }
+    m_last_inferred_pred = raw_pred;
+    m_last_inferred_hash = context.frame_hash;
+    const auto dt_model_end = std::chrono::high_resolution_clock::now();
 
-    const auto last_pred = m_prev_filtered_pred;
-    m_prev_filtered_pred = pred;
-    m_velocity = {vx, vy};
+    context.timings.us_model_inference = std::chrono::duration_cast<std::chrono::microseconds>(dt_model_end-dt_model_start).count();
+    context.timings.us_total = std::chrono::duration_cast<std::chrono::microseconds>(dt_model_end-context.preprocess_start).count();
+    m_latency.Record(LatencyStage::INFERENCE, dt_model_end-dt_model_start);
+    m_latency.Record(LatencyStage::TOTAL, dt_model_end-context.preprocess_start);
+    if (m_is_preview_enabled) {
+        PublishPreview(context);
+    }
+    return raw_pred;
+}
 
-    // ignore if outside of screen
-    if ((pred.x >= 1.0f) || (pred.x <= 0.0f) || 
-        (pred.y >= 1.0f) || (pred.y <= 0.0f)) 
-    {
-        m_status.is_soft_trigger = false;
-        m_status.is_hard_trigger = false;
-        m_velocity = {0.0f, 0.0f};
-        return;
+void SoccerPlayer::ApplyPrediction(const Prediction& raw_pred, const FrameContext& context) {
+    // account for the delay between the screen being captured and the model finishing
+    // the frame is timestamped by when its grab finished
+    const auto dt_apply = std::chrono::high_resolution_clock::now();
+    const int64_t us_frame = get_timestamp_us(context.grab_end);
+    const int64_t us_apply = get_timestamp_us(dt_apply);
+
+    // play soccer
+    const BallController::Screen screen { context.left, context.top, context.width, context.height };
+    const auto decision = m_controller.Update(raw_pred, context.is_unchanged, us_frame, us_apply, screen, m_controls);
+    const auto& filtered_output = decision.estimate;
+    const Prediction filtered_pred = filtered_output.prediction;
+    m_status = decision.status;
+    m_velocity = { decision.velocity.x, decision.velocity.y };
+    m_time_to_impact = filtered_output.time_to_impact;
+    if (!context.is_unchanged) {
+        UpdateRegionTarget(raw_pred, { filtered_output.velocity.x, filtered_output.velocity.y }, context);
+    }
+    if (decision.is_cursor_moved) {
+        m_mouse->SetCursorPosition(decision.cursor_x, decision.cursor_y);
+        if (decision.is_click) {
+            m_mouse->Click(decision.cursor_x, decision.cursor_y);
+        }
     }
 
-    // falling down and near bottom of screen
-    // or falling down really fast regardless of position
-    if ((vy <= -p.fall_speed_trigger_soft) && (pred.y <= p.height_trigger_soft)) {
-        m_status.is_soft_trigger = true;
-        m_status.is_hard_trigger = false;
-        return;
+    if (m_flight_recorder != nullptr) {
+        FlightEvent event;
+        event.frame_index = context.frame_index;
+        event.grab_us = us_frame;
+        event.apply_us = us_apply;
+        event.raw_x = raw_pred.x;
+        event.raw_y = raw_pred.y;
+        event.raw_confidence = raw_pred.confidence;
+        event.filtered_x = filtered_pred.x;
+        event.filtered_y = filtered_pred.y;
+        event.filtered_confidence = filtered_pred.confidence;
+        event.velocity_x = filtered_output.velocity.x;
+        event.velocity_y = filtered_output.velocity.y;
+        event.time_to_impact = filtered_output.time_to_impact;
+        event.cursor_x = decision.cursor_x;
+        event.cursor_y = decision.cursor_y;
+        event.flags =
+            (m_status.is_tracking     ? FLIGHT_EVENT_TRACKING     : 0u) |
+            (m_status.is_soft_trigger ? FLIGHT_EVENT_SOFT_TRIGGER : 0u) |
+            (m_status.is_hard_trigger ? FLIGHT_EVENT_HARD_TRIGGER : 0u) |
+            (decision.is_cursor_moved ? FLIGHT_EVENT_CURSOR_MOVED : 0u) |
+            (decision.is_click        ? FLIGHT_EVENT_CLICKED      : 0u) |
+            (context.is_roi           ? FLIGHT_EVENT_ROI          : 0u) |
+            (context.is_unchanged     ? FLIGHT_EVENT_UNCHANGED    : 0u);
+        event.us_grab = int32_t(context.timings.us_image_grab);
+        event.us_preprocess = int32_t(context.timings.us_image_preprocess);
+        event.us_inference = int32_t(context.timings.us_model_inference);
+        m_flight_recorder->PushEvent(event);
     }
 
-    if ((vy <= -p.fall_speed_trigger_hard) || (pred.y <= p.height_trigger_hard)) {
-        m_status.is_soft_trigger = false;
-        m_status.is_hard_trigger = true;
-        return;
+    // update predictions
+    m_raw_pred = raw_pred;
+    m_filtered_pred = Prediction { filtered_pred.x, filtered_pred.y, filtered_pred.confidence };
+    m_total_frames++;
+    if (context.is_roi) {
+        m_total_roi_frames++;
     }
+    if (context.is_unchanged) {
+        m_total_skipped_frames++;
+    }
+    PublishResult(context);
+
+    const auto dt_control_end = std::chrono::high_resolution_clock::now();
+    m_latency.Record(LatencyStage::CONTROL, dt_control_end-dt_apply);
+    m_latency.Record(LatencyStage::END_TO_END, dt_control_end-context.grab_start);
+}
 
-    m_status.is_soft_trigger = false;
-    m_status.is_hard_trigger = false;
-    return;
+void SoccerPlayer::PublishResult(const FrameContext& context) {
+    auto& result = m_results.GetWriteBuffer();
+    result.frame_index = context.frame_index;
+    result.total_frames = m_total_frames;
+    result.total_roi_frames = m_total_roi_frames;
+    result.total_skipped_frames = m_total_skipped_frames;
+    result.is_roi = context.is_roi;
+    result.is_unchanged = context.is_unchanged;
+    result.roi = context.roi;
+    result.raw_pred = m_raw_pred;
+    result.filtered_pred = m_filtered_pred;
+    result.velocity = m_velocity;
+    result.time_to_impact = m_time_to_impact;
+    result.status = m_status;
+    result.timings = context.timings;
+    m_results.Publish();
+}
+
+void SoccerPlayer::PublishPreview(const FrameContext& context) {
+    const auto input = GetModelInputBuffer(context.is_roi);
+    const size_t total_bytes = GetInputBufferSize(input);
+    auto& preview = m_previews.GetWriteBuffer();
+    preview.frame_index = context.frame_index;
+    preview.format = input;
+    preview.format.data = nullptr;
+    preview.data.resize(total_bytes);
+    memcpy(preview.data.data(), input.data, total_bytes);
+    m_previews.Publish();
+}
+
+void SoccerPlayer::UpdateRegionTarget(const Prediction& raw_pred, const Vec2D<float> velocity, const FrameContext& context) {
+    if (m_roi_model == nullptr) {
+        return;
+    }
+    if (raw_pred.confidence >= m_params->confidence_threshold) {
+        m_total_roi_lost_frames = 0;
+        m_roi_target.is_valid = true;
+        m_roi_target.pred = raw_pred;
+        m_roi_target.velocity = velocity;
+        m_roi_target.timestamp = context.grab_end;
+    } else {
+        // keep following the last known position in case the ball was only missed for a few frames
+        m_total_roi_lost_frames++;
+        if (m_total_roi_lost_frames >= m_params->max_lost_frames) {
+            m_roi_target.is_valid = false;
+        }
+    }
+    m_roi_targets.GetWriteBuffer() = m_roi_target;
+    m_roi_targets.Publish();
 }
@@ -1,14 +1,23 @@
 #pragma once
 
 #include <stdint.h>
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <vector>
 
 #include "IModel.h"
-#include "util/MSS.h"
+#include "IFrameSource.h"
+#include "IMouseController.h"
+#include "BallController.h"
+#include "FlightRecorder.h"
+#include "FramePacer.h"
+#include "LatencyHistogram.h"
+#include "Preprocessor.h"
 #include "Prediction.h"
-#include "Predictor.h"
+#include "IEstimator.h"
 #include "SoccerParams.h"
+#include "TripleBuffer.h"
 
 class SoccerPlayer 
 {
@@ -20,61 +29,176 @@ public:
     };
     struct Timings {
         int64_t us_image_grab = 0;
-        int64_t us_image_resize = 0;
-        int64_t us_image_convert = 0;
+        int64_t us_image_preprocess = 0; // resize and convert to model input format
         int64_t us_model_inference = 0;
-        int64_t us_total = 0; // excludes grab time since that had additional delay limited to display refresh rate
+        // excludes grab time since that had additional delay limited to display refresh rate
+        // NOTE: When pipelined this includes time spent queued between preprocessing and inference
+        int64_t us_total = 0;
     };
-    struct Controls {
-        bool can_track = false;
-        bool can_smart_click = false;
-        bool can_always_click = false;
-        bool can_use_predictor = true;
-        int click_padding = 5;
+    // area of the captured frame in pixels from its top left corner
+    struct Region {
+        int left = 0;
+        int top = 0;
+        int width = 0;
+        int height = 0;
     };
-    struct Status {
-        bool is_tracking = false;
-        bool is_clicking = false;
-        bool is_soft_trigger = false;
-        bool is_hard_trigger = false;
+    // state carried with a frame as it moves through each stage
+    struct FrameContext {
+        uint64_t frame_index = 0;
+        int top = 0;
+        int left = 0;
+        int width = 0;
+        int height = 0;
+        // the region of interest model is run on a crop of the frame instead of the whole frame
+        bool is_roi = false;
+        Region roi;
+        // frame is identical to the previous one so preprocessing and inference were skipped
+        bool is_unchanged = false;
+        uint64_t frame_hash = 0;
+        std::chrono::high_resolution_clock::time_point grab_start;
+        // NOTE: The pacer uses a steady clock which high_resolution_clock isn't on every platform
+        FramePacer::Clock::time_point pacer_grab_time;
+        std::chrono::high_resolution_clock::time_point grab_end;
+        std::chrono::high_resolution_clock::time_point preprocess_start;
+        Timings timings;
+    };
+    struct Controls: public BallController::Controls {
+        // only used if a region of interest model was provided
+        bool can_use_roi = true;
+        // reuse the last prediction if the captured pixels haven't changed
+        bool can_skip_unchanged = true;
+    };
+    using Status = BallController::Status;
+    // snapshot of the player's state after each frame that other threads can read
+    struct FrameResult {
+        uint64_t frame_index = 0;
+        uint64_t total_frames = 0;
+        uint64_t total_roi_frames = 0;
+        uint64_t total_skipped_frames = 0;
+        bool is_roi = false;
+        bool is_unchanged = false;
+        Region roi;
+        Prediction raw_pred;
+        Prediction filtered_pred;
+        Vec2D<float> velocity;
+        // seconds after the input lands until the ball falls to the hard trigger height
+        float time_to_impact = -1.0f;
+        Status status;
+        Timings timings;
+    };
+    // copy of the model input for a frame so it can be shown while the next frame is processed
+    struct ModelPreview {
+        uint64_t frame_index = 0;
+        // NOTE: data pointer isn't set, the input values are stored in data below
+        InputBuffer format { nullptr, 0, 0 };
+        std::vector<uint8_t> data;
+    };
+private:
+    // where the ball is expected to be for picking the region of interest of upcoming frames
+    struct RegionTarget {
+        bool is_valid = false;
+        Prediction pred;
+        Vec2D<float> velocity;
+        std::chrono::high_resolution_clock::time_point timestamp;
     };
 private:
     std::unique_ptr<IModel> m_model; 
-    std::unique_ptr<Predictor> m_predictor;
-    std::shared_ptr<util::MSS> m_mss;
+    // owned by the control stage
+    BallController m_controller;
+    std::shared_ptr<IFrameSource> m_frame_source;
+    std::shared_ptr<IMouseController> m_mouse;
     std::shared_ptr<SoccerParams> m_params;
     
-    std::vector<RGBA<uint8_t>> m_resize_buffer;
-    Vec2D<int> m_resize_buffer_size;
-    Vec2D<int> m_capture_buffer_size;
+    Preprocessor m_preprocessor;
+
+    // optional model that tracks the ball in a crop around its last position
+    std::unique_ptr<IModel> m_roi_model;
+    Preprocessor m_roi_preprocessor;
+    int m_roi_width;
+    int m_roi_height;
+    int m_total_roi_lost_frames;
+    uint64_t m_total_roi_frames;
+
+    // owned by the preprocessing stage
+    uint64_t m_last_frame_hash;
+    bool m_has_last_frame_hash;
+    // owned by the inference stage so unchanged frames get the prediction of the frame they match
+    Prediction m_last_inferred_pred;
+    uint64_t m_last_inferred_hash;
+    // set by the inference stage if an unchanged frame didn't match the last inferred frame
+    // which happens if the frame it matched was dropped before inference
+    std::atomic<bool> m_is_frame_hash_stale;
+    uint64_t m_total_skipped_frames;
 
     Prediction m_raw_pred;
     Prediction m_filtered_pred;
-    Prediction m_prev_filtered_pred;
-    bool m_has_prev_filtered_pred;
     Vec2D<float> m_velocity;
+    float m_time_to_impact;
 
     Controls m_controls;
     Status m_status;
-    std::vector<Timings> m_timings;
-    size_t m_timing_index;
+    LatencyStats m_latency;
+    uint64_t m_total_frames;
+
+    // published by the control and inference stages respectively for a single reader
+    TripleBuffer<FrameResult> m_results;
+    TripleBuffer<ModelPreview> m_previews;
+    // published by the control stage for the preprocessing stage
+    TripleBuffer<RegionTarget> m_roi_targets;
+    RegionTarget m_roi_target; // owned by the control stage
+    std::atomic<bool> m_is_preview_enabled;
+    // waits before each grab for the next frame of the source, learned from the frame hashes
+    FramePacer m_pacer;
+    // optional recording of every frame's thumbnail and what was done about it
+    std::shared_ptr<FlightRecorder> m_flight_recorder;
 public:
     SoccerPlayer(
         std::unique_ptr<IModel>&& model,
-        std::shared_ptr<util::MSS>& mss,
+        std::shared_ptr<IFrameSource>& frame_source,
+        std::shared_ptr<IMouseController>& mouse,
         std::shared_ptr<SoccerParams>& params);
+    // while the ball is being tracked the region of interest model is run on a crop of this many pixels
+    // centred on where the ball is expected to be, otherwise the full frame model searches for it
+    // NOTE: This must be set before any frames are processed
+    void SetROIModel(std::unique_ptr<IModel>&& model, const int width, const int height);
+    bool HasROIModel() const { return m_roi_model != nullptr; }
+    // the difference estimator is used by default
+    // NOTE: This must be set before any frames are processed
+    void SetEstimator(std::unique_ptr<IEstimator>&& estimator);
+    // frames are pushed by the preprocessing stage and events by the control stage, null stops recording
+    // NOTE: This must be set before any frames are processed
+    void SetFlightRecorder(std::shared_ptr<FlightRecorder> recorder);
+    // warms up the full frame and region of interest models and returns the stats of the full frame model
+    // NOTE: This must be called before any frames are processed since it overwrites the model inputs
+    WarmupStats WarmupModels(const int max_iterations);
+    // runs every stage one after the other on the calling thread
     bool Update(const int top, const int left);
-    const auto& GetResizeBuffer() const { return m_resize_buffer; }
-    const auto& GetTimings() const { return m_timings; }
-    void SetTimingHistoryLength(const size_t N);
-    const auto& GetStatus() const { return m_status; }
+    // individual stages of Update so that FramePipeline can run them on separate threads
+    // NOTE: Each stage can run concurrently with the others but not with itself
+    FrameView CaptureFrame(const int top, const int left, FrameContext& context);
+    // picks the region of the frame the model is run on which decides the model input to preprocess into
+    void SelectRegion(FrameContext& context);
+    void PreprocessFrame(const FrameView& frame, InputBuffer dst, FrameContext& context);
+    Prediction RunModel(FrameContext& context);
+    void ApplyPrediction(const Prediction& raw_pred, const FrameContext& context);
+    // NOTE: Only the stages should access the model input, use GetLatestPreview from other threads
+    InputBuffer GetModelInputBuffer(const bool is_roi = false) const {
+        return is_roi ? m_roi_model->GetInputBuffer() : m_model->GetInputBuffer();
+    }
     auto& GetControls() { return m_controls; }
+    // pacing is off by default so every grab runs back to back
+    FramePacer& GetPacer() { return m_pacer; }
 
-    Prediction GetRawPrediction() const { return m_raw_pred; }
-    Prediction GetFilteredPrediction() const { return m_filtered_pred; }
-    auto GetVelocity() const { return m_velocity; }
+    // lock free snapshots for a single reader thread such as the gui
+    // NOTE: References stay valid until the next call from the same thread
+    const FrameResult& GetLatestResult() { return m_results.Read(); }
+    const ModelPreview& GetLatestPreview() { return m_previews.Read(); }
+    // copying the model input for the preview is skipped when nothing is displaying it
+    void SetPreviewEnabled(const bool is_enabled) { m_is_preview_enabled = is_enabled; }
+    // histograms are safe to snapshot from any thread
+    const LatencyStats& GetLatencyStats() const { return m_latency; }
 private:
-    void ResizeImage();
-    void ConvertImage();
-    void UpdateTriggers(Prediction pred, const float vx, const float vy);
+    void PublishResult(const FrameContext& context);
+    void PublishPreview(const FrameContext& context);
+    void UpdateRegionTarget(const Prediction& raw_pred, const Vec2D<float> velocity, const FrameContext& context);
 };
\ No newline at end of file
@@ -0,0 +1,132 @@
+#include "SyntheticFrameSource.h"
+
+#include <algorithm>
+
+// NOTE: The renderer throws if the frame size isn't positive
+SyntheticFrameSource::SyntheticFrameSource(const Config& config)
+: m_renderer(config.width, config.height)
+{
+    m_config = config;
+    m_ball.radius = config.ball_radius;
+    m_ball.gravity = config.gravity;
+
+    m_frame_index = 0;
+    m_is_started = false;
+    // NOTE: xorshift state must be non-zero
+    m_rng_state = (config.seed == 0) ? 0x9E3779B9u : config.seed;
+    m_respawn_countdown = 0;
+    SpawnBall();
+    RenderBall();
+}
+
+bool SyntheticFrameSource::Grab(const int top, const int left) {
+    const float dt = 1.0f / m_config.frame_rate;
+    if (!m_config.is_realtime) {
+        UpdateBall(dt);
+        RenderBall();
+        m_frame_index++;
+        return true;
+    }
+
+    // the first grab is the first frame of the display
+    const auto now = std::chrono::steady_clock::now();
+    if (!m_is_started) {
+        m_start_time = now;
+        m_is_started = true;
+    }
+    const double elapsed_secs = std::chrono::duration<double>(now - m_start_time).count();
+    const uint64_t target_index = uint64_t(elapsed_secs * double(m_config.frame_rate));
+    if (target_index == m_frame_index) {
+        return true;
+    }
+    // NOTE: Frames that were never grabbed are still simulated so the ball moves the same way
+    while (m_frame_index < target_index) {
+        UpdateBall(dt);
+        m_frame_index++;
+    }
+    RenderBall();
+    return true;
+}
+
+FrameView SyntheticFrameSource::GetFrame() {
+    FrameView frame = m_renderer.GetFrame();
+    frame.frame_index = m_frame_index;
+    frame.timestamp_us = int64_t(double(m_frame_index) * 1e6 / double(m_config.frame_rate));
+    return frame;
+}
+
+SyntheticFrameSource::BallState SyntheticFrameSource::GetBallState() const {
+    const float width = float(m_config.width);
+    const float height = float(m_config.height);
+    BallState state;
+    state.x = m_ball.x / width;
+    state.y = 1.0f - m_ball.y / height;
+    state.vx = m_ball.vx / width;
+    state.vy = -m_ball.vy / height;
+    state.is_visible = 
+        (m_respawn_countdown == 0) &&
+        (m_ball.y - m_config.ball_radius < height) &&
+        (m_ball.y + m_config.ball_radius > 0.0f);
+    return state;
+}
+
+void SyntheticFrameSource::SpawnBall() {
+    const float width = float(m_config.width);
+    const float height = float(m_config.height);
+    m_ball.x = GetRandomUniform(m_config.ball_radius, width - m_config.ball_radius);
+    m_ball.y = height - m_config.ball_radius - 10.0f;
+    m_ball.vx = GetRandomUniform(-300.0f, 300.0f);
+    m_ball.vy = GetRandomUniform(-1500.0f, -900.0f);
+    m_ball.angle = 0.0f;
+    m_is_ball_falling_out = false;
+}
+
+void SyntheticFrameSource::UpdateBall(const float dt) {
+    if (m_respawn_countdown > 0) {
+        m_respawn_countdown--;
+        if (m_respawn_countdown == 0) {
+            SpawnBall();
+        }
+        return;
+    }
+
+    const float height = float(m_config.height);
+    m_ball.Update(dt, float(m_config.width));
+
+    // play the game by bouncing the ball when it falls near the bottom
+    const bool is_falling = m_ball.vy > 0.0f;
+    const bool is_bounce_zone = m_ball.y > height*0.75f;
+    if (is_falling && is_bounce_zone && !m_is_ball_falling_out) {
+        if (GetRandomUniform(0.0f, 1.0f) < m_config.miss_chance) {
+            m_is_ball_falling_out = true;
+        } else {
+            // click somewhere across the width of the ball
+            const float x_diff = GetRandomUniform(-1.0f, 1.0f);
+            const float mouse_x = m_ball.x - x_diff*m_ball.radius;
+            m_ball.Bounce(mouse_x, GetRandomUniform(-EMULATOR_MAX_RANDOM_BOUNCE, EMULATOR_MAX_RANDOM_BOUNCE));
+        }
+    }
+
+    if (m_ball.IsOutOfWindow(height)) {
+        m_respawn_countdown = std::max(m_config.total_respawn_frames, 1);
+    }
+}
+
+void SyntheticFrameSource::RenderBall() {
+    m_renderer.Render(m_ball, m_respawn_countdown == 0);
+}
+
+uint32_t SyntheticFrameSource::GetRandom() {
+    // xorshift32
+    uint32_t x = m_rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    m_rng_state = x;
+    return x;
+}
+
+float SyntheticFrameSource::GetRandomUniform(const float v_min, const float v_max) {
+    const float t = float(GetRandom() >> 8) / float(1u << 24);
+    return v_min + (v_max - v_min)*t;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <chrono>
+#include "BallRenderer.h"
+#include "EmulatorBall.h"
+#include "IFrameSource.h"
+
+// Deterministic bouncing ball scene for running the pipeline without a screen
+// Ball physics uses the same pixel space constants as the python emulator
+class SyntheticFrameSource: public IFrameSource
+{
+public:
+    struct Config {
+        int width = 322;
+        int height = 455;
+        uint32_t seed = 1;
+        float frame_rate = 60.0f;
+        float ball_radius = 42.0f;
+        float gravity = 2000.0f;
+        // chance that the ball isn't bounced and falls out of the screen
+        float miss_chance = 0.05f;
+        int total_respawn_frames = 30;
+        // advance at frame_rate in wall clock time instead of once per grab like a real display
+        // so grabs faster than the frame rate see the same frame again
+        bool is_realtime = false;
+    };
+    // ground truth in the same normalised coordinates as model predictions
+    struct BallState {
+        float x = 0.0f;
+        float y = 0.0f; // 0 is the bottom of the screen
+        float vx = 0.0f;
+        float vy = 0.0f;
+        bool is_visible = false;
+    };
+private:
+    Config m_config;
+    BallRenderer m_renderer;
+    uint64_t m_frame_index;
+    uint32_t m_rng_state;
+    bool m_is_started;
+    std::chrono::steady_clock::time_point m_start_time;
+
+    EmulatorBall m_ball;
+    bool m_is_ball_falling_out;
+    int m_respawn_countdown;
+public:
+    SyntheticFrameSource(const Config& config);
+    bool Grab(const int top, const int left) override;
+    FrameView GetFrame() override;
+    BallState GetBallState() const;
+    const auto& GetConfig() const { return m_config; }
+private:
+    void SpawnBall();
+    void UpdateBall(const float dt);
+    void RenderBall();
+    uint32_t GetRandom();
+    float GetRandomUniform(const float v_min, const float v_max);
+};
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <chrono>
+#include <exception>
 #include <thread>
 #include <stdexcept>
 
@@ -9,14 +10,46 @@
 #include "tensorflow/lite/c/common.h"
 
 #include "TensorflowLiteModel.h"
+#include "Float16.h"
 
 static void PrintTfLiteModelSummary(TfLiteInterpreter *interpreter);
 static void PrintTfLiteTensorSummary(const TfLiteTensor *tensor);
 
-TensorflowLiteModel::TensorflowLiteModel(const char *filepath, uint32_t num_threads)
+// tflite's c api has no hooks for its worker threads but new threads inherit the cpus and
+// scheduling policy of the thread that creates them, so we start them from one that has the schedule
+template <typename F>
+static void run_with_schedule(const ThreadSchedule& schedule, F&& func) {
+    if (schedule.IsDefault()) {
+        func();
+        return;
+    }
+    std::exception_ptr error = nullptr;
+    auto thread = std::thread([&]() {
+        try {
+            SetCurrentThreadSchedule(schedule);
+            func();
+        } catch (...) {
+            error = std::current_exception();
+        }
+    });
+    thread.join();
+    if (error != nullptr) {
+        std::rethrow_exception(error);
+    }
+}
+
+TensorflowLiteModel::TensorflowLiteModel(const char *filepath, uint32_t num_threads, size_t max_batch_size, const ThreadSchedule& worker_schedule)
+: m_max_batch_size(max_batch_size), m_batch_size(1), m_worker_schedule(worker_schedule)
 {
+    if (max_batch_size == 0) {
+        throw std::runtime_error("Model must have a max batch size of at least 1");
+    }
     // load model
-    m_model = TfLiteModelCreateFromFile(filepath);
+    m_model_file = std::make_unique<MappedFile>(filepath);
+    m_model = TfLiteModelCreate(m_model_file->GetData(), m_model_file->GetSize());
+    if (m_model == nullptr) {
+        throw std::runtime_error(fmt::format("Failed to load tflite model: '{}'", filepath));
+    }
     m_options = TfLiteInterpreterOptionsCreate();
     // default number of threads is same as core count
     if (num_threads <= 0) {
@@ -24,12 +57,22 @@ TensorflowLiteModel::TensorflowLiteModel(const char *filepath, uint32_t num_thre
     }
     TfLiteInterpreterOptionsSetNumThreads(m_options, num_threads);
     // Create the interpreter.
-    m_interp = TfLiteInterpreterCreate(m_model, m_options);
-    // Allocate tensors and populate the input tensor data.
-    TfLiteInterpreterAllocateTensors(m_interp);
+    // NOTE: Delegates start their thread pools when tensors are first allocated and
+    //       the builtin kernels start theirs on the first invoke
+    run_with_schedule(m_worker_schedule, [this]() {
+        m_interp = TfLiteInterpreterCreate(m_model, m_options);
+        if (m_interp == nullptr) {
+            throw std::runtime_error("Failed to create tflite interpreter");
+        }
+        // Allocate tensors and populate the input tensor data.
+        AllocateTensors();
+        if (!m_worker_schedule.IsDefault() && (TfLiteInterpreterInvoke(m_interp) != kTfLiteOk)) {
+            throw std::runtime_error("Failed to start tflite worker threads");
+        }
+    });
 
     // verify input size matches
-    TfLiteTensor* input_tensor = TfLiteInterpreterGetInputTensor(m_interp, 0);
+    TfLiteTensor* input_tensor = m_input_tensor;
     if (input_tensor->dims->size != 4) {
         throw std::runtime_error(fmt::format(
             "Model expected input tensor shape of dimension 4, got {}. (1,H,W,C)",
@@ -56,8 +99,32 @@ TensorflowLiteModel::TensorflowLiteModel(const char *filepath, uint32_t num_thre
             m_width, m_height, m_channels));
     }
 
+    // quantised models take integer inputs which we write to directly
+    const TfLiteType input_type = TfLiteTensorType(input_tensor);
+    switch (input_type) {
+    case kTfLiteFloat32: m_input_type = InputType::FLOAT32; break;
+    case kTfLiteFloat16: m_input_type = InputType::FLOAT16; break;
+    case kTfLiteUInt8:   m_input_type = InputType::UINT8;   break;
+    case kTfLiteInt8:    m_input_type = InputType::INT8;    break;
+    default:
+        throw std::runtime_error(fmt::format(
+            "Model has unsupported input type {}", TfLiteTypeGetName(input_type)));
+    }
+    m_input_quantization = GetDefaultQuantization(m_input_type);
+    if ((input_type == kTfLiteUInt8) || (input_type == kTfLiteInt8)) {
+        const auto params = TfLiteTensorQuantizationParams(input_tensor);
+        if (params.scale > 0.0f) {
+            m_input_quantization.scale = params.scale;
+            m_input_quantization.zero_point = params.zero_point;
+        }
+    }
+    if (TfLiteTensorByteSize(input_tensor) != m_num_pixels*m_channels*GetInputTypeSize(m_input_type)) {
+        throw std::runtime_error(fmt::format(
+            "Model input tensor has unexpected size of {} bytes", TfLiteTensorByteSize(input_tensor)));
+    }
+
     // verify output size matches
-    const TfLiteTensor* output_tensor = TfLiteInterpreterGetOutputTensor(m_interp, 0);
+    const TfLiteTensor* output_tensor = m_output_tensor;
     size_t output_size = 1; 
     {
         for (int i = 0; i < output_tensor->dims->size; i++) {
@@ -68,8 +135,31 @@ TensorflowLiteModel::TensorflowLiteModel(const char *filepath, uint32_t num_thre
         throw std::runtime_error(fmt::format("Model expected 3 outputs (got {})", output_size));
     }
 
-    // allocate buffer after all checks completed
-    m_input_buffer.resize(m_num_pixels);
+    // quantised outputs are converted back to float after inference
+    m_output_type = TfLiteTensorType(output_tensor);
+    switch (m_output_type) {
+    case kTfLiteFloat32:
+    case kTfLiteFloat16:
+        break;
+    case kTfLiteUInt8:
+    case kTfLiteInt8:
+        {
+            const auto params = TfLiteTensorQuantizationParams(output_tensor);
+            m_output_quantization.scale = params.scale;
+            m_output_quantization.zero_point = params.zero_point;
+        }
+        break;
+    default:
+        throw std::runtime_error(fmt::format(
+            "Model has unsupported output type {}", TfLiteTypeGetName(m_output_type)));
+    }
+
+    // check that the graph can be resized now instead of when the first batch is run
+    m_results.resize(m_max_batch_size);
+    if (m_max_batch_size > 1) {
+        SetBatchSize(m_max_batch_size);
+        SetBatchSize(1);
+    }
 }
 
 TensorflowLiteModel::~TensorflowLiteModel() {
@@ -79,21 +169,79 @@ TensorflowLiteModel::~TensorflowLiteModel() {
     TfLiteModelDelete(m_model);
 }
 
+void TensorflowLiteModel::AllocateTensors() {
+    if (TfLiteInterpreterAllocateTensors(m_interp) != kTfLiteOk) {
+        throw std::runtime_error("Model failed to allocate tensors");
+    }
+    // NOTE: Tensor data can move when the arena is reallocated so we fetch them again
+    m_input_tensor = TfLiteInterpreterGetInputTensor(m_interp, 0);
+    m_output_tensor = TfLiteInterpreterGetOutputTensor(m_interp, 0);
+    if ((m_input_tensor == nullptr) || (m_output_tensor == nullptr)) {
+        throw std::runtime_error("Model is missing an input or output tensor");
+    }
+    if ((TfLiteTensorData(m_input_tensor) == nullptr) || (TfLiteTensorData(m_output_tensor) == nullptr)) {
+        throw std::runtime_error("Model input and output tensors must be in cpu memory");
+    }
+}
+
+void TensorflowLiteModel::SetBatchSize(const size_t batch_size) {
+    if ((batch_size == 0) || (batch_size > m_max_batch_size)) {
+        throw std::runtime_error(fmt::format(
+            "Model batch size must be between 1 and {} (got {})", m_max_batch_size, batch_size));
+    }
+    if (batch_size == m_batch_size) {
+        return;
+    }
+    const int dims[4] = { int(batch_size), int(m_height), int(m_width), int(m_channels) };
+    if (TfLiteInterpreterResizeInputTensor(m_interp, 0, dims, 4) != kTfLiteOk) {
+        throw std::runtime_error(fmt::format("Model failed to resize its input to a batch of {}", batch_size));
+    }
+    AllocateTensors();
+    // NOTE: Graphs that reshape with a hardcoded batch of 1 can still resize without an error
+    size_t output_size = 1;
+    for (int i = 0; i < m_output_tensor->dims->size; i++) {
+        output_size *= m_output_tensor->dims->data[i];
+    }
+    if (output_size != batch_size*3) {
+        throw std::runtime_error(fmt::format(
+            "Model expected {} outputs for a batch of {} (got {})", batch_size*3, batch_size, output_size));
+    }
+    m_batch_size = batch_size;
+}
+
 void TensorflowLiteModel::Parse() {
-    TfLiteTensor* input_tensor = TfLiteInterpreterGetInputTensor(m_interp, 0);
-    const TfLiteTensor* output_tensor = TfLiteInterpreterGetOutputTensor(m_interp, 0);
-    // Copy and run
-    const int num_channels = 3;
-    TfLiteTensorCopyFromBuffer(input_tensor, m_input_buffer.data(), m_num_pixels*m_channels*sizeof(float));
+    // NOTE: The preprocessor has already written to the input tensor so we only need to run
     TfLiteInterpreterInvoke(m_interp);
     // Extract the output tensor data.
-    TfLiteTensorCopyToBuffer(
-        output_tensor, 
-        &m_result, sizeof(m_result));
+    const void* output_data = TfLiteTensorData(m_output_tensor);
+    const float scale = m_output_quantization.scale;
+    const int32_t zero_point = m_output_quantization.zero_point;
+    for (size_t b = 0; b < m_batch_size; b++) {
+        float values[3];
+        for (int i = 0; i < 3; i++) {
+            const size_t index = b*3 + size_t(i);
+            switch (m_output_type) {
+            case kTfLiteFloat32: values[i] = reinterpret_cast<const float*>(output_data)[index]; break;
+            case kTfLiteFloat16: values[i] = half_to_float(reinterpret_cast<const uint16_t*>(output_data)[index]); break;
+            case kTfLiteUInt8:   values[i] = scale * float(int32_t(reinterpret_cast<const uint8_t*>(output_data)[index]) - zero_point); break;
+            case kTfLiteInt8:    values[i] = scale * float(int32_t(reinterpret_cast<const int8_t*>(output_data)[index]) - zero_point); break;
+            default:             values[i] = 0.0f; break;
+            }
+        }
+        auto& result = m_results[b];
+        result.x = values[0];
+        result.y = values[1];
+        result.confidence = values[2];
+    }
 }
 
 void TensorflowLiteModel::PrintSummary() {
     PrintTfLiteModelSummary(m_interp);
+    if (!m_worker_schedule.IsDefault()) {
+        printf("worker threads: cpus=%s, priority=%s\n",
+            m_worker_schedule.cpus.empty() ? "any" : GetCpuListString(m_worker_schedule.cpus).c_str(),
+            GetThreadPriorityString(m_worker_schedule.priority));
+    }
 }
 
 void PrintTfLiteModelSummary(TfLiteInterpreter *interpreter) {
@@ -129,9 +277,9 @@ void PrintTfLiteTensorSummary(const TfLiteTensor *tensor) {
     TfLiteType t = TfLiteTensorType(tensor);
     printf("%s ", TfLiteTypeGetName(t));
     // quantisation?
-    if (t == kTfLiteUInt8) {
+    if ((t == kTfLiteUInt8) || (t == kTfLiteInt8)) {
         TfLiteQuantizationParams qparams = TfLiteTensorQuantizationParams(tensor);
-        printf("[scale=%.2f, zero_point=%d]\n", qparams.scale, qparams.zero_point);
+        printf("[scale=%g, zero_point=%d]\n", qparams.scale, qparams.zero_point);
     } else {
         printf("\n");
     }
@@ -1,37 +1,66 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
+#include <memory>
 #include <vector>
 #include "IModel.h"
+#include "MappedFile.h"
+#include "ThreadSchedule.h"
 #include "tensorflow/lite/c/c_api.h"
 #include "tensorflow/lite/c/common.h"
 
 class TensorflowLiteModel: public IModel
 {
 private:
+    // NOTE: The model reads its weights in place from the mapping so it must outlive the model
+    //       and every process that loads the same file shares those pages
+    std::unique_ptr<MappedFile> m_model_file;
     TfLiteModel *m_model;
     TfLiteInterpreterOptions *m_options;
     TfLiteInterpreter *m_interp;
 
-    std::vector<RGB<float>> m_input_buffer;
+    // NOTE: These point into the interpreter's arena and are invalidated by AllocateTensors
+    TfLiteTensor* m_input_tensor;
+    const TfLiteTensor* m_output_tensor;
     size_t m_width;
     size_t m_height;
     size_t m_channels;
     size_t m_num_pixels;
+    InputType m_input_type;
+    QuantizationParams m_input_quantization;
+    TfLiteType m_output_type;
+    QuantizationParams m_output_quantization;
+    size_t m_max_batch_size;
+    size_t m_batch_size;
+    ThreadSchedule m_worker_schedule;
 
-    Prediction m_result;
+    std::vector<Prediction> m_results;
 public:
     // num_threads <= 0 then use hardware concurrency amount
-    TensorflowLiteModel(const char *filepath, uint32_t num_threads=0);
+    // max_batch_size > 1 resizes the input tensor so the model's graph must allow it
+    // NOTE: Worker threads only follow worker_schedule on linux since they inherit it from the thread that starts them
+    TensorflowLiteModel(const char *filepath, uint32_t num_threads=0, size_t max_batch_size=1, const ThreadSchedule& worker_schedule=ThreadSchedule{});
     ~TensorflowLiteModel() override;
+    // Input buffer is the interpreter's own input tensor so the preprocessor writes in place
+    // NOTE: Don't hold onto this across calls to AllocateTensors
     InputBuffer GetInputBuffer() override {
-        return InputBuffer {
-            m_input_buffer.data(), 
+        InputBuffer buffer {
+            TfLiteTensorData(m_input_tensor), 
             m_width,
-            m_height
+            m_height,
+            m_input_type,
         };
+        buffer.quantization = m_input_quantization;
+        return buffer;
     }
     void Parse() override;
-    Prediction GetPrediction() override { return m_result; };
+    // Reallocates the interpreter's tensors and rebinds our view of them
+    void AllocateTensors();
+    Prediction GetPrediction() override { return m_results[0]; };
     void PrintSummary() override;
+    size_t GetMaxBatchSize() override { return m_max_batch_size; }
+    // Resizes the input tensor and reallocates the interpreter's tensors if the size changes
+    void SetBatchSize(const size_t batch_size) override;
+    Prediction GetBatchPrediction(const size_t index) override { return m_results[index]; }
 };
\ No newline at end of file
@@ -0,0 +1,192 @@
+#include "ThreadSchedule.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <stdexcept>
+#include <fmt/core.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const char* GetThreadPriorityString(const ThreadPriority priority) {
+    switch (priority) {
+    case ThreadPriority::NORMAL:   return "normal";
+    case ThreadPriority::HIGH:     return "high";
+    case ThreadPriority::REALTIME: return "realtime";
+    default:                       return "unknown";
+    }
+}
+
+ThreadPriority ParseThreadPriority(const std::string& str) {
+    if (str.compare("normal") == 0) return ThreadPriority::NORMAL;
+    if (str.compare("high") == 0) return ThreadPriority::HIGH;
+    if (str.compare("realtime") == 0) return ThreadPriority::REALTIME;
+    throw std::runtime_error(fmt::format("Invalid thread priority: '{}'. Options: [normal, high, realtime]", str));
+}
+
+#if defined(_WIN32)
+// thread affinity masks only cover the processor group the thread is in
+static constexpr long MAX_CPUS = long(sizeof(DWORD_PTR)*8);
+#elif defined(CPU_SETSIZE)
+static constexpr long MAX_CPUS = CPU_SETSIZE;
+#else
+static constexpr long MAX_CPUS = 1024;
+#endif
+
+std::vector<int> ParseCpuList(const std::string& str) {
+    std::vector<int> cpus;
+    size_t start = 0;
+    while (start < str.size()) {
+        size_t end = str.find(',', start);
+        if (end == std::string::npos) end = str.size();
+        const auto token = str.substr(start, end-start);
+        start = end+1;
+        if (token.empty()) continue;
+        // the whole token has to be a cpu or a range of cpus
+        const char* first_str = token.c_str();
+        char* token_end = nullptr;
+        errno = 0;
+        const long first = strtol(first_str, &token_end, 10);
+        bool is_valid = (token_end != first_str) && (errno == 0);
+        long last = first;
+        if (is_valid && (*token_end == '-')) {
+            const char* last_str = token_end+1;
+            last = strtol(last_str, &token_end, 10);
+            is_valid = (token_end != last_str) && (errno == 0);
+        }
+        if (!is_valid || (*token_end != '\0') || (first < 0)) {
+            throw std::runtime_error(fmt::format("Invalid cpu range '{}' in '{}'", token, str));
+        }
+        if (last < first) {
+            throw std::runtime_error(fmt::format("Cpu range '{}' in '{}' is reversed", token, str));
+        }
+        if (last >= MAX_CPUS) {
+            throw std::runtime_error(fmt::format("Cpu range '{}' in '{}' is larger than the max of {}", token, str, MAX_CPUS-1));
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(int(cpu));
+        }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+std::string GetCpuListString(const std::vector<int>& cpus) {
+    std::string str;
+    for (size_t i = 0; i < cpus.size(); i++) {
+        // collapse consecutive processors into ranges
+        size_t j = i;
+        while (((j+1) < cpus.size()) && (cpus[j+1] == (cpus[j]+1))) j++;
+        if (!str.empty()) str += ",";
+        str += (j > i) ? fmt::format("{}-{}", cpus[i], cpus[j]) : fmt::format("{}", cpus[i]);
+        i = j;
+    }
+    return str;
+}
+
+#if defined(_WIN32)
+void SetCurrentThreadSchedule(const ThreadSchedule& schedule) {
+    HANDLE thread = GetCurrentThread();
+    if (!schedule.cpus.empty()) {
+        // NOTE: Thread affinity masks only cover the processor group the thread is in
+        DWORD_PTR mask = 0;
+        for (const int cpu: schedule.cpus) {
+            if (cpu >= int(sizeof(DWORD_PTR)*8)) {
+                throw std::runtime_error(fmt::format("Cpu {} is outside of the processor group", cpu));
+            }
+            mask |= DWORD_PTR(1) << cpu;
+        }
+        if (SetThreadAffinityMask(thread, mask) == 0) {
+            throw std::runtime_error(fmt::format(
+                "Failed to set thread affinity to cpus {} (error {})",
+                GetCpuListString(schedule.cpus), GetLastError()));
+        }
+    }
+    int priority = THREAD_PRIORITY_NORMAL;
+    switch (schedule.priority) {
+    case ThreadPriority::NORMAL:   return;
+    case ThreadPriority::HIGH:     priority = THREAD_PRIORITY_HIGHEST; break;
+    case ThreadPriority::REALTIME: priority = THREAD_PRIORITY_TIME_CRITICAL; break;
+    }
+    if (SetThreadPriority(thread, priority) == 0) {
+        throw std::runtime_error(fmt::format(
+            "Failed to set thread priority to {} (error {})",
+            GetThreadPriorityString(schedule.priority), GetLastError()));
+    }
+}
+#else
+void SetCurrentThreadSchedule(const ThreadSchedule& schedule) {
+    if (!schedule.cpus.empty()) {
+#if defined(__linux__)
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        for (const int cpu: schedule.cpus) {
+            if (cpu >= CPU_SETSIZE) {
+                throw std::runtime_error(fmt::format("Cpu {} is larger than the max of {}", cpu, CPU_SETSIZE-1));
+            }
+            CPU_SET(cpu, &cpu_set);
+        }
+        const int error = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+        if (error != 0) {
+            throw std::runtime_error(fmt::format(
+                "Failed to set thread affinity to cpus {}: {}",
+                GetCpuListString(schedule.cpus), strerror(error)));
+        }
+#else
+        throw std::runtime_error("Thread affinity is only supported on windows and linux");
+#endif
+    }
+    switch (schedule.priority) {
+    case ThreadPriority::NORMAL:
+        return;
+    case ThreadPriority::HIGH:
+        {
+#if defined(__linux__)
+            // NOTE: Linux threads have their own nice value which is set through their thread id
+            const id_t id = id_t(syscall(SYS_gettid));
+#else
+            const id_t id = 0;
+#endif
+            if (setpriority(PRIO_PROCESS, id, -10) != 0) {
+                throw std::runtime_error(fmt::format("Failed to set thread priority to high: {}", strerror(errno)));
+            }
+        }
+        return;
+    case ThreadPriority::REALTIME:
+        {
+            // middle of the range leaves room for kernel threads and audio above us
+            sched_param param;
+            memset(&param, 0, sizeof(param));
+            param.sched_priority = (sched_get_priority_min(SCHED_FIFO) + sched_get_priority_max(SCHED_FIFO)) / 2;
+            const int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+            if (error != 0) {
+                throw std::runtime_error(fmt::format("Failed to set thread priority to realtime: {}", strerror(error)));
+            }
+        }
+        return;
+    }
+}
+#endif
+
+bool TrySetCurrentThreadSchedule(const ThreadSchedule& schedule, const char* thread_name) {
+    try {
+        SetCurrentThreadSchedule(schedule);
+        return true;
+    } catch (const std::exception& ex) {
+        fprintf(stderr, "Failed to schedule %s thread: %s\n", thread_name, ex.what());
+        return false;
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+enum class ThreadPriority {
+    // leaves the priority the thread was created with
+    NORMAL,
+    // highest priority of the normal time sharing scheduler
+    HIGH,
+    // preempts every normal thread so it can starve the rest of the system if it never blocks
+    REALTIME,
+};
+
+const char* GetThreadPriorityString(const ThreadPriority priority);
+ThreadPriority ParseThreadPriority(const std::string& str);
+
+// Where and how urgently a thread runs
+// Pinning latency critical threads keeps them from migrating between cores and
+// away from the render thread, which removes most of the jitter in their latency
+struct ThreadSchedule {
+    // logical processors the thread may run on, the os chooses if empty
+    std::vector<int> cpus;
+    ThreadPriority priority = ThreadPriority::NORMAL;
+    bool IsDefault() const { return cpus.empty() && (priority == ThreadPriority::NORMAL); }
+};
+
+// Parses lists of processors such as "0-3,6"
+std::vector<int> ParseCpuList(const std::string& str);
+std::string GetCpuListString(const std::vector<int>& cpus);
+// NOTE: Realtime priority needs CAP_SYS_NICE on linux and high priorities may need administrator on windows
+void SetCurrentThreadSchedule(const ThreadSchedule& schedule);
+// Threads can't pass exceptions back to whoever started them so failures are only reported
+bool TrySetCurrentThreadSchedule(const ThreadSchedule& schedule, const char* thread_name);
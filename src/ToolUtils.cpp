@@ -0,0 +1,70 @@
+#include "ToolUtils.h"
+
+#include <stdint.h>
+#include <exception>
+#include <stdexcept>
+#include <fmt/core.h>
+
+bool ends_with(const std::string& str, const std::string& suffix) {
+    if (suffix.size() > str.size()) return false;
+    return str.compare(str.size()-suffix.size(), suffix.size(), suffix) == 0;
+}
+
+std::vector<std::string> split_list(const std::string& str) {
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= str.size()) {
+        size_t end = str.find(',', start);
+        if (end == std::string::npos) end = str.size();
+        if (end > start) {
+            items.push_back(str.substr(start, end-start));
+        }
+        start = end+1;
+    }
+    return items;
+}
+
+std::vector<int> parse_int_list(const std::string& str, const char* name) {
+    std::vector<int> values;
+    for (const auto& item: split_list(str)) {
+        try {
+            values.push_back(std::stoi(item));
+        } catch (const std::exception&) {
+            throw std::runtime_error(fmt::format("Invalid integer '{}' in {}", item, name));
+        }
+    }
+    if (values.empty()) {
+        throw std::runtime_error(fmt::format("Expected at least one value for {}", name));
+    }
+    return values;
+}
+
+std::string json_escape(const std::string& str) {
+    std::string escaped;
+    escaped.reserve(str.size());
+    for (const char c: str) {
+        switch (c) {
+        case '"':  escaped += "\\\""; break;
+        case '\\': escaped += "\\\\"; break;
+        case '\n': escaped += "\\n"; break;
+        case '\t': escaped += "\\t"; break;
+        default:
+            if (uint8_t(c) < 0x20) {
+                escaped += fmt::format("\\u{:04x}", int(c));
+            } else {
+                escaped += c;
+            }
+        }
+    }
+    return escaped;
+}
+
+std::string get_runtime(const std::string& runtime, const std::string& model_path) {
+    if (runtime.compare("auto") != 0) {
+        return runtime;
+    }
+    if (ends_with(model_path, ".onnx")) return "onnx";
+    if (ends_with(model_path, ".tflite")) return "tflite";
+    if (ends_with(model_path, ".bin")) return "native";
+    throw std::runtime_error(fmt::format("Couldn't determine runtime from model extension: '{}'", model_path));
+}
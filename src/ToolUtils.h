@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Parsing of command line arguments and json output shared by the headless tools
+bool ends_with(const std::string& str, const std::string& suffix);
+// Comma separated items with empty items skipped
+std::vector<std::string> split_list(const std::string& str);
+// Throws if an item isn't an integer or there are no items, name is the argument used in the error
+std::vector<int> parse_int_list(const std::string& str, const char* name);
+std::string json_escape(const std::string& str);
+// Picks the runtime from the model extension if runtime is "auto"
+std::string get_runtime(const std::string& runtime, const std::string& model_path);
@@ -0,0 +1,118 @@
+#include "Trajectory.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <stdexcept>
+#include <fmt/core.h>
+
+static const char* TRAJECTORY_COLUMNS = "time_us,x,y,confidence";
+static const char* TRAJECTORY_TRUTH_COLUMNS = "time_us,x,y,confidence,true_x,true_y,true_vx,true_vy,is_visible";
+
+std::vector<TrajectorySample> LoadTrajectory(const char* filepath) {
+    FILE* fp = fopen(filepath, "r");
+    if (fp == nullptr) {
+        throw std::runtime_error(fmt::format("Failed to open trajectory '{}'", filepath));
+    }
+    std::vector<TrajectorySample> samples;
+    char line[512];
+    bool has_truth = false;
+    size_t line_number = 0;
+    try {
+        if (fgets(line, sizeof(line), fp) == nullptr) {
+            throw std::runtime_error("Missing header");
+        }
+        line_number++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (strcmp(line, TRAJECTORY_TRUTH_COLUMNS) == 0) {
+            has_truth = true;
+        } else if (strcmp(line, TRAJECTORY_COLUMNS) != 0) {
+            throw std::runtime_error(fmt::format("Expected header '{}' or '{}' but got '{}'", TRAJECTORY_COLUMNS, TRAJECTORY_TRUTH_COLUMNS, line));
+        }
+        while (fgets(line, sizeof(line), fp) != nullptr) {
+            line_number++;
+            if ((line[0] == '\n') || (line[0] == '\r') || (line[0] == '\0')) continue;
+            TrajectorySample sample;
+            long long time_us = 0;
+            int is_visible = 0;
+            const int total_expected = has_truth ? 9 : 4;
+            const int total_read = sscanf(line, "%lld,%f,%f,%f,%f,%f,%f,%f,%d",
+                &time_us, &sample.observation.x, &sample.observation.y, &sample.observation.confidence,
+                &sample.truth.x, &sample.truth.y, &sample.truth.vx, &sample.truth.vy, &is_visible);
+            if (total_read != total_expected) {
+                throw std::runtime_error(fmt::format("Expected {} columns but got {}", total_expected, total_read));
+            }
+            sample.time_us = int64_t(time_us);
+            sample.has_truth = has_truth;
+            sample.truth.is_visible = has_truth && (is_visible != 0);
+            if (!samples.empty() && (sample.time_us < samples.back().time_us)) {
+                throw std::runtime_error(fmt::format("Time went backwards from {}us to {}us", samples.back().time_us, sample.time_us));
+            }
+            samples.push_back(sample);
+        }
+    } catch (const std::exception& ex) {
+        fclose(fp);
+        throw std::runtime_error(fmt::format("Invalid trajectory '{}' at line {}: {}", filepath, line_number, ex.what()));
+    }
+    fclose(fp);
+    return samples;
+}
+
+void SaveTrajectory(const char* filepath, const std::vector<TrajectorySample>& samples) {
+    FILE* fp = fopen(filepath, "w");
+    if (fp == nullptr) {
+        throw std::runtime_error(fmt::format("Failed to open trajectory '{}' for writing", filepath));
+    }
+    // the ground truth is only written if every sample has it
+    bool has_truth = !samples.empty();
+    for (const auto& sample: samples) {
+        has_truth = has_truth && sample.has_truth;
+    }
+    fmt::print(fp, "{}\n", has_truth ? TRAJECTORY_TRUTH_COLUMNS : TRAJECTORY_COLUMNS);
+    for (const auto& sample: samples) {
+        const auto& obs = sample.observation;
+        if (has_truth) {
+            const auto& truth = sample.truth;
+            fmt::print(fp, "{},{:.6f},{:.6f},{:.4f},{:.6f},{:.6f},{:.6f},{:.6f},{}\n",
+                sample.time_us, obs.x, obs.y, obs.confidence,
+                truth.x, truth.y, truth.vx, truth.vy, truth.is_visible ? 1 : 0);
+        } else {
+            fmt::print(fp, "{},{:.6f},{:.6f},{:.4f}\n", sample.time_us, obs.x, obs.y, obs.confidence);
+        }
+    }
+    fclose(fp);
+}
+
+bool GetReferencePosition(const TrajectorySample& sample, const float confidence_threshold, float& x, float& y) {
+    if (sample.has_truth) {
+        x = sample.truth.x;
+        y = sample.truth.y;
+        return sample.truth.is_visible;
+    }
+    x = sample.observation.x;
+    y = sample.observation.y;
+    return sample.observation.confidence >= confidence_threshold;
+}
+
+bool GetReferencePositionAt(
+    const std::vector<TrajectorySample>& samples, const float confidence_threshold,
+    size_t& index, const int64_t time_us, float& x, float& y)
+{
+    while (((index+1) < samples.size()) && (samples[index+1].time_us < time_us)) {
+        index++;
+    }
+    if ((index+1) >= samples.size()) {
+        return false;
+    }
+    const auto& s0 = samples[index];
+    const auto& s1 = samples[index+1];
+    float x0, y0, x1, y1;
+    if (!GetReferencePosition(s0, confidence_threshold, x0, y0) || !GetReferencePosition(s1, confidence_threshold, x1, y1)) {
+        return false;
+    }
+    const int64_t dt = s1.time_us - s0.time_us;
+    const float alpha = (dt > 0) ? std::clamp(float(time_us - s0.time_us) / float(dt), 0.0f, 1.0f) : 0.0f;
+    x = x0 + (x1-x0)*alpha;
+    y = y0 + (y1-y0)*alpha;
+    return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "Prediction.h"
+
+// Observations of the ball over time that can be replayed through an estimator
+// Stored as csv with the columns time_us,x,y,confidence and if the trajectory was simulated
+// the ground truth true_x,true_y,true_vx,true_vy,is_visible
+// Positions are normalised screen coordinates with y=0 at the bottom like model predictions
+struct TrajectorySample {
+    int64_t time_us = 0;
+    Prediction observation;
+    bool has_truth = false;
+    struct {
+        float x = 0.0f;
+        float y = 0.0f;
+        float vx = 0.0f;
+        float vy = 0.0f;
+        bool is_visible = false;
+    } truth;
+};
+
+// NOTE: Samples must be in increasing order of time
+std::vector<TrajectorySample> LoadTrajectory(const char* filepath);
+void SaveTrajectory(const char* filepath, const std::vector<TrajectorySample>& samples);
+
+// where the ball really was, which is the truth if there is any otherwise the observation
+// returns false if the ball isn't visible or the observation is below the confidence threshold
+bool GetReferencePosition(const TrajectorySample& sample, const float confidence_threshold, float& x, float& y);
+// reference position interpolated at a time, with the search starting from the sample at index
+// index is moved forward to the sample before the time so increasing times can be looked up in one pass
+bool GetReferencePositionAt(
+    const std::vector<TrajectorySample>& samples, const float confidence_threshold,
+    size_t& index, const int64_t time_us, float& x, float& y);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// Wait free publication of a value from one writer thread to one reader thread
+// The writer fills the back buffer and swaps it with the middle buffer when publishing
+// The reader swaps the middle buffer into the front if it has been published since the last read
+// Neither side ever blocks and the reader never sees a partially written value
+template <typename T>
+class TripleBuffer
+{
+private:
+    static constexpr uint8_t INDEX_MASK = 0b011;
+    static constexpr uint8_t DIRTY_BIT = 0b100;
+    T m_buffers[3];
+    // index of the middle buffer and whether it has been published since the last read
+    alignas(64) std::atomic<uint8_t> m_middle;
+    alignas(64) uint8_t m_back;  // owned by writer
+    alignas(64) uint8_t m_front; // owned by reader
+public:
+    TripleBuffer() {
+        m_front = 0;
+        m_middle.store(1, std::memory_order_relaxed);
+        m_back = 2;
+    }
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // writer only
+    T& GetWriteBuffer() { return m_buffers[m_back]; }
+    void Publish() {
+        const uint8_t prev_middle = m_middle.exchange(m_back | DIRTY_BIT, std::memory_order_acq_rel);
+        m_back = prev_middle & INDEX_MASK;
+    }
+
+    // reader only, returns the most recently published value
+    // NOTE: The reference stays valid until the next call to Read
+    const T& Read() {
+        if (m_middle.load(std::memory_order_relaxed) & DIRTY_BIT) {
+            const uint8_t prev_middle = m_middle.exchange(m_front, std::memory_order_acq_rel);
+            m_front = prev_middle & INDEX_MASK;
+        }
+        return m_buffers[m_front];
+    }
+    // reader only, true if a new value was published since the last read
+    bool IsUpdated() const {
+        return (m_middle.load(std::memory_order_relaxed) & DIRTY_BIT) != 0;
+    }
+};
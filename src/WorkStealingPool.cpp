@@ -0,0 +1,163 @@
+#include "WorkStealingPool.h"
+
+#include <stdexcept>
+#include <fmt/core.h>
+
+static uint64_t pack_range(const uint64_t begin, const uint64_t end) {
+    return begin | (end << 32);
+}
+
+static void unpack_range(const uint64_t value, size_t& begin, size_t& end) {
+    begin = size_t(value & 0xFFFFFFFFu);
+    end = size_t(value >> 32);
+}
+
+WorkStealingPool::WorkStealingPool(const int total_threads, const ThreadSchedule& schedule) {
+    if (total_threads < 0) {
+        throw std::runtime_error(fmt::format("Number of threads can't be negative (got {})", total_threads));
+    }
+    int total_workers = total_threads;
+    if (total_workers == 0) {
+        total_workers = int(std::thread::hardware_concurrency());
+        if (total_workers <= 0) total_workers = 1;
+    }
+    m_schedule = schedule;
+    m_ranges = std::make_unique<Range[]>(size_t(total_workers));
+    m_is_running = true;
+    m_job_id = 0;
+    m_total_busy = 0;
+    m_func = nullptr;
+    m_grain = 1;
+    m_is_cancelled = false;
+    m_threads.reserve(size_t(total_workers));
+    for (int i = 0; i < total_workers; i++) {
+        m_threads.emplace_back([this, i]() { RunWorker(i); });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        auto lock = std::scoped_lock(m_mutex);
+        m_is_running = false;
+        m_cv_start.notify_all();
+    }
+    for (auto& thread: m_threads) {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::ParallelFor(const size_t total, const Func& func, const size_t grain) {
+    if (uint64_t(total) > uint64_t(0xFFFFFFFFu)) {
+        throw std::runtime_error(fmt::format("Work stealing pool supports up to 2^32-1 indices (got {})", total));
+    }
+    if (total == 0) {
+        return;
+    }
+
+    auto lock = std::unique_lock(m_mutex);
+    const size_t total_workers = m_threads.size();
+    for (size_t i = 0; i < total_workers; i++) {
+        const size_t begin = (total * i) / total_workers;
+        const size_t end = (total * (i+1)) / total_workers;
+        m_ranges[i].value.store(pack_range(begin, end), std::memory_order_relaxed);
+    }
+    m_func = &func;
+    m_grain = (grain > 0) ? grain : 1;
+    m_is_cancelled = false;
+    m_error = nullptr;
+    m_total_busy = int(total_workers);
+    m_job_id++;
+    m_cv_start.notify_all();
+    m_cv_done.wait(lock, [this]() { return m_total_busy == 0; });
+    m_func = nullptr;
+    if (m_error != nullptr) {
+        auto error = m_error;
+        m_error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void WorkStealingPool::RunWorker(const int thread_index) {
+    auto schedule = m_schedule;
+    if (!schedule.cpus.empty()) {
+        schedule.cpus = { schedule.cpus[size_t(thread_index) % schedule.cpus.size()] };
+    }
+    TrySetCurrentThreadSchedule(schedule, "work stealing pool");
+
+    uint64_t last_job_id = 0;
+    while (true) {
+        {
+            auto lock = std::unique_lock(m_mutex);
+            m_cv_start.wait(lock, [&]() { return !m_is_running || (m_job_id != last_job_id); });
+            if (!m_is_running) return;
+            last_job_id = m_job_id;
+        }
+
+        const auto& func = *m_func;
+        size_t begin = 0;
+        size_t end = 0;
+        while (!m_is_cancelled.load(std::memory_order_relaxed)) {
+            if (!TakeOwn(thread_index, begin, end) && !(Steal(thread_index) && TakeOwn(thread_index, begin, end))) {
+                break;
+            }
+            try {
+                for (size_t i = begin; i < end; i++) {
+                    func(i, thread_index);
+                }
+            } catch (...) {
+                auto lock = std::scoped_lock(m_mutex);
+                if (m_error == nullptr) {
+                    m_error = std::current_exception();
+                }
+                m_is_cancelled = true;
+            }
+        }
+
+        auto lock = std::scoped_lock(m_mutex);
+        m_total_busy--;
+        if (m_total_busy == 0) {
+            m_cv_done.notify_all();
+        }
+    }
+}
+
+bool WorkStealingPool::TakeOwn(const int thread_index, size_t& begin, size_t& end) {
+    auto& range = m_ranges[size_t(thread_index)].value;
+    uint64_t value = range.load(std::memory_order_acquire);
+    while (true) {
+        size_t range_begin, range_end;
+        unpack_range(value, range_begin, range_end);
+        if (range_begin >= range_end) {
+            return false;
+        }
+        const size_t next_begin = ((range_end - range_begin) > m_grain) ? (range_begin + m_grain) : range_end;
+        if (range.compare_exchange_weak(value, pack_range(next_begin, range_end), std::memory_order_acq_rel)) {
+            begin = range_begin;
+            end = next_begin;
+            return true;
+        }
+    }
+}
+
+bool WorkStealingPool::Steal(const int thread_index) {
+    const size_t total_workers = m_threads.size();
+    for (size_t offset = 1; offset < total_workers; offset++) {
+        auto& victim = m_ranges[(size_t(thread_index) + offset) % total_workers].value;
+        uint64_t value = victim.load(std::memory_order_acquire);
+        while (true) {
+            size_t range_begin, range_end;
+            unpack_range(value, range_begin, range_end);
+            if (range_begin >= range_end) {
+                break;
+            }
+            // the victim keeps the front half which it is already working towards
+            const size_t middle = range_begin + (range_end - range_begin) / 2;
+            if (victim.compare_exchange_weak(value, pack_range(range_begin, middle), std::memory_order_acq_rel)) {
+                // NOTE: Our range is empty so no one else can change it until this store
+                m_ranges[size_t(thread_index)].value.store(pack_range(middle, range_end), std::memory_order_release);
+                return true;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ThreadSchedule.h"
+
+// Runs loops over a fixed set of worker threads that are kept between loops
+// Each worker starts with an equal block of the indices and takes a grain at a time from its front
+// A worker that runs out steals the back half of another's remaining block, so uneven work
+// is balanced without any locks or a shared counter that every worker contends on
+class WorkStealingPool
+{
+private:
+    // remaining indices of a worker with begin in the low and end in the high 32 bits
+    // the owner and thieves both update it with a single compare exchange
+    struct alignas(64) Range {
+        std::atomic<uint64_t> value {0};
+    };
+    using Func = std::function<void(size_t, int)>;
+private:
+    ThreadSchedule m_schedule;
+    std::vector<std::thread> m_threads;
+    std::unique_ptr<Range[]> m_ranges;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv_start;
+    std::condition_variable m_cv_done;
+    bool m_is_running;
+    uint64_t m_job_id;
+    int m_total_busy;
+
+    // current loop which is only changed while no workers are busy
+    const Func* m_func;
+    size_t m_grain;
+    std::atomic<bool> m_is_cancelled;
+    std::exception_ptr m_error;
+public:
+    // uses every core if total_threads is 0
+    // each worker is pinned to the next cpu of the schedule if it has any
+    explicit WorkStealingPool(const int total_threads, const ThreadSchedule& schedule=ThreadSchedule{});
+    ~WorkStealingPool();
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+    int GetTotalThreads() const { return int(m_threads.size()); }
+    // calls func(index, thread_index) for every index in [0,total) and returns once they have all finished
+    // the thread index is in [0,GetTotalThreads()) so it can pick per thread state without locking
+    // NOTE: The first exception thrown by func stops the loop and is rethrown here
+    void ParallelFor(const size_t total, const Func& func, const size_t grain=1);
+private:
+    void RunWorker(const int thread_index);
+    bool TakeOwn(const int thread_index, size_t& begin, size_t& end);
+    bool Steal(const int thread_index);
+};
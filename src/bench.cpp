@@ -0,0 +1,960 @@
+// Headless benchmark of the full SoccerPlayer pipeline
+// Sweeps over models, runtime threading options, capture sizes, pipeline depths, thread priorities and pacing modes
+// and writes the per stage latency distributions and throughput of each configuration as json
+#include <stdio.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include <argparse/argparse.hpp>
+#include <fmt/core.h>
+
+#include "FramePacer.h"
+#include "FramePipeline.h"
+#include "FlightRecorder.h"
+#include "IEstimator.h"
+#include "InferenceServer.h"
+#include "LatencyHistogram.h"
+#include "NativeModel.h"
+#include "NullMouseController.h"
+#include "OnnxDirectMLModel.h"
+#include "ReplayFrameSource.h"
+#include "SoccerParams.h"
+#include "SoccerPlayer.h"
+#include "SyntheticFrameSource.h"
+#include "TensorflowLiteModel.h"
+#include "ThreadSchedule.h"
+#include "ToolUtils.h"
+
+struct BenchOptions {
+    int total_frames = 1000;
+    int total_warmup_frames = 100;
+    // synthetic inputs run through the model on its own before any frames
+    int total_model_warmup_iterations = 200;
+    // use synthetic frames if empty
+    std::string replay_path;
+    // synthetic frames change at this rate in wall clock time like a display, or on every grab if 0
+    int display_hz = 0;
+    bool is_count_allocations = false;
+    bool is_pipeline_drop_stale = true;
+    bool is_dump_buckets = false;
+    bool is_skip_unchanged = true;
+    EstimatorType estimator_type = EstimatorType::DIFFERENCE;
+    // every session records a flight log to this path if provided, with the session index appended if there are several
+    std::string flight_log_path;
+    int flight_log_scale = 4;
+    // region of interest model that is run alongside every configuration if provided
+    std::string roi_model_path;
+    int roi_width = 0;
+    int roi_height = 0;
+    // how long sessions wait for each other to fill a batch
+    int batch_delay_us = 2000;
+    // optimised onnx models are cached here if not empty
+    std::string onnx_cache_directory;
+    // threads are left to the os if these are empty
+    // the model cpus are used by whichever thread runs the model and the capture cpus by the pipeline's capture stage
+    std::vector<int> model_cpus;
+    std::vector<int> capture_cpus;
+    std::vector<int> worker_cpus;
+};
+
+struct BenchConfig {
+    std::string model_path;
+    std::string runtime;
+    int total_threads = 0;
+    bool is_sequential = false;
+    int capture_width = 0;
+    int capture_height = 0;
+    int pipeline_depth = 0;
+    // sessions share one model through an inference server if there is more than one
+    int total_sessions = 1;
+    // used by every thread that has a schedule
+    ThreadPriority thread_priority = ThreadPriority::NORMAL;
+    PacingMode pacing_mode = PacingMode::OFF;
+};
+
+struct BenchResult {
+    BenchConfig config;
+    InputBuffer model_input { nullptr, 0, 0 };
+    double load_secs = 0.0;
+    bool is_loaded_from_cache = false;
+    WarmupStats model_warmup;
+    double duration_secs = 0.0;
+    // cpu time of the whole process while measuring
+    double cpu_secs = 0.0;
+    uint64_t total_captured = 0;
+    uint64_t total_dropped = 0;
+    uint64_t total_roi_frames = 0;
+    uint64_t total_skipped_frames = 0;
+    std::vector<LatencyHistogram::Snapshot> stages;
+    bool has_allocator_stats = false;
+    OnnxDirectMLModel::AllocatorStats allocator_stats;
+    bool has_batch_stats = false;
+    InferenceServer::Stats batch_stats;
+    LatencyHistogram::Snapshot batch_latency;
+    // counters of every session are summed and the learned state is the mean
+    FramePacer::Stats pacer_stats;
+    // summed over every session and including the warmup frames
+    bool has_flight_stats = false;
+    FlightRecorder::Stats flight_stats;
+};
+
+// list of WIDTHxHEIGHT
+static std::vector<std::pair<int,int>> parse_size_list(const std::string& str, const char* name) {
+    std::vector<std::pair<int,int>> sizes;
+    for (const auto& item: split_list(str)) {
+        const size_t split = item.find('x');
+        int width = 0;
+        int height = 0;
+        try {
+            if (split == std::string::npos) throw std::invalid_argument("missing separator");
+            width = std::stoi(item.substr(0, split));
+            height = std::stoi(item.substr(split+1));
+        } catch (const std::exception&) {
+            throw std::runtime_error(fmt::format("Invalid size '{}' in {}, expected WIDTHxHEIGHT", item, name));
+        }
+        if ((width <= 0) || (height <= 0)) {
+            throw std::runtime_error(fmt::format("Size '{}' in {} must be positive", item, name));
+        }
+        sizes.push_back({ width, height });
+    }
+    if (sizes.empty()) {
+        throw std::runtime_error(fmt::format("Expected at least one value for {}", name));
+    }
+    return sizes;
+}
+
+static double ns_to_us(const uint64_t ns) {
+    return double(ns) * 1e-3;
+}
+
+static ThreadSchedule get_schedule(const std::vector<int>& cpus, const BenchConfig& config) {
+    auto schedule = ThreadSchedule{};
+    schedule.cpus = cpus;
+    schedule.priority = config.thread_priority;
+    return schedule;
+}
+
+// runs on a new thread so that the caller's schedule is left as is
+template <typename F>
+static void run_scheduled(const ThreadSchedule& schedule, F&& func) {
+    std::exception_ptr error = nullptr;
+    auto thread = std::thread([&]() {
+        try {
+            SetCurrentThreadSchedule(schedule);
+            func();
+        } catch (...) {
+            error = std::current_exception();
+        }
+    });
+    thread.join();
+    if (error != nullptr) {
+        std::rethrow_exception(error);
+    }
+}
+
+static std::unique_ptr<IModel> create_model(const BenchConfig& config, const BenchOptions& options, const size_t max_batch_size, OnnxDirectMLModel** onnx_model) {
+    *onnx_model = nullptr;
+    if (config.runtime.compare("onnx") == 0) {
+        auto opts = OnnxDirectMLModel::CPU_Options{};
+        opts.total_threads = config.total_threads;
+        opts.is_sequential = config.is_sequential;
+        opts.is_count_allocations = options.is_count_allocations;
+        opts.max_batch_size = max_batch_size;
+        opts.cache_directory = options.onnx_cache_directory;
+        opts.worker_schedule = get_schedule(options.worker_cpus, config);
+        auto model = std::make_unique<OnnxDirectMLModel>(config.model_path.c_str(), opts);
+        *onnx_model = model.get();
+        return model;
+    }
+    if (config.runtime.compare("tflite") == 0) {
+        return std::make_unique<TensorflowLiteModel>(
+            config.model_path.c_str(), uint32_t(config.total_threads), max_batch_size,
+            get_schedule(options.worker_cpus, config));
+    }
+    if (config.runtime.compare("native") == 0) {
+        return std::make_unique<NativeModel>(config.model_path.c_str(), max_batch_size);
+    }
+    throw std::runtime_error(fmt::format("Invalid runtime selected: {}", config.runtime));
+}
+
+#if defined(_WIN32)
+static double get_process_cpu_secs() {
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time)) {
+        return 0.0;
+    }
+    const auto to_secs = [](const FILETIME& time) {
+        const uint64_t ticks = (uint64_t(time.dwHighDateTime) << 32) | uint64_t(time.dwLowDateTime);
+        return double(ticks) * 100e-9;
+    };
+    return to_secs(kernel_time) + to_secs(user_time);
+}
+#else
+static double get_process_cpu_secs() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0.0;
+    }
+    const auto to_secs = [](const struct timeval& time) {
+        return double(time.tv_sec) + double(time.tv_usec)*1e-6;
+    };
+    return to_secs(usage.ru_utime) + to_secs(usage.ru_stime);
+}
+#endif
+
+static std::vector<LatencyHistogram::Snapshot> get_snapshots(const LatencyStats& stats) {
+    std::vector<LatencyHistogram::Snapshot> snapshots(TOTAL_LATENCY_STAGES);
+    for (int i = 0; i < TOTAL_LATENCY_STAGES; i++) {
+        snapshots[i] = stats.Get(LatencyStage(i)).GetSnapshot();
+    }
+    return snapshots;
+}
+
+static void add_snapshot(LatencyHistogram::Snapshot& dst, const LatencyHistogram::Snapshot& src) {
+    for (int i = 0; i < LatencyHistogram::TOTAL_BUCKETS; i++) {
+        dst.counts[i] += src.counts[i];
+    }
+    dst.total_count += src.total_count;
+    dst.total_sum += src.total_sum;
+    dst.max_value = std::max(dst.max_value, src.max_value);
+}
+
+// each session runs on its own thread so that they can fill batches together
+// NOTE: Schedules are checked before the benchmark starts so they can't fail here
+static void run_sessions(std::vector<std::unique_ptr<SoccerPlayer>>& players, const int total_frames, const ThreadSchedule& schedule) {
+    std::vector<std::thread> threads;
+    for (auto& player: players) {
+        threads.emplace_back([&player, &schedule, total_frames]() {
+            TrySetCurrentThreadSchedule(schedule, "session");
+            for (int i = 0; i < total_frames; i++) {
+                player->Update(0, 0);
+            }
+        });
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+}
+
+// grabs of a real time display take far less than a frame so the warmup frames alone may not be
+// enough for the pacer to learn the frame interval before it is measured
+static void run_sessions_until_paced(std::vector<std::unique_ptr<SoccerPlayer>>& players, const ThreadSchedule& schedule) {
+    constexpr auto MAX_DURATION = std::chrono::seconds(2);
+    const auto deadline = std::chrono::steady_clock::now() + MAX_DURATION;
+    std::vector<std::thread> threads;
+    for (auto& player: players) {
+        threads.emplace_back([&player, &schedule, deadline]() {
+            TrySetCurrentThreadSchedule(schedule, "session");
+            while ((player->GetPacer().GetStats().frame_interval_ns == 0) && (std::chrono::steady_clock::now() < deadline)) {
+                player->Update(0, 0);
+            }
+        });
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+}
+
+static BenchResult run_benchmark(BenchConfig config, const BenchOptions& options) {
+    const size_t total_sessions = size_t(config.total_sessions);
+    const auto model_schedule = get_schedule(options.model_cpus, config);
+    OnnxDirectMLModel* onnx_model = nullptr;
+    const auto dt_load_start = std::chrono::steady_clock::now();
+    auto model = create_model(config, options, total_sessions, &onnx_model);
+    const auto dt_load_end = std::chrono::steady_clock::now();
+
+    BenchResult result;
+    result.load_secs = std::chrono::duration<double>(dt_load_end - dt_load_start).count();
+    result.is_loaded_from_cache = (onnx_model != nullptr) && onnx_model->IsLoadedFromCache();
+    // full batches are the steady state when sessions share the model
+    model->SetBatchSize(total_sessions);
+    run_scheduled(model_schedule, [&]() {
+        result.model_warmup = model->Warmup(options.total_model_warmup_iterations);
+    });
+    model->SetBatchSize(1);
+    result.model_input = model->GetInputBuffer();
+    result.model_input.data = nullptr;
+
+    // NOTE: The server must outlive the players since they hold its session models
+    std::unique_ptr<InferenceServer> server = nullptr;
+    if (total_sessions > 1) {
+        auto server_config = InferenceServer::Config{};
+        server_config.max_batch_delay = std::chrono::microseconds(options.batch_delay_us);
+        server_config.batch_schedule = model_schedule;
+        server = std::make_unique<InferenceServer>(std::move(model), total_sessions, server_config);
+    }
+
+    std::vector<std::unique_ptr<SoccerPlayer>> players;
+    std::vector<std::shared_ptr<FlightRecorder>> flight_recorders;
+    for (size_t i = 0; i < total_sessions; i++) {
+        // frame sources aren't thread safe so every session has its own
+        std::shared_ptr<IFrameSource> frame_source = nullptr;
+        if (!options.replay_path.empty()) {
+            auto replay = std::make_shared<ReplayFrameSource>(options.replay_path.c_str(), true);
+            const auto frame = replay->GetFrame(0);
+            config.capture_width = frame.width;
+            config.capture_height = frame.height;
+            frame_source = replay;
+        } else {
+            auto synthetic_config = SyntheticFrameSource::Config{};
+            synthetic_config.width = config.capture_width;
+            synthetic_config.height = config.capture_height;
+            synthetic_config.seed = uint32_t(i+1);
+            if (options.display_hz > 0) {
+                synthetic_config.frame_rate = float(options.display_hz);
+                synthetic_config.is_realtime = true;
+            }
+            frame_source = std::make_shared<SyntheticFrameSource>(synthetic_config);
+        }
+        std::shared_ptr<IMouseController> mouse = std::make_shared<NullMouseController>();
+        auto params = std::make_shared<SoccerParams>();
+        auto session_model = (server != nullptr) ? server->CreateSession() : std::move(model);
+        auto player = std::make_unique<SoccerPlayer>(std::move(session_model), frame_source, mouse, params);
+        player->SetEstimator(CreateEstimator(options.estimator_type, params));
+        if (!options.flight_log_path.empty()) {
+            auto flight_config = FlightRecorder::Config{};
+            flight_config.frame_scale = options.flight_log_scale;
+            const auto flight_log_path = (total_sessions > 1) ? fmt::format("{}.{}", options.flight_log_path, i) : options.flight_log_path;
+            auto recorder = std::make_shared<FlightRecorder>(flight_log_path, flight_config);
+            player->SetFlightRecorder(recorder);
+            flight_recorders.push_back(recorder);
+        }
+        if (!options.roi_model_path.empty()) {
+            // the region of interest model uses the same runtime and threading as the full frame model
+            auto roi_config = config;
+            roi_config.model_path = options.roi_model_path;
+            OnnxDirectMLModel* roi_onnx_model = nullptr;
+            auto roi_model = create_model(roi_config, options, 1, &roi_onnx_model);
+            const auto roi_input = roi_model->GetInputBuffer();
+            const int roi_width = (options.roi_width > 0) ? options.roi_width : int(roi_input.width);
+            const int roi_height = (options.roi_height > 0) ? options.roi_height : int(roi_input.height);
+            player->SetROIModel(std::move(roi_model), roi_width, roi_height);
+        }
+        // exercise the whole control stage including mouse input
+        auto& controls = player->GetControls();
+        controls.can_track = true;
+        controls.can_skip_unchanged = options.is_skip_unchanged;
+        controls.can_smart_click = true;
+        player->GetPacer().SetMode(config.pacing_mode);
+        players.push_back(std::move(player));
+    }
+
+    // NOTE: Warmup is always run without the pipeline since its threads would otherwise
+    //       still be running when we take the baseline
+    run_sessions(players, options.total_warmup_frames, model_schedule);
+    if ((options.display_hz > 0) && options.replay_path.empty() && options.is_skip_unchanged) {
+        run_sessions_until_paced(players, model_schedule);
+    }
+    std::vector<std::vector<LatencyHistogram::Snapshot>> baselines;
+    uint64_t baseline_roi_frames = 0;
+    uint64_t baseline_skipped_frames = 0;
+    for (const auto& player: players) {
+        baselines.push_back(get_snapshots(player->GetLatencyStats()));
+        baseline_roi_frames += player->GetLatestResult().total_roi_frames;
+        baseline_skipped_frames += player->GetLatestResult().total_skipped_frames;
+    }
+    OnnxDirectMLModel::AllocatorStats allocator_baseline;
+    if (onnx_model != nullptr) {
+        allocator_baseline = onnx_model->GetAllocatorStats();
+    }
+    std::vector<FramePacer::Stats> pacer_baselines;
+    for (auto& player: players) {
+        pacer_baselines.push_back(player->GetPacer().GetStats());
+    }
+    InferenceServer::Stats batch_baseline;
+    LatencyHistogram::Snapshot batch_latency_baseline;
+    if (server != nullptr) {
+        batch_baseline = server->GetStats();
+        batch_latency_baseline = server->GetBatchLatency().GetSnapshot();
+    }
+
+    const double cpu_start_secs = get_process_cpu_secs();
+    const auto dt_start = std::chrono::steady_clock::now();
+    auto dt_end = dt_start;
+    if (config.pipeline_depth == 0) {
+        run_sessions(players, options.total_frames, model_schedule);
+        dt_end = std::chrono::steady_clock::now();
+        result.total_captured = uint64_t(options.total_frames) * total_sessions;
+        result.total_dropped = 0;
+    } else {
+        auto pipeline_config = FramePipeline::Config{};
+        pipeline_config.depth = config.pipeline_depth;
+        pipeline_config.drop_stale = options.is_pipeline_drop_stale;
+        pipeline_config.capture_schedule = get_schedule(options.capture_cpus, config);
+        pipeline_config.inference_schedule = model_schedule;
+        std::vector<int> total_polled(total_sessions, 0);
+        std::atomic<size_t> total_capture_done = 0;
+        std::vector<std::unique_ptr<FramePipeline>> pipelines;
+        for (size_t i = 0; i < total_sessions; i++) {
+            pipelines.push_back(std::make_unique<FramePipeline>(*players[i], pipeline_config, [&, i](int& top, int& left) {
+                if (total_polled[i] >= options.total_frames) {
+                    if (total_polled[i] == options.total_frames) {
+                        total_polled[i]++;
+                        total_capture_done++;
+                    }
+                    return false;
+                }
+                total_polled[i]++;
+                top = 0;
+                left = 0;
+                return true;
+            }));
+        }
+        // every captured frame is either dropped by a stage or reaches the end of the control stage
+        while (true) {
+            if (total_capture_done == total_sessions) {
+                uint64_t total_captured = 0;
+                uint64_t total_dropped = 0;
+                uint64_t total_applied = 0;
+                for (size_t i = 0; i < total_sessions; i++) {
+                    const auto stats = pipelines[i]->GetStats();
+                    total_captured += stats.total_captured;
+                    total_dropped += stats.total_dropped;
+                    const uint64_t baseline_applied = baselines[i][int(LatencyStage::END_TO_END)].total_count;
+                    total_applied += players[i]->GetLatencyStats().Get(LatencyStage::END_TO_END).GetSnapshot().total_count - baseline_applied;
+                }
+                if (total_captured == (total_dropped + total_applied)) {
+                    dt_end = std::chrono::steady_clock::now();
+                    result.total_captured = total_captured;
+                    result.total_dropped = total_dropped;
+                    break;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    result.config = config;
+    result.duration_secs = std::chrono::duration<double>(dt_end - dt_start).count();
+    result.cpu_secs = get_process_cpu_secs() - cpu_start_secs;
+    for (size_t i = 0; i < total_sessions; i++) {
+        const auto stats = players[i]->GetPacer().GetStats();
+        const auto& baseline = pacer_baselines[i];
+        auto& dst = result.pacer_stats;
+        dst.total_grabs += stats.total_grabs - baseline.total_grabs;
+        dst.total_new_frames += stats.total_new_frames - baseline.total_new_frames;
+        dst.total_paced_waits += stats.total_paced_waits - baseline.total_paced_waits;
+        dst.total_sleep_ns += stats.total_sleep_ns - baseline.total_sleep_ns;
+        dst.total_yield_ns += stats.total_yield_ns - baseline.total_yield_ns;
+        dst.total_spin_ns += stats.total_spin_ns - baseline.total_spin_ns;
+        dst.frame_interval_ns += stats.frame_interval_ns / int64_t(total_sessions);
+        dst.wake_margin_ns += stats.wake_margin_ns / int64_t(total_sessions);
+        dst.sleep_overshoot_ns += stats.sleep_overshoot_ns / int64_t(total_sessions);
+    }
+    // latencies of every session are merged together
+    result.stages.resize(TOTAL_LATENCY_STAGES);
+    for (size_t i = 0; i < total_sessions; i++) {
+        // NOTE: Every frame has been through the control stage by now so the latest result is the last one
+        const auto& player = players[i];
+        result.total_roi_frames += player->GetLatestResult().total_roi_frames;
+        result.total_skipped_frames += player->GetLatestResult().total_skipped_frames;
+        const auto snapshots = get_snapshots(player->GetLatencyStats());
+        for (int j = 0; j < TOTAL_LATENCY_STAGES; j++) {
+            add_snapshot(result.stages[j], snapshots[j].GetDifference(baselines[i][j]));
+        }
+    }
+    result.total_roi_frames -= baseline_roi_frames;
+    result.total_skipped_frames -= baseline_skipped_frames;
+    if ((onnx_model != nullptr) && onnx_model->IsCountingAllocations()) {
+        const auto stats = onnx_model->GetAllocatorStats();
+        result.has_allocator_stats = true;
+        result.allocator_stats.total_requests = stats.total_requests - allocator_baseline.total_requests;
+        result.allocator_stats.total_allocations = stats.total_allocations - allocator_baseline.total_allocations;
+        result.allocator_stats.total_frees = stats.total_frees - allocator_baseline.total_frees;
+        result.allocator_stats.total_bytes = stats.total_bytes;
+    }
+    if (server != nullptr) {
+        const auto stats = server->GetStats();
+        result.has_batch_stats = true;
+        result.batch_stats.total_batches = stats.total_batches - batch_baseline.total_batches;
+        result.batch_stats.total_requests = stats.total_requests - batch_baseline.total_requests;
+        result.batch_stats.total_partial_batches = stats.total_partial_batches - batch_baseline.total_partial_batches;
+        result.batch_stats.total_failed_batches = stats.total_failed_batches - batch_baseline.total_failed_batches;
+        result.batch_latency = server->GetBatchLatency().GetSnapshot().GetDifference(batch_latency_baseline);
+    }
+    for (const auto& recorder: flight_recorders) {
+        const auto stats = recorder->GetStats();
+        auto& dst = result.flight_stats;
+        result.has_flight_stats = true;
+        dst.total_frames += stats.total_frames;
+        dst.total_events += stats.total_events;
+        dst.total_dropped_frames += stats.total_dropped_frames;
+        dst.total_dropped_events += stats.total_dropped_events;
+        dst.total_chunks += stats.total_chunks;
+        dst.total_bytes += stats.total_bytes;
+        dst.total_failed_writes += stats.total_failed_writes;
+        dst.total_failed_opens += stats.total_failed_opens;
+    }
+    // NOTE: Players are destroyed first since they hold the server's session models
+    players.clear();
+    return result;
+}
+
+static void print_summary(const BenchResult& result) {
+    const auto& config = result.config;
+    const auto& end_to_end = result.stages[int(LatencyStage::END_TO_END)];
+    const auto& inference = result.stages[int(LatencyStage::INFERENCE)];
+    const double fps = (result.duration_secs > 0.0) ? (double(end_to_end.total_count) / result.duration_secs) : 0.0;
+    fmt::print(stderr,
+        "{} runtime={} threads={}{} capture={}x{} depth={} sessions={} priority={} pacing={}: {:.1f} fps, cpu={:.0f}%, "
+        "inference p50={:.1f}us p99={:.1f}us, end_to_end p50={:.1f}us p99={:.1f}us\n",
+        config.model_path, config.runtime, config.total_threads, config.is_sequential ? " (sequential)" : "",
+        config.capture_width, config.capture_height, config.pipeline_depth, config.total_sessions,
+        GetThreadPriorityString(config.thread_priority), GetPacingModeString(config.pacing_mode), fps,
+        (result.duration_secs > 0.0) ? (100.0 * result.cpu_secs / result.duration_secs) : 0.0,
+        ns_to_us(inference.GetPercentile(50.0)), ns_to_us(inference.GetPercentile(99.0)),
+        ns_to_us(end_to_end.GetPercentile(50.0)), ns_to_us(end_to_end.GetPercentile(99.0)));
+    const auto& warmup = result.model_warmup;
+    if (warmup.total_iterations > 0) {
+        fmt::print(stderr, "    model warmup: {} calls{}, cold={:.1f}us warm={:.1f}us\n",
+            warmup.total_iterations, warmup.is_converged ? "" : " (not converged)",
+            ns_to_us(warmup.first_ns), ns_to_us(warmup.converged_ns));
+    }
+}
+
+static void write_results(FILE* fp, const std::vector<BenchResult>& results, const BenchOptions& options) {
+    fmt::print(fp, "{{\n");
+    fmt::print(fp, "  \"frames\": {},\n", options.total_frames);
+    fmt::print(fp, "  \"warmup_frames\": {},\n", options.total_warmup_frames);
+    fmt::print(fp, "  \"model_warmup_iterations\": {},\n", options.total_model_warmup_iterations);
+    fmt::print(fp, "  \"frame_source\": \"{}\",\n", options.replay_path.empty() ? "synthetic" : json_escape(options.replay_path));
+    fmt::print(fp, "  \"display_hz\": {},\n", options.display_hz);
+    fmt::print(fp, "  \"pipeline_drop_stale\": {},\n", options.is_pipeline_drop_stale);
+    fmt::print(fp, "  \"skip_unchanged\": {},\n", options.is_skip_unchanged);
+    fmt::print(fp, "  \"estimator\": \"{}\",\n", GetEstimatorTypeString(options.estimator_type));
+    if (!options.flight_log_path.empty()) {
+        fmt::print(fp, "  \"flight_log\": \"{}\",\n", json_escape(options.flight_log_path));
+        fmt::print(fp, "  \"flight_log_scale\": {},\n", options.flight_log_scale);
+    }
+    fmt::print(fp, "  \"batch_delay_us\": {},\n", options.batch_delay_us);
+    fmt::print(fp, "  \"model_cpus\": \"{}\",\n", GetCpuListString(options.model_cpus));
+    fmt::print(fp, "  \"capture_cpus\": \"{}\",\n", GetCpuListString(options.capture_cpus));
+    fmt::print(fp, "  \"worker_cpus\": \"{}\",\n", GetCpuListString(options.worker_cpus));
+    if (!options.roi_model_path.empty()) {
+        fmt::print(fp, "  \"roi_model\": \"{}\",\n", json_escape(options.roi_model_path));
+    }
+    fmt::print(fp, "  \"results\": [");
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto& result = results[i];
+        const auto& config = result.config;
+        const auto& end_to_end = result.stages[int(LatencyStage::END_TO_END)];
+        const double fps = (result.duration_secs > 0.0) ? (double(end_to_end.total_count) / result.duration_secs) : 0.0;
+        fmt::print(fp, "{}\n    {{\n", (i == 0) ? "" : ",");
+        fmt::print(fp, "      \"model\": \"{}\",\n", json_escape(config.model_path));
+        fmt::print(fp, "      \"runtime\": \"{}\",\n", config.runtime);
+        fmt::print(fp, "      \"threads\": {},\n", config.total_threads);
+        fmt::print(fp, "      \"sequential\": {},\n", config.is_sequential);
+        fmt::print(fp, "      \"load_ms\": {:.3f},\n", result.load_secs*1e3);
+        {
+            // the first call is the cold latency and the median of the last window is the warm latency
+            const auto& warmup = result.model_warmup;
+            fmt::print(fp, "      \"model_warmup\": {{\"iterations\": {}, \"converged\": {}, \"cold_us\": {:.3f}, "
+                "\"warm_us\": {:.3f}, \"max_us\": {:.3f}, \"total_ms\": {:.3f}}},\n",
+                warmup.total_iterations, warmup.is_converged, ns_to_us(warmup.first_ns),
+                ns_to_us(warmup.converged_ns), ns_to_us(warmup.max_ns), double(warmup.total_ns)*1e-6);
+        }
+        if (!options.onnx_cache_directory.empty()) {
+            fmt::print(fp, "      \"loaded_from_cache\": {},\n", result.is_loaded_from_cache);
+        }
+        fmt::print(fp, "      \"input\": {{\"width\": {}, \"height\": {}, \"type\": \"{}\"}},\n",
+            result.model_input.width, result.model_input.height, GetInputTypeString(result.model_input.type));
+        fmt::print(fp, "      \"capture\": {{\"width\": {}, \"height\": {}}},\n", config.capture_width, config.capture_height);
+        fmt::print(fp, "      \"pipeline_depth\": {},\n", config.pipeline_depth);
+        fmt::print(fp, "      \"sessions\": {},\n", config.total_sessions);
+        fmt::print(fp, "      \"thread_priority\": \"{}\",\n", GetThreadPriorityString(config.thread_priority));
+        fmt::print(fp, "      \"pacing\": \"{}\",\n", GetPacingModeString(config.pacing_mode));
+        fmt::print(fp, "      \"duration_s\": {:.6f},\n", result.duration_secs);
+        fmt::print(fp, "      \"captured\": {},\n", result.total_captured);
+        fmt::print(fp, "      \"dropped\": {},\n", result.total_dropped);
+        fmt::print(fp, "      \"completed\": {},\n", end_to_end.total_count);
+        fmt::print(fp, "      \"skipped_unchanged\": {},\n", result.total_skipped_frames);
+        if (!options.roi_model_path.empty()) {
+            fmt::print(fp, "      \"roi_frames\": {},\n", result.total_roi_frames);
+        }
+        fmt::print(fp, "      \"frames_per_second\": {:.3f},\n", fps);
+        // in cores so that 1.0 is one core busy for the whole run
+        fmt::print(fp, "      \"cpu_usage\": {:.3f},\n", (result.duration_secs > 0.0) ? (result.cpu_secs / result.duration_secs) : 0.0);
+        {
+            const auto& stats = result.pacer_stats;
+            fmt::print(fp, "      \"pacer\": {{\"grabs\": {}, \"new_frames\": {}, \"paced_waits\": {}, "
+                "\"sleep_ms\": {:.3f}, \"yield_ms\": {:.3f}, \"spin_ms\": {:.3f}, "
+                "\"frame_interval_us\": {:.3f}, \"wake_margin_us\": {:.3f}, \"sleep_overshoot_us\": {:.3f}}},\n",
+                stats.total_grabs, stats.total_new_frames, stats.total_paced_waits,
+                double(stats.total_sleep_ns)*1e-6, double(stats.total_yield_ns)*1e-6, double(stats.total_spin_ns)*1e-6,
+                double(stats.frame_interval_ns)*1e-3, double(stats.wake_margin_ns)*1e-3, double(stats.sleep_overshoot_ns)*1e-3);
+        }
+        if (result.has_flight_stats) {
+            // NOTE: Counts what the writer had finished when the run ended
+            const auto& stats = result.flight_stats;
+            fmt::print(fp, "      \"flight_recorder\": {{\"frames\": {}, \"events\": {}, \"dropped_frames\": {}, "
+                "\"dropped_events\": {}, \"chunks\": {}, \"bytes\": {}, \"failed_writes\": {}, \"failed_opens\": {}}},\n",
+                stats.total_frames, stats.total_events, stats.total_dropped_frames,
+                stats.total_dropped_events, stats.total_chunks, stats.total_bytes,
+                stats.total_failed_writes, stats.total_failed_opens);
+        }
+        if (result.has_allocator_stats) {
+            fmt::print(fp, "      \"allocator\": {{\"requests\": {}, \"heap_allocations\": {}, \"frees\": {}, \"bytes\": {}}},\n",
+                result.allocator_stats.total_requests, result.allocator_stats.total_allocations,
+                result.allocator_stats.total_frees, result.allocator_stats.total_bytes);
+        }
+        if (result.has_batch_stats) {
+            const auto& stats = result.batch_stats;
+            const auto& latency = result.batch_latency;
+            const double mean_size = (stats.total_batches > 0) ? (double(stats.total_requests) / double(stats.total_batches)) : 0.0;
+            fmt::print(fp, "      \"batches\": {{\"count\": {}, \"requests\": {}, \"partial\": {}, \"failed\": {}, \"mean_size\": {:.3f}, "
+                "\"mean_us\": {:.3f}, \"p50_us\": {:.3f}, \"p99_us\": {:.3f}}},\n",
+                stats.total_batches, stats.total_requests, stats.total_partial_batches, stats.total_failed_batches, mean_size,
+                latency.GetMean()*1e-3, ns_to_us(latency.GetPercentile(50.0)), ns_to_us(latency.GetPercentile(99.0)));
+        }
+        fmt::print(fp, "      \"stages\": {{");
+        for (int j = 0; j < TOTAL_LATENCY_STAGES; j++) {
+            const auto& snapshot = result.stages[j];
+            fmt::print(fp,
+                "{}\n        \"{}\": {{\"count\": {}, \"mean_us\": {:.3f}, \"p50_us\": {:.3f}, \"p90_us\": {:.3f}, "
+                "\"p99_us\": {:.3f}, \"p999_us\": {:.3f}, \"max_us\": {:.3f}",
+                (j == 0) ? "" : ",", GetLatencyStageString(LatencyStage(j)), snapshot.total_count,
+                snapshot.GetMean()*1e-3,
+                ns_to_us(snapshot.GetPercentile(50.0)), ns_to_us(snapshot.GetPercentile(90.0)),
+                ns_to_us(snapshot.GetPercentile(99.0)), ns_to_us(snapshot.GetPercentile(99.9)),
+                ns_to_us(snapshot.max_value));
+            if (options.is_dump_buckets) {
+                // non empty buckets as [lower_ns, upper_ns, count]
+                fmt::print(fp, ", \"buckets\": [");
+                bool is_first = true;
+                for (int k = 0; k < LatencyHistogram::TOTAL_BUCKETS; k++) {
+                    if (snapshot.counts[k] == 0) continue;
+                    fmt::print(fp, "{}[{}, {}, {}]", is_first ? "" : ", ",
+                        LatencyHistogram::GetBucketLowerBound(k), LatencyHistogram::GetBucketUpperBound(k), snapshot.counts[k]);
+                    is_first = false;
+                }
+                fmt::print(fp, "]");
+            }
+            fmt::print(fp, "}}");
+        }
+        fmt::print(fp, "\n      }}\n    }}");
+    }
+    fmt::print(fp, "\n  ]\n}}\n");
+}
+
+int _main(int argc, char** argv) {
+    auto parser = argparse::ArgumentParser("SoccerBot Benchmark", "2.0.0");
+    parser.add_argument("--model")
+        .required()
+        .help("Comma separated list of models to benchmark");
+    parser.add_argument("--roi-model")
+        .default_value(std::string(""))
+        .help("Path to a region of interest model to run alongside each model. Uses the same runtime and threads as each model.");
+    parser.add_argument("--roi-size")
+        .default_value(std::string(""))
+        .help("WIDTHxHEIGHT of the crop given to --roi-model. If not provided the model input size is used.");
+    parser.add_argument("--runtime")
+        .default_value(std::string("auto"))
+        .help("Type of runtime for the models. Options: [auto, onnx, tflite, native]. auto selects from the file extension.");
+    parser.add_argument("--tflite-cpus")
+        .default_value(std::string("1"))
+        .help("Comma separated list of thread counts for tflite. If 0 is provided then number of logical processors is used.");
+    parser.add_argument("--onnx-cpu-threads")
+        .default_value(std::string("0"))
+        .help("Comma separated list of thread counts for the onnx cpu backend. If 0 is provided then onnx decides.");
+    parser.add_argument("--onnx-cpu-execution")
+        .default_value(std::string("parallel"))
+        .help("Comma separated list of onnx cpu execution modes. Options: [parallel, sequential]");
+    parser.add_argument("--onnx-cpu-count-allocations")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Replaces the onnx cpu arena with a caching allocator and reports its heap allocations");
+    parser.add_argument("--onnx-cache-dir")
+        .default_value(std::string(""))
+        .help("Directory to cache optimised onnx cpu models in. The first configuration of each model fills the cache.");
+    parser.add_argument("--capture-sizes")
+        .default_value(std::string("322x455"))
+        .help("Comma separated list of WIDTHxHEIGHT synthetic frame sizes. Ignored when replaying a recording.");
+    parser.add_argument("--replay")
+        .default_value(std::string(""))
+        .help("Path to a raw frame recording to use instead of synthetic frames");
+    parser.add_argument("--display-hz")
+        .default_value(0)
+        .scan<'i', int>()
+        .help("Refresh rate that synthetic frames change at in real time so that pacing can be measured. If 0 is provided then every grab is a new frame.");
+    parser.add_argument("--pacing")
+        .default_value(std::string("off"))
+        .help("Comma separated list of frame pacing modes. Options: [off, latency, balanced, power]");
+    parser.add_argument("--pipeline-depths")
+        .default_value(std::string("0"))
+        .help("Comma separated list of pipeline depths. If 0 is provided then stages run serially on one thread.");
+    parser.add_argument("--pipeline-keep-stale")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Process every buffered frame in order instead of skipping to the newest one");
+    parser.add_argument("--no-skip-unchanged")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Run the model on every frame even if it is identical to the previous one");
+    parser.add_argument("--estimator")
+        .default_value(std::string("difference"))
+        .help("Estimator that tracks the ball in the control stage. Options: [difference, kalman]. Use soccerbot_estimator_bench to compare their accuracy.");
+    parser.add_argument("--flight-log")
+        .default_value(std::string(""))
+        .help("Path to record a flight log of every session to so its overhead can be measured. Sessions after the first append their index and each configuration overwrites the last.");
+    parser.add_argument("--flight-log-scale")
+        .default_value(4)
+        .scan<'i', int>()
+        .help("Flight log thumbnails keep every nth pixel in each direction. If 0 is provided then only predictions are recorded.");
+    parser.add_argument("--sessions")
+        .default_value(std::string("1"))
+        .help("Comma separated list of session counts. Sessions above 1 share one batched model like windows of the same process.");
+    parser.add_argument("--batch-delay-us")
+        .default_value(2000)
+        .scan<'i', int>()
+        .help("Longest time in microseconds a session waits for the others to fill a batch");
+    parser.add_argument("--model-cpus")
+        .default_value(std::string(""))
+        .help("Comma separated list of cpus or ranges such as 0-3,6 to pin the threads that run the model to. If not provided the os chooses.");
+    parser.add_argument("--capture-cpus")
+        .default_value(std::string(""))
+        .help("Cpus to pin the pipeline capture threads to. If not provided the os chooses.");
+    parser.add_argument("--worker-cpus")
+        .default_value(std::string(""))
+        .help("Cpus to pin the onnx cpu and tflite worker threads to, one worker per cpu. Tflite workers are only pinned on linux.");
+    parser.add_argument("--thread-priorities")
+        .default_value(std::string("normal"))
+        .help("Comma separated list of priorities for the model, capture and worker threads. Options: [normal, high, realtime]");
+    parser.add_argument("--frames")
+        .default_value(1000)
+        .scan<'i', int>()
+        .help("Number of frames to measure for each configuration");
+    parser.add_argument("--warmup-frames")
+        .default_value(100)
+        .scan<'i', int>()
+        .help("Number of frames to run before measuring each configuration");
+    parser.add_argument("--model-warmup-iterations")
+        .default_value(200)
+        .scan<'i', int>()
+        .help("Max number of synthetic inputs to run through each model until its latency settles. If 0 is provided then the warmup frames measure the cold model.");
+    parser.add_argument("--dump-buckets")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Include the non empty histogram buckets of each stage in the output");
+    parser.add_argument("--output")
+        .default_value(std::string(""))
+        .help("Path to write json results to. If not provided results are written to stdout.");
+
+    try {
+        parser.parse_args(argc, argv);
+    } catch (const std::runtime_error& ex) {
+        std::cerr << ex.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    auto options = BenchOptions{};
+    options.total_frames = parser.get<int>("--frames");
+    options.total_warmup_frames = parser.get<int>("--warmup-frames");
+    options.total_model_warmup_iterations = parser.get<int>("--model-warmup-iterations");
+    options.replay_path = parser.get<std::string>("--replay");
+    options.display_hz = parser.get<int>("--display-hz");
+    options.is_count_allocations = parser.get<bool>("--onnx-cpu-count-allocations");
+    options.onnx_cache_directory = parser.get<std::string>("--onnx-cache-dir");
+    options.is_pipeline_drop_stale = !parser.get<bool>("--pipeline-keep-stale");
+    options.is_dump_buckets = parser.get<bool>("--dump-buckets");
+    options.is_skip_unchanged = !parser.get<bool>("--no-skip-unchanged");
+    options.estimator_type = ParseEstimatorType(parser.get<std::string>("--estimator"));
+    options.flight_log_path = parser.get<std::string>("--flight-log");
+    options.flight_log_scale = parser.get<int>("--flight-log-scale");
+    options.batch_delay_us = parser.get<int>("--batch-delay-us");
+    options.roi_model_path = parser.get<std::string>("--roi-model");
+    options.model_cpus = ParseCpuList(parser.get<std::string>("--model-cpus"));
+    options.capture_cpus = ParseCpuList(parser.get<std::string>("--capture-cpus"));
+    options.worker_cpus = ParseCpuList(parser.get<std::string>("--worker-cpus"));
+    const auto roi_size = parser.get<std::string>("--roi-size");
+    if (!roi_size.empty()) {
+        const auto size = parse_size_list(roi_size, "--roi-size");
+        if (size.size() != 1) {
+            throw std::runtime_error(fmt::format("Expected a single size for --roi-size (got {})", size.size()));
+        }
+        options.roi_width = size[0].first;
+        options.roi_height = size[0].second;
+    }
+    if (options.total_frames <= 0) {
+        throw std::runtime_error(fmt::format("Number of frames must be positive (got {})", options.total_frames));
+    }
+    if (options.total_warmup_frames < 0) {
+        throw std::runtime_error(fmt::format("Number of warmup frames can't be negative (got {})", options.total_warmup_frames));
+    }
+    if (options.total_model_warmup_iterations < 0) {
+        throw std::runtime_error(fmt::format("Number of model warmup iterations can't be negative (got {})", options.total_model_warmup_iterations));
+    }
+    if (options.display_hz < 0) {
+        throw std::runtime_error(fmt::format("Display refresh rate can't be negative (got {})", options.display_hz));
+    }
+    if (options.batch_delay_us < 0) {
+        throw std::runtime_error(fmt::format("Batch delay can't be negative (got {})", options.batch_delay_us));
+    }
+
+    const auto model_paths = split_list(parser.get<std::string>("--model"));
+    if (model_paths.empty()) {
+        throw std::runtime_error("Expected at least one model");
+    }
+    const auto tflite_threads = parser.get<std::string>("--tflite-cpus");
+    const auto onnx_threads = parser.get<std::string>("--onnx-cpu-threads");
+    std::vector<bool> onnx_sequential;
+    for (const auto& mode: split_list(parser.get<std::string>("--onnx-cpu-execution"))) {
+        if (mode.compare("parallel") == 0) {
+            onnx_sequential.push_back(false);
+        } else if (mode.compare("sequential") == 0) {
+            onnx_sequential.push_back(true);
+        } else {
+            throw std::runtime_error(fmt::format("Invalid onnx cpu execution mode: {}", mode));
+        }
+    }
+    if (onnx_sequential.empty()) {
+        throw std::runtime_error("Expected at least one onnx cpu execution mode");
+    }
+    // replayed recordings have a fixed size so only run each configuration once
+    auto capture_sizes = parse_size_list(parser.get<std::string>("--capture-sizes"), "--capture-sizes");
+    if (!options.replay_path.empty()) {
+        capture_sizes.resize(1);
+    }
+    const auto pipeline_depths = parse_int_list(parser.get<std::string>("--pipeline-depths"), "--pipeline-depths");
+    for (const int depth: pipeline_depths) {
+        if (depth < 0) {
+            throw std::runtime_error(fmt::format("Pipeline depth can't be negative (got {})", depth));
+        }
+    }
+    const auto session_counts = parse_int_list(parser.get<std::string>("--sessions"), "--sessions");
+    for (const int total_sessions: session_counts) {
+        if (total_sessions < 1) {
+            throw std::runtime_error(fmt::format("Number of sessions must be positive (got {})", total_sessions));
+        }
+    }
+
+    // fail now instead of measuring unscheduled threads if we aren't allowed to use a schedule
+    std::vector<ThreadPriority> thread_priorities;
+    for (const auto& priority: split_list(parser.get<std::string>("--thread-priorities"))) {
+        thread_priorities.push_back(ParseThreadPriority(priority));
+    }
+    if (thread_priorities.empty()) {
+        throw std::runtime_error("Expected at least one thread priority");
+    }
+    for (const auto priority: thread_priorities) {
+        for (const auto* cpus: { &options.model_cpus, &options.capture_cpus, &options.worker_cpus }) {
+            auto schedule = ThreadSchedule{};
+            schedule.cpus = *cpus;
+            schedule.priority = priority;
+            run_scheduled(schedule, []() {});
+        }
+    }
+
+    std::vector<PacingMode> pacing_modes;
+    for (const auto& mode: split_list(parser.get<std::string>("--pacing"))) {
+        pacing_modes.push_back(ParsePacingMode(mode));
+    }
+    if (pacing_modes.empty()) {
+        throw std::runtime_error("Expected at least one pacing mode");
+    }
+
+    // cartesian product of every sweep
+    std::vector<BenchConfig> configs;
+    const auto runtime = parser.get<std::string>("--runtime");
+    for (const auto& model_path: model_paths) {
+        auto base_config = BenchConfig{};
+        base_config.model_path = model_path;
+        base_config.runtime = get_runtime(runtime, model_path);
+        std::vector<BenchConfig> runtime_configs;
+        if (base_config.runtime.compare("onnx") == 0) {
+            for (const int total_threads: parse_int_list(onnx_threads, "--onnx-cpu-threads")) {
+                for (const bool is_sequential: onnx_sequential) {
+                    auto config = base_config;
+                    config.total_threads = total_threads;
+                    config.is_sequential = is_sequential;
+                    runtime_configs.push_back(config);
+                }
+            }
+        } else if (base_config.runtime.compare("tflite") == 0) {
+            for (int total_threads: parse_int_list(tflite_threads, "--tflite-cpus")) {
+                if (total_threads == 0) {
+                    total_threads = int(std::thread::hardware_concurrency());
+                }
+                auto config = base_config;
+                config.total_threads = total_threads;
+                runtime_configs.push_back(config);
+            }
+        } else if (base_config.runtime.compare("native") == 0) {
+            // native models always run on the calling thread
+            auto config = base_config;
+            config.total_threads = 1;
+            runtime_configs.push_back(config);
+        } else {
+            throw std::runtime_error(fmt::format("Invalid runtime selected: {}", base_config.runtime));
+        }
+        for (const auto& runtime_config: runtime_configs) {
+            for (const auto& size: capture_sizes) {
+                for (const int depth: pipeline_depths) {
+                    for (const int total_sessions: session_counts) {
+                        for (const auto priority: thread_priorities) {
+                            for (const auto pacing_mode: pacing_modes) {
+                                auto config = runtime_config;
+                                config.capture_width = size.first;
+                                config.capture_height = size.second;
+                                config.pipeline_depth = depth;
+                                config.total_sessions = total_sessions;
+                                config.thread_priority = priority;
+                                config.pacing_mode = pacing_mode;
+                                configs.push_back(config);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // NOTE: Progress goes to stderr so that stdout only has the json results
+    std::vector<BenchResult> results;
+    for (size_t i = 0; i < configs.size(); i++) {
+        fmt::print(stderr, "[{}/{}] ", i+1, configs.size());
+        results.push_back(run_benchmark(configs[i], options));
+        print_summary(results.back());
+    }
+
+    const auto output_path = parser.get<std::string>("--output");
+    if (output_path.empty()) {
+        write_results(stdout, results, options);
+        fflush(stdout);
+        return 0;
+    }
+    FILE* fp = fopen(output_path.c_str(), "w");
+    if (fp == nullptr) {
+        throw std::runtime_error(fmt::format("Failed to open output file '{}'", output_path));
+    }
+    write_results(fp, results, options);
+    fclose(fp);
+    fmt::print(stderr, "Wrote results to: {}\n", output_path);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    try {
+        return _main(argc, argv);
+    } catch (std::exception& ex) {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
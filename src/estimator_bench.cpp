@@ -0,0 +1,407 @@
+// Accuracy and speed of the ball estimators on recorded or simulated trajectories
+// Each observation is filtered as if it was applied some latency after its frame and the projected
+// position is compared against the ground truth, or the later observations if there is none, at the
+// time our input would land
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <argparse/argparse.hpp>
+#include <fmt/core.h>
+
+#include "FlightLogReader.h"
+#include "IEstimator.h"
+#include "LatencyHistogram.h"
+#include "SoccerParams.h"
+#include "SyntheticFrameSource.h"
+#include "ToolUtils.h"
+#include "Trajectory.h"
+
+struct EstimatorBenchOptions {
+    // simulated if there are no recorded trajectories
+    int total_frames = 20000;
+    uint32_t seed = 1;
+    float frame_rate = 60.0f;
+    // standard deviation of simulated predictions at full confidence in normalised screen units
+    float noise = 0.004f;
+    // chance that a visible ball is missed by the simulated model
+    float dropout = 0.05f;
+    // between the frame being captured and the estimator output being used
+    float latency_ms = 8.0f;
+    // how far ahead the time to impact is checked against the truth
+    float impact_horizon_secs = 1.0f;
+};
+
+// error distribution in the units of the values
+struct ErrorSummary {
+    size_t count = 0;
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+struct EstimatorResult {
+    EstimatorType type = EstimatorType::DIFFERENCE;
+    std::string trajectory_name;
+    bool has_truth = false;
+    size_t total_samples = 0;
+    size_t total_tracked = 0;
+    ErrorSummary position_error;
+    ErrorSummary velocity_error;
+    ErrorSummary impact_error_ms;
+    // falling faster than the hard trigger speed according to the estimator but not the truth and vice versa
+    size_t total_false_fast_falls = 0;
+    size_t total_missed_fast_falls = 0;
+    LatencyHistogram::Snapshot update_latency;
+};
+
+// the synthetic scene with the model replaced by noisy observations of its ground truth
+static std::vector<TrajectorySample> simulate_trajectory(const EstimatorBenchOptions& options) {
+    auto config = SyntheticFrameSource::Config{};
+    config.seed = options.seed;
+    config.frame_rate = options.frame_rate;
+    SyntheticFrameSource source(config);
+
+    std::mt19937 rng(options.seed);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<TrajectorySample> samples;
+    samples.reserve(size_t(options.total_frames));
+    for (int i = 0; i < options.total_frames; i++) {
+        if (i > 0) {
+            source.Grab(0, 0);
+        }
+        const auto state = source.GetBallState();
+        TrajectorySample sample;
+        sample.time_us = int64_t(double(i) * 1e6 / double(options.frame_rate));
+        sample.has_truth = true;
+        sample.truth.x = state.x;
+        sample.truth.y = state.y;
+        sample.truth.vx = state.vx;
+        sample.truth.vy = state.vy;
+        sample.truth.is_visible = state.is_visible;
+        const bool is_detected = state.is_visible && (uniform(rng) >= options.dropout);
+        if (is_detected) {
+            // less confident predictions are further off like a real model
+            const float confidence = 0.6f + 0.4f*uniform(rng);
+            const float noise = options.noise / confidence;
+            sample.observation = Prediction { state.x + noise*normal(rng), state.y + noise*normal(rng), confidence };
+        } else {
+            sample.observation = Prediction { uniform(rng), uniform(rng), 0.4f*uniform(rng) };
+        }
+        samples.push_back(sample);
+    }
+    return samples;
+}
+
+// seconds after a time when the reference first falls through a height, negative if it doesn't within the horizon
+static float get_reference_time_to_height(
+    const std::vector<TrajectorySample>& samples, const SoccerParams& params,
+    size_t index, const int64_t time_us, const float height, const float horizon_secs)
+{
+    float x_prev, y_prev;
+    if (!GetReferencePositionAt(samples, params.confidence_threshold, index, time_us, x_prev, y_prev)) {
+        return -1.0f;
+    }
+    if (y_prev <= height) {
+        return 0.0f;
+    }
+    int64_t t_prev = time_us;
+    const int64_t t_end = time_us + int64_t(horizon_secs * 1e6f);
+    for (size_t i = index+1; (i < samples.size()) && (samples[i].time_us <= t_end); i++) {
+        float x, y;
+        if (!GetReferencePosition(samples[i], params.confidence_threshold, x, y)) {
+            return -1.0f;
+        }
+        if (y <= height) {
+            const float alpha = (y_prev - height) / (y_prev - y);
+            const float t_cross = float(t_prev) + alpha*float(samples[i].time_us - t_prev);
+            return (t_cross - float(time_us)) * 1e-6f;
+        }
+        y_prev = y;
+        t_prev = samples[i].time_us;
+    }
+    return -1.0f;
+}
+
+static ErrorSummary summarise_errors(std::vector<float>& errors) {
+    ErrorSummary summary;
+    summary.count = errors.size();
+    if (errors.empty()) {
+        return summary;
+    }
+    std::sort(errors.begin(), errors.end());
+    double sum = 0.0;
+    for (const float error: errors) {
+        sum += double(error);
+    }
+    const auto get_percentile = [&](const double percentile) {
+        const size_t index = std::min(size_t(percentile/100.0 * double(errors.size())), errors.size()-1);
+        return double(errors[index]);
+    };
+    summary.mean = sum / double(errors.size());
+    summary.p50 = get_percentile(50.0);
+    summary.p90 = get_percentile(90.0);
+    summary.p99 = get_percentile(99.0);
+    summary.max = double(errors.back());
+    return summary;
+}
+
+static EstimatorResult run_estimator(
+    const EstimatorType type, const std::string& trajectory_name,
+    const std::vector<TrajectorySample>& samples, std::shared_ptr<SoccerParams>& params,
+    const EstimatorBenchOptions& options)
+{
+    const auto& p = *params;
+    auto estimator = CreateEstimator(type, params);
+    const int64_t latency_us = int64_t(options.latency_ms * 1000.0f);
+    const int64_t input_delay_us = int64_t(p.input_delay_secs * 1e6f);
+
+    EstimatorResult result;
+    result.type = type;
+    result.trajectory_name = trajectory_name;
+    result.has_truth = !samples.empty() && samples.front().has_truth;
+    result.total_samples = samples.size();
+    LatencyHistogram update_latency;
+    std::vector<float> position_errors;
+    std::vector<float> velocity_errors;
+    std::vector<float> impact_errors_ms;
+    size_t reference_index = 0;
+    for (size_t i = 0; i < samples.size(); i++) {
+        const auto& sample = samples[i];
+        const int64_t apply_us = sample.time_us + latency_us;
+        const auto dt_start = std::chrono::steady_clock::now();
+        const auto output = estimator->Filter(sample.observation, sample.time_us, apply_us);
+        const auto dt_end = std::chrono::steady_clock::now();
+        update_latency.Record(dt_end - dt_start);
+        if (output.prediction.confidence < p.confidence_threshold) {
+            continue;
+        }
+        result.total_tracked++;
+
+        // the output is projected to when the input lands
+        const int64_t target_us = apply_us + input_delay_us;
+        reference_index = std::max(reference_index, i);
+        float x, y;
+        if (GetReferencePositionAt(samples, p.confidence_threshold, reference_index, target_us, x, y)) {
+            position_errors.push_back(hypotf(output.prediction.x - x, output.prediction.y - y));
+        }
+        if (output.time_to_impact > 0.0f) {
+            const float time_to_impact = get_reference_time_to_height(
+                samples, p, reference_index, target_us, p.height_trigger_hard, options.impact_horizon_secs);
+            if (time_to_impact >= 0.0f) {
+                impact_errors_ms.push_back(fabsf(output.time_to_impact - time_to_impact) * 1000.0f);
+            }
+        }
+        if (sample.has_truth && sample.truth.is_visible) {
+            velocity_errors.push_back(hypotf(output.velocity.x - sample.truth.vx, output.velocity.y - sample.truth.vy));
+            const bool is_fast_fall = output.velocity.y <= -p.fall_speed_trigger_hard;
+            const bool is_true_fast_fall = sample.truth.vy <= -p.fall_speed_trigger_hard;
+            if (is_fast_fall && !is_true_fast_fall) result.total_false_fast_falls++;
+            if (!is_fast_fall && is_true_fast_fall) result.total_missed_fast_falls++;
+        }
+    }
+    result.position_error = summarise_errors(position_errors);
+    result.velocity_error = summarise_errors(velocity_errors);
+    result.impact_error_ms = summarise_errors(impact_errors_ms);
+    result.update_latency = update_latency.GetSnapshot();
+    return result;
+}
+
+static void print_summary(const EstimatorResult& result) {
+    fmt::print(stderr,
+        "{} on {}: tracked {}/{}, position p50={:.4f} p99={:.4f}, velocity p50={:.3f} p99={:.3f}, "
+        "impact p50={:.1f}ms p99={:.1f}ms, false_fast_falls={} missed_fast_falls={}, update p50={}ns\n",
+        GetEstimatorTypeString(result.type), result.trajectory_name, result.total_tracked, result.total_samples,
+        result.position_error.p50, result.position_error.p99,
+        result.velocity_error.p50, result.velocity_error.p99,
+        result.impact_error_ms.p50, result.impact_error_ms.p99,
+        result.total_false_fast_falls, result.total_missed_fast_falls,
+        result.update_latency.GetPercentile(50.0));
+}
+
+static void write_error_summary(FILE* fp, const char* name, const ErrorSummary& summary) {
+    fmt::print(fp, "      \"{}\": {{\"count\": {}, \"mean\": {:.6f}, \"p50\": {:.6f}, \"p90\": {:.6f}, \"p99\": {:.6f}, \"max\": {:.6f}}},\n",
+        name, summary.count, summary.mean, summary.p50, summary.p90, summary.p99, summary.max);
+}
+
+static void write_results(FILE* fp, const std::vector<EstimatorResult>& results, const EstimatorBenchOptions& options, const SoccerParams& params) {
+    fmt::print(fp, "{{\n");
+    fmt::print(fp, "  \"latency_ms\": {:.3f},\n", options.latency_ms);
+    fmt::print(fp, "  \"input_delay_ms\": {:.3f},\n", params.input_delay_secs * 1000.0f);
+    fmt::print(fp, "  \"acceleration\": {:.3f},\n", params.acceleration);
+    fmt::print(fp, "  \"simulation\": {{\"frames\": {}, \"seed\": {}, \"frame_rate\": {:.3f}, \"noise\": {:.6f}, \"dropout\": {:.3f}}},\n",
+        options.total_frames, options.seed, options.frame_rate, options.noise, options.dropout);
+    fmt::print(fp, "  \"results\": [");
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto& result = results[i];
+        fmt::print(fp, "{}\n    {{\n", (i == 0) ? "" : ",");
+        fmt::print(fp, "      \"estimator\": \"{}\",\n", GetEstimatorTypeString(result.type));
+        fmt::print(fp, "      \"trajectory\": \"{}\",\n", json_escape(result.trajectory_name));
+        // without the truth errors are measured against later observations
+        fmt::print(fp, "      \"has_truth\": {},\n", result.has_truth);
+        fmt::print(fp, "      \"samples\": {},\n", result.total_samples);
+        fmt::print(fp, "      \"tracked\": {},\n", result.total_tracked);
+        write_error_summary(fp, "position_error", result.position_error);
+        write_error_summary(fp, "velocity_error", result.velocity_error);
+        write_error_summary(fp, "impact_error_ms", result.impact_error_ms);
+        fmt::print(fp, "      \"false_fast_falls\": {},\n", result.total_false_fast_falls);
+        fmt::print(fp, "      \"missed_fast_falls\": {},\n", result.total_missed_fast_falls);
+        const auto& latency = result.update_latency;
+        fmt::print(fp, "      \"update_ns\": {{\"mean\": {:.1f}, \"p50\": {}, \"p99\": {}, \"max\": {}}}\n",
+            latency.GetMean(), latency.GetPercentile(50.0), latency.GetPercentile(99.0), latency.max_value);
+        fmt::print(fp, "    }}");
+    }
+    fmt::print(fp, "\n  ]\n}}\n");
+}
+
+int _main(int argc, char** argv) {
+    auto parser = argparse::ArgumentParser("SoccerBot Estimator Benchmark", "1.0.0");
+    parser.add_argument("--estimators")
+        .default_value(std::string("difference,kalman"))
+        .help("Comma separated list of estimators. Options: [difference, kalman]");
+    parser.add_argument("--trajectory")
+        .default_value(std::string(""))
+        .help("Comma separated list of recorded trajectories as csv or flight logs ending in .sbfl. If not provided a trajectory is simulated.");
+    parser.add_argument("--save-trajectory")
+        .default_value(std::string(""))
+        .help("Path to save the simulated trajectory to for replaying later");
+    parser.add_argument("--frames")
+        .default_value(20000)
+        .scan<'i', int>()
+        .help("Number of frames to simulate");
+    parser.add_argument("--seed")
+        .default_value(1)
+        .scan<'i', int>()
+        .help("Seed of the simulated scene and observation noise");
+    parser.add_argument("--frame-rate")
+        .default_value(60.0f)
+        .scan<'g', float>()
+        .help("Frame rate of the simulation");
+    parser.add_argument("--noise")
+        .default_value(0.004f)
+        .scan<'g', float>()
+        .help("Standard deviation of simulated predictions at full confidence in normalised screen units");
+    parser.add_argument("--dropout")
+        .default_value(0.05f)
+        .scan<'g', float>()
+        .help("Chance that the simulated model misses a visible ball");
+    parser.add_argument("--latency-ms")
+        .default_value(8.0f)
+        .scan<'g', float>()
+        .help("Delay between a frame being captured and the estimate being used");
+    parser.add_argument("--acceleration")
+        .default_value(-1.0f)
+        .scan<'g', float>()
+        .help("Gravity in normalised screen heights per second^2. If negative the simulation's gravity is used, or the gui default for recordings.");
+    parser.add_argument("--output")
+        .default_value(std::string(""))
+        .help("Path to write json results to. If not provided results are written to stdout.");
+
+    try {
+        parser.parse_args(argc, argv);
+    } catch (const std::runtime_error& ex) {
+        std::cerr << ex.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    auto options = EstimatorBenchOptions{};
+    options.total_frames = parser.get<int>("--frames");
+    options.seed = uint32_t(parser.get<int>("--seed"));
+    options.frame_rate = parser.get<float>("--frame-rate");
+    options.noise = parser.get<float>("--noise");
+    options.dropout = parser.get<float>("--dropout");
+    options.latency_ms = parser.get<float>("--latency-ms");
+    if (options.total_frames <= 0) {
+        throw std::runtime_error(fmt::format("Number of frames must be positive (got {})", options.total_frames));
+    }
+    if (options.frame_rate <= 0.0f) {
+        throw std::runtime_error(fmt::format("Frame rate must be positive (got {})", options.frame_rate));
+    }
+    if ((options.dropout < 0.0f) || (options.dropout > 1.0f)) {
+        throw std::runtime_error(fmt::format("Dropout must be between 0 and 1 (got {})", options.dropout));
+    }
+    if (options.latency_ms < 0.0f) {
+        throw std::runtime_error(fmt::format("Latency can't be negative (got {}ms)", options.latency_ms));
+    }
+
+    std::vector<EstimatorType> estimator_types;
+    for (const auto& estimator: split_list(parser.get<std::string>("--estimators"))) {
+        estimator_types.push_back(ParseEstimatorType(estimator));
+    }
+    if (estimator_types.empty()) {
+        throw std::runtime_error("Expected at least one estimator");
+    }
+
+    std::vector<std::pair<std::string, std::vector<TrajectorySample>>> trajectories;
+    const auto trajectory_paths = split_list(parser.get<std::string>("--trajectory"));
+    for (const auto& path: trajectory_paths) {
+        // flight logs have the raw predictions of the game without any ground truth
+        if (ends_with(path, ".sbfl")) {
+            trajectories.push_back({ path, FlightLogReader(path.c_str()).LoadTrajectory() });
+        } else {
+            trajectories.push_back({ path, LoadTrajectory(path.c_str()) });
+        }
+    }
+    float acceleration = parser.get<float>("--acceleration");
+    if (trajectories.empty()) {
+        trajectories.push_back({ "synthetic", simulate_trajectory(options) });
+        const auto save_path = parser.get<std::string>("--save-trajectory");
+        if (!save_path.empty()) {
+            SaveTrajectory(save_path.c_str(), trajectories.back().second);
+            fmt::print(stderr, "Saved trajectory to: {}\n", save_path);
+        }
+        if (acceleration < 0.0f) {
+            const auto config = SyntheticFrameSource::Config{};
+            acceleration = config.gravity / float(config.height);
+        }
+    }
+    auto params = std::make_shared<SoccerParams>();
+    if (acceleration >= 0.0f) {
+        params->acceleration = acceleration;
+    }
+
+    std::vector<EstimatorResult> results;
+    for (const auto& [name, samples]: trajectories) {
+        for (const auto type: estimator_types) {
+            results.push_back(run_estimator(type, name, samples, params, options));
+            print_summary(results.back());
+        }
+    }
+
+    const auto output_path = parser.get<std::string>("--output");
+    if (output_path.empty()) {
+        write_results(stdout, results, options, *params);
+        fflush(stdout);
+        return 0;
+    }
+    FILE* fp = fopen(output_path.c_str(), "w");
+    if (fp == nullptr) {
+        throw std::runtime_error(fmt::format("Failed to open output file '{}'", output_path));
+    }
+    write_results(fp, results, options, *params);
+    fclose(fp);
+    fmt::print(stderr, "Wrote results to: {}\n", output_path);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    try {
+        return _main(argc, argv);
+    } catch (std::exception& ex) {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,321 @@
+// Offline evaluation of models over a labeled dataset written by soccerbot_generator
+// Samples are spread over every core with each thread running its own copy of the model through the
+// same preprocessing as the player, and the position error, confidence roc and throughput of each
+// model are written as json
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <argparse/argparse.hpp>
+#include <fmt/core.h>
+
+#include "ModelEvaluator.h"
+#include "NativeModel.h"
+#include "OnnxDirectMLModel.h"
+#include "SampleDataset.h"
+#include "TensorflowLiteModel.h"
+#include "ThreadSchedule.h"
+#include "ToolUtils.h"
+#include "WorkStealingPool.h"
+
+struct EvaluatorOptions {
+    std::string dataset_path;
+    std::vector<std::string> model_paths;
+    std::string runtime = "auto";
+    // uses every sample if 0
+    int total_samples = 0;
+    // synthetic inputs run through each copy of the model before any samples
+    int total_warmup_iterations = 20;
+    float confidence_threshold = 0.5f;
+    int total_roc_points = 21;
+    // uses every core if 0
+    int total_threads = 0;
+    std::vector<int> cpus;
+};
+
+// distribution of the time spent in a stage per sample
+struct StageSummary {
+    double mean_us = 0.0;
+    double p50_us = 0.0;
+    double p99_us = 0.0;
+};
+
+struct EvaluatorResult {
+    std::string model_path;
+    std::string runtime;
+    InputBuffer model_input { nullptr, 0, 0 };
+    int total_threads = 0;
+    double duration_secs = 0.0;
+    StageSummary preprocess;
+    StageSummary inference;
+    EvaluationSummary summary;
+};
+
+// json has no nan so metrics without any samples are null
+static std::string json_float(const float value, const bool is_valid) {
+    if (!is_valid) return "null";
+    return fmt::format("{:.6f}", value);
+}
+
+// every thread runs its own copy of the model so each one is limited to a single thread
+static std::unique_ptr<IModel> create_model(const std::string& runtime, const std::string& model_path) {
+    if (runtime.compare("onnx") == 0) {
+        auto opts = OnnxDirectMLModel::CPU_Options{};
+        opts.total_threads = 1;
+        opts.is_sequential = true;
+        return std::make_unique<OnnxDirectMLModel>(model_path.c_str(), opts);
+    }
+    if (runtime.compare("tflite") == 0) {
+        return std::make_unique<TensorflowLiteModel>(model_path.c_str(), 1);
+    }
+    if (runtime.compare("native") == 0) {
+        return std::make_unique<NativeModel>(model_path.c_str());
+    }
+    throw std::runtime_error(fmt::format("Invalid runtime selected: {}", runtime));
+}
+
+static StageSummary get_stage_summary(std::vector<uint64_t>& ns_values) {
+    StageSummary summary;
+    if (ns_values.empty()) return summary;
+    std::sort(ns_values.begin(), ns_values.end());
+    double total_ns = 0.0;
+    for (const auto ns: ns_values) {
+        total_ns += double(ns);
+    }
+    const auto get_percentile_us = [&](const double percentile) {
+        const size_t rank = size_t(std::ceil(percentile / 100.0 * double(ns_values.size())));
+        return double(ns_values[std::clamp(rank, size_t(1), ns_values.size()) - 1]) * 1e-3;
+    };
+    summary.mean_us = total_ns / double(ns_values.size()) * 1e-3;
+    summary.p50_us = get_percentile_us(50.0);
+    summary.p99_us = get_percentile_us(99.0);
+    return summary;
+}
+
+static EvaluatorResult evaluate_model(
+    const EvaluatorOptions& options, const std::string& model_path,
+    const SampleDataset& dataset, const std::vector<SampleLabel>& labels, WorkStealingPool& pool)
+{
+    EvaluatorResult result;
+    result.model_path = model_path;
+    result.runtime = get_runtime(options.runtime, model_path);
+    result.total_threads = pool.GetTotalThreads();
+
+    std::vector<std::unique_ptr<ModelEvaluator>> evaluators;
+    for (int i = 0; i < pool.GetTotalThreads(); i++) {
+        evaluators.push_back(std::make_unique<ModelEvaluator>(create_model(result.runtime, model_path)));
+        if (options.total_warmup_iterations > 0) {
+            evaluators.back()->GetModel().Warmup(options.total_warmup_iterations);
+        }
+    }
+    result.model_input = evaluators.front()->GetModel().GetInputBuffer();
+    result.model_input.data = nullptr;
+
+    const size_t total_samples = labels.size();
+    std::vector<Prediction> preds(total_samples);
+    std::vector<uint64_t> preprocess_ns(total_samples);
+    std::vector<uint64_t> inference_ns(total_samples);
+    const int width = dataset.GetWidth();
+    const int height = dataset.GetHeight();
+    const auto dt_start = std::chrono::steady_clock::now();
+    pool.ParallelFor(total_samples, [&](const size_t index, const int thread_index) {
+        auto& evaluator = *evaluators[size_t(thread_index)];
+        const auto sample = evaluator.Evaluate(dataset.GetImage(int(index)), width, height);
+        preds[index] = sample.pred;
+        preprocess_ns[index] = sample.preprocess_ns;
+        inference_ns[index] = sample.inference_ns;
+    }, 4);
+    const auto dt_end = std::chrono::steady_clock::now();
+
+    result.duration_secs = std::chrono::duration<double>(dt_end - dt_start).count();
+    result.preprocess = get_stage_summary(preprocess_ns);
+    result.inference = get_stage_summary(inference_ns);
+    result.summary = ModelEvaluator::Summarise(labels, preds, options.confidence_threshold, options.total_roc_points);
+    return result;
+}
+
+static void print_result(const EvaluatorResult& result) {
+    const auto& s = result.summary;
+    fmt::print(stderr, "{} ({}): {:.0f} samples/s on {} threads, inference mean={:.1f}us p99={:.1f}us\n",
+        result.model_path, result.runtime, double(s.total_samples) / result.duration_secs, result.total_threads,
+        result.inference.mean_us, result.inference.p99_us);
+    const auto text_float = [](const float value, const bool is_valid) -> std::string {
+        if (!is_valid) return "n/a";
+        return fmt::format("{:.4f}", value);
+    };
+    fmt::print(stderr, "  confidence: accuracy={} auc={}, position: error={} p50={} p99={} hit_rate={}\n",
+        text_float(s.confidence_accuracy, s.has_confidence), text_float(s.confidence_auc, s.has_confidence_auc),
+        text_float(s.mean_position_error, s.has_position), text_float(s.p50_distance, s.has_position),
+        text_float(s.p99_distance, s.has_position), text_float(s.hit_rate, s.has_position));
+}
+
+static void write_stage(FILE* fp, const StageSummary& stage) {
+    fmt::print(fp, "{{\"mean_us\": {:.3f}, \"p50_us\": {:.3f}, \"p99_us\": {:.3f}}}", stage.mean_us, stage.p50_us, stage.p99_us);
+}
+
+static void write_results(FILE* fp, const EvaluatorOptions& options, const SampleDataset& dataset, const std::vector<EvaluatorResult>& results) {
+    fmt::print(fp, "{{\n");
+    fmt::print(fp, "  \"dataset\": {{\"path\": \"{}\", \"shards\": {}, \"width\": {}, \"height\": {}}},\n",
+        json_escape(options.dataset_path), dataset.GetTotalShards(), dataset.GetWidth(), dataset.GetHeight());
+    fmt::print(fp, "  \"results\": [");
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto& result = results[i];
+        const auto& s = result.summary;
+        fmt::print(fp, "{}\n    {{\n", (i == 0) ? "" : ",");
+        fmt::print(fp, "      \"model\": \"{}\",\n", json_escape(result.model_path));
+        fmt::print(fp, "      \"runtime\": \"{}\",\n", result.runtime);
+        fmt::print(fp, "      \"model_input\": {{\"width\": {}, \"height\": {}, \"type\": \"{}\"}},\n",
+            result.model_input.width, result.model_input.height, GetInputTypeString(result.model_input.type));
+        fmt::print(fp, "      \"threads\": {},\n", result.total_threads);
+        fmt::print(fp, "      \"samples\": {},\n", s.total_samples);
+        fmt::print(fp, "      \"balls\": {},\n", s.total_balls);
+        fmt::print(fp, "      \"duration_secs\": {:.6f},\n", result.duration_secs);
+        fmt::print(fp, "      \"samples_per_sec\": {:.3f},\n", double(s.total_samples) / result.duration_secs);
+        fmt::print(fp, "      \"preprocess\": ");
+        write_stage(fp, result.preprocess);
+        fmt::print(fp, ",\n      \"inference\": ");
+        write_stage(fp, result.inference);
+        fmt::print(fp, ",\n");
+        fmt::print(fp, "      \"confidence\": {{\"threshold\": {:.4f}, \"accuracy\": {}, \"mean_error\": {}, \"auc\": {}}},\n",
+            s.confidence_threshold, json_float(s.confidence_accuracy, s.has_confidence),
+            json_float(s.mean_confidence_error, s.has_confidence), json_float(s.confidence_auc, s.has_confidence_auc));
+        fmt::print(fp, "      \"position\": {{\"mean_error\": {}, \"mean_distance\": {}, \"p50_distance\": {}, \"p90_distance\": {}, \"p99_distance\": {}, \"max_distance\": {}, \"hit_rate\": {}}},\n",
+            json_float(s.mean_position_error, s.has_position), json_float(s.mean_distance, s.has_position),
+            json_float(s.p50_distance, s.has_position), json_float(s.p90_distance, s.has_position),
+            json_float(s.p99_distance, s.has_position), json_float(s.max_distance, s.has_position),
+            json_float(s.hit_rate, s.has_position));
+        fmt::print(fp, "      \"roc\": [");
+        for (size_t j = 0; j < s.roc.size(); j++) {
+            const auto& point = s.roc[j];
+            fmt::print(fp, "{}\n        {{\"threshold\": {:.4f}, \"tpr\": {}, \"fpr\": {}}}",
+                (j == 0) ? "" : ",", point.threshold,
+                json_float(point.true_positive_rate, point.has_true_positive_rate),
+                json_float(point.false_positive_rate, point.has_false_positive_rate));
+        }
+        fmt::print(fp, "\n      ]\n    }}");
+    }
+    fmt::print(fp, "\n  ]\n}}\n");
+}
+
+int _main(int argc, char** argv) {
+    auto parser = argparse::ArgumentParser("SoccerBot Model Evaluator", "1.0.0");
+    parser.add_argument("--dataset")
+        .required()
+        .help("Folder of shards written by soccerbot_generator");
+    parser.add_argument("--model")
+        .required()
+        .help("Comma separated list of models to evaluate");
+    parser.add_argument("--runtime")
+        .default_value(std::string("auto"))
+        .help("Runtime of every model. Options: [auto, onnx, tflite, native]. Picked from each model's extension if auto.");
+    parser.add_argument("--samples")
+        .default_value(0)
+        .scan<'i', int>()
+        .help("Number of samples to evaluate from the start of the dataset. Uses every sample if 0.");
+    parser.add_argument("--warmup")
+        .default_value(20)
+        .scan<'i', int>()
+        .help("Maximum number of synthetic inputs to warm up each copy of a model with");
+    parser.add_argument("--confidence-threshold")
+        .default_value(0.5f)
+        .scan<'g', float>()
+        .help("Confidence above which a prediction counts as a ball for the accuracy");
+    parser.add_argument("--roc-points")
+        .default_value(21)
+        .scan<'i', int>()
+        .help("Number of evenly spaced thresholds from 0 to 1 on the confidence roc curve");
+    parser.add_argument("--threads")
+        .default_value(0)
+        .scan<'i', int>()
+        .help("Number of threads to evaluate samples on, each with its own copy of the model. Uses every core if 0.");
+    parser.add_argument("--cpus")
+        .default_value(std::string(""))
+        .help("Logical processors to pin the threads to such as 0-3,6. Left to the os if not provided.");
+    parser.add_argument("--output")
+        .default_value(std::string(""))
+        .help("Path to write json results to. If not provided results are written to stdout.");
+
+    try {
+        parser.parse_args(argc, argv);
+    } catch (const std::runtime_error& ex) {
+        std::cerr << ex.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    auto options = EvaluatorOptions{};
+    options.dataset_path = parser.get<std::string>("--dataset");
+    options.model_paths = split_list(parser.get<std::string>("--model"));
+    options.runtime = parser.get<std::string>("--runtime");
+    options.total_samples = parser.get<int>("--samples");
+    options.total_warmup_iterations = parser.get<int>("--warmup");
+    options.confidence_threshold = parser.get<float>("--confidence-threshold");
+    options.total_roc_points = parser.get<int>("--roc-points");
+    options.total_threads = parser.get<int>("--threads");
+    options.cpus = ParseCpuList(parser.get<std::string>("--cpus"));
+    if (options.model_paths.empty()) {
+        throw std::runtime_error("Expected at least one model");
+    }
+    if (options.total_samples < 0) {
+        throw std::runtime_error(fmt::format("Number of samples can't be negative (got {})", options.total_samples));
+    }
+    if (options.total_roc_points < 2) {
+        throw std::runtime_error(fmt::format("Roc curve requires at least 2 points (got {})", options.total_roc_points));
+    }
+
+    const SampleDataset dataset(options.dataset_path);
+    int total_samples = dataset.GetTotalSamples();
+    if (options.total_samples > 0) {
+        total_samples = std::min(total_samples, options.total_samples);
+    }
+    std::vector<SampleLabel> labels;
+    labels.reserve(size_t(total_samples));
+    for (int i = 0; i < total_samples; i++) {
+        labels.push_back(dataset.GetLabel(i));
+    }
+    fmt::print(stderr, "Loaded {} of {} samples from {} shards in {}: {}x{}\n",
+        total_samples, dataset.GetTotalSamples(), dataset.GetTotalShards(), options.dataset_path,
+        dataset.GetWidth(), dataset.GetHeight());
+
+    auto schedule = ThreadSchedule{};
+    schedule.cpus = options.cpus;
+    WorkStealingPool pool(options.total_threads, schedule);
+    // NOTE: Models are evaluated one after the other so each one has every core to itself
+    std::vector<EvaluatorResult> results;
+    for (const auto& model_path: options.model_paths) {
+        results.push_back(evaluate_model(options, model_path, dataset, labels, pool));
+        print_result(results.back());
+    }
+
+    const auto output_path = parser.get<std::string>("--output");
+    if (output_path.empty()) {
+        write_results(stdout, options, dataset, results);
+        fflush(stdout);
+        return 0;
+    }
+    FILE* fp = fopen(output_path.c_str(), "w");
+    if (fp == nullptr) {
+        throw std::runtime_error(fmt::format("Failed to open output file '{}'", output_path));
+    }
+    write_results(fp, options, dataset, results);
+    fclose(fp);
+    fmt::print(stderr, "Wrote results to: {}\n", output_path);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    try {
+        return _main(argc, argv);
+    } catch (std::exception& ex) {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
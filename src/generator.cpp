@@ -0,0 +1,149 @@
+// Generates training samples with the same assets and random choices as the python generator
+// Samples are made in parallel on every core and written straight into memory mapped shards that the
+// training scripts read with scripts/generator/dataset.py
+#include <stdio.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <argparse/argparse.hpp>
+#include <fmt/core.h>
+
+#include "SampleDataset.h"
+#include "SampleGenerator.h"
+#include "ThreadSchedule.h"
+#include "WorkStealingPool.h"
+
+struct GeneratorOptions {
+    std::string asset_path = "./scripts/assets";
+    std::string ball_filename = "ball.png";
+    float font_size = 92.0f;
+    std::string output_path = "./data/dataset";
+    int total_samples = 100000;
+    int samples_per_shard = 4096;
+    uint32_t seed = 1;
+    // uses every core if 0
+    int total_threads = 0;
+    std::vector<int> cpus;
+};
+
+int _main(int argc, char** argv) {
+    auto parser = argparse::ArgumentParser("SoccerBot Sample Generator", "1.0.0");
+    parser.add_argument("--asset-path")
+        .default_value(std::string("./scripts/assets"))
+        .help("Path to game assets");
+    parser.add_argument("--ball")
+        .default_value(std::string("ball.png"))
+        .help("Filename of the ball in the icons folder of the assets");
+    parser.add_argument("--font-size")
+        .default_value(92.0f)
+        .scan<'g', float>()
+        .help("Size of the score font in pixels");
+    parser.add_argument("--output")
+        .default_value(std::string("./data/dataset"))
+        .help("Folder to write the shards to");
+    parser.add_argument("--samples")
+        .default_value(100000)
+        .scan<'i', int>()
+        .help("Number of samples to generate");
+    parser.add_argument("--samples-per-shard")
+        .default_value(4096)
+        .scan<'i', int>()
+        .help("Number of samples in each shard");
+    parser.add_argument("--seed")
+        .default_value(1)
+        .scan<'i', int>()
+        .help("Seed of the samples. The dataset is the same for any number of threads.");
+    parser.add_argument("--threads")
+        .default_value(0)
+        .scan<'i', int>()
+        .help("Number of threads to generate samples on. Uses every core if 0.");
+    parser.add_argument("--cpus")
+        .default_value(std::string(""))
+        .help("Logical processors to pin the threads to such as 0-3,6. Left to the os if not provided.");
+
+    try {
+        parser.parse_args(argc, argv);
+    } catch (const std::runtime_error& ex) {
+        std::cerr << ex.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    auto options = GeneratorOptions{};
+    options.asset_path = parser.get<std::string>("--asset-path");
+    options.ball_filename = parser.get<std::string>("--ball");
+    options.font_size = parser.get<float>("--font-size");
+    options.output_path = parser.get<std::string>("--output");
+    options.total_samples = parser.get<int>("--samples");
+    options.samples_per_shard = parser.get<int>("--samples-per-shard");
+    options.seed = uint32_t(parser.get<int>("--seed"));
+    options.total_threads = parser.get<int>("--threads");
+    options.cpus = ParseCpuList(parser.get<std::string>("--cpus"));
+    if (options.total_samples <= 0) {
+        throw std::runtime_error(fmt::format("Number of samples must be positive (got {})", options.total_samples));
+    }
+    if (options.samples_per_shard <= 0) {
+        throw std::runtime_error(fmt::format("Number of samples per shard must be positive (got {})", options.samples_per_shard));
+    }
+    if (options.font_size <= 0.0f) {
+        throw std::runtime_error(fmt::format("Font size must be positive (got {})", options.font_size));
+    }
+
+    std::shared_ptr<const SampleAssets> assets = LoadSampleAssets(options.asset_path, options.ball_filename, options.font_size);
+    const int width = assets->background.width;
+    const int height = assets->background.height;
+    fmt::print(stderr, "Loaded assets from {}: {}x{} background, {}x{} ball and {} emotes\n",
+        options.asset_path, width, height, assets->ball.width, assets->ball.height, assets->emotes.size());
+
+    auto schedule = ThreadSchedule{};
+    schedule.cpus = options.cpus;
+    WorkStealingPool pool(options.total_threads, schedule);
+    std::vector<std::unique_ptr<SampleGenerator>> generators;
+    for (int i = 0; i < pool.GetTotalThreads(); i++) {
+        generators.push_back(std::make_unique<SampleGenerator>(assets));
+    }
+
+    std::filesystem::create_directories(options.output_path);
+    const int total_shards = (options.total_samples + options.samples_per_shard - 1) / options.samples_per_shard;
+    int total_balls = 0;
+    const auto dt_start = std::chrono::steady_clock::now();
+    for (int shard = 0; shard < total_shards; shard++) {
+        const int first_sample = shard*options.samples_per_shard;
+        const int total_shard_samples = std::min(options.samples_per_shard, options.total_samples - first_sample);
+        const auto filepath = (std::filesystem::path(options.output_path) / fmt::format("shard-{:05d}.sbds", shard)).string();
+        SampleShardWriter writer(filepath.c_str(), width, height, total_shard_samples);
+        // NOTE: Each sample is seeded by its index so the dataset doesn't depend on the number of threads
+        pool.ParallelFor(size_t(total_shard_samples), [&](const size_t index, const int thread_index) {
+            auto& generator = *generators[size_t(thread_index)];
+            writer.GetLabel(int(index)) = generator.Generate(options.seed, uint32_t(first_sample) + uint32_t(index));
+            generator.CopyToRGB(writer.GetImage(int(index)));
+        }, 4);
+        for (int i = 0; i < total_shard_samples; i++) {
+            total_balls += int(writer.GetLabel(i).has_ball);
+        }
+        fmt::print(stderr, "Wrote {} samples to: {}\n", total_shard_samples, filepath);
+    }
+    const auto dt_end = std::chrono::steady_clock::now();
+    const double duration_secs = std::chrono::duration<double>(dt_end - dt_start).count();
+    fmt::print(stderr, "Generated {} samples ({} with a ball) in {} shards in {:.2f}s ({:.0f} samples/s) on {} threads\n",
+        options.total_samples, total_balls, total_shards, duration_secs,
+        double(options.total_samples) / duration_secs, pool.GetTotalThreads());
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    try {
+        return _main(argc, argv);
+    } catch (std::exception& ex) {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -6,6 +6,7 @@
 #include "imgui_internal.h"
 
 #include <algorithm>
+#include <vector>
 #include <inttypes.h>
 
 static void RenderControls(App &app);
@@ -26,16 +27,38 @@ void RenderApp(App &app) {
 void RenderControls(App &app) {
     auto& model_controls = app.m_player->GetControls();
     ImGui::Begin("Controls");
-    ImGui::Checkbox("Is model (F1)", &app.m_is_model_running);
-    ImGui::Checkbox("Is render (F2)", &app.m_is_render_running);
+    bool is_model_running = app.m_is_model_running;
+    bool is_render_running = app.m_is_render_running;
+    if (ImGui::Checkbox("Is model (F1)", &is_model_running)) app.SetModelRunning(is_model_running);
+    if (ImGui::Checkbox("Is render (F2)", &is_render_running)) app.m_is_render_running = is_render_running;
     ImGui::Checkbox("Is tracking ball (F3)", &model_controls.can_track);
     ImGui::Checkbox("Is smart clicking ball (F4)", &model_controls.can_smart_click);
     ImGui::Checkbox("Is using predictor (F5)", &model_controls.can_use_predictor);
     ImGui::Checkbox("Is always clicking ball (F6)", &model_controls.can_always_click);
+    ImGui::Checkbox("Is skipping unchanged frames", &model_controls.can_skip_unchanged);
+    if (app.m_player->HasROIModel()) {
+        ImGui::Checkbox("Is using region of interest", &model_controls.can_use_roi);
+    }
     ImGui::Separator();
     ImGui::Checkbox("Show raw prediction", &app.m_render_overlay_flags.raw_pred);
     ImGui::Checkbox("Show filtered prediction", &app.m_render_overlay_flags.filtered_pred);
+    if (app.m_player->HasROIModel()) {
+        ImGui::Checkbox("Show region of interest", &app.m_render_overlay_flags.roi);
+    }
     ImGui::SliderInt("Click padding", &model_controls.click_padding, 0, 10);
+    {
+        auto& pacer = app.m_player->GetPacer();
+        const PacingMode modes[] = { PacingMode::OFF, PacingMode::LATENCY, PacingMode::BALANCED, PacingMode::POWER };
+        const PacingMode current_mode = pacer.GetMode();
+        if (ImGui::BeginCombo("Frame pacing", GetPacingModeString(current_mode))) {
+            for (const auto mode: modes) {
+                if (ImGui::Selectable(GetPacingModeString(mode), mode == current_mode)) {
+                    pacer.SetMode(mode);
+                }
+            }
+            ImGui::EndCombo();
+        }
+    }
     ImGui::Separator();
 
     const auto screen_size = util::GetScreenSize();
@@ -58,6 +81,21 @@ void RenderControls(App &app) {
     ImGui::Text("texture_size        = %d x %d", app.m_texture_width, app.m_texture_height);
     auto max_buffer_size = app.m_mss->GetMaxSize();
     ImGui::Text("max_screenshot_size = %d x %d", max_buffer_size.x, max_buffer_size.y);
+    if (!app.m_is_model_warm) {
+        ImGui::Text("model_warmup        = running");
+    } else {
+        const auto& warmup = app.m_warmup_stats;
+        ImGui::Text("model_warmup        = %d calls%s, first=%.2fms, warm=%.2fms",
+            warmup.total_iterations, warmup.is_converged ? "" : " (not converged)",
+            float(warmup.first_ns)*1e-6f, float(warmup.converged_ns)*1e-6f);
+    }
+    {
+        const auto stats = app.m_player->GetPacer().GetStats();
+        const float new_percentage = (stats.total_grabs > 0) ? (100.0f * float(stats.total_new_frames) / float(stats.total_grabs)) : 0.0f;
+        ImGui::Text("frame_interval      = %.2fms, margin=%.2fms, sleep_overshoot=%.2fms",
+            float(stats.frame_interval_ns)*1e-6f, float(stats.wake_margin_ns)*1e-6f, float(stats.sleep_overshoot_ns)*1e-6f);
+        ImGui::Text("new_frames          = %.1f%% of grabs", new_percentage);
+    }
 
     ImGui::End(); 
 }
@@ -83,14 +121,15 @@ void RenderAIParameters(App &app) {
     ImGui::SliderFloat("fall height hard", &params.height_trigger_hard, 0.0f, 1.0f);
 
     ImGui::Separator();
-    auto raw_pred = player.GetRawPrediction();
+    const auto& result = player.GetLatestResult();
+    auto raw_pred = result.raw_pred;
     ImGui::Text("Confidence: %+.3f", raw_pred.confidence);
     widgets::RenderConfidenceMeter(raw_pred.confidence, params.confidence_threshold);
     ImGui::SameLine();
     ImGui::Text("confidence");
     
     ImGui::Separator();
-    auto vel = player.GetVelocity();
+    auto vel = result.velocity;
     ImGui::Text("Velocity: x=%+.3f y=%+.3f", vel.x, vel.y);
     widgets::RenderVelocityMeter(vel.x, -VMAX, +VMAX);
     ImGui::SameLine();
@@ -98,13 +137,25 @@ void RenderAIParameters(App &app) {
     widgets::RenderVelocityMeter(vel.y, -VMAX, +VMAX);
     ImGui::SameLine();
     ImGui::Text("dy");
+    if (result.time_to_impact >= 0.0f) {
+        ImGui::Text("Time to impact: %.0fms", result.time_to_impact*1000.0f);
+    } else {
+        ImGui::Text("Time to impact: none");
+    }
     ImGui::Separator();
-    const auto status = player.GetStatus();
+    const auto status = result.status;
     ImGui::RadioButton("Tracking", status.is_tracking);
     ImGui::SameLine();
     ImGui::RadioButton("Soft trigger", status.is_soft_trigger);
     ImGui::SameLine();
     ImGui::RadioButton("Hard trigger", status.is_hard_trigger);
+    const float skipped_percentage = (result.total_frames > 0) ? (100.0f * float(result.total_skipped_frames) / float(result.total_frames)) : 0.0f;
+    ImGui::Text("Unchanged frames skipped: %llu (%.1f%%)", (unsigned long long)result.total_skipped_frames, skipped_percentage);
+    if (player.HasROIModel()) {
+        ImGui::RadioButton("Region of interest", result.is_roi);
+        const float roi_percentage = (result.total_frames > 0) ? (100.0f * float(result.total_roi_frames) / float(result.total_frames)) : 0.0f;
+        ImGui::Text("Region of interest frames: %.1f%%", roi_percentage);
+    }
 
     ImGui::End();
 }
@@ -112,15 +163,67 @@ void RenderAIParameters(App &app) {
 void RenderStatistics(App &app) {
     ImGui::Begin("Statistics");
     ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
-    const auto timings = app.m_player->GetTimings();
-    float us_average_forward = 0.0f;
-    for (const auto& timing: timings) {
-        const float us_total = timing.us_image_resize + timing.us_image_convert + timing.us_model_inference; 
-        us_average_forward += us_total;
+
+    // statistics are shown relative to a baseline so they can be reset without touching the model thread
+    static std::vector<LatencyHistogram::Snapshot> baselines(TOTAL_LATENCY_STAGES);
+    static int selected_stage = int(LatencyStage::END_TO_END);
+    const auto& latency = app.m_player->GetLatencyStats();
+    std::vector<LatencyHistogram::Snapshot> snapshots(TOTAL_LATENCY_STAGES);
+    for (int i = 0; i < TOTAL_LATENCY_STAGES; i++) {
+        snapshots[i] = latency.Get(LatencyStage(i)).GetSnapshot().GetDifference(baselines[i]);
+    }
+    if (ImGui::Button("Reset")) {
+        for (int i = 0; i < TOTAL_LATENCY_STAGES; i++) {
+            baselines[i] = latency.Get(LatencyStage(i)).GetSnapshot();
+        }
+    }
+
+    const auto& inference = snapshots[int(LatencyStage::TOTAL)];
+    if (inference.total_count > 0) {
+        const float us_average_forward = float(inference.GetMean()) * 1e-3f;
+        ImGui::Text("Forward average %.3f us/pass (%.1f FPS)", us_average_forward, 1e6f / us_average_forward);
+    }
+
+    const ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg;
+    if (ImGui::BeginTable("Latency", 7, flags)) {
+        ImGui::TableSetupColumn("Stage");
+        ImGui::TableSetupColumn("Count");
+        ImGui::TableSetupColumn("Mean");
+        ImGui::TableSetupColumn("p50");
+        ImGui::TableSetupColumn("p95");
+        ImGui::TableSetupColumn("p99");
+        ImGui::TableSetupColumn("Max");
+        ImGui::TableHeadersRow();
+        for (int i = 0; i < TOTAL_LATENCY_STAGES; i++) {
+            const auto& snapshot = snapshots[i];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            if (ImGui::Selectable(GetLatencyStageString(LatencyStage(i)), selected_stage == i, ImGuiSelectableFlags_SpanAllColumns)) {
+                selected_stage = i;
+            }
+            ImGui::TableNextColumn(); ImGui::Text("%" PRIu64, snapshot.total_count);
+            ImGui::TableNextColumn(); ImGui::Text("%.1f", float(snapshot.GetMean())*1e-3f);
+            ImGui::TableNextColumn(); ImGui::Text("%.1f", float(snapshot.GetPercentile(50.0))*1e-3f);
+            ImGui::TableNextColumn(); ImGui::Text("%.1f", float(snapshot.GetPercentile(95.0))*1e-3f);
+            ImGui::TableNextColumn(); ImGui::Text("%.1f", float(snapshot.GetPercentile(99.0))*1e-3f);
+            ImGui::TableNextColumn(); ImGui::Text("%.1f", float(snapshot.max_value)*1e-3f);
+        }
+        ImGui::EndTable();
+    }
+    ImGui::Text("Latency in us");
+    widgets::RenderLatencyHistogram(GetLatencyStageString(LatencyStage(selected_stage)), snapshots[selected_stage], ImVec2(0, 80));
+    if (app.m_flight_recorder != nullptr) {
+        const auto stats = app.m_flight_recorder->GetStats();
+        ImGui::Separator();
+        ImGui::Text("Flight log: %" PRIu64 " frames, %" PRIu64 " events, %.1f MB written",
+            stats.total_frames, stats.total_events, float(stats.total_bytes) / (1024.0f*1024.0f));
+        ImGui::Text("Flight log dropped: %" PRIu64 " frames, %" PRIu64 " events",
+            stats.total_dropped_frames, stats.total_dropped_events);
+        if ((stats.total_failed_writes > 0) || (stats.total_failed_opens > 0)) {
+            ImGui::Text("Flight log failed: %" PRIu64 " chunks lost, %" PRIu64 " opens",
+                stats.total_failed_writes, stats.total_failed_opens);
+        }
     }
-    us_average_forward /= float(timings.size());
-    ImGui::Text("Forward average %.3f us/pass (%.1f FPS)", us_average_forward, 1e6f / us_average_forward);
-    widgets::RenderTimings("Timings", timings.data(), timings.size(), ImVec2(0, 80));
     ImGui::End();
 }
 
@@ -85,7 +85,7 @@ void RenderConfidenceMeter(const float value,  const float threshold, const ImVe
     ImGui::RenderRectFilledRangeH(window->DrawList, bb, color, 0.0f, fraction, style.FrameRounding);
 }
 
-int RenderTimings(const char* label, const SoccerPlayer::Timings* timings, const size_t N, const ImVec2& size_arg) {
+int RenderLatencyHistogram(const char* label, const LatencyHistogram::Snapshot& snapshot, const ImVec2& size_arg) {
     ImGuiContext& g = *GImGui;
     ImGuiWindow* window = ImGui::GetCurrentWindow();
     if (window->SkipItems)
@@ -105,56 +105,37 @@ int RenderTimings(const char* label, const SoccerPlayer::Timings* timings, const
         return -1;
 
     const bool hovered = ImGui::ItemHoverable(frame_bb, id);
+    ImGui::RenderFrame(frame_bb.Min, frame_bb.Max, ImGui::GetColorU32(ImGuiCol_FrameBg), true, style.FrameRounding);
 
-    // Determine scale from values if not specified
-    int64_t v_max = 0;
-    for (size_t i = 0; i < N; i++) {
-        auto timing = timings[i];
-        v_max = ImMax(v_max, timing.us_total);
+    // only show the range of buckets that have values
+    int i_min = -1;
+    int i_max = -1;
+    uint64_t v_max = 0;
+    for (int i = 0; i < LatencyHistogram::TOTAL_BUCKETS; i++) {
+        const uint64_t count = snapshot.counts[i];
+        if (count == 0) continue;
+        if (i_min < 0) i_min = i;
+        i_max = i;
+        v_max = ImMax(v_max, count);
     }
 
-    ImGui::RenderFrame(frame_bb.Min, frame_bb.Max, ImGui::GetColorU32(ImGuiCol_FrameBg), true, style.FrameRounding);
-    
-    // 0 = Model
-    // 1 = Resize
-    // 2 = Convert
-    // 3 = Grab
-    const uint8_t COL_INACTIVE_VAL = 180;
-    const uint8_t COL_ACTIVE_VAL = 255;
-    const ImColor COL_INACTIVE[4] = {
-        ImColor(COL_INACTIVE_VAL,0,0),
-        ImColor(0,COL_INACTIVE_VAL,0),
-        ImColor(0,0,COL_INACTIVE_VAL),
-        ImColor(0,COL_INACTIVE_VAL,COL_INACTIVE_VAL),
-    };
-    const ImColor COL_ACTIVE[4] = {
-        ImColor(COL_ACTIVE_VAL,0,0),
-        ImColor(0,COL_ACTIVE_VAL,0),
-        ImColor(0,0,COL_ACTIVE_VAL),
-        ImColor(0,COL_ACTIVE_VAL,COL_ACTIVE_VAL),
-    };
-
+    const ImColor COL_INACTIVE = ImColor(0,180,180);
+    const ImColor COL_ACTIVE = ImColor(0,255,255);
 
     int idx_hovered = -1;
-    if (N >= 1) {
-        int res_w = ImMin(int(frame_size.x), int(N));
+    if (i_min >= 0) {
+        const int N = i_max - i_min + 1;
+        const int res_w = ImMin(int(frame_size.x), N);
 
         // Tooltip on hover
         if (hovered && inner_bb.Contains(g.IO.MousePos)) {
             const float t = ImClamp((g.IO.MousePos.x - inner_bb.Min.x) / (inner_bb.Max.x - inner_bb.Min.x), 0.0f, 0.9999f);
-            const int v_idx = int(t * float(N)) % N;
-
-            const auto timing = timings[v_idx]; 
+            const int v_idx = i_min + int(t * float(N));
             ImGui::BeginTooltip();
-            
-            ImGui::PushStyleColor(ImGuiCol_Text, COL_ACTIVE[0].Value); ImGui::Text("#"); ImGui::PopStyleColor(); ImGui::SameLine();
-            ImGui::Text("Model   %" PRIi64 "us", timing.us_model_inference);
-            ImGui::PushStyleColor(ImGuiCol_Text, COL_ACTIVE[1].Value); ImGui::Text("#"); ImGui::PopStyleColor(); ImGui::SameLine();
-            ImGui::Text("Resize  %" PRIi64 "us", timing.us_image_resize);
-            ImGui::PushStyleColor(ImGuiCol_Text, COL_ACTIVE[2].Value); ImGui::Text("#"); ImGui::PopStyleColor(); ImGui::SameLine();
-            ImGui::Text("Format  %" PRIi64 "us", timing.us_image_convert);
-            ImGui::PushStyleColor(ImGuiCol_Text, COL_ACTIVE[3].Value); ImGui::Text("#"); ImGui::PopStyleColor(); ImGui::SameLine();
-            ImGui::Text("Grab    %" PRIi64 "us", timing.us_image_grab);
+            ImGui::Text("%.1f to %.1f us", 
+                float(LatencyHistogram::GetBucketLowerBound(v_idx))*1e-3f, 
+                float(LatencyHistogram::GetBucketUpperBound(v_idx))*1e-3f);
+            ImGui::Text("count = %" PRIu64, snapshot.counts[v_idx]);
             ImGui::EndTooltip();
             idx_hovered = v_idx;
         }
@@ -165,28 +146,12 @@ int RenderTimings(const char* label, const SoccerPlayer::Timings* timings, const
         float x0 = 0.0f;
         for (int i = 0; i < res_w; i++) {
             const float x1 = x0 + x_step;
-            const int v1_idx = int(x0*N + 0.5f) % N;
-
-            const auto timing = timings[v1_idx];
-
-            constexpr int TOTAL_VALUES = 2;
-            int64_t y_values[TOTAL_VALUES];
-            y_values[0] = timing.us_model_inference;
-            y_values[1] = timing.us_image_resize + y_values[0];
-            // y_values[2] = timing.us_image_convert + y_values[1];
-            // y_values[3] = timing.us_image_grab + y_values[2];
-
-            float yn_prev = 0.0f;
-            for (int j = 0; j < TOTAL_VALUES; j++) {
-                const float yn_new = float(y_values[j]) * inv_v_max;
-                const ImVec2 tn0 = ImVec2(x0, 1.0f-yn_prev);                       // Point in the normalized space of our target rectangle
-                const ImVec2 tn1 = ImVec2(x1, 1.0f-yn_new);
-                const ImVec2 pos0 = ImLerp(inner_bb.Min, inner_bb.Max, tn0);
-                const ImVec2 pos1 = ImLerp(inner_bb.Min, inner_bb.Max, tn1);
-                const ImColor colour = (idx_hovered == v1_idx) ? COL_ACTIVE[j] : COL_INACTIVE[j];
-                window->DrawList->AddRectFilled(pos0, pos1, colour);
-                yn_prev = yn_new;
-            }
+            const int v_idx = i_min + int(x0*float(N) + 0.5f);
+            const float yn = float(snapshot.counts[v_idx]) * inv_v_max;
+            const ImVec2 pos0 = ImLerp(inner_bb.Min, inner_bb.Max, ImVec2(x0, 1.0f));
+            const ImVec2 pos1 = ImLerp(inner_bb.Min, inner_bb.Max, ImVec2(x1, 1.0f-yn));
+            const ImColor colour = (idx_hovered == v_idx) ? COL_ACTIVE : COL_INACTIVE;
+            window->DrawList->AddRectFilled(pos0, pos1, colour);
             x0 = x1;
         }
     }
@@ -194,8 +159,6 @@ int RenderTimings(const char* label, const SoccerPlayer::Timings* timings, const
     if (label_size.x > 0.0f) {
         ImGui::RenderText(ImVec2(frame_bb.Max.x + style.ItemInnerSpacing.x, inner_bb.Min.y), label);
     }
-    // Return hovered index or -1 if none are hovered.
-    // This is currently not exposed in the public API because we need a larger redesign of the whole thing, but in the short-term we are making it available in PlotEx().
     return idx_hovered;
 }
 
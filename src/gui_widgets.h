@@ -3,7 +3,7 @@
 #include <imgui.h>
 #include <stddef.h>
 #include <stdint.h>
-#include "./SoccerPlayer.h"
+#include "./LatencyHistogram.h"
 
 namespace widgets 
 {
@@ -12,6 +12,6 @@ void RenderVelocityMeter(const float value, const float v_min, const float v_max
 
 void RenderConfidenceMeter(const float value, const float threshold, const ImVec2& size_arg=ImVec2(0,0));
 
-int RenderTimings(const char* label, const SoccerPlayer::Timings* timings, const size_t N, const ImVec2& size_arg=ImVec2(0,0));
+int RenderLatencyHistogram(const char* label, const LatencyHistogram::Snapshot& snapshot, const ImVec2& size_arg=ImVec2(0,0));
 
 };
@@ -11,9 +11,11 @@
 #include "gui.h"
 #include "IModel.h"
 #include "TensorflowLiteModel.h"
+#include "NativeModel.h"
 #include "OnnxDirectMLModel.h"
+#include "ThreadSchedule.h"
 
-int run_app(std::unique_ptr<IModel>&& pModel);
+int run_app(std::unique_ptr<IModel>&& pModel, std::unique_ptr<IModel>&& pROIModel, const AppConfig& config);
 
 // Main code
 int _main(int argc, char** argv) {
@@ -22,10 +24,16 @@ int _main(int argc, char** argv) {
         .default_value(std::string("./models/onnx-basic-small.onnx"))
         .required()
         .help("Path to model to load");
+    parser.add_argument("--roi-model")
+        .default_value(std::string(""))
+        .help("Path to model that tracks the ball in a crop around its predicted position. Uses the same runtime as --model.");
+    parser.add_argument("--roi-size")
+        .default_value(std::string(""))
+        .help("WIDTHxHEIGHT of the crop in screen pixels given to --roi-model. If not provided the model input size is used.");
     parser.add_argument("--runtime")
         .default_value(std::string("onnx"))
         .required()
-        .help("Type of runtime for model. Options: [onnx, tflite]");
+        .help("Type of runtime for model. Options: [onnx, tflite, native]");
     parser.add_argument("--tflite-cpus")
         .default_value(1)
         .scan<'i', int>()
@@ -49,6 +57,64 @@ int _main(int argc, char** argv) {
         .default_value(false)
         .implicit_value(true)
         .help("Sets onnx cpu backend to run the model sequentially");
+    parser.add_argument("--onnx-cpu-count-allocations")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Replaces the onnx cpu arena with a caching allocator that counts heap allocations");
+    parser.add_argument("--onnx-cache-dir")
+        .default_value(std::string(""))
+        .help("Directory to cache optimised onnx cpu models in so that later launches start faster and share their weights");
+    parser.add_argument("--warmup-iterations")
+        .default_value(200)
+        .scan<'i', int>()
+        .help("Max number of synthetic inputs to run through the model until its latency settles before capturing frames");
+    parser.add_argument("--model-cpus")
+        .default_value(std::string(""))
+        .help("Comma separated list of cpus or ranges such as 0-3,6 to pin the model thread to. If not provided the os chooses.");
+    parser.add_argument("--capture-cpus")
+        .default_value(std::string(""))
+        .help("Cpus to pin the capture thread to when pipelined. If not provided the os chooses.");
+    parser.add_argument("--worker-cpus")
+        .default_value(std::string(""))
+        .help("Cpus to pin the onnx cpu and tflite worker threads to, one worker per cpu. Tflite workers are only pinned on linux.");
+    parser.add_argument("--thread-priority")
+        .default_value(std::string("normal"))
+        .help("Priority of the model, capture and worker threads. Options: [normal, high, realtime]");
+    parser.add_argument("--pacing")
+        .default_value(std::string("balanced"))
+        .help("How to wait for the next frame of the display. Options: [off, latency, balanced, power]. latency spins, balanced yields and power only sleeps before a frame is due.");
+    parser.add_argument("--estimator")
+        .default_value(std::string("difference"))
+        .help("How the ball is tracked between predictions. Options: [difference, kalman]. kalman is less noisy and learns the gravity of the game.");
+    parser.add_argument("--record-frames")
+        .default_value(std::string(""))
+        .help("Path to save captured frames to for replaying later");
+    parser.add_argument("--pipeline-depth")
+        .default_value(0)
+        .scan<'i', int>()
+        .help("Number of frames buffered between capture, preprocess, inference and control threads. If 0 is provided then stages run serially on one thread for the lowest latency.");
+    parser.add_argument("--pipeline-keep-stale")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Process every buffered frame in order instead of skipping to the newest one");
+    parser.add_argument("--latency-log")
+        .default_value(std::string(""))
+        .help("Path to periodically write latency percentiles to. Files ending in .json or .jsonl are written as json lines, otherwise csv.");
+    parser.add_argument("--latency-log-interval")
+        .default_value(10.0f)
+        .scan<'g', float>()
+        .help("Seconds between each entry in the latency log");
+    parser.add_argument("--flight-log")
+        .default_value(std::string(""))
+        .help("Path to record thumbnails of frames with the predictions, trigger status and clicks of each one to for offline analysis");
+    parser.add_argument("--flight-log-scale")
+        .default_value(4)
+        .scan<'i', int>()
+        .help("Thumbnails in the flight log keep every nth pixel in each direction. If 0 is provided then only predictions are recorded.");
+    parser.add_argument("--flight-log-max-mb")
+        .default_value(1024)
+        .scan<'i', int>()
+        .help("Once the flight log reaches half of this size it is moved to <path>.old and a new one is started. If 0 is provided then there is no limit.");
 
     try {
         parser.parse_args(argc, argv);
@@ -63,10 +129,14 @@ int _main(int argc, char** argv) {
 
     auto runtime_type = parser.get<std::string>("--runtime");
     bool is_onnx = true;
+    bool is_native = false;
     if (runtime_type.compare("onnx") == 0) {
         is_onnx = true;
     } else if (runtime_type.compare("tflite") == 0) {
         is_onnx = false;
+    } else if (runtime_type.compare("native") == 0) {
+        is_onnx = false;
+        is_native = true;
     } else {
         std::cerr << "Invalid runtime selected: " << runtime_type << std::endl;
         std::cerr << parser;
@@ -74,47 +144,117 @@ int _main(int argc, char** argv) {
     }
     std::cout << "Selected backend: " << runtime_type << std::endl;
 
-    std::unique_ptr<IModel> pModel = nullptr;
-    if (is_onnx) {
-        auto onnx_device = parser.get<std::string>("--onnx-device");
-        if (onnx_device.compare("cpu") == 0) {
-            std::cout << "Selected onnx CPU backend" << std::endl;
-            int total_threads = parser.get<int>("--onnx-cpu-threads");
-            if (total_threads != 0) {
-                std::cout << "Using " << total_threads << " threads for CPU inference" << std::endl;
+    const auto thread_priority = ParseThreadPriority(parser.get<std::string>("--thread-priority"));
+    auto worker_schedule = ThreadSchedule{};
+    worker_schedule.cpus = ParseCpuList(parser.get<std::string>("--worker-cpus"));
+    worker_schedule.priority = thread_priority;
+
+    const auto load_model = [&](const std::string& path) -> std::unique_ptr<IModel> {
+        if (is_native) {
+            std::cout << "Selected native backend on 1 CPU thread" << std::endl;
+            return std::make_unique<NativeModel>(path.c_str());
+        } else if (is_onnx) {
+            auto onnx_device = parser.get<std::string>("--onnx-device");
+            if (onnx_device.compare("cpu") == 0) {
+                std::cout << "Selected onnx CPU backend" << std::endl;
+                int total_threads = parser.get<int>("--onnx-cpu-threads");
+                if (total_threads != 0) {
+                    std::cout << "Using " << total_threads << " threads for CPU inference" << std::endl;
+                } else {
+                    std::cout << "Letting onnx optimise the number of CPU threads" << std::endl;
+                }
+
+                bool is_sequential = parser.get<bool>("--onnx-cpu-sequential");
+                std::cout << "CPU backend is running in parallel: " << !is_sequential << std::endl;
+
+                auto opts = OnnxDirectMLModel::CPU_Options{};
+                opts.total_threads = total_threads;
+                opts.is_sequential = is_sequential;
+                opts.is_count_allocations = parser.get<bool>("--onnx-cpu-count-allocations");
+                opts.cache_directory = parser.get<std::string>("--onnx-cache-dir");
+                opts.worker_schedule = worker_schedule;
+                return std::make_unique<OnnxDirectMLModel>(path.c_str(), opts);
+            } else if (onnx_device.compare("directml") == 0) {
+                const int gpu_id = parser.get<int>("--onnx-directml-gpu-id");
+                std::cout << "Selected onnx DirectML backend GPU:" << gpu_id << std::endl;
+
+                auto opts = OnnxDirectMLModel::GPU_Options{};
+                opts.device_id = gpu_id;
+                return std::make_unique<OnnxDirectMLModel>(path.c_str(), opts);
             } else {
-                std::cout << "Letting onnx optimise the number of CPU threads" << std::endl;
+                throw std::runtime_error("Invalid onnx device: " + onnx_device);
             }
+        } else {
+            int total_threads = parser.get<int>("--tflite-cpus");
+            if (total_threads == 0) {
+                total_threads = std::thread::hardware_concurrency();
+            }
+            std::cout << "Select tflite backend with " << total_threads << " CPU threads" << std::endl;
+            return std::make_unique<TensorflowLiteModel>(path.c_str(), total_threads, 1, worker_schedule);
+        }
+    };
 
-            bool is_sequential = parser.get<bool>("--onnx-cpu-sequential");
-            std::cout << "CPU backend is running in parallel: " << !is_sequential << std::endl;
+    std::unique_ptr<IModel> pModel = load_model(model_path);
+    pModel->PrintSummary();
 
-            auto opts = OnnxDirectMLModel::CPU_Options{};
-            opts.total_threads = total_threads;
-            opts.is_sequential = is_sequential;
-            pModel = std::make_unique<OnnxDirectMLModel>(model_path.c_str(), opts);
-        } else if (onnx_device.compare("directml") == 0) {
-            const int gpu_id = parser.get<int>("--onnx-directml-gpu-id");
-            std::cout << "Selected onnx DirectML backend GPU:" << gpu_id << std::endl;
+    std::unique_ptr<IModel> pROIModel = nullptr;
+    auto roi_model_path = parser.get<std::string>("--roi-model");
+    if (!roi_model_path.empty()) {
+        printf("Loading region of interest model: %s\n", roi_model_path.c_str());
+        pROIModel = load_model(roi_model_path);
+        pROIModel->PrintSummary();
+    }
 
-            auto opts = OnnxDirectMLModel::GPU_Options{};
-            opts.device_id = gpu_id;
-            pModel = std::make_unique<OnnxDirectMLModel>(model_path.c_str(), opts);
-        } else {
-            std::cerr << "Invalid onnx device: " << onnx_device << std::endl;
+    auto app_config = AppConfig{};
+    app_config.record_frames_path = parser.get<std::string>("--record-frames");
+    if (!app_config.record_frames_path.empty()) {
+        std::cout << "Recording frames to: " << app_config.record_frames_path << std::endl;
+    }
+    app_config.warmup_iterations = parser.get<int>("--warmup-iterations");
+    app_config.pipeline_depth = parser.get<int>("--pipeline-depth");
+    app_config.pipeline_drop_stale = !parser.get<bool>("--pipeline-keep-stale");
+    if (app_config.pipeline_depth > 0) {
+        std::cout << "Running pipelined with depth " << app_config.pipeline_depth << std::endl;
+    }
+    app_config.model_schedule.cpus = ParseCpuList(parser.get<std::string>("--model-cpus"));
+    app_config.model_schedule.priority = thread_priority;
+    app_config.capture_schedule.cpus = ParseCpuList(parser.get<std::string>("--capture-cpus"));
+    app_config.capture_schedule.priority = thread_priority;
+    if (!app_config.model_schedule.IsDefault() || !worker_schedule.IsDefault()) {
+        std::cout << "Model threads on cpus [" << GetCpuListString(app_config.model_schedule.cpus)
+                  << "] with workers on [" << GetCpuListString(worker_schedule.cpus)
+                  << "] at " << GetThreadPriorityString(thread_priority) << " priority" << std::endl;
+    }
+    app_config.pacing_mode = ParsePacingMode(parser.get<std::string>("--pacing"));
+    std::cout << "Frame pacing: " << GetPacingModeString(app_config.pacing_mode) << std::endl;
+    app_config.estimator_type = ParseEstimatorType(parser.get<std::string>("--estimator"));
+    std::cout << "Estimator: " << GetEstimatorTypeString(app_config.estimator_type) << std::endl;
+    app_config.latency_log_path = parser.get<std::string>("--latency-log");
+    app_config.latency_log_interval = std::chrono::milliseconds(int64_t(parser.get<float>("--latency-log-interval") * 1000.0f));
+    if (!app_config.latency_log_path.empty()) {
+        std::cout << "Logging latency to: " << app_config.latency_log_path << std::endl;
+    }
+    app_config.flight_log_path = parser.get<std::string>("--flight-log");
+    app_config.flight_log.frame_scale = parser.get<int>("--flight-log-scale");
+    const int flight_log_max_mb = parser.get<int>("--flight-log-max-mb");
+    if (flight_log_max_mb < 0) {
+        std::cerr << "Flight log size limit can't be negative: " << flight_log_max_mb << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+    app_config.flight_log.max_bytes = uint64_t(flight_log_max_mb) * 1024 * 1024;
+    if (!app_config.flight_log_path.empty()) {
+        std::cout << "Recording flight log to: " << app_config.flight_log_path << std::endl;
+    }
+    const auto roi_size = parser.get<std::string>("--roi-size");
+    if (!roi_size.empty()) {
+        if (sscanf(roi_size.c_str(), "%dx%d", &app_config.roi_width, &app_config.roi_height) != 2) {
+            std::cerr << "Invalid region of interest size: " << roi_size << std::endl;
+            std::cerr << parser;
             return 1;
         }
-    } else {
-        int total_threads = parser.get<int>("--tflite-cpus");
-        if (total_threads == 0) {
-            total_threads = std::thread::hardware_concurrency();
-        }
-        std::cout << "Select tflite backend with " << total_threads << " CPU threads" << std::endl;
-        pModel = std::make_unique<TensorflowLiteModel>(model_path.c_str(), total_threads);
     }
-
-    pModel->PrintSummary();
-    return run_app(std::move(pModel));
+    return run_app(std::move(pModel), std::move(pROIModel), app_config);
 }
 
 // Release mode builds don't have an exception output window
@@ -152,7 +292,7 @@ void CreateRenderTarget();
 void CleanupRenderTarget();
 LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
-int run_app(std::unique_ptr<IModel>&& pModel) {
+int run_app(std::unique_ptr<IModel>&& pModel, std::unique_ptr<IModel>&& pROIModel, const AppConfig& config) {
     // Create application window
     //ImGui_ImplWin32_EnableDpiAwareness();
     WNDCLASSEX wc = { sizeof(WNDCLASSEX), CS_CLASSDC, WndProc, 0L, 0L, GetModuleHandle(NULL), NULL, NULL, NULL, NULL, _T("SoccerBot"), NULL };
@@ -223,7 +363,7 @@ int run_app(std::unique_ptr<IModel>&& pModel) {
     ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
     // create app after setting up the dx11 context
-    auto main_app = App(std::move(pModel), g_pd3dDevice, g_pd3dDeviceContext);
+    auto main_app = App(std::move(pModel), std::move(pROIModel), config, g_pd3dDevice, g_pd3dDeviceContext);
 
     // Main loop
     bool done = false;
@@ -241,6 +381,8 @@ int run_app(std::unique_ptr<IModel>&& pModel) {
             break;
         }
 
+        // only copy the model input for display when we are rendering it
+        main_app.m_player->SetPreviewEnabled(main_app.m_is_render_running);
         if (!main_app.m_is_render_running) {
             std::this_thread::sleep_for(std::chrono::milliseconds(100));
             continue;
@@ -0,0 +1,469 @@
+// Stress test of the lock free queues and pipeline stages that is meant to be run under thread sanitizer
+// Pushes numbered items through SPSCQueue and TripleBuffer and checks that every one arrives whole and in order,
+// then runs FramePipeline on synthetic frames while another thread reads the player's snapshots like the gui does
+// Exits with an error if any check fails, configure with -DSOCCERBOT_TSAN=ON so data races are reported too
+#include <stdio.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <argparse/argparse.hpp>
+#include <fmt/core.h>
+
+#include "FramePipeline.h"
+#include "IEstimator.h"
+#include "LatencyHistogram.h"
+#include "NativeModel.h"
+#include "NullMouseController.h"
+#include "SoccerParams.h"
+#include "SoccerPlayer.h"
+#include "SPSCQueue.h"
+#include "SyntheticFrameSource.h"
+#include "ToolUtils.h"
+#include "TripleBuffer.h"
+
+struct StressOptions {
+    // items pushed through each queue and triple buffer
+    uint64_t total_items = 200000;
+    int total_frames = 500;
+    std::vector<int> pipeline_depths = {1,2,3};
+    // a pipeline that stops making progress for this long is reported as stalled
+    int stall_secs = 30;
+    // uses a model that only reads its input if empty
+    std::string model_path;
+    bool is_roi = true;
+    int capture_width = 322;
+    int capture_height = 455;
+};
+
+// failures can be reported from any thread and only the first few are printed
+class FailureLog
+{
+private:
+    static constexpr uint64_t MAX_PRINTED = 16;
+    std::atomic<uint64_t> m_total_failures {0};
+public:
+    void Report(const std::string& message) {
+        const uint64_t index = m_total_failures++;
+        if (index < MAX_PRINTED) {
+            fmt::print(stderr, "FAIL: {}\n", message);
+        }
+    }
+    uint64_t GetTotalFailures() const { return m_total_failures; }
+};
+
+// Cheap stand in for a model that reads all of its input so that races with the preprocessing stage are seen
+// Confidence comes and goes in streaks so the region of interest model is switched in and out
+class StressModel: public IModel
+{
+private:
+    std::vector<float> m_input_buffer;
+    size_t m_width;
+    size_t m_height;
+    uint64_t m_total_calls;
+    Prediction m_prediction;
+public:
+    StressModel(const size_t width, const size_t height)
+    : m_input_buffer(width*height*3, 0.0f), m_width(width), m_height(height), m_total_calls(0) {}
+    InputBuffer GetInputBuffer() override {
+        return InputBuffer {
+            m_input_buffer.data(),
+            m_width,
+            m_height,
+        };
+    }
+    void Parse() override {
+        float total = 0.0f;
+        for (const float v: m_input_buffer) {
+            total += v;
+        }
+        const float mean = total / float(m_input_buffer.size());
+        m_prediction.x = std::clamp(mean, 0.0f, 1.0f);
+        m_prediction.y = 0.5f;
+        m_prediction.confidence = ((m_total_calls % 16) < 12) ? 0.9f : 0.1f;
+        m_total_calls++;
+    }
+    Prediction GetPrediction() override { return m_prediction; }
+    void PrintSummary() override {}
+};
+
+// every item carries a value derived from its index so a torn or stale copy is caught
+struct SequenceItem {
+    uint64_t index = 0;
+    uint64_t check = 0;
+};
+
+static uint64_t get_check(const uint64_t index) {
+    return ~(index * 0x9E3779B97F4A7C15ull);
+}
+
+static void stress_queue(const size_t capacity, const uint64_t total_items, FailureLog& failures) {
+    SPSCQueue<SequenceItem> queue(capacity);
+    std::thread producer([&]() {
+        for (uint64_t i = 0; i < total_items; i++) {
+            const auto item = SequenceItem { i, get_check(i) };
+            while (!queue.TryPush(item)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint64_t expected = 0;
+    uint64_t total_empty_pops = 0;
+    uint64_t total_out_of_order = 0;
+    while (expected < total_items) {
+        SequenceItem item;
+        if (!queue.TryPop(item)) {
+            total_empty_pops++;
+            std::this_thread::yield();
+            continue;
+        }
+        if ((item.index != expected) || (item.check != get_check(expected))) {
+            total_out_of_order++;
+            failures.Report(fmt::format("Queue of capacity {} popped item {} (check={:016x}) when expecting {}",
+                queue.GetCapacity(), item.index, item.check, expected));
+        }
+        if (queue.GetSize() > queue.GetCapacity()) {
+            failures.Report(fmt::format("Queue of capacity {} has {} items", queue.GetCapacity(), queue.GetSize()));
+        }
+        expected++;
+    }
+    producer.join();
+
+    SequenceItem item;
+    if (queue.TryPop(item)) {
+        failures.Report(fmt::format("Queue of capacity {} has item {} after every item was popped", queue.GetCapacity(), item.index));
+    }
+    fmt::print(stderr, "SPSCQueue capacity={}: {} items with {} out of order and {} empty pops\n",
+        queue.GetCapacity(), total_items, total_out_of_order, total_empty_pops);
+}
+
+// large enough to span several cache lines so a partially written value is likely to be seen if it can be
+struct SequenceBlock {
+    static constexpr int TOTAL_VALUES = 31;
+    uint64_t index = 0;
+    uint64_t values[TOTAL_VALUES] = {};
+};
+
+static void stress_triple_buffer(const uint64_t total_items, FailureLog& failures) {
+    TripleBuffer<SequenceBlock> buffer;
+    std::thread writer([&]() {
+        for (uint64_t i = 1; i <= total_items; i++) {
+            auto& block = buffer.GetWriteBuffer();
+            block.index = i;
+            for (int j = 0; j < SequenceBlock::TOTAL_VALUES; j++) {
+                block.values[j] = get_check(i + uint64_t(j));
+                // give up the core halfway through some values so the reader overlaps with partial writes
+                // even when there are fewer cores than threads
+                if (((i % 16) == 0) && (j == SequenceBlock::TOTAL_VALUES/2)) {
+                    std::this_thread::yield();
+                }
+            }
+            buffer.Publish();
+        }
+    });
+
+    // the last published value stays in the middle buffer until it is read so the reader always reaches it
+    uint64_t last_index = 0;
+    uint64_t total_reads = 0;
+    uint64_t total_updates = 0;
+    uint64_t total_torn = 0;
+    while (last_index < total_items) {
+        const bool is_updated = buffer.IsUpdated();
+        const auto& block = buffer.Read();
+        total_reads++;
+        if (block.index < last_index) {
+            failures.Report(fmt::format("Triple buffer went back from {} to {}", last_index, block.index));
+        }
+        if (is_updated && (block.index == last_index)) {
+            failures.Report(fmt::format("Triple buffer was updated but read the same value {}", block.index));
+        }
+        if (block.index != 0) {
+            for (int j = 0; j < SequenceBlock::TOTAL_VALUES; j++) {
+                if (block.values[j] != get_check(block.index + uint64_t(j))) {
+                    total_torn++;
+                    failures.Report(fmt::format("Triple buffer value {} is torn at {}", block.index, j));
+                    break;
+                }
+            }
+        }
+        total_updates += uint64_t(block.index != last_index);
+        last_index = std::max(last_index, block.index);
+    }
+    writer.join();
+
+    if (buffer.IsUpdated()) {
+        failures.Report("Triple buffer is updated after the last value was read");
+    }
+    fmt::print(stderr, "TripleBuffer: {} values with {} reads seeing {} of them and {} torn\n",
+        total_items, total_reads, total_updates, total_torn);
+}
+
+// checks that the snapshots only move forwards while the pipeline is running
+class SnapshotReader
+{
+private:
+    SoccerPlayer& m_player;
+    FailureLog& m_failures;
+    std::atomic<bool> m_is_running;
+    std::thread m_thread;
+    uint64_t m_total_reads;
+    uint64_t m_total_results;
+    uint64_t m_total_previews;
+public:
+    SnapshotReader(SoccerPlayer& player, FailureLog& failures)
+    : m_player(player), m_failures(failures), m_is_running(true),
+      m_total_reads(0), m_total_results(0), m_total_previews(0)
+    {
+        m_thread = std::thread([this]() { Run(); });
+    }
+    ~SnapshotReader() {
+        Stop();
+    }
+    void Stop() {
+        m_is_running = false;
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+    uint64_t GetTotalReads() const { return m_total_reads; }
+    uint64_t GetTotalResults() const { return m_total_results; }
+    uint64_t GetTotalPreviews() const { return m_total_previews; }
+private:
+    void Run() {
+        uint64_t last_result_frame = 0;
+        uint64_t last_total_frames = 0;
+        uint64_t last_preview_frame = 0;
+        uint64_t last_counts[TOTAL_LATENCY_STAGES] = {};
+        while (m_is_running) {
+            const auto& result = m_player.GetLatestResult();
+            if (result.total_frames != last_total_frames) {
+                if ((result.total_frames < last_total_frames) || (result.frame_index < last_result_frame)) {
+                    m_failures.Report(fmt::format("Result went back from frame {} ({} total) to frame {} ({} total)",
+                        last_result_frame, last_total_frames, result.frame_index, result.total_frames));
+                }
+                if ((result.total_roi_frames > result.total_frames) || (result.total_skipped_frames > result.total_frames)) {
+                    m_failures.Report(fmt::format("Result of frame {} has {} roi and {} skipped frames out of {}",
+                        result.frame_index, result.total_roi_frames, result.total_skipped_frames, result.total_frames));
+                }
+                last_result_frame = result.frame_index;
+                last_total_frames = result.total_frames;
+                m_total_results++;
+            }
+
+            const auto& preview = m_player.GetLatestPreview();
+            if (!preview.data.empty()) {
+                if (preview.frame_index < last_preview_frame) {
+                    m_failures.Report(fmt::format("Preview went back from frame {} to {}", last_preview_frame, preview.frame_index));
+                }
+                if (preview.data.size() != GetInputBufferSize(preview.format)) {
+                    m_failures.Report(fmt::format("Preview of frame {} has {} bytes for a {}x{} {} input",
+                        preview.frame_index, preview.data.size(), preview.format.width, preview.format.height,
+                        GetInputTypeString(preview.format.type)));
+                }
+                m_total_previews += uint64_t(preview.frame_index != last_preview_frame);
+                last_preview_frame = preview.frame_index;
+            }
+
+            const auto& latency = m_player.GetLatencyStats();
+            for (int i = 0; i < TOTAL_LATENCY_STAGES; i++) {
+                const auto stage = LatencyStage(i);
+                const auto snapshot = latency.Get(stage).GetSnapshot();
+                if (snapshot.total_count < last_counts[i]) {
+                    m_failures.Report(fmt::format("Latency count of {} went back from {} to {}",
+                        GetLatencyStageString(stage), last_counts[i], snapshot.total_count));
+                }
+                last_counts[i] = snapshot.total_count;
+            }
+            m_total_reads++;
+        }
+    }
+};
+
+static std::unique_ptr<IModel> create_model(const StressOptions& options) {
+    if (!options.model_path.empty()) {
+        return std::make_unique<NativeModel>(options.model_path.c_str());
+    }
+    return std::make_unique<StressModel>(227, 161);
+}
+
+static void stress_pipeline(const StressOptions& options, const int depth, const bool is_drop_stale, FailureLog& failures) {
+    auto synthetic_config = SyntheticFrameSource::Config{};
+    synthetic_config.width = options.capture_width;
+    synthetic_config.height = options.capture_height;
+    std::shared_ptr<IFrameSource> frame_source = std::make_shared<SyntheticFrameSource>(synthetic_config);
+    std::shared_ptr<IMouseController> mouse = std::make_shared<NullMouseController>();
+    auto params = std::make_shared<SoccerParams>();
+    SoccerPlayer player(create_model(options), frame_source, mouse, params);
+    player.SetEstimator(CreateEstimator(EstimatorType::DIFFERENCE, params));
+    if (options.is_roi) {
+        player.SetROIModel(std::make_unique<StressModel>(96, 96), 160, 160);
+    }
+    player.SetPreviewEnabled(true);
+
+    auto pipeline_config = FramePipeline::Config{};
+    pipeline_config.depth = depth;
+    pipeline_config.drop_stale = is_drop_stale;
+    int total_polled = 0;
+    std::atomic<bool> is_capture_done = false;
+    uint64_t total_captured = 0;
+    uint64_t total_dropped = 0;
+    uint64_t total_applied = 0;
+    const auto dt_start = std::chrono::steady_clock::now();
+    // NOTE: The reader outlives the pipeline so it keeps reading while the stages shut down
+    SnapshotReader reader(player, failures);
+    {
+        FramePipeline pipeline(player, pipeline_config, [&](int& top, int& left) {
+            if (total_polled >= options.total_frames) {
+                is_capture_done = true;
+                return false;
+            }
+            total_polled++;
+            top = 0;
+            left = 0;
+            return true;
+        });
+        // every captured frame is either dropped by a stage or reaches the end of the control stage
+        uint64_t last_progress = 0;
+        auto dt_last_progress = std::chrono::steady_clock::now();
+        while (true) {
+            const auto stats = pipeline.GetStats();
+            total_captured = stats.total_captured;
+            total_dropped = stats.total_dropped;
+            total_applied = player.GetLatencyStats().Get(LatencyStage::END_TO_END).GetSnapshot().total_count;
+            if (is_capture_done && (total_captured == (total_dropped + total_applied))) break;
+
+            const auto dt_now = std::chrono::steady_clock::now();
+            const uint64_t progress = total_captured + total_dropped + total_applied;
+            if (progress != last_progress) {
+                last_progress = progress;
+                dt_last_progress = dt_now;
+            } else if ((dt_now - dt_last_progress) > std::chrono::seconds(options.stall_secs)) {
+                failures.Report(fmt::format("Pipeline stalled for {}s with {} captured, {} dropped and {} applied",
+                    options.stall_secs, total_captured, total_dropped, total_applied));
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+    reader.Stop();
+    const auto dt_end = std::chrono::steady_clock::now();
+    fmt::print(stderr, "FramePipeline depth={} drop_stale={}: {} captured, {} dropped, {} reads seeing {} results and {} previews in {:.2f}s\n",
+        depth, is_drop_stale, total_captured, total_dropped, reader.GetTotalReads(), reader.GetTotalResults(),
+        reader.GetTotalPreviews(), std::chrono::duration<double>(dt_end - dt_start).count());
+
+    if (total_captured != uint64_t(options.total_frames)) {
+        failures.Report(fmt::format("Pipeline captured {} frames but {} were polled", total_captured, options.total_frames));
+    }
+    if (!is_drop_stale && (total_dropped != 0)) {
+        failures.Report(fmt::format("Pipeline dropped {} frames without drop_stale", total_dropped));
+    }
+    const auto& result = player.GetLatestResult();
+    if (result.total_frames != total_applied) {
+        failures.Report(fmt::format("Last result has {} frames but {} were applied", result.total_frames, total_applied));
+    }
+}
+
+int _main(int argc, char** argv) {
+    auto parser = argparse::ArgumentParser("SoccerBot Pipeline Stress Test", "1.0.0");
+    parser.add_argument("--items")
+        .default_value(200000)
+        .scan<'i', int>()
+        .help("Number of items pushed through each queue and triple buffer");
+    parser.add_argument("--frames")
+        .default_value(500)
+        .scan<'i', int>()
+        .help("Number of frames captured for each pipeline configuration");
+    parser.add_argument("--pipeline-depths")
+        .default_value(std::string("1,2,3"))
+        .help("Comma separated list of pipeline depths to run");
+    parser.add_argument("--stall-secs")
+        .default_value(30)
+        .scan<'i', int>()
+        .help("Seconds without any frames moving through the pipeline before it is reported as stalled");
+    parser.add_argument("--model")
+        .default_value(std::string(""))
+        .help("Native model (.bin) to run in the pipeline. Uses a model that only reads its input if not provided.");
+    parser.add_argument("--no-roi")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Don't run a region of interest model alongside the full frame model");
+    parser.add_argument("--capture-size")
+        .default_value(std::string("322x455"))
+        .help("Size of the synthetic frames as WxH");
+
+    try {
+        parser.parse_args(argc, argv);
+    } catch (const std::runtime_error& ex) {
+        std::cerr << ex.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    auto options = StressOptions{};
+    const int total_items = parser.get<int>("--items");
+    options.total_frames = parser.get<int>("--frames");
+    options.pipeline_depths = parse_int_list(parser.get<std::string>("--pipeline-depths"), "--pipeline-depths");
+    options.stall_secs = parser.get<int>("--stall-secs");
+    options.model_path = parser.get<std::string>("--model");
+    options.is_roi = !parser.get<bool>("--no-roi");
+    const auto capture_size = parser.get<std::string>("--capture-size");
+    if (sscanf(capture_size.c_str(), "%dx%d", &options.capture_width, &options.capture_height) != 2) {
+        throw std::runtime_error(fmt::format("Invalid capture size: '{}'", capture_size));
+    }
+    if (total_items <= 0) {
+        throw std::runtime_error(fmt::format("Number of items must be positive (got {})", total_items));
+    }
+    options.total_items = uint64_t(total_items);
+    if (options.total_frames <= 0) {
+        throw std::runtime_error(fmt::format("Number of frames must be positive (got {})", options.total_frames));
+    }
+    if (options.stall_secs <= 0) {
+        throw std::runtime_error(fmt::format("Stall timeout must be positive (got {})", options.stall_secs));
+    }
+    for (const int depth: options.pipeline_depths) {
+        if (depth <= 0) {
+            throw std::runtime_error(fmt::format("Pipeline depth must be positive (got {})", depth));
+        }
+    }
+    if ((options.capture_width <= 0) || (options.capture_height <= 0)) {
+        throw std::runtime_error(fmt::format("Capture size must be positive (got {})", capture_size));
+    }
+
+    FailureLog failures;
+    // a capacity of 1 makes every push wait for the consumer which is where ordering mistakes show up
+    for (const size_t capacity: {size_t(1), size_t(2), size_t(7), size_t(64)}) {
+        stress_queue(capacity, options.total_items, failures);
+    }
+    stress_triple_buffer(options.total_items, failures);
+    for (const int depth: options.pipeline_depths) {
+        for (const bool is_drop_stale: {true, false}) {
+            stress_pipeline(options, depth, is_drop_stale, failures);
+        }
+    }
+
+    const uint64_t total_failures = failures.GetTotalFailures();
+    if (total_failures > 0) {
+        fmt::print(stderr, "{} checks failed\n", total_failures);
+        return 1;
+    }
+    fmt::print(stderr, "Every check passed\n");
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    try {
+        return _main(argc, argv);
+    } catch (std::exception& ex) {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,405 @@
+// Closed loop evaluation of the ball controller on simulated games of the emulator
+// Games are spread over every core and the distribution of their scores is written as json for each
+// combination of estimator and observation mode
+#include <stdio.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <argparse/argparse.hpp>
+#include <fmt/core.h>
+
+#include "EmulatorBall.h"
+#include "GameSimulator.h"
+#include "IEstimator.h"
+#include "NativeModel.h"
+#include "OnnxDirectMLModel.h"
+#include "SoccerParams.h"
+#include "TensorflowLiteModel.h"
+#include "ToolUtils.h"
+
+struct SimulatorOptions {
+    int total_games = 10000;
+    // uses every core if 0
+    int total_threads = 0;
+    uint32_t seed = 1;
+    GameSimulator::Config game;
+    // only needed for model observations, each thread loads its own copy
+    std::string model_path;
+    std::string runtime = "auto";
+};
+
+// distribution of the final scores of a set of games
+struct ScoreSummary {
+    double mean = 0.0;
+    int p10 = 0;
+    int p50 = 0;
+    int p90 = 0;
+    int p99 = 0;
+    int max = 0;
+    // counts of scores in [i*bucket_width, (i+1)*bucket_width)
+    int bucket_width = 1;
+    std::vector<int> buckets;
+};
+
+struct SimulatorResult {
+    EstimatorType estimator_type = EstimatorType::DIFFERENCE;
+    ObservationMode observation_mode = ObservationMode::TRUTH;
+    int total_threads = 0;
+    double duration_secs = 0.0;
+    ScoreSummary score;
+    uint64_t total_frames = 0;
+    uint64_t total_clicks = 0;
+    uint64_t total_misses = 0;
+    int total_timeouts = 0;
+};
+
+// every game thread runs its own model so each one is limited to a single thread
+static std::unique_ptr<IModel> create_model(const SimulatorOptions& options) {
+    const auto runtime = get_runtime(options.runtime, options.model_path);
+    if (runtime.compare("onnx") == 0) {
+        auto opts = OnnxDirectMLModel::CPU_Options{};
+        opts.total_threads = 1;
+        opts.is_sequential = true;
+        return std::make_unique<OnnxDirectMLModel>(options.model_path.c_str(), opts);
+    }
+    if (runtime.compare("tflite") == 0) {
+        return std::make_unique<TensorflowLiteModel>(options.model_path.c_str(), 1);
+    }
+    if (runtime.compare("native") == 0) {
+        return std::make_unique<NativeModel>(options.model_path.c_str());
+    }
+    throw std::runtime_error(fmt::format("Invalid runtime selected: {}", runtime));
+}
+
+static ScoreSummary summarise_scores(std::vector<int>& scores) {
+    ScoreSummary summary;
+    if (scores.empty()) {
+        return summary;
+    }
+    std::sort(scores.begin(), scores.end());
+    double sum = 0.0;
+    for (const int score: scores) {
+        sum += double(score);
+    }
+    const auto get_percentile = [&](const double percentile) {
+        const size_t index = std::min(size_t(percentile/100.0 * double(scores.size())), scores.size()-1);
+        return scores[index];
+    };
+    summary.mean = sum / double(scores.size());
+    summary.p10 = get_percentile(10.0);
+    summary.p50 = get_percentile(50.0);
+    summary.p90 = get_percentile(90.0);
+    summary.p99 = get_percentile(99.0);
+    summary.max = scores.back();
+
+    // keep the histogram to a readable number of buckets
+    const int max_buckets = 50;
+    summary.bucket_width = std::max((summary.max + max_buckets) / max_buckets, 1);
+    summary.buckets.resize(size_t(summary.max / summary.bucket_width) + 1, 0);
+    for (const int score: scores) {
+        summary.buckets[size_t(score / summary.bucket_width)]++;
+    }
+    return summary;
+}
+
+static SimulatorResult run_games(
+    const EstimatorType estimator_type, const ObservationMode observation_mode,
+    std::shared_ptr<SoccerParams>& params, const SimulatorOptions& options)
+{
+    auto config = options.game;
+    config.observation_mode = observation_mode;
+
+    // every thread has its own simulator so the games don't share any state
+    const int total_threads = std::min(options.total_threads, options.total_games);
+    std::vector<std::unique_ptr<GameSimulator>> simulators;
+    for (int i = 0; i < total_threads; i++) {
+        auto simulator = std::make_unique<GameSimulator>(config, params);
+        simulator->SetEstimator(CreateEstimator(estimator_type, params));
+        if (observation_mode == ObservationMode::MODEL) {
+            simulator->SetModel(create_model(options));
+        }
+        simulators.push_back(std::move(simulator));
+    }
+
+    // games are handed out one at a time since their lengths vary a lot
+    std::vector<GameSimulator::GameResult> games(size_t(options.total_games));
+    std::atomic<int> next_game = 0;
+    std::vector<std::exception_ptr> errors(size_t(total_threads), nullptr);
+    std::vector<std::thread> threads;
+    const auto dt_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < total_threads; i++) {
+        threads.emplace_back([&, i]() {
+            try {
+                auto& simulator = *simulators[size_t(i)];
+                while (true) {
+                    const int game = next_game.fetch_add(1);
+                    if (game >= options.total_games) break;
+                    games[size_t(game)] = simulator.Play(options.seed + uint32_t(game));
+                }
+            } catch (...) {
+                errors[size_t(i)] = std::current_exception();
+                next_game = options.total_games;
+            }
+        });
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    const auto dt_end = std::chrono::steady_clock::now();
+    for (auto& error: errors) {
+        if (error != nullptr) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    SimulatorResult result;
+    result.estimator_type = estimator_type;
+    result.observation_mode = observation_mode;
+    result.total_threads = total_threads;
+    result.duration_secs = std::chrono::duration<double>(dt_end - dt_start).count();
+    std::vector<int> scores;
+    scores.reserve(games.size());
+    for (const auto& game: games) {
+        scores.push_back(game.score);
+        result.total_frames += uint64_t(game.total_frames);
+        result.total_clicks += uint64_t(game.total_clicks);
+        result.total_misses += uint64_t(game.total_misses);
+        result.total_timeouts += game.is_timeout ? 1 : 0;
+    }
+    result.score = summarise_scores(scores);
+    return result;
+}
+
+static void print_summary(const SimulatorResult& result, const SimulatorOptions& options) {
+    const double total_games = double(options.total_games);
+    const double game_secs = double(result.total_frames) / double(options.game.frame_rate);
+    fmt::print(stderr,
+        "{} with {} observations: score mean={:.2f} p10={} p50={} p90={} p99={} max={}, "
+        "misses={}/{}, timeouts={}, {:.0f} games/s, {:.0f}x realtime\n",
+        GetEstimatorTypeString(result.estimator_type), GetObservationModeString(result.observation_mode),
+        result.score.mean, result.score.p10, result.score.p50, result.score.p90, result.score.p99, result.score.max,
+        result.total_misses, result.total_clicks, result.total_timeouts,
+        total_games / result.duration_secs, game_secs / result.duration_secs);
+}
+
+static void write_results(FILE* fp, const std::vector<SimulatorResult>& results, const SimulatorOptions& options, const SoccerParams& params) {
+    const auto& game = options.game;
+    fmt::print(fp, "{{\n");
+    fmt::print(fp, "  \"games\": {},\n", options.total_games);
+    fmt::print(fp, "  \"seed\": {},\n", options.seed);
+    fmt::print(fp, "  \"window\": {{\"width\": {}, \"height\": {}}},\n", game.width, game.height);
+    fmt::print(fp, "  \"frame_rate\": {:.3f},\n", game.frame_rate);
+    fmt::print(fp, "  \"inference_latency_ms\": {:.3f},\n", game.inference_latency_ms);
+    fmt::print(fp, "  \"input_latency_ms\": {:.3f},\n", game.input_latency_ms);
+    fmt::print(fp, "  \"max_game_secs\": {:.3f},\n", game.max_game_secs);
+    fmt::print(fp, "  \"noise\": {:.6f},\n", game.noise);
+    fmt::print(fp, "  \"dropout\": {:.3f},\n", game.dropout);
+    fmt::print(fp, "  \"use_predictor\": {},\n", game.can_use_predictor);
+    fmt::print(fp, "  \"params\": {{\"acceleration\": {:.4f}, \"relative_ball_width\": {:.4f}, \"input_delay_ms\": {:.3f}}},\n",
+        params.acceleration, params.relative_ball_width, params.input_delay_secs * 1000.0f);
+    fmt::print(fp, "  \"results\": [");
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto& result = results[i];
+        const auto& score = result.score;
+        const double game_secs = double(result.total_frames) / double(game.frame_rate);
+        fmt::print(fp, "{}\n    {{\n", (i == 0) ? "" : ",");
+        fmt::print(fp, "      \"estimator\": \"{}\",\n", GetEstimatorTypeString(result.estimator_type));
+        fmt::print(fp, "      \"observations\": \"{}\",\n", GetObservationModeString(result.observation_mode));
+        fmt::print(fp, "      \"threads\": {},\n", result.total_threads);
+        fmt::print(fp, "      \"duration_secs\": {:.6f},\n", result.duration_secs);
+        fmt::print(fp, "      \"games_per_sec\": {:.3f},\n", double(options.total_games) / result.duration_secs);
+        fmt::print(fp, "      \"realtime_factor\": {:.3f},\n", game_secs / result.duration_secs);
+        fmt::print(fp, "      \"frames\": {},\n", result.total_frames);
+        fmt::print(fp, "      \"clicks\": {},\n", result.total_clicks);
+        fmt::print(fp, "      \"misses\": {},\n", result.total_misses);
+        fmt::print(fp, "      \"timeouts\": {},\n", result.total_timeouts);
+        fmt::print(fp, "      \"score\": {{\"mean\": {:.4f}, \"p10\": {}, \"p50\": {}, \"p90\": {}, \"p99\": {}, \"max\": {}}},\n",
+            score.mean, score.p10, score.p50, score.p90, score.p99, score.max);
+        fmt::print(fp, "      \"histogram\": {{\"bucket_width\": {}, \"counts\": [", score.bucket_width);
+        for (size_t j = 0; j < score.buckets.size(); j++) {
+            fmt::print(fp, "{}{}", (j == 0) ? "" : ", ", score.buckets[j]);
+        }
+        fmt::print(fp, "]}}\n");
+        fmt::print(fp, "    }}");
+    }
+    fmt::print(fp, "\n  ]\n}}\n");
+}
+
+int _main(int argc, char** argv) {
+    auto parser = argparse::ArgumentParser("SoccerBot Simulator", "1.0.0");
+    parser.add_argument("--estimators")
+        .default_value(std::string("difference,kalman"))
+        .help("Comma separated list of estimators. Options: [difference, kalman]");
+    parser.add_argument("--observations")
+        .default_value(std::string("truth,noisy"))
+        .help("Comma separated list of what the controller sees. Options: [truth, noisy, model]");
+    parser.add_argument("--model")
+        .default_value(std::string(""))
+        .help("Model to run on rendered frames for model observations");
+    parser.add_argument("--runtime")
+        .default_value(std::string("auto"))
+        .help("Runtime of the model. Options: [auto, tflite, onnx, native]");
+    parser.add_argument("--games")
+        .default_value(10000)
+        .scan<'i', int>()
+        .help("Number of games to play for each estimator and observation mode");
+    parser.add_argument("--threads")
+        .default_value(0)
+        .scan<'i', int>()
+        .help("Number of threads to play games on. Uses every core if 0.");
+    parser.add_argument("--seed")
+        .default_value(1)
+        .scan<'i', int>()
+        .help("Seed of the first game, each game after it uses the next seed");
+    parser.add_argument("--frame-rate")
+        .default_value(60.0f)
+        .scan<'g', float>()
+        .help("Frame rate of the game");
+    parser.add_argument("--inference-latency-ms")
+        .default_value(8.0f)
+        .scan<'g', float>()
+        .help("Delay between a frame being displayed and the controller acting on it");
+    parser.add_argument("--input-latency-ms")
+        .default_value(20.0f)
+        .scan<'g', float>()
+        .help("Delay between the controller acting and the click landing in the game");
+    parser.add_argument("--input-delay-ms")
+        .default_value(-1.0f)
+        .scan<'g', float>()
+        .help("Input delay the estimators project their outputs by. If negative the input latency is used.");
+    parser.add_argument("--noise")
+        .default_value(0.004f)
+        .scan<'g', float>()
+        .help("Standard deviation of noisy observations at full confidence in normalised screen units");
+    parser.add_argument("--dropout")
+        .default_value(0.05f)
+        .scan<'g', float>()
+        .help("Chance that a noisy observation misses a visible ball");
+    parser.add_argument("--max-game-secs")
+        .default_value(120.0f)
+        .scan<'g', float>()
+        .help("Games are stopped after this long");
+    parser.add_argument("--no-predictor")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Move the cursor to the raw observations instead of the estimator's projection");
+    parser.add_argument("--acceleration")
+        .default_value(-1.0f)
+        .scan<'g', float>()
+        .help("Gravity the estimators expect in normalised screen heights per second^2. If negative the emulator's gravity is used.");
+    parser.add_argument("--output")
+        .default_value(std::string(""))
+        .help("Path to write json results to. If not provided results are written to stdout.");
+
+    try {
+        parser.parse_args(argc, argv);
+    } catch (const std::runtime_error& ex) {
+        std::cerr << ex.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    auto options = SimulatorOptions{};
+    options.total_games = parser.get<int>("--games");
+    options.total_threads = parser.get<int>("--threads");
+    options.seed = uint32_t(parser.get<int>("--seed"));
+    options.model_path = parser.get<std::string>("--model");
+    options.runtime = parser.get<std::string>("--runtime");
+    auto& game = options.game;
+    game.frame_rate = parser.get<float>("--frame-rate");
+    game.inference_latency_ms = parser.get<float>("--inference-latency-ms");
+    game.input_latency_ms = parser.get<float>("--input-latency-ms");
+    game.noise = parser.get<float>("--noise");
+    game.dropout = parser.get<float>("--dropout");
+    game.max_game_secs = parser.get<float>("--max-game-secs");
+    game.can_use_predictor = !parser.get<bool>("--no-predictor");
+    if (options.total_games <= 0) {
+        throw std::runtime_error(fmt::format("Number of games must be positive (got {})", options.total_games));
+    }
+    if (options.total_threads < 0) {
+        throw std::runtime_error(fmt::format("Number of threads can't be negative (got {})", options.total_threads));
+    }
+    if (options.total_threads == 0) {
+        options.total_threads = std::max(int(std::thread::hardware_concurrency()), 1);
+    }
+    if ((game.dropout < 0.0f) || (game.dropout > 1.0f)) {
+        throw std::runtime_error(fmt::format("Dropout must be between 0 and 1 (got {})", game.dropout));
+    }
+    if (game.max_game_secs <= 0.0f) {
+        throw std::runtime_error(fmt::format("Maximum game length must be positive (got {}s)", game.max_game_secs));
+    }
+
+    std::vector<EstimatorType> estimator_types;
+    for (const auto& estimator: split_list(parser.get<std::string>("--estimators"))) {
+        estimator_types.push_back(ParseEstimatorType(estimator));
+    }
+    if (estimator_types.empty()) {
+        throw std::runtime_error("Expected at least one estimator");
+    }
+    std::vector<ObservationMode> observation_modes;
+    for (const auto& mode: split_list(parser.get<std::string>("--observations"))) {
+        observation_modes.push_back(ParseObservationMode(mode));
+        if ((observation_modes.back() == ObservationMode::MODEL) && options.model_path.empty()) {
+            throw std::runtime_error("Model observations require a model to be provided with --model");
+        }
+    }
+    if (observation_modes.empty()) {
+        throw std::runtime_error("Expected at least one observation mode");
+    }
+
+    // the estimators are told what the game is like unless overridden
+    const EmulatorBall ball;
+    float acceleration = parser.get<float>("--acceleration");
+    if (acceleration < 0.0f) {
+        acceleration = ball.gravity / float(game.height);
+    }
+    float input_delay_ms = parser.get<float>("--input-delay-ms");
+    if (input_delay_ms < 0.0f) {
+        input_delay_ms = game.input_latency_ms;
+    }
+    auto params = std::make_shared<SoccerParams>();
+    params->acceleration = acceleration;
+    params->relative_ball_width = 2.0f*ball.radius / float(game.width);
+    params->input_delay_secs = input_delay_ms / 1000.0f;
+
+    std::vector<SimulatorResult> results;
+    for (const auto mode: observation_modes) {
+        for (const auto type: estimator_types) {
+            results.push_back(run_games(type, mode, params, options));
+            print_summary(results.back(), options);
+        }
+    }
+
+    const auto output_path = parser.get<std::string>("--output");
+    if (output_path.empty()) {
+        write_results(stdout, results, options, *params);
+        fflush(stdout);
+        return 0;
+    }
+    FILE* fp = fopen(output_path.c_str(), "w");
+    if (fp == nullptr) {
+        throw std::runtime_error(fmt::format("Failed to open output file '{}'", output_path));
+    }
+    write_results(fp, results, options, *params);
+    fclose(fp);
+    fmt::print(stderr, "Wrote results to: {}\n", output_path);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    try {
+        return _main(argc, argv);
+    } catch (std::exception& ex) {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,383 @@
+// Searches for the soccer params that catch the most falls of recorded trajectories
+// Random candidates are drawn from the ranges of the gui's sliders, then each round searches a smaller
+// range around the best so far. Every candidate is replayed through the real estimator and triggers
+// on a work stealing pool and the best is written as json
+#include <stdio.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <argparse/argparse.hpp>
+#include <fmt/core.h>
+
+#include "FlightLogReader.h"
+#include "IEstimator.h"
+#include "ParamTuner.h"
+#include "SoccerParams.h"
+#include "ThreadSchedule.h"
+#include "ToolUtils.h"
+#include "Trajectory.h"
+#include "WorkStealingPool.h"
+
+struct TunerOptions {
+    EstimatorType estimator_type = EstimatorType::DIFFERENCE;
+    int total_candidates = 4096;
+    int total_rounds = 3;
+    uint32_t seed = 1;
+    // uses every core if 0
+    int total_threads = 0;
+    std::vector<int> cpus;
+    int total_top = 10;
+    ParamTuner::Config tuner;
+};
+
+// values of the tuned params that are searched over
+struct ParamRange {
+    float min = 0.0f;
+    float max = 0.0f;
+};
+
+struct Candidate {
+    SoccerParams params;
+    TuningScore score;
+    int round = 0;
+};
+
+struct RoundSummary {
+    int total_candidates = 0;
+    double duration_secs = 0.0;
+    TuningScore best_score;
+};
+
+static ParamRange get_slider_range(const TunedParam param) {
+    // same as the sliders in the gui's parameters window
+    switch (param) {
+    case TunedParam::ACCELERATION:            return { 0.0f, 10.0f };
+    case TunedParam::INPUT_DELAY_SECS:        return { 0.0f, 0.5f };
+    case TunedParam::CONFIDENCE_THRESHOLD:    return { 0.0f, 1.0f };
+    case TunedParam::MAX_LOST_FRAMES:         return { 0.0f, 5.0f };
+    case TunedParam::FALL_SPEED_TRIGGER_SOFT: return { 0.0f, 10.0f };
+    case TunedParam::HEIGHT_TRIGGER_SOFT:     return { 0.0f, 1.0f };
+    case TunedParam::FALL_SPEED_TRIGGER_HARD: return { 0.0f, 10.0f };
+    case TunedParam::HEIGHT_TRIGGER_HARD:     return { 0.0f, 1.0f };
+    default: throw std::runtime_error(fmt::format("Invalid tuned param: {}", int(param)));
+    }
+}
+
+// higher objective first then fewer misses so ties go to the more careful params
+static bool is_better(const TuningScore& a, const TuningScore& b) {
+    if (a.objective != b.objective) return a.objective > b.objective;
+    return a.total_misses < b.total_misses;
+}
+
+// draws candidates around the centre in a range that shrinks by half each round
+static std::vector<Candidate> create_candidates(
+    const SoccerParams& centre, const int round, const int total_candidates, std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    const float scale = 1.0f / float(1 << std::min(round, 16));
+    std::vector<Candidate> candidates;
+    candidates.resize(size_t(total_candidates));
+    for (auto& candidate: candidates) {
+        candidate.params = centre;
+        candidate.round = round;
+        for (int i = 0; i < TOTAL_TUNED_PARAMS; i++) {
+            const auto param = TunedParam(i);
+            const auto range = get_slider_range(param);
+            // the first round covers the whole range and later rounds are centred on the best
+            float v_min = range.min;
+            float v_max = range.max;
+            if (round > 0) {
+                const float half_width = 0.5f * scale * (range.max - range.min);
+                const float value = GetTunedParam(centre, param);
+                v_min = std::max(value - half_width, range.min);
+                v_max = std::min(value + half_width, range.max);
+            }
+            SetTunedParam(candidate.params, param, v_min + (v_max - v_min)*uniform(rng));
+        }
+    }
+    return candidates;
+}
+
+static void evaluate_candidates(
+    std::vector<Candidate>& candidates, std::vector<std::unique_ptr<ParamTuner>>& tuners,
+    const std::vector<TuningTrajectory>& trajectories, WorkStealingPool& pool)
+{
+    pool.ParallelFor(candidates.size(), [&](const size_t index, const int thread_index) {
+        auto& candidate = candidates[index];
+        candidate.score = tuners[size_t(thread_index)]->Evaluate(candidate.params, trajectories);
+    });
+}
+
+static void print_score(const char* name, const TuningScore& score) {
+    fmt::print(stderr, "{}: caught {}/{} falls, {} of {} clicks missed, objective={:.4f}\n",
+        name, score.total_caught, score.total_falls, score.total_misses, score.total_clicks, score.objective);
+}
+
+static void write_params(FILE* fp, const SoccerParams& params) {
+    fmt::print(fp, "{{\"relative_ball_width\": {:.4f}", params.relative_ball_width);
+    for (int i = 0; i < TOTAL_TUNED_PARAMS; i++) {
+        const auto param = TunedParam(i);
+        if (param == TunedParam::MAX_LOST_FRAMES) {
+            fmt::print(fp, ", \"{}\": {}", GetTunedParamString(param), params.max_lost_frames);
+        } else {
+            fmt::print(fp, ", \"{}\": {:.4f}", GetTunedParamString(param), GetTunedParam(params, param));
+        }
+    }
+    fmt::print(fp, "}}");
+}
+
+static void write_score(FILE* fp, const TuningScore& score) {
+    fmt::print(fp, "{{\"falls\": {}, \"caught\": {}, \"clicks\": {}, \"misses\": {}, \"objective\": {:.6f}}}",
+        score.total_falls, score.total_caught, score.total_clicks, score.total_misses, score.objective);
+}
+
+static void write_results(
+    FILE* fp, const TunerOptions& options, const std::vector<TuningTrajectory>& trajectories,
+    const Candidate& baseline, const std::vector<Candidate>& top, const std::vector<RoundSummary>& rounds,
+    const int total_threads)
+{
+    const auto& config = options.tuner;
+    fmt::print(fp, "{{\n");
+    fmt::print(fp, "  \"estimator\": \"{}\",\n", GetEstimatorTypeString(options.estimator_type));
+    fmt::print(fp, "  \"threads\": {},\n", total_threads);
+    fmt::print(fp, "  \"seed\": {},\n", options.seed);
+    fmt::print(fp, "  \"latency_ms\": {:.3f},\n", config.latency_ms);
+    fmt::print(fp, "  \"input_latency_ms\": {:.3f},\n", config.input_latency_ms);
+    fmt::print(fp, "  \"screen\": {{\"width\": {}, \"height\": {}, \"ball_radius\": {:.3f}}},\n",
+        config.screen_width, config.screen_height, config.ball_radius);
+    fmt::print(fp, "  \"miss_penalty\": {:.4f},\n", config.miss_penalty);
+    fmt::print(fp, "  \"trajectories\": [");
+    for (size_t i = 0; i < trajectories.size(); i++) {
+        const auto& trajectory = trajectories[i];
+        fmt::print(fp, "{}\n    {{\"name\": \"{}\", \"samples\": {}, \"falls\": {}, \"bounces\": {}, \"losses\": {}}}",
+            (i == 0) ? "" : ",", json_escape(trajectory.name), trajectory.observations.size(),
+            trajectory.total_falls, trajectory.total_bounces, trajectory.total_losses);
+    }
+    fmt::print(fp, "\n  ],\n");
+    fmt::print(fp, "  \"rounds\": [");
+    for (size_t i = 0; i < rounds.size(); i++) {
+        const auto& round = rounds[i];
+        fmt::print(fp, "{}\n    {{\"candidates\": {}, \"duration_secs\": {:.6f}, \"candidates_per_sec\": {:.3f}, \"best\": ",
+            (i == 0) ? "" : ",", round.total_candidates, round.duration_secs,
+            double(round.total_candidates) / round.duration_secs);
+        write_score(fp, round.best_score);
+        fmt::print(fp, "}}");
+    }
+    fmt::print(fp, "\n  ],\n");
+    fmt::print(fp, "  \"baseline\": {{\"params\": ");
+    write_params(fp, baseline.params);
+    fmt::print(fp, ", \"score\": ");
+    write_score(fp, baseline.score);
+    fmt::print(fp, "}},\n");
+    fmt::print(fp, "  \"best\": {{\"params\": ");
+    write_params(fp, top.front().params);
+    fmt::print(fp, ", \"score\": ");
+    write_score(fp, top.front().score);
+    fmt::print(fp, ", \"round\": {}}},\n", top.front().round);
+    fmt::print(fp, "  \"top\": [");
+    for (size_t i = 0; i < top.size(); i++) {
+        fmt::print(fp, "{}\n    {{\"params\": ", (i == 0) ? "" : ",");
+        write_params(fp, top[i].params);
+        fmt::print(fp, ", \"score\": ");
+        write_score(fp, top[i].score);
+        fmt::print(fp, ", \"round\": {}}}", top[i].round);
+    }
+    fmt::print(fp, "\n  ]\n}}\n");
+}
+
+int _main(int argc, char** argv) {
+    auto parser = argparse::ArgumentParser("SoccerBot Param Tuner", "1.0.0");
+    parser.add_argument("--trajectory")
+        .required()
+        .help("Comma separated list of recorded trajectories as csv or flight logs ending in .sbfl");
+    parser.add_argument("--estimator")
+        .default_value(std::string("difference"))
+        .help("Estimator to tune the params of. Options: [difference, kalman]");
+    parser.add_argument("--candidates")
+        .default_value(4096)
+        .scan<'i', int>()
+        .help("Number of candidate params to try in each round");
+    parser.add_argument("--rounds")
+        .default_value(3)
+        .scan<'i', int>()
+        .help("Number of rounds, each after the first searches half the range of the last around the best so far");
+    parser.add_argument("--seed")
+        .default_value(1)
+        .scan<'i', int>()
+        .help("Seed of the random candidates");
+    parser.add_argument("--threads")
+        .default_value(0)
+        .scan<'i', int>()
+        .help("Number of threads to evaluate candidates on. Uses every core if 0.");
+    parser.add_argument("--cpus")
+        .default_value(std::string(""))
+        .help("Logical processors to pin the threads to such as 0-3,6. Left to the os if not provided.");
+    parser.add_argument("--latency-ms")
+        .default_value(8.0f)
+        .scan<'g', float>()
+        .help("Delay between a frame being captured and the controller acting on it");
+    parser.add_argument("--input-latency-ms")
+        .default_value(20.0f)
+        .scan<'g', float>()
+        .help("Delay between the controller acting and the click landing in the game");
+    parser.add_argument("--screen-size")
+        .default_value(std::string("322x455"))
+        .help("Size in pixels of the window the trajectories were captured from");
+    parser.add_argument("--ball-radius")
+        .default_value(41.75f)
+        .scan<'g', float>()
+        .help("Radius of the ball in pixels that a click has to land within");
+    parser.add_argument("--relative-ball-width")
+        .default_value(-1.0f)
+        .scan<'g', float>()
+        .help("Ball width relative to the screen width for the estimator. If negative the gui default is used.");
+    parser.add_argument("--miss-penalty")
+        .default_value(0.01f)
+        .scan<'g', float>()
+        .help("Cost of a click that misses as a fraction of a caught fall");
+    parser.add_argument("--top")
+        .default_value(10)
+        .scan<'i', int>()
+        .help("Number of the best candidates to write");
+    parser.add_argument("--output")
+        .default_value(std::string(""))
+        .help("Path to write json results to. If not provided results are written to stdout.");
+
+    try {
+        parser.parse_args(argc, argv);
+    } catch (const std::runtime_error& ex) {
+        std::cerr << ex.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    auto options = TunerOptions{};
+    options.estimator_type = ParseEstimatorType(parser.get<std::string>("--estimator"));
+    options.total_candidates = parser.get<int>("--candidates");
+    options.total_rounds = parser.get<int>("--rounds");
+    options.seed = uint32_t(parser.get<int>("--seed"));
+    options.total_threads = parser.get<int>("--threads");
+    options.cpus = ParseCpuList(parser.get<std::string>("--cpus"));
+    options.total_top = parser.get<int>("--top");
+    auto& config = options.tuner;
+    config.latency_ms = parser.get<float>("--latency-ms");
+    config.input_latency_ms = parser.get<float>("--input-latency-ms");
+    config.ball_radius = parser.get<float>("--ball-radius");
+    config.miss_penalty = parser.get<float>("--miss-penalty");
+    {
+        const auto screen_size = parser.get<std::string>("--screen-size");
+        if (sscanf(screen_size.c_str(), "%dx%d", &config.screen_width, &config.screen_height) != 2) {
+            throw std::runtime_error(fmt::format("Screen size must be formatted as WIDTHxHEIGHT (got '{}')", screen_size));
+        }
+    }
+    if (options.total_candidates <= 0) {
+        throw std::runtime_error(fmt::format("Number of candidates must be positive (got {})", options.total_candidates));
+    }
+    if (options.total_rounds <= 0) {
+        throw std::runtime_error(fmt::format("Number of rounds must be positive (got {})", options.total_rounds));
+    }
+    if (options.total_top <= 0) {
+        throw std::runtime_error(fmt::format("Number of top candidates must be positive (got {})", options.total_top));
+    }
+    if ((config.latency_ms < 0.0f) || (config.input_latency_ms < 0.0f)) {
+        throw std::runtime_error(fmt::format(
+            "Latencies can't be negative (got latency={}ms, input={}ms)", config.latency_ms, config.input_latency_ms));
+    }
+    if (config.ball_radius <= 0.0f) {
+        throw std::runtime_error(fmt::format("Ball radius must be positive (got {})", config.ball_radius));
+    }
+
+    std::vector<TuningTrajectory> trajectories;
+    for (const auto& path: split_list(parser.get<std::string>("--trajectory"))) {
+        // flight logs have the raw predictions of the game without any ground truth
+        const auto samples = ends_with(path, ".sbfl") ? FlightLogReader(path.c_str()).LoadTrajectory() : LoadTrajectory(path.c_str());
+        trajectories.push_back(ParamTuner::PrepareTrajectory(config, path, samples));
+        const auto& trajectory = trajectories.back();
+        fmt::print(stderr, "Loaded {}: {} samples with {} falls ({} bounces, {} losses)\n",
+            path, samples.size(), trajectory.total_falls, trajectory.total_bounces, trajectory.total_losses);
+    }
+    if (trajectories.empty()) {
+        throw std::runtime_error("Expected at least one trajectory");
+    }
+
+    auto params = std::make_shared<SoccerParams>();
+    const float relative_ball_width = parser.get<float>("--relative-ball-width");
+    if (relative_ball_width >= 0.0f) {
+        params->relative_ball_width = relative_ball_width;
+    }
+
+    auto schedule = ThreadSchedule{};
+    schedule.cpus = options.cpus;
+    WorkStealingPool pool(options.total_threads, schedule);
+    std::vector<std::unique_ptr<ParamTuner>> tuners;
+    for (int i = 0; i < pool.GetTotalThreads(); i++) {
+        tuners.push_back(std::make_unique<ParamTuner>(config, options.estimator_type));
+    }
+
+    Candidate baseline;
+    baseline.params = *params;
+    baseline.score = tuners.front()->Evaluate(baseline.params, trajectories);
+    print_score("Baseline", baseline.score);
+
+    // the best candidates over every round
+    std::vector<Candidate> top;
+    top.push_back(baseline);
+    std::vector<RoundSummary> rounds;
+    std::mt19937 rng(options.seed);
+    for (int round = 0; round < options.total_rounds; round++) {
+        auto candidates = create_candidates(top.front().params, round, options.total_candidates, rng);
+        const auto dt_start = std::chrono::steady_clock::now();
+        evaluate_candidates(candidates, tuners, trajectories, pool);
+        const auto dt_end = std::chrono::steady_clock::now();
+
+        const auto is_better_candidate = [](const Candidate& a, const Candidate& b) { return is_better(a.score, b.score); };
+        const size_t total_kept = std::min(candidates.size(), size_t(options.total_top));
+        std::partial_sort(candidates.begin(), candidates.begin() + total_kept, candidates.end(), is_better_candidate);
+        top.insert(top.end(), candidates.begin(), candidates.begin() + total_kept);
+        std::stable_sort(top.begin(), top.end(), is_better_candidate);
+        top.resize(std::min(top.size(), size_t(options.total_top)));
+
+        RoundSummary summary;
+        summary.total_candidates = int(candidates.size());
+        summary.duration_secs = std::chrono::duration<double>(dt_end - dt_start).count();
+        summary.best_score = candidates.front().score;
+        rounds.push_back(summary);
+        fmt::print(stderr, "Round {}: {} candidates in {:.2f}s ({:.0f}/s) on {} threads\n",
+            round, summary.total_candidates, summary.duration_secs,
+            double(summary.total_candidates) / summary.duration_secs, pool.GetTotalThreads());
+        print_score("  Best of round", summary.best_score);
+    }
+    print_score("Best", top.front().score);
+
+    const auto output_path = parser.get<std::string>("--output");
+    if (output_path.empty()) {
+        write_results(stdout, options, trajectories, baseline, top, rounds, pool.GetTotalThreads());
+        fflush(stdout);
+        return 0;
+    }
+    FILE* fp = fopen(output_path.c_str(), "w");
+    if (fp == nullptr) {
+        throw std::runtime_error(fmt::format("Failed to open output file '{}'", output_path));
+    }
+    write_results(fp, options, trajectories, baseline, top, rounds, pool.GetTotalThreads());
+    fclose(fp);
+    fmt::print(stderr, "Wrote results to: {}\n", output_path);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    try {
+        return _main(argc, argv);
+    } catch (std::exception& ex) {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
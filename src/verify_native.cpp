@@ -0,0 +1,230 @@
+// Checks that a native model gives the same predictions as the onnx model it was converted alongside
+// Random inputs are run through onnxruntime one at a time and through the native engine at every batch size
+// so the layer kernels, the padded weight layouts and the batched path are all compared against a reference
+// Exits with an error if any prediction differs by more than the tolerance
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <argparse/argparse.hpp>
+#include <fmt/core.h>
+
+#include "Float16.h"
+#include "NativeModel.h"
+#include "OnnxDirectMLModel.h"
+
+struct VerifyOptions {
+    std::string native_path;
+    std::string onnx_path;
+    int total_samples = 64;
+    // native model is run at every batch size up to this
+    int max_batch_size = 4;
+    float tolerance = 1e-3f;
+    uint32_t seed = 1;
+};
+
+// largest absolute difference of each output over every sample
+struct PredictionError {
+    float x = 0.0f;
+    float y = 0.0f;
+    float confidence = 0.0f;
+};
+
+static float get_max_error(const PredictionError& error) {
+    return std::max(error.x, std::max(error.y, error.confidence));
+}
+
+static void update_error(PredictionError& error, const Prediction& expected, const Prediction& actual) {
+    error.x = std::max(error.x, std::abs(expected.x - actual.x));
+    error.y = std::max(error.y, std::abs(expected.y - actual.y));
+    error.confidence = std::max(error.confidence, std::abs(expected.confidence - actual.confidence));
+}
+
+// inputs are whole pixel values so that integer models see exactly the same image as float models
+static std::vector<float> create_input(std::mt19937& rng, const size_t total_values) {
+    std::uniform_int_distribution<int> pixel(0, 255);
+    std::vector<float> values(total_values);
+    for (auto& v: values) {
+        v = float(pixel(rng)) / 255.0f;
+    }
+    return values;
+}
+
+// src is a normalised (H,W,C) image that is converted to the type and layout of the buffer
+static void write_input(const InputBuffer& dst, const size_t batch_index, const std::vector<float>& src) {
+    const size_t width = dst.width;
+    const size_t height = dst.height;
+    const size_t total_values = width*height*3;
+    const auto get_index = [&](const size_t i) -> size_t {
+        if (dst.layout == InputLayout::INTERLEAVED) return i;
+        const size_t pixel = i / 3;
+        const size_t channel = i % 3;
+        return channel*width*height + pixel;
+    };
+    const auto quantise = [&](const float v, const int32_t min_value, const int32_t max_value) {
+        const int32_t q = int32_t(std::round(v / dst.quantization.scale)) + dst.quantization.zero_point;
+        return std::clamp(q, min_value, max_value);
+    };
+    switch (dst.type) {
+    case InputType::UINT8: {
+        uint8_t* data = reinterpret_cast<uint8_t*>(dst.data) + batch_index*total_values;
+        for (size_t i = 0; i < total_values; i++) data[get_index(i)] = uint8_t(quantise(src[i], 0, 255));
+        break;
+    }
+    case InputType::INT8: {
+        int8_t* data = reinterpret_cast<int8_t*>(dst.data) + batch_index*total_values;
+        for (size_t i = 0; i < total_values; i++) data[get_index(i)] = int8_t(quantise(src[i], -128, 127));
+        break;
+    }
+    case InputType::FLOAT16: {
+        uint16_t* data = reinterpret_cast<uint16_t*>(dst.data) + batch_index*total_values;
+        for (size_t i = 0; i < total_values; i++) data[get_index(i)] = float_to_half(src[i]);
+        break;
+    }
+    case InputType::FLOAT32:
+    default: {
+        float* data = reinterpret_cast<float*>(dst.data) + batch_index*total_values;
+        for (size_t i = 0; i < total_values; i++) data[get_index(i)] = src[i];
+        break;
+    }
+    }
+}
+
+int _main(int argc, char** argv) {
+    auto parser = argparse::ArgumentParser("SoccerBot Native Model Verifier", "1.0.0");
+    parser.add_argument("--native")
+        .required()
+        .help("Native model (.bin) to verify");
+    parser.add_argument("--onnx")
+        .required()
+        .help("Onnx model (.onnx) exported from the same checkpoint which is used as the reference");
+    parser.add_argument("--samples")
+        .default_value(64)
+        .scan<'i', int>()
+        .help("Number of random inputs to compare");
+    parser.add_argument("--max-batch-size")
+        .default_value(4)
+        .scan<'i', int>()
+        .help("Native model is run at every batch size from 1 up to this");
+    parser.add_argument("--tolerance")
+        .default_value(1e-3f)
+        .scan<'g', float>()
+        .help("Largest absolute difference allowed between any output of the two models");
+    parser.add_argument("--seed")
+        .default_value(1)
+        .scan<'i', int>()
+        .help("Seed of the random inputs");
+
+    try {
+        parser.parse_args(argc, argv);
+    } catch (const std::runtime_error& ex) {
+        std::cerr << ex.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    auto options = VerifyOptions{};
+    options.native_path = parser.get<std::string>("--native");
+    options.onnx_path = parser.get<std::string>("--onnx");
+    options.total_samples = parser.get<int>("--samples");
+    options.max_batch_size = parser.get<int>("--max-batch-size");
+    options.tolerance = parser.get<float>("--tolerance");
+    options.seed = uint32_t(parser.get<int>("--seed"));
+    if (options.total_samples <= 0) {
+        throw std::runtime_error(fmt::format("Number of samples must be positive (got {})", options.total_samples));
+    }
+    if (options.max_batch_size <= 0) {
+        throw std::runtime_error(fmt::format("Max batch size must be positive (got {})", options.max_batch_size));
+    }
+    if (options.tolerance < 0.0f) {
+        throw std::runtime_error(fmt::format("Tolerance can't be negative (got {})", options.tolerance));
+    }
+
+    NativeModel native_model(options.native_path.c_str(), size_t(options.max_batch_size));
+    // NOTE: The reference runs one input at a time so the onnx model doesn't need a dynamic batch axis
+    auto onnx_options = OnnxDirectMLModel::CPU_Options{};
+    onnx_options.total_threads = 1;
+    onnx_options.is_sequential = true;
+    OnnxDirectMLModel onnx_model(options.onnx_path.c_str(), onnx_options);
+
+    const auto onnx_input = onnx_model.GetInputBuffer();
+    const auto native_input = native_model.GetInputBuffer();
+    if ((onnx_input.width != native_input.width) || (onnx_input.height != native_input.height)) {
+        throw std::runtime_error(fmt::format(
+            "Native model takes {}x{} inputs but onnx model takes {}x{}",
+            native_input.width, native_input.height, onnx_input.width, onnx_input.height));
+    }
+    fmt::print(stderr, "Comparing {} and {} on {} random {}x{} inputs with onnx input of {}\n",
+        options.native_path, options.onnx_path, options.total_samples,
+        native_input.width, native_input.height, GetInputTypeString(onnx_input.type));
+
+    std::mt19937 rng(options.seed);
+    const size_t total_values = native_input.width*native_input.height*3;
+    std::vector<std::vector<float>> inputs;
+    std::vector<Prediction> expected;
+    for (int i = 0; i < options.total_samples; i++) {
+        inputs.push_back(create_input(rng, total_values));
+        write_input(onnx_model.GetInputBuffer(), 0, inputs.back());
+        onnx_model.Parse();
+        expected.push_back(onnx_model.GetPrediction());
+    }
+
+    bool is_match = true;
+    for (int batch_size = 1; batch_size <= options.max_batch_size; batch_size++) {
+        PredictionError error;
+        int worst_sample = 0;
+        Prediction worst_actual;
+        for (int start = 0; start < options.total_samples; start += batch_size) {
+            const int total_batch = std::min(batch_size, options.total_samples - start);
+            native_model.SetBatchSize(size_t(total_batch));
+            // NOTE: Changing the batch size can move the input buffer
+            const auto input = native_model.GetInputBuffer();
+            for (int i = 0; i < total_batch; i++) {
+                write_input(input, size_t(i), inputs[size_t(start+i)]);
+            }
+            native_model.Parse();
+            for (int i = 0; i < total_batch; i++) {
+                const float max_error = get_max_error(error);
+                const auto actual = native_model.GetBatchPrediction(size_t(i));
+                update_error(error, expected[size_t(start+i)], actual);
+                if (get_max_error(error) > max_error) {
+                    worst_sample = start+i;
+                    worst_actual = actual;
+                }
+            }
+        }
+        const bool is_batch_match = get_max_error(error) <= options.tolerance;
+        is_match = is_match && is_batch_match;
+        const auto& worst_expected = expected[size_t(worst_sample)];
+        fmt::print("batch_size={}: max_error x={:.3e} y={:.3e} confidence={:.3e} {}\n",
+            batch_size, error.x, error.y, error.confidence, is_batch_match ? "ok" : "MISMATCH");
+        if (!is_batch_match) {
+            fmt::print("    worst sample {} expected (x={:.4f}, y={:.4f}, confidence={:.4f}) but got (x={:.4f}, y={:.4f}, confidence={:.4f})\n",
+                worst_sample, worst_expected.x, worst_expected.y, worst_expected.confidence,
+                worst_actual.x, worst_actual.y, worst_actual.confidence);
+        }
+    }
+
+    if (!is_match) {
+        fmt::print(stderr, "Native model doesn't match the onnx model within a tolerance of {:.3e}\n", options.tolerance);
+        return 1;
+    }
+    fmt::print(stderr, "Native model matches the onnx model within a tolerance of {:.3e}\n", options.tolerance);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    try {
+        return _main(argc, argv);
+    } catch (std::exception& ex) {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}